@@ -21,6 +21,15 @@ void CommandLineArgs::parse(int argc, char* argv[]) {
         {"mask_layer_datatype", required_argument, nullptr, 'd'},
         {"input_layers", required_argument, nullptr, 'i'},
         {"db_name", required_argument, nullptr, 'n'},
+        {"use_index", no_argument, nullptr, 'x'},
+        {"reader_threads", required_argument, nullptr, 't'},
+        {"hierarchical_capture", no_argument, nullptr, 'c'},
+        {"stream_mask_layer", no_argument, nullptr, 's'},
+        {"dbu_geometry", no_argument, nullptr, 'u'},
+        {"flat_layers", no_argument, nullptr, 'f'},
+        {"use_cache", no_argument, nullptr, 'a'},
+        {"export_gds", required_argument, nullptr, 'e'},
+        {"top_cell", required_argument, nullptr, 'T'},
         {nullptr, 0, nullptr, 0}
     };
 
@@ -31,7 +40,7 @@ void CommandLineArgs::parse(int argc, char* argv[]) {
     std::cout << std::endl;
 
     int opt;
-    while ((opt = getopt_long(argc, argv, "l:m:d:i:n:", long_options, nullptr)) != -1) {
+    while ((opt = getopt_long(argc, argv, "l:m:d:i:n:xt:csufae:T:", long_options, nullptr)) != -1) {
         try {
             switch (opt) {
                 case 'l':
@@ -62,6 +71,47 @@ void CommandLineArgs::parse(int argc, char* argv[]) {
                     db_name = optarg;
                     std::cout << "Parsed db_name: " << db_name << std::endl;
                     break;
+                case 'x':
+                    use_index = true;
+                    std::cout << "Parsed use_index: enabled" << std::endl;
+                    break;
+                case 't': {
+                    std::string arg(optarg);
+                    if (arg.empty()) throw std::invalid_argument("Empty reader_threads");
+                    reader_threads = std::stoi(arg);
+                    if (reader_threads < 1) throw std::invalid_argument("reader_threads must be at least 1");
+                    std::cout << "Parsed reader_threads: " << reader_threads << std::endl;
+                    break;
+                }
+                case 'c':
+                    hierarchical_capture = true;
+                    std::cout << "Parsed hierarchical_capture: enabled" << std::endl;
+                    break;
+                case 's':
+                    stream_mask_layer = true;
+                    std::cout << "Parsed stream_mask_layer: enabled" << std::endl;
+                    break;
+                case 'u':
+                    dbu_geometry = true;
+                    std::cout << "Parsed dbu_geometry: enabled" << std::endl;
+                    break;
+                case 'f':
+                    flat_layers = true;
+                    std::cout << "Parsed flat_layers: enabled" << std::endl;
+                    break;
+                case 'a':
+                    use_cache = true;
+                    std::cout << "Parsed use_cache: enabled" << std::endl;
+                    break;
+                case 'e':
+                    export_gds = optarg;
+                    std::cout << "Parsed export_gds: " << export_gds << std::endl;
+                    break;
+                case 'T':
+                    top_cell = optarg;
+                    if (top_cell.empty()) throw std::invalid_argument("Empty top_cell");
+                    std::cout << "Parsed top_cell: " << top_cell << std::endl;
+                    break;
                 case '?':
                     std::cerr << "Error: Unrecognized option" << std::endl;
                     throw std::runtime_error("Unrecognized option");
@@ -92,6 +142,15 @@ void CommandLineArgs::parse(int argc, char* argv[]) {
     }
     std::cout << std::endl;
     std::cout << "  Database name: " << db_name << std::endl;
+    std::cout << "  Layout index: " << (use_index ? "enabled" : "disabled") << std::endl;
+    std::cout << "  Reader threads: " << reader_threads << std::endl;
+    std::cout << "  Hierarchical capture: " << (hierarchical_capture ? "enabled" : "disabled") << std::endl;
+    std::cout << "  Stream mask layer: " << (stream_mask_layer ? "enabled" : "disabled") << std::endl;
+    std::cout << "  Database-unit geometry: " << (dbu_geometry ? "enabled" : "disabled") << std::endl;
+    std::cout << "  Flat layer layout: " << (flat_layers ? "enabled" : "disabled") << std::endl;
+    std::cout << "  Layer cache: " << (use_cache ? "enabled" : "disabled") << std::endl;
+    std::cout << "  Pattern export: " << (export_gds.empty() ? "disabled" : export_gds) << std::endl;
+    std::cout << "  Top cell: " << (top_cell.empty() ? "all" : top_cell) << std::endl;
 }
 
 std::vector<std::pair<int, int>> CommandLineArgs::parseInputLayers(const std::string& input_layers_str) {
@@ -12,6 +12,15 @@ public:
     int mask_layer_datatype = -1;
     std::vector<std::pair<int, int>> input_layers;
     std::string db_name;
+    bool use_index = false; // Build/reuse the layout's .dfmidx sidecar index
+    int reader_threads = 1; // Threads used to parse the layout file
+    bool hierarchical_capture = false; // Capture repeated cell instances once (hierarchical layouts)
+    bool stream_mask_layer = false; // Capture mask polygons as they are read instead of loading the mask layer first
+    bool dbu_geometry = false; // Keep integer database-unit coordinates and AND them with the integer kernel
+    bool flat_layers = false; // Load the input layers into the flat structure-of-arrays layout and clip from it
+    bool use_cache = false; // Build/reuse the layout's .dfmcache sidecar cache of parsed layers
+    std::string export_gds; // Also write the captured patterns to this GDSII file, one structure each
+    std::string top_cell; // Capture only the geometry reachable from this cell, in its coordinates
 private:
     void parse(int argc, char* argv[]);
     std::vector<std::pair<int, int>> parseInputLayers(const std::string& input_layers_str);
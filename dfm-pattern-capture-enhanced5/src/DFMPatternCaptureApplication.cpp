@@ -1,11 +1,163 @@
 #include "DFMPatternCaptureApplication.h"
 #include "LayoutFileReader.h"
+#include "LayoutFileWriter.h"
 #include "GeometryProcessor.h"
 #include "../shared/DatabaseManager.h"
 #include "Utils.h"
 #include <sstream>
 #include <Logging.h>
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
+#include <iterator>
+#include <map>
+
+namespace {
+
+// Uniform grid over the bounding boxes of a layer's polygons; repeated shapes are counted
+// through their own bounding-box query
+class BoxGrid {
+public:
+    explicit BoxGrid(const Layer& layer) : repetitions_(layer.repetitions) {
+        for (const auto& poly : layer.polygons) {
+            if (poly.points.empty()) continue;
+            const BoundingBox& box = poly.bbox;
+            if (boxes_.empty()) {
+                extent_ = box;
+            }
+            extent_.min_x = std::min(extent_.min_x, box.min_x);
+            extent_.min_y = std::min(extent_.min_y, box.min_y);
+            extent_.max_x = std::max(extent_.max_x, box.max_x);
+            extent_.max_y = std::max(extent_.max_y, box.max_y);
+            boxes_.push_back(box);
+        }
+        if (boxes_.empty()) return;
+        columns_ = rows_ = std::clamp(static_cast<int>(std::sqrt(static_cast<double>(boxes_.size()))), 1, 1024);
+        cell_width_ = std::max((extent_.max_x - extent_.min_x) / columns_, 1e-9);
+        cell_height_ = std::max((extent_.max_y - extent_.min_y) / rows_, 1e-9);
+        bins_.resize(static_cast<size_t>(columns_) * rows_);
+        for (size_t i = 0; i < boxes_.size(); ++i) {
+            for (int r = row(boxes_[i].min_y); r <= row(boxes_[i].max_y); ++r) {
+                for (int c = column(boxes_[i].min_x); c <= column(boxes_[i].max_x); ++c) {
+                    bins_[r * columns_ + c].push_back(i);
+                }
+            }
+        }
+    }
+
+    // Number of polygons whose bounding box touches box
+    size_t countOverlapping(const BoundingBox& box) const {
+        size_t count = 0;
+        for (const auto& repetition : repetitions_) {
+            count += repetition.overlappingOffsets(box.min_x, box.min_y, box.max_x, box.max_y).size();
+        }
+        if (boxes_.empty()) return count;
+        int c0 = column(box.min_x), c1 = column(box.max_x);
+        int r0 = row(box.min_y), r1 = row(box.max_y);
+        for (int r = r0; r <= r1; ++r) {
+            for (int c = c0; c <= c1; ++c) {
+                for (size_t i : bins_[r * columns_ + c]) {
+                    const BoundingBox& b = boxes_[i];
+                    if (b.max_x < box.min_x || b.min_x > box.max_x || b.max_y < box.min_y || b.min_y > box.max_y) {
+                        continue;
+                    }
+                    // Count each box only in the first bin it shares with the query
+                    if (std::max(column(b.min_x), c0) == c && std::max(row(b.min_y), r0) == r) {
+                        count++;
+                    }
+                }
+            }
+        }
+        return count;
+    }
+
+private:
+    int column(double x) const {
+        return std::clamp(static_cast<int>(std::floor((x - extent_.min_x) / cell_width_)), 0, columns_ - 1);
+    }
+    int row(double y) const {
+        return std::clamp(static_cast<int>(std::floor((y - extent_.min_y) / cell_height_)), 0, rows_ - 1);
+    }
+
+    const std::vector<ShapeRepetition>& repetitions_;
+    std::vector<BoundingBox> boxes_;
+    BoundingBox extent_{0.0, 0.0, 0.0, 0.0};
+    int columns_ = 1, rows_ = 1;
+    double cell_width_ = 1.0, cell_height_ = 1.0;
+    std::vector<std::vector<size_t>> bins_;
+};
+
+// Places cell-local geometry in user units; the transform is in database units
+Point placePoint(const Point& p, const CellTransform& t, double unit_scale) {
+    return Point(t.xx * p.x + t.xy * p.y + t.dx * unit_scale, t.yx * p.x + t.yy * p.y + t.dy * unit_scale);
+}
+
+BoundingBox placeBox(const BoundingBox& box, const CellTransform& t, double unit_scale) {
+    Point a = placePoint(Point(box.min_x, box.min_y), t, unit_scale);
+    Point b = placePoint(Point(box.max_x, box.max_y), t, unit_scale);
+    return {std::min(a.x, b.x), std::min(a.y, b.y), std::max(a.x, b.x), std::max(a.y, b.y)};
+}
+
+// Moves a polygon captured in cell-local coordinates to one occurrence; grid isometries keep area,
+// perimeter and validity, map bounding boxes exactly onto bounding boxes, and reverse the orientation
+// when they mirror
+void placePolygon(Polygon& poly, const CellTransform& t, double unit_scale) {
+    for (auto& p : poly.points) {
+        p = placePoint(p, t, unit_scale);
+    }
+    poly.bbox = placeBox(poly.bbox, t, unit_scale);
+    poly.clockwise = poly.clockwise != (t.xx * t.yy - t.xy * t.yx < 0.0);
+}
+
+// Moves a pattern captured in cell-local coordinates to one occurrence
+void placePattern(MultiLayerPattern& pattern, const CellTransform& t, double unit_scale) {
+    placePolygon(pattern.mask_polygon, t, unit_scale);
+    for (auto& layer : pattern.input_layers) {
+        for (auto& poly : layer.polygons) {
+            placePolygon(poly, t, unit_scale);
+        }
+        layer.calculateBounds();
+    }
+}
+
+// Placement from the occurrence at first to the one at other. Both are grid isometries, so the
+// inverse of first is its transpose and the offsets stay exact integers until they are scaled.
+PatternPlacement relativePlacement(const CellTransform& first, const CellTransform& other, double unit_scale) {
+    CellTransform inverse;
+    inverse.xx = first.xx;
+    inverse.xy = first.yx;
+    inverse.yx = first.xy;
+    inverse.yy = first.yy;
+    inverse.dx = -(first.xx * first.dx + first.yx * first.dy);
+    inverse.dy = -(first.xy * first.dx + first.yy * first.dy);
+    CellTransform t = other * inverse;
+    return {t.xx, t.xy, t.yx, t.yy, t.dx * unit_scale, t.dy * unit_scale};
+}
+
+// Logs what the reader's catalog measured for a layer while loading it. Without catalog statistics
+// (OASIS, the layer cache), or when they are of cell shapes before flattening, the loaded polygons
+// are measured instead.
+void logLayerStatistics(const LayoutCatalog& catalog, const Layer& layer) {
+    const LayerStatistics* stats = catalog.find(layer.layer_number, layer.datatype);
+    std::ostringstream oss;
+    if (catalog.measured && stats) {
+        oss << "  Vertices: " << stats->vertex_count << ", area: " << stats->total_area
+            << ", estimated memory: " << (stats->estimatedBytes() >> 10) << " KB";
+        LOG_INFO(oss.str());
+        oss.str("");
+        oss << "  Invalid polygons skipped by the reader: " << stats->invalid_count;
+        LOG_INFO(oss.str());
+        if (!catalog.hierarchical) {
+            return;
+        }
+        LOG_INFO("  Counts are of shapes drawn in their cells, before flattening");
+        oss.str("");
+    }
+    oss << "  Loaded vertices: " << layer.getVertexCount() << ", area: " << layer.getTotalArea();
+    LOG_INFO(oss.str());
+}
+
+} // namespace
 
 DFMPatternCaptureApplication::DFMPatternCaptureApplication(const CommandLineArgs& args)
     : args_(args), db_manager_(args.db_name, "", "", "localhost", "5432",
@@ -18,24 +170,54 @@ DFMPatternCaptureApplication::DFMPatternCaptureApplication(const CommandLineArgs
     }
 }
 
-void DFMPatternCaptureApplication::load_mask_layer(Layer &mask_layer, LayoutFileReader &reader) {
+void DFMPatternCaptureApplication::load_layers(Layer &mask_layer, std::vector<Layer> &input_layers, LayoutFileReader &reader) {
     LOG_FUNCTION();
-    mask_layer = reader.loadLayer(args_.mask_layer_number, args_.mask_layer_datatype);
-    size_t mask_total_polygons = mask_layer.polygons.size();
-    size_t mask_invalid_small_area = 0;
-    for (const auto& poly : mask_layer.polygons) {
-        if (!poly.isValid()) {
-            double temp_area = 0.0;
-            for (size_t i = 0; i < poly.points.size(); ++i) {
-                size_t j = (i + 1) % poly.points.size();
-                temp_area += poly.points[i].x * poly.points[j].y - poly.points[j].x * poly.points[i].y;
-            }
-            temp_area = std::abs(temp_area) / 2.0;
-            if (temp_area < 1e-9) {
-                mask_invalid_small_area++;
-            }
+    // A catalog known before the load (from the layout index) tells which layers hold no polygons
+    const LayoutCatalog* catalog = reader.hasCatalog() ? &reader.getCatalog() : nullptr;
+    auto known_empty = [catalog](int layer_num, int datatype) {
+        if (!catalog || !catalog->measured) return false;
+        const LayerStatistics* stats = catalog->find(layer_num, datatype);
+        return !stats || stats->empty();
+    };
+    if (known_empty(args_.mask_layer_number, args_.mask_layer_datatype)) {
+        std::ostringstream oss;
+        oss << "No polygons in mask layer " << args_.mask_layer_number << ":" << args_.mask_layer_datatype;
+        throw std::runtime_error(oss.str());
+    }
+
+    // Mask layer first, then the non-empty input layers in command-line order, all read in one pass
+    std::vector<std::pair<int, int>> requested;
+    requested.emplace_back(args_.mask_layer_number, args_.mask_layer_datatype);
+    for (const auto& [layer_num, datatype] : args_.input_layers) {
+        if (known_empty(layer_num, datatype)) {
+            std::ostringstream oss;
+            oss << "Skipping input layer " << layer_num << ":" << datatype << ", the catalog shows no polygons";
+            LOG_INFO(oss.str());
+            continue;
         }
+        requested.emplace_back(layer_num, datatype);
     }
+    std::vector<Layer> loaded_layers = reader.loadLayers(requested);
+
+    load_mask_layer(mask_layer, loaded_layers.front(), reader.getCatalog());
+    std::vector<Layer> loaded_inputs;
+    size_t next = 1;
+    for (const auto& [layer_num, datatype] : args_.input_layers) {
+        if (next < requested.size() && requested[next] == std::make_pair(layer_num, datatype)) {
+            loaded_inputs.push_back(std::move(loaded_layers[next++]));
+        } else {
+            loaded_inputs.emplace_back(layer_num, datatype);
+        }
+    }
+    load_input_layers(input_layers, loaded_inputs, reader.getCatalog());
+}
+
+void DFMPatternCaptureApplication::load_mask_layer(Layer &mask_layer, Layer &loaded_layer, const LayoutCatalog &catalog) {
+    LOG_FUNCTION();
+    mask_layer = std::move(loaded_layer);
+    // Every mask polygon becomes its own pattern, so repeated mask shapes are expanded
+    mask_layer.expandRepetitions();
+    size_t mask_total_polygons = mask_layer.polygons.size();
     std::ostringstream oss;
     oss << "Loaded mask layer " << args_.mask_layer_number << ":" << args_.mask_layer_datatype
         << " with " << mask_total_polygons << " polygons";
@@ -44,9 +226,7 @@ void DFMPatternCaptureApplication::load_mask_layer(Layer &mask_layer, LayoutFile
     oss.str("");
     oss << "  Total polygons: " << mask_total_polygons;
     LOG_INFO(oss.str());
-    oss.str("");
-    oss << "  Invalid polygons (small area < 1e-9): " << mask_invalid_small_area;
-    LOG_INFO(oss.str());
+    logLayerStatistics(catalog, mask_layer);
     LOG_INFO("===========================================================================================");
     if (mask_layer.polygons.empty()) {
         oss.str("");
@@ -55,25 +235,12 @@ void DFMPatternCaptureApplication::load_mask_layer(Layer &mask_layer, LayoutFile
     }
 }
 
-unsigned int DFMPatternCaptureApplication::load_input_layers(std::vector<Layer> &input_layers, LayoutFileReader &reader) {    
+unsigned int DFMPatternCaptureApplication::load_input_layers(std::vector<Layer> &input_layers, std::vector<Layer> &loaded_layers, const LayoutCatalog &catalog) {
     LOG_FUNCTION();
-    for (const auto& [layer_num, datatype] : args_.input_layers) {
-        Layer input_layer = reader.loadLayer(layer_num, datatype);
-        size_t input_total_polygons = input_layer.polygons.size();
-        size_t input_invalid_small_area = 0;
-        for (const auto& poly : input_layer.polygons) {
-            if (!poly.isValid()) {
-                double temp_area = 0.0;
-                for (size_t i = 0; i < poly.points.size(); ++i) {
-                    size_t j = (i + 1) % poly.points.size();
-                    temp_area += poly.points[i].x * poly.points[j].y - poly.points[j].x * poly.points[i].y;
-                }
-                temp_area = std::abs(temp_area) / 2.0;
-                if (temp_area < 1e-9) {
-                    input_invalid_small_area++;
-                }
-            }
-        }
+    for (size_t k = 0; k < args_.input_layers.size(); ++k) {
+        const auto& [layer_num, datatype] = args_.input_layers[k];
+        Layer &input_layer = loaded_layers[k];
+        size_t input_total_polygons = input_layer.getPolygonCount();
         std::ostringstream oss;
         oss << "Loaded input layer " << layer_num << ":" << datatype
             << " with " << input_total_polygons << " polygons";
@@ -84,11 +251,9 @@ unsigned int DFMPatternCaptureApplication::load_input_layers(std::vector<Layer>
         oss.str("");
         oss << "  Total polygons: " << input_total_polygons;
         LOG_INFO(oss.str());
-        oss.str("");
-        oss << "  Invalid polygons (small area < 1e-9): " << input_invalid_small_area;
-        LOG_INFO(oss.str());
+        logLayerStatistics(catalog, input_layer);
         
-        if (input_layer.polygons.empty()) {
+        if (input_total_polygons == 0) {
             oss.str("");
             oss << "No polygons loaded for input layer " << layer_num << ":" << datatype;
             LOG_WARN(oss.str());
@@ -96,28 +261,28 @@ unsigned int DFMPatternCaptureApplication::load_input_layers(std::vector<Layer>
             input_layers.push_back(empty_layer);
             continue;
         }
-        input_layers.push_back(input_layer);
+        input_layers.push_back(std::move(input_layer));
     }
     return 0;
 }
 
-unsigned int DFMPatternCaptureApplication::process_mask_layer_polygon(Polygon &mask_polygon, std::vector<Layer> &input_layers, MultiLayerPattern &captured_pattern) {
+unsigned int DFMPatternCaptureApplication::process_mask_layer_polygon(const Polygon &mask_polygon, std::vector<Layer> &input_layers, MultiLayerPattern &captured_pattern) {
     LOG_FUNCTION();
     GeometryProcessor processor;
     size_t i = 0;
     for (const auto& [layer_num, datatype] : args_.input_layers) {
         Layer &input_layer = input_layers[i];
-        Layer result_layer = processor.performANDOperation(mask_polygon, input_layer);
+        Layer result_layer = processor.performANDOperation(mask_polygon, input_layer, capture_arena_);
         std::ostringstream oss;
         oss << "AND operation for layer " << result_layer.layer_number << ":"
             << result_layer.datatype << " resulted in " << result_layer.polygons.size() << " polygons";
         LOG_INFO(oss.str());
         
         if (!result_layer.polygons.empty()) {
-            captured_pattern.input_layers.push_back(result_layer);
             oss.str("");
             oss << "Added layer " << result_layer.layer_number << ":" << result_layer.datatype
                 << " to pattern with " << result_layer.polygons.size() << " polygons";
+            captured_pattern.input_layers.push_back(std::move(result_layer));
             LOG_INFO(oss.str());
         } else {
             oss.str("");
@@ -137,7 +302,7 @@ unsigned int DFMPatternCaptureApplication::process_mask_layer_polygons(Layer &ma
     size_t valid_mask_polygons = 0;
 
     for (size_t i = 0; i < mask_total_polygons; ++i) {
-        Polygon current_mask_polygon = mask_layer.polygons[i];
+        const Polygon& current_mask_polygon = mask_layer.polygons[i];
         
         if (!current_mask_polygon.isValid()) {
             std::ostringstream oss;
@@ -153,18 +318,7 @@ unsigned int DFMPatternCaptureApplication::process_mask_layer_polygons(Layer &ma
             continue;
         }
 
-        MultiLayerPattern current_captured_pattern;
-        current_captured_pattern.pattern_id = Utils::generatePatternId(args_.mask_layer_number,
-                                                                     args_.mask_layer_datatype,
-                                                                     current_mask_polygon,
-                                                                     args_.input_layers);
-        current_captured_pattern.mask_layer_number = args_.mask_layer_number;
-        current_captured_pattern.mask_layer_datatype = args_.mask_layer_datatype;
-        current_captured_pattern.mask_polygon = current_mask_polygon;
-        current_captured_pattern.created_at = std::chrono::system_clock::now();
-
-        process_mask_layer_polygon(current_mask_polygon, input_layers, current_captured_pattern);
-        captured_patterns.push_back(current_captured_pattern);
+        captured_patterns.push_back(capture_pattern(current_mask_polygon, input_layers));
         valid_mask_polygons++;
     }
 
@@ -175,14 +329,232 @@ unsigned int DFMPatternCaptureApplication::process_mask_layer_polygons(Layer &ma
     return 0;
 }
 
+unsigned int DFMPatternCaptureApplication::process_mask_layer_stream(LayoutFileReader &reader, std::vector<Layer> &input_layers, std::vector<MultiLayerPattern> &captured_patterns) {
+    LOG_FUNCTION();
+    size_t mask_total_polygons = 0;
+    reader.forEachPolygon(args_.mask_layer_number, args_.mask_layer_datatype, [&](const Polygon &mask_polygon) {
+        // The reader only hands out valid polygons
+        captured_patterns.push_back(capture_pattern(mask_polygon, input_layers));
+        mask_total_polygons++;
+    });
+
+    std::ostringstream oss;
+    oss << "Processed " << mask_total_polygons << " mask polygons streamed from layer "
+        << args_.mask_layer_number << ":" << args_.mask_layer_datatype;
+    LOG_INFO(oss.str());
+    if (mask_total_polygons == 0) {
+        oss.str("");
+        oss << "No polygons in mask layer " << args_.mask_layer_number << ":" << args_.mask_layer_datatype;
+        throw std::runtime_error(oss.str());
+    }
+    return 0;
+}
+
+unsigned int DFMPatternCaptureApplication::process_mask_layer_dbu(const std::vector<DbuLayer> &dbu_layers, std::vector<MultiLayerPattern> &captured_patterns) {
+    LOG_FUNCTION();
+    const DbuLayer &mask_layer = dbu_layers.front();
+    if (mask_layer.polygons.empty()) {
+        std::ostringstream oss;
+        oss << "No polygons in mask layer " << args_.mask_layer_number << ":" << args_.mask_layer_datatype;
+        throw std::runtime_error(oss.str());
+    }
+    std::vector<DbuLayer> input_layers(dbu_layers.begin() + 1, dbu_layers.end());
+
+    size_t valid_mask_polygons = 0;
+    for (const auto& mask_dbu : mask_layer.polygons) {
+        if (!mask_dbu.isValid()) continue;
+        MultiLayerPattern captured_pattern;
+        captured_pattern.mask_polygon = mask_dbu.toUser(mask_layer.unit_scale);
+        captured_pattern.pattern_id = Utils::generatePatternId(args_.mask_layer_number, args_.mask_layer_datatype,
+                                                               captured_pattern.mask_polygon, args_.input_layers);
+        captured_pattern.mask_layer_number = args_.mask_layer_number;
+        captured_pattern.mask_layer_datatype = args_.mask_layer_datatype;
+        captured_pattern.created_at = std::chrono::system_clock::now();
+        for (const auto& input_layer : input_layers) {
+            DbuLayer result_layer = GeometryProcessor::performANDOperation(mask_dbu, input_layer);
+            captured_pattern.input_layers.push_back(result_layer.toUser());
+        }
+        captured_patterns.push_back(std::move(captured_pattern));
+        valid_mask_polygons++;
+    }
+
+    std::ostringstream oss;
+    oss << "Processed " << valid_mask_polygons << " valid mask polygons out of " << mask_layer.polygons.size()
+        << " total mask polygons in database units";
+    LOG_INFO(oss.str());
+    return 0;
+}
+
+unsigned int DFMPatternCaptureApplication::process_mask_layer_flat(Layer &mask_layer, const std::vector<FlatLayer> &input_layers, std::vector<MultiLayerPattern> &captured_patterns) {
+    LOG_FUNCTION();
+    size_t valid_mask_polygons = 0;
+    for (const auto& mask_polygon : mask_layer.polygons) {
+        if (!mask_polygon.isValid()) continue;
+        MultiLayerPattern captured_pattern;
+        captured_pattern.pattern_id = Utils::generatePatternId(args_.mask_layer_number, args_.mask_layer_datatype,
+                                                               mask_polygon, args_.input_layers);
+        captured_pattern.mask_layer_number = args_.mask_layer_number;
+        captured_pattern.mask_layer_datatype = args_.mask_layer_datatype;
+        captured_pattern.mask_polygon = mask_polygon;
+        captured_pattern.created_at = std::chrono::system_clock::now();
+        for (const auto& input_layer : input_layers) {
+            captured_pattern.flat_input_layers.push_back(
+                GeometryProcessor::performANDOperation(mask_polygon, input_layer));
+        }
+        captured_patterns.push_back(std::move(captured_pattern));
+        valid_mask_polygons++;
+    }
+
+    std::ostringstream oss;
+    oss << "Processed " << valid_mask_polygons << " valid mask polygons out of " << mask_layer.polygons.size()
+        << " total mask polygons against the flat layer layout";
+    LOG_INFO(oss.str());
+    return 0;
+}
+
+MultiLayerPattern DFMPatternCaptureApplication::capture_pattern(const Polygon &mask_polygon, std::vector<Layer> &input_layers) {
+    MultiLayerPattern captured_pattern;
+    captured_pattern.pattern_id = Utils::generatePatternId(args_.mask_layer_number,
+                                                           args_.mask_layer_datatype,
+                                                           mask_polygon,
+                                                           args_.input_layers);
+    captured_pattern.mask_layer_number = args_.mask_layer_number;
+    captured_pattern.mask_layer_datatype = args_.mask_layer_datatype;
+    captured_pattern.mask_polygon = mask_polygon;
+    captured_pattern.created_at = std::chrono::system_clock::now();
+
+    process_mask_layer_polygon(mask_polygon, input_layers, captured_pattern);
+    return captured_pattern;
+}
+
+unsigned int DFMPatternCaptureApplication::process_mask_layer_cells(const LayoutHierarchy &hierarchy, std::vector<Layer> &input_layers, std::vector<MultiLayerPattern> &captured_patterns) {
+    LOG_FUNCTION();
+    const std::pair<int, int> mask_key(args_.mask_layer_number, args_.mask_layer_datatype);
+    std::map<std::pair<int, int>, size_t> input_slots;
+    for (size_t k = 0; k < args_.input_layers.size(); ++k) {
+        input_slots.emplace(args_.input_layers[k], k);
+    }
+    std::vector<BoxGrid> flat_grids;
+    for (const auto& layer : input_layers) {
+        flat_grids.emplace_back(layer);
+    }
+
+    size_t unique_contexts = 0, reused_occurrences = 0, flat_occurrences = 0, mask_shape_count = 0;
+    for (int cell_index = 0; cell_index < static_cast<int>(hierarchy.cellCount()); ++cell_index) {
+        const Cell& cell = hierarchy.cell(cell_index);
+        PolygonList mask_shapes;
+        auto shapes = cell.shapes.find(mask_key);
+        if (shapes != cell.shapes.end()) {
+            mask_shapes = shapes->second;
+        }
+        auto repetitions = cell.repetitions.find(mask_key);
+        if (repetitions != cell.repetitions.end()) {
+            for (const auto& repetition : repetitions->second) {
+                repetition.expand(mask_shapes);
+            }
+        }
+        if (mask_shapes.empty()) continue;
+        mask_shape_count += mask_shapes.size();
+        std::vector<CellTransform> instances = hierarchy.instancesOf(cell_index);
+        if (instances.empty()) continue;
+
+        // Input geometry of the cell's subtree in cell-local coordinates; only worth it for repeated cells
+        bool repeated = instances.size() > 1;
+        std::vector<Layer> local_layers;
+        std::vector<BoxGrid> local_grids;
+        for (const auto& [layer_num, datatype] : args_.input_layers) {
+            local_layers.emplace_back(layer_num, datatype);
+            local_layers.back().bounds = BoundingBox::empty();
+        }
+        if (repeated) {
+            hierarchy.flattenLocal(cell_index, input_slots, local_layers);
+            for (size_t k = 0; k < args_.input_layers.size(); ++k) {
+                size_t first = input_slots[args_.input_layers[k]];
+                if (first != k) {
+                    local_layers[k].polygons = local_layers[first].polygons;
+                    local_layers[k].repetitions = local_layers[first].repetitions;
+                    local_layers[k].bounds = local_layers[first].bounds;
+                }
+                local_grids.emplace_back(local_layers[k]);
+            }
+        }
+
+        for (const auto& shape : mask_shapes) {
+            Polygon local_mask = hierarchy.placeShape(shape, CellTransform());
+            if (!local_mask.isValid()) continue;
+            const BoundingBox& local_box = local_mask.bbox;
+            std::vector<size_t> local_counts;
+            for (const auto& grid : local_grids) {
+                local_counts.push_back(grid.countOverlapping(local_box));
+            }
+
+            // An instance reuses the cell-local result when no geometry from outside the instance
+            // reaches the mask polygon, i.e. the flat layout has exactly the cell's own candidates there
+            std::vector<const CellTransform*> occurrences;
+            for (const auto& instance : instances) {
+                if (repeated && instance.isGridIsometry()) {
+                    BoundingBox placed_box = placeBox(local_box, instance, hierarchy.unit_scale);
+                    bool cell_local = true;
+                    for (size_t k = 0; k < flat_grids.size() && cell_local; ++k) {
+                        cell_local = flat_grids[k].countOverlapping(placed_box) == local_counts[k];
+                    }
+                    if (cell_local) {
+                        occurrences.push_back(&instance);
+                        continue;
+                    }
+                }
+                Polygon mask_polygon = hierarchy.placeShape(shape, instance);
+                if (!mask_polygon.isValid()) continue;
+                captured_patterns.push_back(capture_pattern(mask_polygon, input_layers));
+                flat_occurrences++;
+            }
+            if (occurrences.empty()) continue;
+
+            // One pattern for the context, placed at its first occurrence and moved to the others
+            MultiLayerPattern pattern = capture_pattern(local_mask, local_layers);
+            const CellTransform& first = *occurrences.front();
+            placePattern(pattern, first, hierarchy.unit_scale);
+            pattern.pattern_id = Utils::generatePatternId(args_.mask_layer_number, args_.mask_layer_datatype,
+                                                          pattern.mask_polygon, args_.input_layers);
+            for (size_t k = 1; k < occurrences.size(); ++k) {
+                pattern.occurrences.push_back(relativePlacement(first, *occurrences[k], hierarchy.unit_scale));
+            }
+            captured_patterns.push_back(std::move(pattern));
+            unique_contexts++;
+            reused_occurrences += occurrences.size();
+        }
+    }
+    if (mask_shape_count == 0) {
+        std::ostringstream oss;
+        oss << "No polygons in mask layer " << args_.mask_layer_number << ":" << args_.mask_layer_datatype;
+        throw std::runtime_error(oss.str());
+    }
+
+    std::ostringstream oss;
+    oss << "Hierarchical capture: " << unique_contexts << " cell-local contexts computed once for "
+        << reused_occurrences << " occurrences, " << flat_occurrences
+        << " mask polygons processed flat (context crosses a cell boundary or the cell is placed once)";
+    LOG_INFO(oss.str());
+    return 0;
+}
+
 void DFMPatternCaptureApplication::store_captured_patterns_in_database(std::vector<MultiLayerPattern> &captured_patterns, int &successful, int &failed) {
     LOG_FUNCTION();
     std::ostringstream oss;
     oss << "# of Captured patterns from layout file =  " << captured_patterns.size();
     LOG_INFO(oss.str());
+    size_t occurrence_count = 0;
+    for (const auto& pattern : captured_patterns) {
+        occurrence_count += pattern.occurrenceCount();
+    }
+    if (occurrence_count > captured_patterns.size()) {
+        oss.str("");
+        oss << "Patterns cover " << occurrence_count << " occurrences; further occurrences are stored as placements";
+        LOG_INFO(oss.str());
+    }
 
     for (size_t i = 0; i < captured_patterns.size(); ++i) {
-        MultiLayerPattern current_pattern = captured_patterns[i];
+        const MultiLayerPattern& current_pattern = captured_patterns[i];
         
         bool has_valid_input = false;
         for (const auto& layer : current_pattern.input_layers) {
@@ -191,9 +563,18 @@ void DFMPatternCaptureApplication::store_captured_patterns_in_database(std::vect
                 break;
             }
         }
+        for (const auto& layer : current_pattern.flat_input_layers) {
+            if (layer.polygonCount() > 0) {
+                has_valid_input = true;
+                break;
+            }
+        }
         if (has_valid_input) {
             try {
-                if (db_manager_.storePattern(current_pattern, args_.layout_file)) {
+                bool stored = current_pattern.flat_input_layers.empty()
+                    ? db_manager_.storePattern(current_pattern, args_.layout_file)
+                    : db_manager_.storePattern(current_pattern, current_pattern.flat_input_layers, args_.layout_file);
+                if (stored) {
                     successful++;
                     oss.str("");
                     oss << "Successfully stored pattern: " << current_pattern.pattern_id;
@@ -219,6 +600,54 @@ void DFMPatternCaptureApplication::store_captured_patterns_in_database(std::vect
     }
 }
 
+void DFMPatternCaptureApplication::export_captured_patterns(const std::vector<MultiLayerPattern> &captured_patterns, double unit_scale) {
+    LOG_FUNCTION();
+    LayoutFileWriter writer(args_.export_gds);
+    writer.beginLibrary("DFMPATTERNS", 1e-6, unit_scale * 1e-6);
+    size_t skipped = 0;
+    auto writePolygon = [&](int layer_number, int datatype, const Polygon& polygon) {
+        if (polygon.points.size() < 3 || polygon.points.size() > LayoutFileWriter::MAX_BOUNDARY_POINTS) {
+            skipped++;
+            return;
+        }
+        writer.writePolygon(layer_number, datatype, polygon);
+    };
+    size_t structure_count = 0;
+    Polygon flat_polygon; // Reused for every polygon of a flat layer
+    auto writePattern = [&](const MultiLayerPattern& pattern) {
+        writer.beginStructure("PATTERN_" + std::to_string(++structure_count));
+        writePolygon(pattern.mask_layer_number, pattern.mask_layer_datatype, pattern.mask_polygon);
+        for (const auto& layer : pattern.input_layers) {
+            for (const auto& polygon : layer.polygons) {
+                writePolygon(layer.layer_number, layer.datatype, polygon);
+            }
+        }
+        for (const auto& layer : pattern.flat_input_layers) {
+            for (size_t i = 0; i < layer.polygonCount(); ++i) {
+                layer.getPolygon(i, flat_polygon);
+                writePolygon(layer.layer_number, layer.datatype, flat_polygon);
+            }
+        }
+        writer.endStructure();
+    };
+    // The export is flat: every occurrence of a hierarchically captured pattern gets its own structure
+    for (const auto& pattern : captured_patterns) {
+        writePattern(pattern);
+        for (size_t k = 0; k < pattern.occurrences.size(); ++k) {
+            writePattern(pattern.placedAt(k));
+        }
+    }
+    writer.endLibrary();
+    writer.close();
+
+    std::ostringstream oss;
+    oss << "Exported " << structure_count << " patterns to " << args_.export_gds;
+    if (skipped > 0) {
+        oss << " (" << skipped << " polygons with too few or too many points skipped)";
+    }
+    LOG_INFO(oss.str());
+}
+
 void DFMPatternCaptureApplication::run() {
     LOG_FUNCTION();
     LOG_INFO("===========================================================================================");
@@ -228,11 +657,73 @@ void DFMPatternCaptureApplication::run() {
     try {
         LOG_INFO("====================================================================================");
         LayoutFileReader reader(args_.layout_file);
-        auto available_layers = reader.getAvailableLayersAndDatatypes();
+        reader.setTopCell(args_.top_cell);
+        reader.setUseIndex(args_.use_index);
+        reader.setReaderThreads(args_.reader_threads);
+        reader.setKeepRepetitions(true);
+        // Cached layers carry no cell hierarchy, which hierarchical capture and top-cell loads need
+        reader.setUseCache(args_.use_cache && !args_.hierarchical_capture && args_.top_cell.empty());
+        if (args_.use_cache && (args_.hierarchical_capture || !args_.top_cell.empty())) {
+            LOG_WARN("The layer cache is not used with hierarchical capture or a top cell");
+        }
+        Layer mask_layer(args_.mask_layer_number, args_.mask_layer_datatype);
+        std::vector<Layer> input_layers;
+        bool stream_mask = args_.stream_mask_layer && !args_.hierarchical_capture;
+        if (args_.stream_mask_layer && args_.hierarchical_capture) {
+            LOG_WARN("Mask layer streaming is not used with hierarchical capture");
+        }
+        bool dbu_geometry = args_.dbu_geometry && !args_.hierarchical_capture && !stream_mask;
+        if (args_.dbu_geometry && !dbu_geometry) {
+            LOG_WARN("Database-unit geometry is not used with hierarchical capture or mask layer streaming");
+        }
+        flat_layers_ = args_.flat_layers && !args_.hierarchical_capture && !stream_mask && !dbu_geometry;
+        if (args_.flat_layers && !flat_layers_) {
+            LOG_WARN("The flat layer layout is not used with hierarchical capture, mask layer streaming or database-unit geometry");
+        }
+        std::vector<DbuLayer> dbu_layers;
+        std::vector<FlatLayer> flat_input_layers;
+        // Hierarchical capture reads the mask layer cell by cell, so only the input layers are flattened
+        const LayoutHierarchy* cell_shapes = nullptr;
+        if (args_.hierarchical_capture) {
+            std::vector<std::pair<int, int>> cell_layers = args_.input_layers;
+            cell_layers.emplace_back(args_.mask_layer_number, args_.mask_layer_datatype);
+            cell_shapes = reader.loadCellShapes(cell_layers);
+        }
+        
+        if (dbu_geometry) {
+            std::vector<std::pair<int, int>> requested;
+            requested.emplace_back(args_.mask_layer_number, args_.mask_layer_datatype);
+            requested.insert(requested.end(), args_.input_layers.begin(), args_.input_layers.end());
+            dbu_layers = reader.loadLayersDbu(requested);
+        } else if (stream_mask) {
+            // Input layers are needed by every pattern, so they are loaded before the mask streams
+            std::vector<Layer> loaded_layers = reader.loadLayers(args_.input_layers);
+            load_input_layers(input_layers, loaded_layers, reader.getCatalog());
+        } else if (cell_shapes) {
+            std::vector<Layer> loaded_layers = reader.loadLayers(args_.input_layers);
+            load_input_layers(input_layers, loaded_layers, reader.getCatalog());
+        } else if (flat_layers_) {
+            // One pass for all layers; only the mask layer is turned into polygons
+            std::vector<std::pair<int, int>> requested;
+            requested.emplace_back(args_.mask_layer_number, args_.mask_layer_datatype);
+            requested.insert(requested.end(), args_.input_layers.begin(), args_.input_layers.end());
+            std::vector<FlatLayer> loaded_layers = reader.loadFlatLayers(requested);
+            Layer loaded_mask = loaded_layers.front().toLayer();
+            load_mask_layer(mask_layer, loaded_mask, reader.getCatalog());
+            flat_input_layers.assign(std::make_move_iterator(loaded_layers.begin() + 1),
+                                     std::make_move_iterator(loaded_layers.end()));
+        } else {
+            load_layers(mask_layer, input_layers, reader);
+        }
+        
+        const LayoutCatalog& catalog = reader.getCatalog(); // Filled by the load pass
         LOG_INFO("Available layers in " + args_.layout_file + ":");
-        for (const auto& [layer, dt] : available_layers) {
+        for (const auto& stats : catalog.layers()) {
             std::ostringstream oss;
-            oss << "  Layer: " << layer << ":" << dt;
+            oss << "  Layer: " << stats.layer_number << ":" << stats.datatype;
+            if (catalog.measured) {
+                oss << " (" << stats.polygon_count << " polygons)";
+            }
             LOG_INFO(oss.str());
         }
         std::ostringstream oss;
@@ -243,19 +734,36 @@ void DFMPatternCaptureApplication::run() {
         oss << std::endl;
         LOG_INFO(oss.str());
         
-        Layer mask_layer(args_.mask_layer_number, args_.mask_layer_datatype);
-        std::vector<Layer> input_layers;
-        
-        load_mask_layer(mask_layer, reader);
-        load_input_layers(input_layers, reader);
-        
         LOG_INFO("=============================================================");
         LOG_INFO("Started processing mask pattern polygons ===");
         
         std::vector<MultiLayerPattern> patterns;
-        process_mask_layer_polygons(mask_layer, input_layers, patterns);
+        capture_arena_ = std::make_shared<PolygonArena>();
+        if (cell_shapes) {
+            process_mask_layer_cells(*reader.getHierarchy(), input_layers, patterns);
+        } else if (dbu_geometry) {
+            process_mask_layer_dbu(dbu_layers, patterns);
+        } else if (flat_layers_) {
+            process_mask_layer_flat(mask_layer, flat_input_layers, patterns);
+        } else if (stream_mask) {
+            process_mask_layer_stream(reader, input_layers, patterns);
+        } else {
+            if (args_.hierarchical_capture) {
+                LOG_WARN("Layout " + args_.layout_file + " has no cell hierarchy, using flat capture");
+            }
+            process_mask_layer_polygons(mask_layer, input_layers, patterns);
+        }
         
         LOG_INFO("Completed processing mask pattern polygons ===");
+        oss.str("");
+        oss << "Capture arena: " << capture_arena_->allocations() << " polygon allocations served from "
+            << capture_arena_->heapAllocations() << " heap allocations";
+        LOG_INFO(oss.str());
+        capture_arena_.reset(); // The patterns keep it alive until they are freed
+        
+        if (!args_.export_gds.empty()) {
+            export_captured_patterns(patterns, reader.getUnitScale());
+        }
         
         LOG_INFO("Started storing patterns ===");
         int successful = 0, failed = 0;
@@ -9,18 +9,42 @@ class DFMPatternCaptureApplication {
 public:
     DFMPatternCaptureApplication(const CommandLineArgs& args);
     
-    void load_mask_layer(Layer &mask_layer, LayoutFileReader &reader);
-    unsigned int load_input_layers(std::vector<Layer> &input_layers, LayoutFileReader &reader);
+    void load_layers(Layer &mask_layer, std::vector<Layer> &input_layers, LayoutFileReader &reader);
+    // Statistics such as invalid polygon counts come from the reader's catalog, not from another pass
+    void load_mask_layer(Layer &mask_layer, Layer &loaded_layer, const LayoutCatalog &catalog);
+    unsigned int load_input_layers(std::vector<Layer> &input_layers, std::vector<Layer> &loaded_layers, const LayoutCatalog &catalog);
     
-    unsigned int process_mask_layer_polygon(Polygon &mask_polygon, std::vector<Layer> &input_layers, MultiLayerPattern &captured_pattern);
+    unsigned int process_mask_layer_polygon(const Polygon &mask_polygon, std::vector<Layer> &input_layers, MultiLayerPattern &captured_pattern);
     unsigned int process_mask_layer_polygons(Layer &mask_layer, std::vector<Layer> &input_layers, std::vector<MultiLayerPattern> &captured_patterns);
+    // Captures each mask polygon as the reader decodes it; the mask layer is never held in memory
+    unsigned int process_mask_layer_stream(LayoutFileReader &reader, std::vector<Layer> &input_layers, std::vector<MultiLayerPattern> &captured_patterns);
+    // Flat capture in integer database units; dbu_layers holds the mask layer, then the input layers.
+    // Coordinates are converted to user units only when a pattern is built.
+    unsigned int process_mask_layer_dbu(const std::vector<DbuLayer> &dbu_layers, std::vector<MultiLayerPattern> &captured_patterns);
+    // Flat capture against input layers in the flat structure-of-arrays layout: input polygons whose
+    // stored bounding box misses the mask polygon are skipped without being copied out
+    unsigned int process_mask_layer_flat(Layer &mask_layer, const std::vector<FlatLayer> &input_layers, std::vector<MultiLayerPattern> &captured_patterns);
+    // Hierarchical capture: patterns whose context lies inside one cell instance are computed once in
+    // cell-local coordinates and kept as one pattern with a placement per further instance (see
+    // MultiLayerPattern::occurrences); other instances are processed flat. The mask layer is read from
+    // the cells and never flattened.
+    unsigned int process_mask_layer_cells(const LayoutHierarchy &hierarchy, std::vector<Layer> &input_layers, std::vector<MultiLayerPattern> &captured_patterns);
     
     void store_captured_patterns_in_database(std::vector<MultiLayerPattern> &captured_patterns, int &successful, int &failed);
+    // Writes each pattern as a GDSII structure PATTERN_<n> holding its mask polygon and clipped input polygons
+    void export_captured_patterns(const std::vector<MultiLayerPattern> &captured_patterns, double unit_scale);
     void run();
 
 private:
+    MultiLayerPattern capture_pattern(const Polygon &mask_polygon, std::vector<Layer> &input_layers);
+
     CommandLineArgs args_;
     DatabaseManager db_manager_;
+    // Arena of the capture batch in progress: the clipped layers of its patterns are allocated there
+    // and freed together with the patterns
+    std::shared_ptr<PolygonArena> capture_arena_;
+    // Set by run() when the input layers are in the flat layout; the patterns are then stored from it too
+    bool flat_layers_ = false;
 };
 
 #endif
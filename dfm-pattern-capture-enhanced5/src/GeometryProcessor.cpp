@@ -3,6 +3,7 @@
 #include <boost/geometry/geometries/polygon.hpp>
 #include <boost/geometry/geometries/adapted/std_array.hpp>
 #include <algorithm>
+#include <cmath>
 #include <sstream>
 #include <Logging.h>
 
@@ -10,6 +11,10 @@ namespace bg = boost::geometry;
 using point_t = bg::model::d2::point_xy<double>;
 using polygon_t = bg::model::polygon<point_t>;
 using multi_polygon_t = bg::model::multi_polygon<polygon_t>;
+// 64-bit so products of int32 database-unit coordinates cannot overflow
+using dbu_point_t = bg::model::d2::point_xy<int64_t>;
+using dbu_polygon_t = bg::model::polygon<dbu_point_t>;
+using dbu_multi_polygon_t = bg::model::multi_polygon<dbu_polygon_t>;
 
 std::tuple<double, double, double, double> GeometryProcessor::getBoundingBox(const Polygon& polygon) {
     LOG_FUNCTION();
@@ -18,14 +23,9 @@ std::tuple<double, double, double, double> GeometryProcessor::getBoundingBox(con
         LOG_WARN("Empty polygon in getBoundingBox");
         return {0, 0, 0, 0};
     }
-    double min_x = polygon.points[0].x, max_x = polygon.points[0].x;
-    double min_y = polygon.points[0].y, max_y = polygon.points[0].y;
-    for (const auto& point : polygon.points) {
-        min_x = std::min(min_x, point.x);
-        max_x = std::max(max_x, point.x);
-        min_y = std::min(min_y, point.y);
-        max_y = std::max(max_y, point.y);
-    }
+    // Cached when the points were filled in
+    double min_x = polygon.bbox.min_x, max_x = polygon.bbox.max_x;
+    double min_y = polygon.bbox.min_y, max_y = polygon.bbox.max_y;
     std::ostringstream oss;
     oss << "Bounding box: min_x=" << min_x << ", max_x=" << max_x
         << ", min_y=" << min_y << ", max_y=" << max_y;
@@ -33,10 +33,11 @@ std::tuple<double, double, double, double> GeometryProcessor::getBoundingBox(con
     return {min_x, max_x, min_y, max_y};
 }
 
-Polygon GeometryProcessor::intersectPolygons(const Polygon& poly1, const Polygon& poly2) {
+Polygon GeometryProcessor::intersectPolygons(const Polygon& poly1, const Polygon& poly2,
+                                             const Polygon::allocator_type& allocator) {
     LOG_FUNCTION();
 
-    Polygon result;
+    Polygon result(allocator);
     if (!poly1.isValid() || !poly2.isValid()) {
         LOG_ERROR("Invalid input polygons for intersection");
         return result;
@@ -118,6 +119,7 @@ Polygon GeometryProcessor::intersectPolygons(const Polygon& poly1, const Polygon
     }
 
     // Filter and collect valid polygons
+    Polygon candidate(allocator); // Reused until one is valid, which then becomes the result
     for (const auto& result_poly : output) {
         if (!bg::is_valid(result_poly)) {
             LOG_WARN("Invalid result polygon, skipping");
@@ -129,20 +131,19 @@ Polygon GeometryProcessor::intersectPolygons(const Polygon& poly1, const Polygon
             LOG_DEBUG(oss.str());
             continue;
         }
-        Polygon temp_result;
+        candidate.points.clear();
         for (const auto& p : result_poly.outer()) {
-            temp_result.points.push_back({bg::get<0>(p), bg::get<1>(p)});
+            candidate.points.push_back({bg::get<0>(p), bg::get<1>(p)});
         }
         // Remove closing point if duplicated
-        if (!temp_result.points.empty() && temp_result.points.size() > 1 &&
-            temp_result.points.front() == temp_result.points.back()) {
-            temp_result.points.pop_back();
-        }
-        if (temp_result.points.size() >= 3) {
-            temp_result.calculateArea();
-            temp_result.calculatePerimeter();
-            if (temp_result.isValid() && temp_result.area > 1e-6) {
-                result = temp_result; // Use first valid polygon
+        if (!candidate.points.empty() && candidate.points.size() > 1 &&
+            candidate.points.front() == candidate.points.back()) {
+            candidate.points.pop_back();
+        }
+        if (candidate.points.size() >= 3) {
+            candidate.finalize();
+            if (candidate.isValid() && candidate.area > 1e-6) {
+                result = std::move(candidate); // Use first valid polygon
                 oss.str("");
                 oss << "Valid intersection: area=" << result.area
                     << ", points=" << result.points.size();
@@ -159,13 +160,166 @@ Polygon GeometryProcessor::intersectPolygons(const Polygon& poly1, const Polygon
     return result;
 }
 
-Layer GeometryProcessor::performANDOperation(const Polygon& mask_polygon, const Layer& input_layer) {
+DbuPolygon GeometryProcessor::intersectPolygons(const DbuPolygon& poly1, const DbuPolygon& poly2,
+                                                int64_t min_doubled_area) {
     LOG_FUNCTION();
 
-    Layer result_layer(input_layer.layer_number, input_layer.datatype);
+    DbuPolygon result;
+    if (!poly1.isValid() || !poly2.isValid()) {
+        LOG_ERROR("Invalid input polygons for intersection");
+        return result;
+    }
+
+    dbu_polygon_t boost_poly1, boost_poly2;
+    for (const auto& p : poly1.points) {
+        bg::append(boost_poly1.outer(), dbu_point_t(p.x, p.y));
+    }
+    for (const auto& p : poly2.points) {
+        bg::append(boost_poly2.outer(), dbu_point_t(p.x, p.y));
+    }
+    // Closes the rings and fixes their orientation
+    bg::correct(boost_poly1);
+    bg::correct(boost_poly2);
+    std::string reason;
+    if (!bg::is_valid(boost_poly1, reason) || !bg::is_valid(boost_poly2, reason)) {
+        LOG_ERROR("Input polygon remains invalid after correction, reason: " + reason);
+        return result;
+    }
+
+    dbu_multi_polygon_t output;
+    bg::intersection(boost_poly1, boost_poly2, output);
+    if (output.empty()) {
+        LOG_INFO("No intersection");
+        return result;
+    }
+
+    for (const auto& result_poly : output) {
+        DbuPolygon candidate;
+        for (const auto& p : result_poly.outer()) {
+            candidate.points.emplace_back(static_cast<int32_t>(bg::get<0>(p)), static_cast<int32_t>(bg::get<1>(p)));
+        }
+        if (candidate.points.size() > 1 && candidate.points.front() == candidate.points.back()) {
+            candidate.points.pop_back();
+        }
+        if (candidate.isValid() && candidate.doubledArea() >= min_doubled_area) {
+            candidate.calculateBoundingBox();
+            result = std::move(candidate); // Use first valid polygon, like the floating-point kernel
+            std::ostringstream oss;
+            oss << "Valid intersection: doubled area=" << result.doubledArea() << " DBU^2, points="
+                << result.points.size();
+            LOG_INFO(oss.str());
+            break;
+        }
+    }
+    if (result.points.empty()) {
+        LOG_INFO("No valid intersection polygons after filtering");
+    }
+    return result;
+}
+
+DbuLayer GeometryProcessor::performANDOperation(const DbuPolygon& mask_polygon, const DbuLayer& input_layer) {
+    LOG_FUNCTION();
+
+    DbuLayer result_layer(input_layer.layer_number, input_layer.datatype, input_layer.unit_scale);
+    std::ostringstream oss;
+    oss << "Performing integer AND operation on layer " << input_layer.layer_number << ":" << input_layer.datatype
+        << " with " << input_layer.polygons.size() << " polygons";
+    LOG_INFO(oss.str());
+
+    if (!mask_polygon.isValid()) {
+        LOG_ERROR("Mask polygon is invalid or empty");
+        return result_layer;
+    }
+    // Slivers below the floating-point kernel's 1e-6 user-unit area are dropped here too
+    const double MIN_AREA = 1e-6;
+    double unit_area = input_layer.unit_scale * input_layer.unit_scale;
+    auto min_doubled_area = static_cast<int64_t>(std::ceil(2.0 * MIN_AREA / unit_area));
+    // Polygons whose box misses the mask's can only produce an empty intersection
+    DbuBox mask_box = mask_polygon.bbox;
+    if (!mask_box.overlaps(input_layer.bounds)) {
+        oss.str("");
+        oss << "Layer " << input_layer.layer_number << ":" << input_layer.datatype
+            << " does not reach the mask polygon's bounding box";
+        LOG_INFO(oss.str());
+        result_layer.calculateBounds();
+        return result_layer;
+    }
+    size_t candidates = 0;
+    for (size_t i = 0; i < input_layer.polygons.size(); ++i) {
+        const DbuPolygon& input_polygon = input_layer.polygons[i];
+        if (!mask_box.overlaps(input_polygon.bbox)) {
+            continue;
+        }
+        ++candidates;
+        if (!input_polygon.isValid()) {
+            oss.str("");
+            oss << "Input polygon " << i << " is invalid or has insufficient points, skipping";
+            LOG_WARN(oss.str());
+            continue;
+        }
+        DbuPolygon intersection = intersectPolygons(mask_polygon, input_polygon, min_doubled_area);
+        if (intersection.isValid()) {
+            result_layer.polygons.push_back(std::move(intersection));
+        }
+    }
+
+    result_layer.calculateBounds();
+    oss.str("");
+    oss << "Integer AND operation intersected " << candidates << " of " << input_layer.polygons.size()
+        << " polygons and resulted in " << result_layer.polygons.size() << " polygons";
+    LOG_INFO(oss.str());
+    return result_layer;
+}
+
+FlatLayer GeometryProcessor::performANDOperation(const Polygon& mask_polygon, const FlatLayer& input_layer) {
+    LOG_FUNCTION();
+
+    FlatLayer result_layer(input_layer.layer_number, input_layer.datatype);
+    std::ostringstream oss;
+    oss << "Performing flat AND operation on layer " << input_layer.layer_number << ":" << input_layer.datatype
+        << " with " << input_layer.polygonCount() << " polygons";
+    LOG_INFO(oss.str());
+
+    if (!mask_polygon.isValid() || mask_polygon.points.empty()) {
+        LOG_ERROR("Mask polygon is invalid or empty");
+        return result_layer;
+    }
+    auto [min_x, max_x, min_y, max_y] = getBoundingBox(mask_polygon);
+
+    // A polygon outside the mask's box can only produce an empty intersection
+    size_t candidates = 0;
+    Polygon input_polygon; // Reused for every candidate
+    for (size_t i = 0; i < input_layer.polygonCount(); ++i) {
+        if (!input_layer.boxes[i].overlaps(min_x, min_y, max_x, max_y)) continue;
+        ++candidates;
+        input_layer.getPolygon(i, input_polygon);
+        if (!input_polygon.isValid()) {
+            oss.str("");
+            oss << "Input polygon " << i << " is invalid or has insufficient points, skipping";
+            LOG_WARN(oss.str());
+            continue;
+        }
+        Polygon intersection = intersectPolygons(mask_polygon, input_polygon, Polygon::allocator_type());
+        if (intersection.isValid() && !intersection.points.empty() && intersection.area > 1e-11) {
+            result_layer.addPolygon(intersection);
+        }
+    }
+
+    oss.str("");
+    oss << "Flat AND operation intersected " << candidates << " of " << input_layer.polygonCount()
+        << " polygons and resulted in " << result_layer.polygonCount() << " polygons";
+    LOG_INFO(oss.str());
+    return result_layer;
+}
+
+Layer GeometryProcessor::performANDOperation(const Polygon& mask_polygon, const Layer& input_layer,
+                                             std::shared_ptr<PolygonArena> arena) {
+    LOG_FUNCTION();
+
+    Layer result_layer(input_layer.layer_number, input_layer.datatype, std::move(arena));
     std::ostringstream oss;
     oss << "Performing AND operation on layer " << input_layer.layer_number
-        << ":" << input_layer.datatype << " with " << input_layer.polygons.size() << " polygons";
+        << ":" << input_layer.datatype << " with " << input_layer.getPolygonCount() << " polygons";
     LOG_INFO(oss.str());
 
     if (!mask_polygon.isValid() || mask_polygon.points.empty()) {
@@ -187,13 +341,19 @@ Layer GeometryProcessor::performANDOperation(const Polygon& mask_polygon, const
     oss << ", area=" << mask_polygon.area;
     LOG_INFO(oss.str());
 
-    for (size_t i = 0; i < input_layer.polygons.size(); ++i) {
-        const auto& input_polygon = input_layer.polygons[i];
+    // Polygons whose cached box misses the mask's can only produce an empty intersection
+    BoundingBox mask_box = mask_polygon.bbox;
+    size_t candidates = 0;
+    auto intersectInput = [&](size_t i, const Polygon& input_polygon) {
+        if (!mask_box.overlaps(input_polygon.bbox)) {
+            return;
+        }
+        ++candidates;
         if (!input_polygon.isValid() || input_polygon.points.size() < 3) {
             oss.str("");
             oss << "Input polygon " << i << " is invalid or has insufficient points, skipping";
             LOG_WARN(oss.str());
-            continue;
+            return;
         }
         oss.str("");
         oss << "Input polygon " << i << " points: ";
@@ -203,22 +363,49 @@ Layer GeometryProcessor::performANDOperation(const Polygon& mask_polygon, const
         oss << ", area=" << input_polygon.area;
         LOG_INFO(oss.str());
 	// intersect mask polygon with input_polygon
-        Polygon intersection = intersectPolygons(mask_polygon, input_polygon);
+        Polygon intersection = intersectPolygons(mask_polygon, input_polygon, result_layer.polygons.get_allocator());
         // check if intersection is valid
         if (intersection.isValid() && !intersection.points.empty() && intersection.area > 1e-11) {
-            result_layer.polygons.push_back(intersection);
             oss.str("");
             oss << "Added intersection polygon " << i << " with area=" << intersection.area;
+            result_layer.polygons.push_back(std::move(intersection)); // Already in the result's arena
             LOG_INFO(oss.str());
         } else {
             oss.str("");
             oss << "Intersection " << i << " discarded: invalid or empty polygon";
             LOG_INFO(oss.str());
         }
+    };
+
+    if (!mask_box.overlaps(input_layer.bounds)) {
+        oss.str("");
+        oss << "Layer " << input_layer.layer_number << ":" << input_layer.datatype
+            << " does not reach the mask polygon's bounding box";
+        LOG_INFO(oss.str());
+    } else {
+        for (size_t i = 0; i < input_layer.polygons.size(); ++i) {
+            intersectInput(i, input_layer.polygons[i]);
+        }
+        // Repeated shapes are only materialized where they can reach the mask
+        if (!input_layer.repetitions.empty()) {
+            PolygonList instances;
+            for (const auto& repetition : input_layer.repetitions) {
+                repetition.collectOverlapping(min_x, min_y, max_x, max_y, instances);
+            }
+            oss.str("");
+            oss << "Repetitions on layer " << input_layer.layer_number << ":" << input_layer.datatype
+                << " contribute " << instances.size() << " instances near the mask";
+            LOG_INFO(oss.str());
+            for (size_t i = 0; i < instances.size(); ++i) {
+                intersectInput(input_layer.polygons.size() + i, instances[i]);
+            }
+        }
     }
 
+    result_layer.calculateBounds();
     oss.str("");
-    oss << "AND operation resulted in " << result_layer.polygons.size() << " polygons";
+    oss << "AND operation intersected " << candidates << " of " << input_layer.getPolygonCount()
+        << " polygons and resulted in " << result_layer.polygons.size() << " polygons";
     LOG_INFO(oss.str());
     if (result_layer.polygons.empty()) {
         oss.str("");
@@ -5,10 +5,22 @@
 
 class GeometryProcessor {
 public:
-    static Layer performANDOperation(const Polygon& mask_polygon, const Layer& input_layer);
+    // The result layer is built on arena when one is given (e.g. the arena of a capture batch).
+    // Input polygons whose cached bounding box misses the mask's are skipped without clipping.
+    static Layer performANDOperation(const Polygon& mask_polygon, const Layer& input_layer,
+                                     std::shared_ptr<PolygonArena> arena = nullptr);
+    // Same in integer database units: exact for Manhattan geometry, other intersection points
+    // are rounded to the database grid
+    static DbuLayer performANDOperation(const DbuPolygon& mask_polygon, const DbuLayer& input_layer);
+    // Same over the flat layout, into a flat result: polygons whose stored bounding box misses the
+    // mask's are skipped without being copied out, the rest are intersected as in the Layer overload
+    static FlatLayer performANDOperation(const Polygon& mask_polygon, const FlatLayer& input_layer);
 
 private:
-    static Polygon intersectPolygons(const Polygon& poly1, const Polygon& poly2);
+    // The result's points are allocated with allocator
+    static Polygon intersectPolygons(const Polygon& poly1, const Polygon& poly2, const Polygon::allocator_type& allocator);
+    // Keeps the first result polygon with at least min_doubled_area (twice the area, in DBU^2)
+    static DbuPolygon intersectPolygons(const DbuPolygon& poly1, const DbuPolygon& poly2, int64_t min_doubled_area);
     static std::tuple<double, double, double, double> getBoundingBox(const Polygon& poly);
 };
 
@@ -0,0 +1,148 @@
+#include "Geometry.h"
+#include "LayoutFileWriter.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Measures LayoutFileWriter throughput: one structure of N boundaries written from database-unit
+// coordinates (writeBoundary) and from user-unit polygons rounded to the grid (writePolygon). Each
+// run is checked against the size of the records it must produce and the size of the file on disk.
+//
+// Usage: benchmark_layout_writer [--polygons N] [--vertices K] [--buffer BYTES] [--output FILE] [--repeat R]
+//   N boundaries of K vertices each, written through a buffer of BYTES to FILE, which is removed
+
+namespace {
+
+const char LIBRARY_NAME[] = "BENCH";
+const char STRUCTURE_NAME[] = "TOP";
+
+// Regular outlines on a grid of 100 x 100 database-unit cells, so that every boundary differs
+std::vector<DbuPoint> makeOutline(size_t index, size_t vertices) {
+    int32_t x = static_cast<int32_t>(index % 10000) * 100;
+    int32_t y = static_cast<int32_t>(index / 10000) * 100;
+    std::vector<DbuPoint> points;
+    if (vertices == 4) {
+        points = {{x, y}, {x + 50, y}, {x + 50, y + 50}, {x, y + 50}};
+        return points;
+    }
+    for (size_t k = 0; k < vertices; ++k) {
+        double t = 6.283185307179586 * static_cast<double>(k) / static_cast<double>(vertices);
+        points.emplace_back(x + 50 + static_cast<int32_t>(std::lround(40 * std::cos(t))),
+                            y + 50 + static_cast<int32_t>(std::lround(40 * std::sin(t))));
+    }
+    return points;
+}
+
+// HEADER, BGNLIB, LIBNAME, UNITS, BGNSTR, STRNAME, ENDSTR and ENDLIB, plus per boundary
+// BOUNDARY, LAYER, DATATYPE, XY with the closing point and ENDEL
+uint64_t expectedBytes(size_t polygon_count, size_t vertices) {
+    auto stringRecord = [](const char* s) { return 4 + ((std::char_traits<char>::length(s) + 1) & ~size_t(1)); };
+    uint64_t frame = 6 + 28 + stringRecord(LIBRARY_NAME) + 20 + 28 + stringRecord(STRUCTURE_NAME) + 4 + 4;
+    return frame + polygon_count * (4 + 6 + 6 + 4 + 8 * (vertices + 1) + 4);
+}
+
+uint64_t fileSize(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    return in ? static_cast<uint64_t>(in.tellg()) : 0;
+}
+
+// Best time of repeat runs
+double bestSeconds(int repeat, const std::function<void()>& run) {
+    double best = 0.0;
+    for (int r = 0; r < repeat; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (r == 0 || seconds < best) best = seconds;
+    }
+    return best;
+}
+
+void report(const std::string& name, double seconds, uint64_t bytes, size_t polygon_count) {
+    std::cout << std::setw(16) << name << std::setw(12) << std::fixed << std::setprecision(3) << seconds
+              << std::setw(12) << std::setprecision(1) << static_cast<double>(bytes) / 1e6 << std::setw(10)
+              << std::setprecision(2) << static_cast<double>(bytes) / seconds / 1e9 << std::setw(14)
+              << std::setprecision(2) << static_cast<double>(polygon_count) / seconds / 1e6 << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t polygon_count = 5000000;
+    size_t vertices = 4;
+    size_t buffer_size = 4 << 20;
+    std::string output = "benchmark_layout_writer.gds";
+    int repeat = 3;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--polygons" && i + 1 < argc) {
+            polygon_count = std::max(std::atol(argv[++i]), 1L);
+        } else if (arg == "--vertices" && i + 1 < argc) {
+            vertices = std::clamp<long>(std::atol(argv[++i]), 3L, static_cast<long>(LayoutFileWriter::MAX_BOUNDARY_POINTS));
+        } else if (arg == "--buffer" && i + 1 < argc) {
+            buffer_size = std::max(std::atol(argv[++i]), 1L);
+        } else if (arg == "--output" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::max(std::atoi(argv[++i]), 1);
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--polygons N] [--vertices K] [--buffer BYTES] [--output FILE] [--repeat R]" << std::endl;
+            return 1;
+        }
+    }
+
+    // A few thousand distinct outlines, reused round-robin, so that building input is not measured
+    const size_t distinct = std::min<size_t>(polygon_count, 4096);
+    std::vector<std::vector<DbuPoint>> outlines;
+    std::vector<Polygon> polygons(distinct);
+    const double user_unit = 1e-6, db_unit = 1e-9, unit_scale = db_unit / user_unit;
+    for (size_t i = 0; i < distinct; ++i) {
+        outlines.push_back(makeOutline(i, vertices));
+        for (const auto& p : outlines.back()) {
+            polygons[i].points.emplace_back(p.x * unit_scale, p.y * unit_scale);
+        }
+    }
+    const uint64_t expected = expectedBytes(polygon_count, vertices);
+    std::cout << "Boundaries: " << polygon_count << " of " << vertices << " vertices, buffer " << buffer_size
+              << " bytes, output " << output << std::endl;
+    std::cout << std::setw(16) << "method" << std::setw(12) << "seconds" << std::setw(12) << "MB"
+              << std::setw(10) << "GB/s" << std::setw(14) << "Mpolygons/s" << std::endl;
+
+    bool all_match = true;
+    auto run = [&](const std::string& name, const std::function<void(LayoutFileWriter&, size_t)>& write) {
+        uint64_t bytes = 0;
+        double seconds = bestSeconds(repeat, [&]() {
+            LayoutFileWriter writer(output, buffer_size);
+            writer.beginLibrary(LIBRARY_NAME, user_unit, db_unit);
+            writer.beginStructure(STRUCTURE_NAME);
+            for (size_t i = 0; i < polygon_count; ++i) {
+                write(writer, i % distinct);
+            }
+            writer.endStructure();
+            writer.endLibrary();
+            writer.close();
+            bytes = writer.bytesWritten();
+        });
+        bool match = bytes == expected && fileSize(output) == expected;
+        report(name + (match ? "" : " MISMATCH"), seconds, bytes, polygon_count);
+        all_match = all_match && match;
+    };
+    run("writeBoundary", [&](LayoutFileWriter& writer, size_t i) { writer.writeBoundary(1, 0, outlines[i]); });
+    run("writePolygon", [&](LayoutFileWriter& writer, size_t i) { writer.writePolygon(1, 0, polygons[i]); });
+    std::remove(output.c_str());
+
+    if (!all_match) {
+        std::cerr << "Error: the writer did not produce the expected " << expected << " bytes" << std::endl;
+        return 1;
+    }
+    return 0;
+}
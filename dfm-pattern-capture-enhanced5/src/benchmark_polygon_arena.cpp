@@ -0,0 +1,192 @@
+#include "Geometry.h"
+#include "GeometryProcessor.h"
+#include "PolygonArena.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+// Counts the heap allocations of the two patterns that dominate polygon memory traffic, with
+// polygons on the heap and on a PolygonArena:
+//   load     a decode buffer copied into a layer once per polygon, as the reader does, then freed
+//   capture  a batch of patterns clipped from an input layer, as flat capture does, then freed
+//
+// Usage: benchmark_polygon_arena [--polygons N] [--vertices K] [--masks M] [--repeat R]
+
+namespace {
+
+uint64_t heap_allocations = 0;
+
+} // namespace
+
+// Every heap allocation of the process goes through here, including the arena's own chunks
+void* operator new(size_t size) {
+    heap_allocations++;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+// std::pmr::new_delete_resource() allocates through the aligned forms
+void* operator new(size_t size, std::align_val_t alignment) {
+    heap_allocations++;
+    size_t align = static_cast<size_t>(alignment);
+    if (void* p = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+struct Run {
+    double seconds = 0.0;
+    uint64_t allocations = 0;       // Heap allocations, including freeing everything built
+    uint64_t arena_allocations = 0; // Blocks the arena handed out instead
+};
+
+// Best time of repeat runs; the allocation counts are the same for every run
+template <typename Body>
+Run measure(int repeat, const Body& body) {
+    Run best;
+    for (int r = 0; r < repeat; ++r) {
+        uint64_t before = heap_allocations;
+        auto start = std::chrono::steady_clock::now();
+        uint64_t arena_allocations = body();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (r == 0 || seconds < best.seconds) {
+            best.seconds = seconds;
+            best.allocations = heap_allocations - before;
+            best.arena_allocations = arena_allocations;
+        }
+    }
+    return best;
+}
+
+// Rectangle-like outline with the given number of vertices around (x, y)
+void makeShape(Polygon& poly, double x, double y, size_t vertices) {
+    poly.points.clear();
+    for (size_t k = 0; k < vertices; ++k) {
+        double t = 6.283185307179586 * static_cast<double>(k) / static_cast<double>(vertices);
+        poly.points.emplace_back(x + 0.4 * std::cos(t), y + 0.4 * std::sin(t));
+    }
+    poly.finalize();
+}
+
+uint64_t loadLayer(bool use_arena, size_t polygon_count, size_t vertices) {
+    std::shared_ptr<PolygonArena> arena = use_arena ? std::make_shared<PolygonArena>() : nullptr;
+    Layer layer(1, 0, arena);
+    Polygon poly; // Decode buffer, reused for every element
+    size_t side = static_cast<size_t>(std::sqrt(static_cast<double>(polygon_count))) + 1;
+    for (size_t i = 0; i < polygon_count; ++i) {
+        makeShape(poly, static_cast<double>(i % side), static_cast<double>(i / side), vertices);
+        layer.polygons.push_back(poly);
+    }
+    return arena ? arena->allocations() : 0;
+}
+
+uint64_t captureBatch(bool use_arena, const Layer& input, size_t mask_count, double extent) {
+    std::shared_ptr<PolygonArena> arena = use_arena ? std::make_shared<PolygonArena>() : nullptr;
+    std::vector<MultiLayerPattern> patterns;
+    for (size_t m = 0; m < mask_count; ++m) {
+        // Masks of 2 x 2 units spread over the input, each overlapping a few of its shapes
+        double x = std::fmod(static_cast<double>(m) * 7.31, extent - 2.0);
+        double y = std::fmod(static_cast<double>(m) * 3.17, extent - 2.0);
+        MultiLayerPattern pattern;
+        pattern.mask_polygon.points = {{x, y}, {x + 2.0, y}, {x + 2.0, y + 2.0}, {x, y + 2.0}};
+        pattern.mask_polygon.finalize();
+        pattern.input_layers.push_back(GeometryProcessor::performANDOperation(pattern.mask_polygon, input, arena));
+        patterns.push_back(std::move(pattern));
+    }
+    return arena ? arena->allocations() : 0;
+}
+
+void report(const std::string& name, const Run& run, size_t items) {
+    std::cout << std::setw(10) << name << std::setw(12) << std::fixed << std::setprecision(2) << run.seconds * 1e3
+              << std::setw(16) << run.allocations << std::setw(14) << std::setprecision(3)
+              << static_cast<double>(run.allocations) / static_cast<double>(items) << std::setw(16)
+              << run.arena_allocations << std::endl;
+}
+
+void header(const std::string& per) {
+    std::cout << std::setw(10) << "memory" << std::setw(12) << "ms" << std::setw(16) << "heap allocs"
+              << std::setw(14) << per << std::setw(16) << "arena allocs" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t polygon_count = 1 << 20;
+    size_t vertices = 6;
+    size_t mask_count = 200;
+    int repeat = 3;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--polygons" && i + 1 < argc) {
+            polygon_count = std::max(std::atol(argv[++i]), 1L);
+        } else if (arg == "--vertices" && i + 1 < argc) {
+            vertices = std::max(std::atol(argv[++i]), 3L);
+        } else if (arg == "--masks" && i + 1 < argc) {
+            mask_count = std::max(std::atol(argv[++i]), 1L);
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::max(std::atoi(argv[++i]), 1);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--polygons N] [--vertices K] [--masks M] [--repeat R]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "Load: " << polygon_count << " polygons of " << vertices << " vertices" << std::endl;
+    header("per polygon");
+    Run heap = measure(repeat, [&]() { return loadLayer(false, polygon_count, vertices); });
+    report("heap", heap, polygon_count);
+    Run arena = measure(repeat, [&]() { return loadLayer(true, polygon_count, vertices); });
+    report("arena", arena, polygon_count);
+
+    // Input of one shape per unit cell on a 20 x 20 grid; every mask is clipped against all of them
+    const size_t side = 20;
+    Layer input(2, 0);
+    Polygon cell;
+    for (size_t i = 0; i < side * side; ++i) {
+        makeShape(cell, static_cast<double>(i % side), static_cast<double>(i / side), 4);
+        input.polygons.push_back(cell);
+    }
+    input.calculateBounds();
+    std::cout << std::endl << "Capture: batch of " << mask_count << " patterns from " << input.polygons.size()
+              << " input polygons" << std::endl;
+    header("per pattern");
+    Run batch_heap = measure(repeat, [&]() { return captureBatch(false, input, mask_count, side); });
+    report("heap", batch_heap, mask_count);
+    Run batch_arena = measure(repeat, [&]() { return captureBatch(true, input, mask_count, side); });
+    report("arena", batch_arena, mask_count);
+
+    if (arena.allocations >= heap.allocations || batch_arena.allocations >= batch_heap.allocations) {
+        std::cerr << "Error: the arena did not reduce heap allocations" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include "Geometry.h"
+#include "PolygonMeasure.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Measures polygon area and perimeter: Polygon::calculateArea and calculatePerimeter called per
+// polygon, against each batch kernel this CPU supports, over the flat layout of FlatLayer and over
+// separately allocated polygons, and checks that all of them produce bit-identical results.
+//
+// Usage: benchmark_polygon_measure [--polygons N] [--vertices K] [--repeat R]
+//   N polygons of K vertices each
+
+namespace {
+
+// Irregular outlines scattered over a die of +-5 mm, so that no two edges are alike
+std::vector<Polygon> makePolygons(size_t polygon_count, size_t vertices) {
+    std::vector<Polygon> polygons(polygon_count);
+    uint64_t state = 1;
+    auto next = [&state]() {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<double>(state >> 11) / static_cast<double>(1ULL << 53);
+    };
+    for (auto& poly : polygons) {
+        double x = (next() - 0.5) * 10000.0;
+        double y = (next() - 0.5) * 10000.0;
+        for (size_t k = 0; k < vertices; ++k) {
+            double t = 6.283185307179586 * static_cast<double>(k) / static_cast<double>(vertices);
+            double r = 0.5 + next();
+            poly.points.emplace_back(x + r * std::cos(t), y + r * std::sin(t));
+        }
+    }
+    return polygons;
+}
+
+// Best time of repeat runs
+double bestSeconds(int repeat, const std::function<void()>& run) {
+    double best = 0.0;
+    for (int r = 0; r < repeat; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (r == 0 || seconds < best) best = seconds;
+    }
+    return best;
+}
+
+void report(const std::string& name, double seconds, size_t vertex_count, double baseline_seconds) {
+    double vertices = static_cast<double>(vertex_count);
+    std::cout << std::setw(24) << name << std::setw(12) << std::fixed << std::setprecision(3)
+              << seconds * 1e9 / vertices << std::setw(14) << std::setprecision(1) << vertices / seconds / 1e6
+              << std::setw(10) << std::setprecision(2) << baseline_seconds / seconds << std::endl;
+}
+
+bool same(const std::vector<double>& a, const std::vector<double>& b) {
+    return std::memcmp(a.data(), b.data(), a.size() * sizeof(double)) == 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t polygon_count = 1 << 20;
+    size_t vertices = 6;
+    int repeat = 5;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--polygons" && i + 1 < argc) {
+            polygon_count = std::max(std::atol(argv[++i]), 1L);
+        } else if (arg == "--vertices" && i + 1 < argc) {
+            vertices = std::max(std::atol(argv[++i]), 3L);
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::max(std::atoi(argv[++i]), 1);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--polygons N] [--vertices K] [--repeat R]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<Polygon> polygons = makePolygons(polygon_count, vertices);
+    std::vector<Point> points;
+    std::vector<uint64_t> offsets(1, 0);
+    points.reserve(polygon_count * vertices);
+    for (const auto& poly : polygons) {
+        points.insert(points.end(), poly.points.begin(), poly.points.end());
+        offsets.push_back(points.size());
+    }
+    const size_t vertex_count = points.size();
+    std::cout << "Polygons: " << polygon_count << " of " << vertices << " vertices, active kernel: "
+              << measureKernelName(activeMeasureKernel()) << std::endl;
+    std::cout << std::setw(24) << "method" << std::setw(12) << "ns/vertex" << std::setw(14) << "Mvertices/s"
+              << std::setw(10) << "speedup" << std::endl;
+
+    std::vector<double> expected_areas(polygon_count);
+    std::vector<double> expected_perimeters(polygon_count);
+    double area_baseline = bestSeconds(repeat, [&]() {
+        for (auto& poly : polygons) {
+            poly.calculateArea();
+        }
+    });
+    report("calculateArea", area_baseline, vertex_count, area_baseline);
+    double baseline = bestSeconds(repeat, [&]() {
+        for (auto& poly : polygons) {
+            poly.calculateArea();
+            poly.calculatePerimeter();
+        }
+    });
+    report("both", baseline, vertex_count, baseline);
+    for (size_t i = 0; i < polygon_count; ++i) {
+        expected_areas[i] = polygons[i].area;
+        expected_perimeters[i] = polygons[i].perimeter;
+    }
+
+    // Speedups are against calculateArea for the area runs and against both calls for the others
+    bool all_match = true;
+    std::vector<double> areas(polygon_count);
+    std::vector<double> perimeters(polygon_count);
+    for (MeasureKernel kernel : {MeasureKernel::Scalar, MeasureKernel::AVX2, MeasureKernel::AVX512}) {
+        if (!measureKernelSupported(kernel)) {
+            std::cout << std::setw(24) << measureKernelName(kernel) << "  not supported on this CPU" << std::endl;
+            continue;
+        }
+        std::string name = measureKernelName(kernel);
+        double seconds = bestSeconds(repeat, [&]() {
+            measurePolygons(points.data(), offsets.data(), polygon_count, areas.data(), nullptr, kernel);
+        });
+        bool match = same(areas, expected_areas);
+        report(name + " area" + (match ? "" : " MISMATCH"), seconds, vertex_count, area_baseline);
+        all_match = all_match && match;
+
+        seconds = bestSeconds(repeat, [&]() {
+            measurePolygons(points.data(), offsets.data(), polygon_count, areas.data(), perimeters.data(), kernel);
+        });
+        match = same(areas, expected_areas) && same(perimeters, expected_perimeters);
+        report(name + " both" + (match ? "" : " MISMATCH"), seconds, vertex_count, baseline);
+        all_match = all_match && match;
+
+        seconds = bestSeconds(repeat, [&]() {
+            measurePolygons(polygons.data(), polygon_count, areas.data(), perimeters.data(), kernel);
+        });
+        match = same(areas, expected_areas) && same(perimeters, expected_perimeters);
+        report(name + " both list" + (match ? "" : " MISMATCH"), seconds, vertex_count, baseline);
+        all_match = all_match && match;
+    }
+
+    if (!all_match) {
+        std::cerr << "Error: measure kernels disagree with Polygon::calculateArea and calculatePerimeter"
+                  << std::endl;
+        return 1;
+    }
+    return 0;
+}
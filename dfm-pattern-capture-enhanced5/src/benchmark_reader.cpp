@@ -0,0 +1,112 @@
+#include "LayoutFileReader.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+#include <Logging.h>
+
+// Measures LayoutFileReader::loadLayers() throughput for a list of reader thread counts
+// and checks that every thread count produces the same geometry as the first one.
+//
+// Usage: benchmark_reader <layout_file> [--repeat N] [thread_count ...]
+
+struct LoadResult {
+    size_t polygons = 0;
+    size_t points = 0;
+    double checksum = 0.0;
+};
+
+LoadResult summarize(const std::vector<Layer>& layers) {
+    LoadResult result;
+    for (const auto& layer : layers) {
+        result.polygons += layer.polygons.size();
+        for (size_t i = 0; i < layer.polygons.size(); ++i) {
+            for (const auto& p : layer.polygons[i].points) {
+                result.checksum += (p.x + 2.0 * p.y) * static_cast<double>(i % 97 + 1);
+            }
+            result.points += layer.polygons[i].points.size();
+        }
+    }
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    LOG_FUNCTION()
+
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <layout_file> [--repeat N] [thread_count ...]" << std::endl;
+        return 1;
+    }
+    std::string layout_file = argv[1];
+    int repeat = 3;
+    std::vector<int> thread_counts;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::max(std::atoi(argv[++i]), 1);
+        } else {
+            thread_counts.push_back(std::max(std::atoi(argv[i]), 1));
+        }
+    }
+    if (thread_counts.empty()) {
+        thread_counts = {1, 2, 4, 8, 16, 32};
+    }
+
+    struct stat st;
+    if (::stat(layout_file.c_str(), &st) != 0) {
+        std::cerr << "Error: Cannot stat layout file " << layout_file << std::endl;
+        return 1;
+    }
+    double megabytes = static_cast<double>(st.st_size) / (1024.0 * 1024.0);
+
+    std::vector<std::pair<int, int>> layers;
+    try {
+        LayoutFileReader catalog_reader(layout_file);
+        layers = catalog_reader.getAvailableLayersAndDatatypes();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "Layout file: " << layout_file << " (" << std::fixed << std::setprecision(1)
+              << megabytes << " MB, " << layers.size() << " layers)" << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "best [s]" << std::setw(12) << "MB/s"
+              << std::setw(10) << "speedup" << std::setw(12) << "polygons" << std::setw(10) << "match" << std::endl;
+
+    double baseline_seconds = 0.0;
+    LoadResult baseline;
+    bool all_match = true;
+    for (size_t t = 0; t < thread_counts.size(); ++t) {
+        double best = 0.0;
+        LoadResult result;
+        for (int r = 0; r < repeat; ++r) {
+            LayoutFileReader reader(layout_file);
+            reader.setReaderThreads(thread_counts[t]);
+            auto start = std::chrono::steady_clock::now();
+            std::vector<Layer> loaded = reader.loadLayers(layers);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (r == 0 || seconds < best) best = seconds;
+            result = summarize(loaded);
+        }
+        if (t == 0) {
+            baseline_seconds = best;
+            baseline = result;
+        }
+        bool match = result.polygons == baseline.polygons && result.points == baseline.points &&
+                     result.checksum == baseline.checksum;
+        all_match = all_match && match;
+        std::cout << std::setw(8) << thread_counts[t] << std::setw(12) << std::setprecision(4) << best
+                  << std::setw(12) << std::setprecision(1) << megabytes / best
+                  << std::setw(10) << std::setprecision(2) << baseline_seconds / best
+                  << std::setw(12) << result.polygons << std::setw(10) << (match ? "yes" : "NO") << std::endl;
+    }
+
+    if (!all_match) {
+        std::cerr << "Error: Parallel results differ from the first thread count" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include "GDSIIDecode.h"
+#include "GDSIIRecords.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Measures GDSII XY payload decoding: the per-coordinate gdsReadInt32 loop the reader used before,
+// against each decoder kernel this CPU supports, and checks that all of them produce the same points
+// and, when asked for them, the same bounding boxes.
+//
+// Usage: benchmark_xy_decode [--points N] [--record_points K] [--repeat R]
+//   N points in total, decoded K points (one XY record) per call
+
+namespace {
+
+struct Payload {
+    std::vector<uint8_t> bytes;
+    size_t record_points;
+    size_t records;
+};
+
+Payload makePayload(size_t total_points, size_t record_points) {
+    Payload payload;
+    payload.record_points = record_points;
+    payload.records = std::max<size_t>(total_points / record_points, 1);
+    payload.bytes.resize(payload.records * record_points * 8);
+    uint64_t state = 1;
+    for (size_t i = 0; i < payload.bytes.size(); i += 4) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        // Coordinates of both signs, up to +-2^30 database units
+        gdsWriteInt32(payload.bytes.data() + i, static_cast<int32_t>(state >> 33) - (1 << 30));
+    }
+    return payload;
+}
+
+// The reader's decoding before the vectorized kernels: one gdsReadInt32 per coordinate, then scaling
+void decodeReference(const uint8_t* xy, size_t point_count, double scale, std::vector<Point>& points) {
+    points.clear();
+    points.reserve(point_count);
+    for (size_t i = 0; i < point_count; i++, xy += 8) {
+        points.emplace_back(gdsReadInt32(xy), gdsReadInt32(xy + 4));
+    }
+    for (auto& p : points) {
+        p.x *= scale;
+        p.y *= scale;
+    }
+}
+
+// Best time of repeat runs
+double bestSeconds(int repeat, const std::function<void()>& run) {
+    double best = 0.0;
+    for (int r = 0; r < repeat; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (r == 0 || seconds < best) best = seconds;
+    }
+    return best;
+}
+
+void report(const std::string& name, double seconds, const Payload& payload, double baseline_seconds) {
+    double points = static_cast<double>(payload.records * payload.record_points);
+    std::cout << std::setw(20) << name << std::setw(12) << std::fixed << std::setprecision(2)
+              << seconds * 1e9 / points << std::setw(12) << std::setprecision(2)
+              << payload.bytes.size() / seconds / (1024.0 * 1024.0 * 1024.0) << std::setw(10) << std::setprecision(2)
+              << baseline_seconds / seconds << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t total_points = 16 << 20;
+    size_t record_points = 5;
+    int repeat = 5;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--points" && i + 1 < argc) {
+            total_points = std::max(std::atol(argv[++i]), 1L);
+        } else if (arg == "--record_points" && i + 1 < argc) {
+            record_points = std::max(std::atol(argv[++i]), 1L);
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::max(std::atoi(argv[++i]), 1);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--points N] [--record_points K] [--repeat R]" << std::endl;
+            return 1;
+        }
+    }
+
+    const double scale = 0.001;
+    Payload payload = makePayload(total_points, record_points);
+    const size_t record_bytes = record_points * 8;
+    std::cout << "XY payload: " << payload.records << " records of " << record_points << " points ("
+              << std::fixed << std::setprecision(1) << payload.bytes.size() / (1024.0 * 1024.0) << " MB), "
+              << "active kernel: " << gdsXYKernelName(gdsActiveXYKernel()) << std::endl;
+    std::cout << std::setw(20) << "decoder" << std::setw(12) << "ns/point" << std::setw(12) << "GB/s"
+              << std::setw(10) << "speedup" << std::endl;
+
+    // Reference points, decoded record by record into one buffer
+    std::vector<Point> expected(payload.records * record_points);
+    std::vector<Point> scratch;
+    double baseline = bestSeconds(repeat, [&]() {
+        for (size_t r = 0; r < payload.records; ++r) {
+            decodeReference(payload.bytes.data() + r * record_bytes, record_points, scale, scratch);
+            std::memcpy(&expected[r * record_points], scratch.data(), record_bytes * 2);
+        }
+    });
+    report("reference", baseline, payload, baseline);
+
+    bool all_match = true;
+    std::vector<BoundingBox> expected_boxes(payload.records, BoundingBox::empty());
+    for (size_t r = 0; r < payload.records; ++r) {
+        for (size_t k = 0; k < record_points; ++k) {
+            expected_boxes[r].include(expected[r * record_points + k]);
+        }
+    }
+    std::vector<Point> points(expected.size());
+    std::vector<BoundingBox> boxes(payload.records);
+    std::vector<int32_t> coordinates(2 * expected.size());
+    for (GdsXYKernel kernel : {GdsXYKernel::Scalar, GdsXYKernel::SSSE3, GdsXYKernel::AVX2}) {
+        if (!gdsXYKernelSupported(kernel)) {
+            std::cout << std::setw(20) << gdsXYKernelName(kernel) << "  not supported on this CPU" << std::endl;
+            continue;
+        }
+        std::string name = gdsXYKernelName(kernel);
+        double seconds = bestSeconds(repeat, [&]() {
+            for (size_t r = 0; r < payload.records; ++r) {
+                gdsDecodeXY(payload.bytes.data() + r * record_bytes, record_points, scale,
+                            &points[r * record_points], kernel);
+            }
+        });
+        bool match = std::memcmp(points.data(), expected.data(), points.size() * sizeof(Point)) == 0;
+        report(name + (match ? "" : " MISMATCH"), seconds, payload, baseline);
+
+        seconds = bestSeconds(repeat, [&]() {
+            for (size_t r = 0; r < payload.records; ++r) {
+                gdsDecodeXY(payload.bytes.data() + r * record_bytes, record_points, scale,
+                            &points[r * record_points], boxes[r], kernel);
+            }
+        });
+        bool box_match = std::memcmp(points.data(), expected.data(), points.size() * sizeof(Point)) == 0 &&
+                         std::memcmp(boxes.data(), expected_boxes.data(), boxes.size() * sizeof(BoundingBox)) == 0;
+        report(name + " bounds" + (box_match ? "" : " MISMATCH"), seconds, payload, baseline);
+
+        seconds = bestSeconds(repeat, [&]() {
+            for (size_t r = 0; r < payload.records; ++r) {
+                gdsDecodeXY(payload.bytes.data() + r * record_bytes, record_points,
+                            &coordinates[2 * r * record_points], kernel);
+            }
+        });
+        bool int_match = true;
+        for (size_t i = 0; i < expected.size() && int_match; ++i) {
+            int_match = coordinates[2 * i] * scale == expected[i].x && coordinates[2 * i + 1] * scale == expected[i].y;
+        }
+        report(name + " int32" + (int_match ? "" : " MISMATCH"), seconds, payload, baseline);
+        all_match = all_match && match && box_match && int_match;
+    }
+
+    if (!all_match) {
+        std::cerr << "Error: decoders disagree with the reference" << std::endl;
+        return 1;
+    }
+    return 0;
+}
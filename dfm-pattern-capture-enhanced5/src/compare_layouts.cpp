@@ -0,0 +1,155 @@
+#include "LayoutFileReader.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <Logging.h>
+
+// Compares the flattened geometry of two layout files (GDSII or OASIS, in any combination) layer by
+// layer. Polygons are compared on the database grid, as sets: their order, starting vertex,
+// orientation and collinear vertices do not matter.
+//
+// Usage: compare_layouts <layout_a> <layout_b> [--threads N] [--keep_repetitions]
+//   N reader threads for both files; --keep_repetitions loads repeated OASIS shapes compactly
+//   and expands them afterwards
+
+namespace {
+
+using Outline = std::vector<std::pair<long long, long long>>;
+using LayerKey = std::pair<int, int>;
+
+long long cross(const std::pair<long long, long long>& o, const std::pair<long long, long long>& a,
+                const std::pair<long long, long long>& b) {
+    return (a.first - o.first) * (b.second - o.second) - (a.second - o.second) * (b.first - o.first);
+}
+
+// Vertices in database units, without repeated or collinear vertices, counterclockwise from the
+// smallest one
+Outline canonical(const Polygon& polygon, double unit_scale) {
+    Outline outline;
+    for (const auto& p : polygon.points) {
+        outline.emplace_back(std::llround(p.x / unit_scale), std::llround(p.y / unit_scale));
+    }
+    bool changed = true;
+    while (changed && outline.size() >= 3) {
+        changed = false;
+        for (size_t i = 0; i < outline.size() && outline.size() >= 3; ++i) {
+            const auto& previous = outline[(i + outline.size() - 1) % outline.size()];
+            const auto& next = outline[(i + 1) % outline.size()];
+            if (outline[i] == previous || cross(previous, outline[i], next) == 0) {
+                outline.erase(outline.begin() + static_cast<long>(i));
+                changed = true;
+                --i;
+            }
+        }
+    }
+    long long doubled_area = 0;
+    for (size_t i = 0; i < outline.size(); ++i) {
+        const auto& a = outline[i];
+        const auto& b = outline[(i + 1) % outline.size()];
+        doubled_area += a.first * b.second - b.first * a.second;
+    }
+    if (doubled_area < 0) {
+        std::reverse(outline.begin(), outline.end());
+    }
+    std::rotate(outline.begin(), std::min_element(outline.begin(), outline.end()), outline.end());
+    return outline;
+}
+
+std::map<LayerKey, std::vector<Outline>> loadOutlines(const std::string& layout_file, int threads,
+                                                      bool keep_repetitions) {
+    LayoutFileReader reader(layout_file);
+    reader.setReaderThreads(threads);
+    reader.setKeepRepetitions(keep_repetitions);
+    std::vector<LayerKey> keys = reader.getAvailableLayersAndDatatypes();
+    std::vector<Layer> layers = reader.loadLayers(keys);
+    double unit_scale = reader.getUnitScale();
+
+    std::map<LayerKey, std::vector<Outline>> outlines;
+    for (auto& layer : layers) {
+        layer.expandRepetitions();
+        std::vector<Outline>& layer_outlines = outlines[{layer.layer_number, layer.datatype}];
+        for (const auto& polygon : layer.polygons) {
+            layer_outlines.push_back(canonical(polygon, unit_scale));
+        }
+        std::sort(layer_outlines.begin(), layer_outlines.end());
+    }
+    return outlines;
+}
+
+std::string format(const Outline& outline) {
+    std::string text;
+    for (const auto& p : outline) {
+        text += "(" + std::to_string(p.first) + "," + std::to_string(p.second) + ")";
+    }
+    return text;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    LOG_FUNCTION()
+
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <layout_a> <layout_b> [--threads N] [--keep_repetitions]"
+                  << std::endl;
+        return 1;
+    }
+    int threads = 1;
+    bool keep_repetitions = false;
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max(std::atoi(argv[++i]), 1);
+        } else if (arg == "--keep_repetitions") {
+            keep_repetitions = true;
+        } else {
+            std::cerr << "Error: Unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    std::map<LayerKey, std::vector<Outline>> a, b;
+    try {
+        a = loadOutlines(argv[1], threads, keep_repetitions);
+        b = loadOutlines(argv[2], threads, keep_repetitions);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    bool all_match = true;
+    std::map<LayerKey, bool> keys;
+    for (const auto& entry : a) keys[entry.first];
+    for (const auto& entry : b) keys[entry.first];
+    for (const auto& entry : keys) {
+        const LayerKey& key = entry.first;
+        const std::vector<Outline>& left = a[key];
+        const std::vector<Outline>& right = b[key];
+        std::cout << "Layer " << key.first << ":" << key.second << ": " << left.size() << " / " << right.size()
+                  << " polygons";
+        if (left == right) {
+            std::cout << " match" << std::endl;
+            continue;
+        }
+        all_match = false;
+        auto mismatch = std::mismatch(left.begin(), left.end(), right.begin(), right.end());
+        std::cout << " differ" << std::endl;
+        if (mismatch.first != left.end()) {
+            std::cout << "  first differing polygon in " << argv[1] << ": " << format(*mismatch.first) << std::endl;
+        }
+        if (mismatch.second != right.end()) {
+            std::cout << "  first differing polygon in " << argv[2] << ": " << format(*mismatch.second) << std::endl;
+        }
+    }
+    if (!all_match) {
+        std::cerr << "Error: " << argv[1] << " and " << argv[2] << " differ" << std::endl;
+        return 1;
+    }
+    std::cout << "Layouts match on " << keys.size() << " layers" << std::endl;
+    return 0;
+}
@@ -1,134 +1,22 @@
 #include "Geometry.h"
-#include <fstream>
+#include "LayoutFileWriter.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
 #include <vector>
 #include <string>
-#include <cmath>
-#include <iomanip>
 #include <Logging.h>
 
-// Write a 16-bit unsigned integer
-void write_uint16(std::ofstream& file, uint16_t value) {
-    LOG_FUNCTION()
-    file.put(static_cast<char>(value >> 8));
-    file.put(static_cast<char>(value & 0xFF));
-    if (!file) std::cerr << "Error writing uint16 at " << file.tellp() << std::endl;
-}
-
-// Write a 32-bit integer
-void write_int32(std::ofstream& file, int32_t value) {
-    LOG_FUNCTION()
-    file.put(static_cast<char>(value >> 24));
-    file.put(static_cast<char>((value >> 16) & 0xFF));
-    file.put(static_cast<char>((value >> 8) & 0xFF));
-    file.put(static_cast<char>(value & 0xFF));
-    if (!file) std::cerr << "Error writing int32 at " << file.tellp() << std::endl;
-}
-
-// Write a GDSII double
-void write_double(std::ofstream& file, double value) {
-    LOG_FUNCTION()
-    bool negative = value < 0;
-    if (negative) value = -value;
-    int exponent = 0;
-    while (value > 1.0 && exponent < 64) {
-        value /= 16.0;
-        exponent++;
-    }
-    while (value < 0.0625 && exponent > -64) {
-        value *= 16.0;
-        exponent--;
-    }
-    uint64_t mantissa = static_cast<uint64_t>(value * (1ULL << 56));
-    uint8_t sign_exp = (negative ? 0x80 : 0) | (static_cast<uint8_t>(exponent + 64) & 0x7F);
-    file.put(static_cast<char>(sign_exp));
-    for (int i = 6; i >= 0; --i) {
-        file.put(static_cast<char>((mantissa >> (i * 8)) & 0xFF));
-    }
-    if (!file) std::cerr << "Error writing double at " << file.tellp() << std::endl;
-}
-
-// Write a string with specified record type
-void write_string(std::ofstream& file, const std::string& str, uint8_t record_type, size_t& byte_pos) {
-    LOG_FUNCTION()
-    size_t len = str.size();
-    if (len % 2) len++; // Pad to even length
-    write_uint16(file, static_cast<uint16_t>(len + 4));
-    file.put(record_type); // LIBNAME (0x02) or STRNAME (0x06)
-    file.put(0x06); // ASCII data type
-    file.write(str.c_str(), str.size());
-    if (str.size() % 2) file.put(0);
-    byte_pos += len + 4;
-    std::cout << "Wrote string record type 0x" << std::hex << (int)record_type
-              << " at " << std::dec << (byte_pos - (len + 4)) << ": " << str << std::endl;
-    if (!file) std::cerr << "Error writing string at " << file.tellp() << std::endl;
-}
-
-// Write a polygon
-void write_polygon(std::ofstream& file, const Polygon& poly, int layer_number, int datatype, double unit_scale, size_t& byte_pos, size_t poly_index) {
-    LOG_FUNCTION()
-    if (!poly.isValid()) {
-        std::cerr << "Error: Invalid polygon " << poly_index << " for layer " << layer_number << ":" << datatype << std::endl;
-        return;
-    }
-
-    std::cout << "Writing polygon " << poly_index << " to layer " << layer_number << ":" << datatype << std::endl;
-
-    // BOUNDARY
-    write_uint16(file, 4);
-    file.put(0x08);
-    file.put(0x00);
-    byte_pos += 4;
-    std::cout << "Wrote BOUNDARY at " << byte_pos - 4 << std::endl;
-
-    // LAYER
-    write_uint16(file, 6);
-    file.put(0x0D);
-    file.put(0x02);
-    write_uint16(file, static_cast<uint16_t>(layer_number));
-    byte_pos += 6;
-    std::cout << "Wrote LAYER " << layer_number << " at " << byte_pos - 6 << std::endl;
-
-    // DATATYPE
-    write_uint16(file, 6);
-    file.put(0x0E);
-    file.put(0x02);
-    write_uint16(file, static_cast<uint16_t>(datatype));
-    byte_pos += 6;
-    std::cout << "Wrote DATATYPE " << datatype << " at " << byte_pos - 6 << std::endl;
-
-    // XY
-    size_t num_points = poly.points.size() + 1;
-    uint16_t xy_length = static_cast<uint16_t>(4 + 8 * num_points);
-    write_uint16(file, xy_length);
-    file.put(0x10);
-    file.put(0x03);
-    byte_pos += 4;
-    std::cout << "Wrote XY header at " << byte_pos - 4 << " (length=" << xy_length << ", points=" << num_points << ")" << std::endl;
-    for (size_t i = 0; i < poly.points.size(); ++i) {
-        int32_t x = static_cast<int32_t>(std::round(poly.points[i].x / unit_scale));
-        int32_t y = static_cast<int32_t>(std::round(poly.points[i].y / unit_scale));
-        write_int32(file, x);
-        write_int32(file, y);
-        byte_pos += 8;
-        std::cout << "Wrote point " << i << " (" << x << "," << y << ") at " << byte_pos - 8 << std::endl;
-    }
-    int32_t x0 = static_cast<int32_t>(std::round(poly.points[0].x / unit_scale));
-    int32_t y0 = static_cast<int32_t>(std::round(poly.points[0].y / unit_scale));
-    write_int32(file, x0);
-    write_int32(file, y0);
-    byte_pos += 8;
-    std::cout << "Wrote closing point (" << x0 << "," << y0 << ") at " << byte_pos - 8 << std::endl;
-
-    // ENDEL
-    write_uint16(file, 4);
-    file.put(0x11);
-    file.put(0x00);
-    byte_pos += 4;
-    std::cout << "Wrote ENDEL at " << byte_pos - 4 << std::endl;
-
-    std::cout << "Finished polygon " << poly_index << " (area=" << poly.area << ")" << std::endl;
-}
+// Writes GDSII test layouts with a mask layer 66:20 and input layers 67:20, 68:20 and 69:20.
+//
+// Usage: generate_test_gds [output_file]
+//            The small fixed layout used by the regression tests
+//        generate_test_gds <output_file> --polygons N [--density D] [--all_angle] [--overlap R]
+//                          [--depth L] [--array A] [--aref] [--feature_size S] [--seed S]
+//            A synthetic layout of about N polygons for benchmarking; see SyntheticOptions
 
 // Create a rectangle
 Polygon create_rectangle(double x, double y, double width, double height) {
@@ -153,67 +41,9 @@ Polygon create_triangle(double x, double y, double size, int offset) {
     return poly;
 }
 
-int main(int argc, char* argv[]) {
+// The small fixed layout used by the regression tests
+int writeRegressionLayout(const std::string& output_file) {
     LOG_FUNCTION()
-    
-    std::string output_file = "test_layers.gds";
-    if (argc > 1) {
-        output_file = argv[1];
-    }
-
-    std::ofstream file(output_file, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "Error: Cannot open output file " << output_file << std::endl;
-        return 1;
-    }
-
-    size_t byte_pos = 0;
-
-    // GDSII parameters
-    double user_unit = 1e-6; // 1 micron
-    double db_unit = 1e-9;   // 1 nanometer
-    double unit_scale = db_unit / user_unit; // 1e-3
-
-    // HEADER
-    write_uint16(file, 6);
-    file.put(0x00);
-    file.put(0x02);
-    write_uint16(file, 600);
-    byte_pos += 6;
-    std::cout << "Wrote HEADER at 0" << std::endl;
-
-    // BGNLIB
-    write_uint16(file, 28);
-    file.put(0x01);
-    file.put(0x02);
-    for (int i = 0; i < 12; ++i) write_uint16(file, 2025);
-    byte_pos += 28;
-    std::cout << "Wrote BGNLIB at 6" << std::endl;
-
-    // LIBNAME
-    write_string(file, "TESTLIB", 0x02, byte_pos);
-    std::cout << "Wrote LIBNAME at 34" << std::endl;
-
-    // UNITS
-    write_uint16(file, 20);
-    file.put(0x03);
-    file.put(0x05);
-    write_double(file, user_unit);
-    write_double(file, db_unit);
-    byte_pos += 20;
-    std::cout << "Wrote UNITS at 46" << std::endl;
-
-    // BGNSTR
-    write_uint16(file, 28);
-    file.put(0x05);
-    file.put(0x02);
-    for (int i = 0; i < 12; ++i) write_uint16(file, 2025);
-    byte_pos += 28;
-    std::cout << "Wrote BGNSTR at 66" << std::endl;
-
-    // STRNAME
-    write_string(file, "TESTCELL", 0x06, byte_pos);
-    std::cout << "Wrote STRNAME at 94" << std::endl;
 
     // Layers and polygons (scaled down by 1000x)
     std::vector<std::pair<int, int>> layers = {{66, 20}, {67, 20}, {68, 20}, {69, 20}};
@@ -259,34 +89,252 @@ int main(int argc, char* argv[]) {
         create_rectangle(8.0, 1.4, 0.4, 0.4)
     };
 
-    // Write polygons
-    size_t poly_index = 0;
+    LayoutFileWriter writer(output_file);
+    writer.beginLibrary("TESTLIB", 1e-6, 1e-9); // 1 micron user unit, 1 nanometer database unit
+    writer.beginStructure("TESTCELL");
     for (size_t i = 0; i < layers.size(); ++i) {
         for (const auto& poly : layer_polygons[i]) {
-            write_polygon(file, poly, layers[i].first, layers[i].second, unit_scale, byte_pos, poly_index++);
+            if (!poly.isValid()) {
+                std::cerr << "Error: Invalid polygon for layer " << layers[i].first << ":" << layers[i].second << std::endl;
+                continue;
+            }
+            writer.writePolygon(layers[i].first, layers[i].second, poly);
         }
     }
+    writer.endStructure();
+    writer.endLibrary();
+    writer.close();
+    std::cout << "Generated GDSII file: " << output_file << " with 4 layers" << std::endl;
+    return 0;
+}
+
+namespace {
+
+const int MASK_LAYER = 66;
+const int LAYER_DATATYPE = 20;
+const int INPUT_LAYERS[] = {67, 68, 69};
+const int LAYERS_PER_SITE = 4; // The mask polygon and one polygon on each input layer
+
+struct SyntheticOptions {
+    uint64_t polygons = 0;        // Total polygons once the hierarchy is expanded
+    double density = 0.25;        // Fraction of the area taken by the feature_size squares that hold the
+                                  // mask polygons (0, 0.9]; the polygons fill about half of each square
+    bool all_angle = false;       // Convex all-angle polygons instead of rectangles and L shapes
+    double overlap = 0.5;         // Probability that an input polygon overlaps its mask polygon
+    int depth = 0;                // Hierarchy levels above the leaf cell; 0 writes a flat layout
+    int array = 2;                // Each level places array x array copies of the level below
+    bool aref = false;            // As one AREF instead of array * array SREFs
+    int32_t feature_size = 1000;  // Mask polygon size in database units (1 nm)
+    uint64_t seed = 1;
+};
+
+// splitmix64: small, fast, and the same sequence on every platform for a given seed
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed) {}
+    uint64_t next() {
+        uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    double uniform() { return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0); }
+    int32_t range(int32_t low, int32_t high) { return low + static_cast<int32_t>(uniform() * (high - low + 1)); }
+
+private:
+    uint64_t state_;
+};
+
+// Convex polygon with vertex_count vertices around (cx, cy). The angular gaps stay below pi,
+// so the polygon always contains its center.
+std::vector<DbuPoint> convexShape(Random& random, int32_t cx, int32_t cy, int32_t radius, int vertex_count) {
+    const double PI = 3.14159265358979323846;
+    std::vector<DbuPoint> points;
+    double step = 2 * PI / vertex_count;
+    double start = random.uniform() * step;
+    for (int i = 0; i < vertex_count; ++i) {
+        double angle = start + step * (i + 0.4 * (random.uniform() - 0.5));
+        double r = radius * (0.8 + 0.2 * random.uniform());
+        DbuPoint p(cx + static_cast<int32_t>(std::lround(r * std::cos(angle))),
+                   cy + static_cast<int32_t>(std::lround(r * std::sin(angle))));
+        if (points.empty() || !(points.back() == p)) points.push_back(p);
+    }
+    return points;
+}
+
+std::vector<DbuPoint> rectangle(int32_t x, int32_t y, int32_t width, int32_t height) {
+    return {{x, y}, {x + width, y}, {x + width, y + height}, {x, y + height}};
+}
 
-    // ENDSTR
-    write_uint16(file, 4);
-    file.put(0x07); // Changed to 0x07 to test if 0x06 causes issues
-    file.put(0x00);
-    byte_pos += 4;
-    std::cout << "Wrote ENDSTR at " << byte_pos - 4 << std::endl;
+// Writes the polygons of one site: a mask polygon inside [x, x + size]^2 and one polygon per
+// input layer, either over the mask polygon or in the free margin to its right
+void writeSite(LayoutFileWriter& writer, Random& random, const SyntheticOptions& options, int32_t pitch,
+               int32_t x, int32_t y) {
+    int32_t size = options.feature_size;
+    int32_t margin = pitch - size;
+    // Center and half-extent of a region that lies inside the mask polygon whatever its shape
+    int32_t inner_x, inner_y, inner_half;
+    if (options.all_angle) {
+        int32_t radius = size / 2;
+        writer.writeBoundary(MASK_LAYER, LAYER_DATATYPE, convexShape(random, x + radius, y + radius, radius,
+                                                                     5 + static_cast<int>(random.next() % 4)));
+        inner_x = x + radius;
+        inner_y = y + radius;
+        inner_half = radius / 4;
+    } else {
+        int32_t width = random.range(size / 2, size);
+        int32_t height = random.range(size / 2, size);
+        if (random.uniform() < 0.25) {
+            // L shape: the rectangle without its upper right quarter
+            std::vector<DbuPoint> shape = {{x, y}, {x + width, y}, {x + width, y + height / 2},
+                                           {x + width / 2, y + height / 2}, {x + width / 2, y + height}, {x, y + height}};
+            writer.writeBoundary(MASK_LAYER, LAYER_DATATYPE, shape);
+        } else {
+            writer.writeBoundary(MASK_LAYER, LAYER_DATATYPE, rectangle(x, y, width, height));
+        }
+        inner_x = x + width / 4;
+        inner_y = y + height / 4;
+        inner_half = std::min(width, height) / 4;
+    }
 
-    // ENDLIB
-    write_uint16(file, 4);
-    file.put(0x04);
-    file.put(0x00);
-    byte_pos += 4;
-    std::cout << "Wrote ENDLIB at " << byte_pos - 4 << std::endl;
+    int32_t outside_size = std::min(size / 4, margin / 2);
+    for (size_t i = 0; i < sizeof(INPUT_LAYERS) / sizeof(INPUT_LAYERS[0]); ++i) {
+        bool overlapping = random.uniform() < options.overlap || outside_size < 4;
+        int32_t cx, cy, half;
+        if (overlapping) {
+            // Centered inside the mask polygon, so it overlaps whatever its own size
+            half = std::max<int32_t>(2, random.range(size / 8, size / 4));
+            cx = inner_x + random.range(-inner_half / 2, inner_half / 2);
+            cy = inner_y + random.range(-inner_half / 2, inner_half / 2);
+        } else {
+            half = outside_size / 2;
+            cx = x + size + margin / 2;
+            cy = y + static_cast<int32_t>((2 * i + 1) * size / 6);
+        }
+        if (options.all_angle) {
+            writer.writeBoundary(INPUT_LAYERS[i], LAYER_DATATYPE,
+                                 convexShape(random, cx, cy, half, 3 + static_cast<int>(random.next() % 4)));
+        } else {
+            writer.writeBoundary(INPUT_LAYERS[i], LAYER_DATATYPE, rectangle(cx - half, cy - half, 2 * half, 2 * half));
+        }
+    }
+}
 
-    file.flush();
-    file.close();
-    if (!file.good()) {
-        std::cerr << "Error: File write failed for " << output_file << std::endl;
+int writeSyntheticLayout(const std::string& output_file, const SyntheticOptions& options) {
+    LOG_FUNCTION()
+    auto start = std::chrono::steady_clock::now();
+
+    // Every level multiplies the leaf sites by array^2
+    double copies = std::pow(static_cast<double>(options.array) * options.array, options.depth);
+    uint64_t leaf_sites = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(
+                                                     options.polygons / (LAYERS_PER_SITE * copies))));
+    int32_t pitch = static_cast<int32_t>(std::ceil(options.feature_size / std::sqrt(options.density)));
+    uint64_t columns = static_cast<uint64_t>(std::ceil(std::sqrt(static_cast<double>(leaf_sites))));
+    uint64_t rows = (leaf_sites + columns - 1) / columns;
+    double extent = static_cast<double>(std::max(columns, rows)) * pitch *
+                    std::pow(static_cast<double>(options.array), options.depth);
+    if (extent > 2.0e9) {
+        std::cerr << "Error: Layout extent " << extent << " exceeds the 32-bit coordinate range" << std::endl;
         return 1;
     }
-    std::cout << "Generated GDSII file: " << output_file << " with 4 layers" << std::endl;
+
+    Random random(options.seed);
+    LayoutFileWriter writer(output_file);
+    writer.beginLibrary("SYNTHLIB", 1e-6, 1e-9);
+    std::string child = options.depth == 0 ? "TOP" : "LEAF";
+    writer.beginStructure(child);
+    for (uint64_t site = 0; site < leaf_sites; ++site) {
+        writeSite(writer, random, options, pitch, static_cast<int32_t>((site % columns) * pitch),
+                  static_cast<int32_t>((site / columns) * pitch));
+    }
+    writer.endStructure();
+
+    int32_t width = static_cast<int32_t>(columns * pitch);
+    int32_t height = static_cast<int32_t>(rows * pitch);
+    for (int level = 1; level <= options.depth; ++level) {
+        std::string name = level == options.depth ? "TOP" : "LEVEL_" + std::to_string(level);
+        writer.beginStructure(name);
+        if (options.aref) {
+            writer.writeAref(child, options.array, options.array, 0, 0, width, height);
+        } else {
+            for (int row = 0; row < options.array; ++row) {
+                for (int column = 0; column < options.array; ++column) {
+                    writer.writeSref(child, column * width, row * height);
+                }
+            }
+        }
+        writer.endStructure();
+        child = name;
+        width *= options.array;
+        height *= options.array;
+    }
+    writer.endLibrary();
+    writer.close();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t total = static_cast<uint64_t>(leaf_sites * LAYERS_PER_SITE * copies);
+    std::cout << "Generated GDSII file: " << output_file << " with " << total << " polygons (" << leaf_sites
+              << " sites per leaf cell, depth " << options.depth << "), " << writer.bytesWritten() << " bytes in "
+              << seconds << " s" << std::endl;
     return 0;
 }
+
+// Value of the option at argv[i + 1]; throws if it is missing
+std::string optionValue(int argc, char* argv[], int& i) {
+    if (i + 1 >= argc) {
+        throw std::invalid_argument(std::string("Missing value for ") + argv[i]);
+    }
+    return argv[++i];
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    LOG_FUNCTION()
+
+    std::string output_file = "test_layers.gds";
+    SyntheticOptions options;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--polygons") {
+                options.polygons = std::stoull(optionValue(argc, argv, i));
+            } else if (arg == "--density") {
+                options.density = std::stod(optionValue(argc, argv, i));
+            } else if (arg == "--all_angle") {
+                options.all_angle = true;
+            } else if (arg == "--overlap") {
+                options.overlap = std::stod(optionValue(argc, argv, i));
+            } else if (arg == "--depth") {
+                options.depth = std::stoi(optionValue(argc, argv, i));
+            } else if (arg == "--array") {
+                options.array = std::stoi(optionValue(argc, argv, i));
+            } else if (arg == "--aref") {
+                options.aref = true;
+            } else if (arg == "--feature_size") {
+                options.feature_size = std::stoi(optionValue(argc, argv, i));
+            } else if (arg == "--seed") {
+                options.seed = std::stoull(optionValue(argc, argv, i));
+            } else if (arg.rfind("--", 0) == 0) {
+                throw std::invalid_argument("Unknown option " + arg);
+            } else {
+                output_file = arg;
+            }
+        }
+        if (!(options.density > 0 && options.density <= 0.9)) throw std::invalid_argument("--density must be in (0, 0.9]");
+        if (!(options.overlap >= 0 && options.overlap <= 1)) throw std::invalid_argument("--overlap must be in [0, 1]");
+        if (options.depth < 0 || options.depth > 16) throw std::invalid_argument("--depth must be in 0..16");
+        if (options.array < 1 || options.array > 32767) throw std::invalid_argument("--array must be in 1..32767");
+        if (options.feature_size < 16) throw std::invalid_argument("--feature_size must be at least 16");
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    try {
+        return options.polygons > 0 ? writeSyntheticLayout(output_file, options) : writeRegressionLayout(output_file);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,29 @@
+#!/bin/bash
+
+# Throughput benchmark for LayoutFileWriter.
+# Runs benchmark_layout_writer for rectangles and for larger boundaries, each for an output that
+# fits in the page cache and one of 0.6 to 1.3 GB, and fails if any run does not produce exactly
+# the records it should. The output goes to a scratch file that is removed afterwards.
+
+set -e # Exit on error
+
+# Paths and variables
+PROJECT_DIR="$(cd "$(dirname "$0")/../.." && pwd)"
+BUILD_DIR="${BUILD_DIR:-${PROJECT_DIR}/build}"
+OUTPUT_FILE="${TMPDIR:-/tmp}/bench_layout_writer_$$.gds"
+VERTICES="4 32 2000"
+
+for VERTEX_COUNT in ${VERTICES}; do
+    for TOTAL_VERTICES in 400000 80000000; do
+        ${BUILD_DIR}/benchmark_layout_writer --polygons $((TOTAL_VERTICES / VERTEX_COUNT)) \
+            --vertices ${VERTEX_COUNT} --output "${OUTPUT_FILE}" || {
+            echo "Error: benchmark_layout_writer failed for boundaries of ${VERTEX_COUNT} vertices"
+            rm -f "${OUTPUT_FILE}"
+            exit 1
+        }
+        echo
+    done
+done
+
+echo "Layout writer benchmark completed successfully!"
+exit 0
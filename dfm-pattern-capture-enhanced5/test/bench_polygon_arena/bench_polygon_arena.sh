@@ -0,0 +1,23 @@
+#!/bin/bash
+
+# Allocation benchmark for polygon storage on the heap and on a PolygonArena.
+# Runs benchmark_polygon_arena for rectangles and larger polygons and fails if the arena
+# does not cut the heap allocations of a layer load or a capture batch.
+
+set -e # Exit on error
+
+# Paths and variables
+PROJECT_DIR="$(cd "$(dirname "$0")/../.." && pwd)"
+BUILD_DIR="${BUILD_DIR:-${PROJECT_DIR}/build}"
+VERTICES="4 32"
+
+for VERTEX_COUNT in ${VERTICES}; do
+    ${BUILD_DIR}/benchmark_polygon_arena --polygons 1048576 --vertices ${VERTEX_COUNT} --masks 100 || {
+        echo "Error: benchmark_polygon_arena failed for polygons of ${VERTEX_COUNT} vertices"
+        exit 1
+    }
+    echo
+done
+
+echo "Polygon arena benchmark completed successfully!"
+exit 0
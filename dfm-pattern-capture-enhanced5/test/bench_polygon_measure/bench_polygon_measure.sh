@@ -0,0 +1,27 @@
+#!/bin/bash
+
+# Throughput benchmark for the batch polygon area and perimeter kernels.
+# Runs benchmark_polygon_measure for rectangles, small and large polygons, each for a layer
+# that fits in the cache and one that does not, and fails if any kernel's results differ
+# from Polygon::calculateArea and calculatePerimeter.
+
+set -e # Exit on error
+
+# Paths and variables
+PROJECT_DIR="$(cd "$(dirname "$0")/../.." && pwd)"
+BUILD_DIR="${BUILD_DIR:-${PROJECT_DIR}/build}"
+VERTICES="4 32 2000"
+
+for VERTEX_COUNT in ${VERTICES}; do
+    for TOTAL_VERTICES in 40000 8388608; do
+        ${BUILD_DIR}/benchmark_polygon_measure --polygons $((TOTAL_VERTICES / VERTEX_COUNT)) \
+            --vertices ${VERTEX_COUNT} || {
+            echo "Error: benchmark_polygon_measure failed for polygons of ${VERTEX_COUNT} vertices"
+            exit 1
+        }
+        echo
+    done
+done
+
+echo "Polygon measure benchmark completed successfully!"
+exit 0
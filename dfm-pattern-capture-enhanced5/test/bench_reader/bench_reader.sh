@@ -0,0 +1,39 @@
+#!/bin/bash
+
+# Reader scaling benchmark for the parallel GDSII parser.
+# Runs benchmark_reader on spm.gds and on any extra layout files given as arguments,
+# for 1..32 reader threads, and fails if any thread count changes the parsed geometry.
+# SYNTHETIC_POLYGONS="100000 10000000" also benchmarks flat synthetic layouts of those
+# polygon counts, written by generate_test_gds with a fixed seed.
+
+set -e # Exit on error
+
+# Paths and variables
+PROJECT_DIR="$(cd "$(dirname "$0")/../.." && pwd)"
+BUILD_DIR="${BUILD_DIR:-${PROJECT_DIR}/build}"
+THREAD_COUNTS="1 2 4 8 16 32"
+REPEAT=3
+SYNTHETIC_POLYGONS="${SYNTHETIC_POLYGONS:-}"
+
+LAYOUT_FILES=("${PROJECT_DIR}/test/test_spm/spm.gds" "$@")
+
+for POLYGONS in ${SYNTHETIC_POLYGONS}; do
+    SYNTHETIC_FILE="${BUILD_DIR}/synthetic_${POLYGONS}.gds"
+    ${BUILD_DIR}/generate_test_gds "${SYNTHETIC_FILE}" --polygons ${POLYGONS} --seed 1 || {
+        echo "Error: generate_test_gds failed for ${POLYGONS} polygons"
+        exit 1
+    }
+    LAYOUT_FILES+=("${SYNTHETIC_FILE}")
+done
+
+for LAYOUT_FILE in "${LAYOUT_FILES[@]}"; do
+    echo "Benchmarking ${LAYOUT_FILE}"
+    ${BUILD_DIR}/benchmark_reader "${LAYOUT_FILE}" --repeat ${REPEAT} ${THREAD_COUNTS} || {
+        echo "Error: benchmark_reader failed for ${LAYOUT_FILE}"
+        exit 1
+    }
+    echo
+done
+
+echo "Reader benchmark completed successfully!"
+exit 0
@@ -0,0 +1,26 @@
+#!/bin/bash
+
+# Microbenchmark for the GDSII XY payload decoders.
+# Runs benchmark_xy_decode for short records (rectangles), medium and long polygons, both
+# in cache and from memory, and fails if any decoder kernel disagrees with the reference loop.
+
+set -e # Exit on error
+
+# Paths and variables
+PROJECT_DIR="$(cd "$(dirname "$0")/../.." && pwd)"
+BUILD_DIR="${BUILD_DIR:-${PROJECT_DIR}/build}"
+RECORD_POINTS="5 64 1000"
+TOTAL_POINTS="65536 16777216"
+
+for POINTS in ${TOTAL_POINTS}; do
+    for RECORD in ${RECORD_POINTS}; do
+        ${BUILD_DIR}/benchmark_xy_decode --points ${POINTS} --record_points ${RECORD} || {
+            echo "Error: benchmark_xy_decode failed for ${POINTS} points in records of ${RECORD}"
+            exit 1
+        }
+        echo
+    done
+done
+
+echo "XY decoder benchmark completed successfully!"
+exit 0
@@ -116,6 +116,32 @@ else
     echo "Database entries verified successfully"
 fi
 
+# Step 6: Capture again from the flat layer layout and check that it stores the same entries
+echo "Checking database entries captured with --flat_layers"
+psql -d postgres -c "DROP DATABASE IF EXISTS ${DB_NAME};" || {
+    echo "Error: Failed to drop database"
+    exit 1
+}
+psql -d postgres -c "CREATE DATABASE ${DB_NAME};" || {
+    echo "Error: Failed to create database"
+    exit 1
+}
+eval ${COMMAND} --flat_layers > "${LOG_FILE}" 2>&1 || {
+    echo "Error: dfm_pattern_capture --flat_layers failed with exit code $?"
+    cat "${LOG_FILE}"
+    exit 1
+}
+psql -d "${DB_NAME}" -c "SELECT id, pattern_hash, mask_layer_number, mask_layer_datatype, input_layers::text, layout_file_name FROM patterns;" -t -A > "${DB_OUTPUT_FILE}"
+psql -d "${DB_NAME}" -c "SELECT pattern_id, layer_number, datatype, geometry_type, coordinates::text, area, perimeter FROM pattern_geometries ORDER BY layer_number, coordinates::text;" -t -A >> "${DB_OUTPUT_FILE}"
+sed -E 's/\|pattern_66_20_67_20_68_20_69_20_4\.00_[0-9]+/\|pattern_66_20_67_20_68_20_69_20_4.00_/; s/":\s*/":/g; s/\s*,"/,"/g; s/,\s+/, /g; s/\[\s*/[/g; s/\s*\]/]/g; s/([0-9])\.0+\b/\1/g; s/([0-9])\.0+\|/\1|/g; s/\|([0-9])\.0+\|/|\1|/g; s/":([0-9]+)\b/":\1/g' "${DB_OUTPUT_FILE}" > "${DB_OUTPUT_FILE}.filtered"
+if ! diff -u "${EXPECTED_DB_FILE}" "${DB_OUTPUT_FILE}.filtered" > "${DB_OUTPUT_FILE}.diff"; then
+    echo "Error: Database entries captured with --flat_layers do not match expected"
+    cat "${DB_OUTPUT_FILE}.diff"
+    exit 1
+else
+    echo "Flat layer layout database entries verified successfully"
+fi
+
 # Clean up temporary files
 rm -f "${LOG_FILE}" "${LOG_FILE}.filtered" "${LOG_FILE}.diff" "${DB_OUTPUT_FILE}" "${DB_OUTPUT_FILE}.filtered" "${DB_OUTPUT_FILE}.diff"
 
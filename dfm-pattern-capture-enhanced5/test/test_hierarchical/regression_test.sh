@@ -0,0 +1,141 @@
+#!/bin/bash
+
+# Regression test for hierarchical capture
+# Drops database, runs generate_test_gds for a two-level AREF hierarchy, runs
+# dfm_pattern_capture --hierarchical_capture, verifies logs, checks the patterns and
+# pattern_occurrences entries, and checks that the exported geometry matches a flat capture.
+
+set -e # Exit on error
+
+# Paths and variables
+PROJECT_DIR="$(cd "$(dirname "$0")/../.." && pwd)"
+echo "${PROJECT_DIR}"
+BUILD_DIR="${BUILD_DIR:-${PROJECT_DIR}/build}"
+TEST_DIR="${PROJECT_DIR}/test/test_hierarchical"
+DB_NAME="test_db"
+LOG_FILE="${TEST_DIR}/test_output.log"
+EXPECTED_LOG_FILE="${TEST_DIR}/expected_log.txt"
+DB_OUTPUT_FILE="${TEST_DIR}/db_output.txt"
+EXPECTED_DB_FILE="${TEST_DIR}/expected_db.txt"
+HIERARCHICAL_EXPORT="${TEST_DIR}/hierarchical_export.gds"
+FLAT_EXPORT="${TEST_DIR}/flat_export.gds"
+
+recreate_database() {
+    echo "Dropping and recreating database: ${DB_NAME}"
+    psql -d postgres -c "DROP DATABASE IF EXISTS ${DB_NAME};" || {
+        echo "Error: Failed to drop database"
+        exit 1
+    }
+    psql -d postgres -c "CREATE DATABASE ${DB_NAME};" || {
+        echo "Error: Failed to create database"
+        exit 1
+    }
+}
+
+# Step 1: Drop and recreate the database
+recreate_database
+
+# Step 2: Run generate_test_gds
+# Two placement levels of 2 x 2 AREFs: the leaf cell's 2 sites occur 16 times each
+echo "Running generate_test_gds"
+cd "${TEST_DIR}"
+${BUILD_DIR}/generate_test_gds ./hier.gds --polygons 128 --depth 2 --aref --overlap 1 --seed 1 || {
+    echo "Error: generate_test_gds failed"
+    exit 1
+}
+
+# Step 3: Run dfm_pattern_capture --hierarchical_capture
+echo "Running dfm_pattern_capture --hierarchical_capture"
+COMMAND="${BUILD_DIR}/dfm_pattern_capture --layout_file ./hier.gds --mask_layer_number 66 --mask_layer_datatype 20 --input_layers \"67:20,68:20,69:20\" --db_name ${DB_NAME}"
+echo "Executing: ${COMMAND} --hierarchical_capture"
+DFM_LOGGING=1 eval ${COMMAND} --hierarchical_capture --export_gds "${HIERARCHICAL_EXPORT}" > "${LOG_FILE}" 2>&1 || {
+    echo "Error: dfm_pattern_capture --hierarchical_capture failed with exit code $?"
+    cat "${LOG_FILE}"
+    exit 1
+}
+
+# Step 4: Verify logs
+echo "Verifying logs"
+
+# Create expected log patterns
+cat > "${EXPECTED_LOG_FILE}" << 'EOF'
+Hierarchical capture: 2 cell-local contexts computed once for 32 occurrences, 0 mask polygons processed flat (context crosses a cell boundary or the cell is placed once)
+Exported 32 patterns to hierarchical_export.gds
+Patterns cover 32 occurrences; further occurrences are stored as placements
+Successfully stored pattern: pattern_66_20_67_20_68_20_69_20_0.68_
+Successfully stored pattern: pattern_66_20_67_20_68_20_69_20_0.48_
+Total patterns processed: 2
+Successfully stored patterns: 2
+Failed patterns: 0
+EOF
+
+# Extract and normalize relevant lines from log file
+grep -E "\] (Hierarchical capture:|Exported|Patterns cover|Successfully stored pattern:)|^(Total patterns processed|Successfully stored patterns|Failed patterns):" "${LOG_FILE}" | \
+sed -E 's/^.*\[[A-Z]+\] //; s/Exported ([0-9]+) patterns to .*\//Exported \1 patterns to /; s/(Successfully stored pattern: pattern_[0-9_]+_[0-9]+\.[0-9]{2}_)[0-9]+/\1/' > "${LOG_FILE}.filtered"
+
+# Compare logs
+if ! diff -u "${EXPECTED_LOG_FILE}" "${LOG_FILE}.filtered" > "${LOG_FILE}.diff"; then
+    echo "Error: Log output does not match expected"
+    cat "${LOG_FILE}.diff"
+    exit 1
+else
+    echo "Logs verified successfully"
+fi
+
+# Step 5: Check database entries
+echo "Checking database entries"
+
+# Each pattern is stored once with one polygon per layer; its 15 further occurrences are placements
+psql -d "${DB_NAME}" -c "SELECT id, pattern_hash, mask_layer_number, mask_layer_datatype, input_layers::text, layout_file_name FROM patterns ORDER BY id;" -t -A > "${DB_OUTPUT_FILE}"
+psql -d "${DB_NAME}" -c "SELECT pattern_id, layer_number, datatype, count(*) FROM pattern_geometries GROUP BY pattern_id, layer_number, datatype ORDER BY pattern_id, layer_number, datatype;" -t -A >> "${DB_OUTPUT_FILE}"
+psql -d "${DB_NAME}" -c "SELECT pattern_id, jsonb_array_length(placements), placements::text FROM pattern_occurrences ORDER BY pattern_id;" -t -A >> "${DB_OUTPUT_FILE}"
+
+# Create expected database output
+cat > "${EXPECTED_DB_FILE}" << 'EOF'
+1|pattern_66_20_67_20_68_20_69_20_0.68_|66|20|[{"layer":67, "datatype":20}, {"layer":68, "datatype":20}, {"layer":69, "datatype":20}]|./hier.gds
+2|pattern_66_20_67_20_68_20_69_20_0.48_|66|20|[{"layer":67, "datatype":20}, {"layer":68, "datatype":20}, {"layer":69, "datatype":20}]|./hier.gds
+1|66|20|1
+1|67|20|1
+1|68|20|1
+1|69|20|1
+2|66|20|1
+2|67|20|1
+2|68|20|1
+2|69|20|1
+1|15|[[1, 0, 0, 1, 4, 0], [1, 0, 0, 1, 0, 2], [1, 0, 0, 1, 4, 2], [1, 0, 0, 1, 8, 0], [1, 0, 0, 1, 12, 0], [1, 0, 0, 1, 8, 2], [1, 0, 0, 1, 12, 2], [1, 0, 0, 1, 0, 4], [1, 0, 0, 1, 4, 4], [1, 0, 0, 1, 0, 6], [1, 0, 0, 1, 4, 6], [1, 0, 0, 1, 8, 4], [1, 0, 0, 1, 12, 4], [1, 0, 0, 1, 8, 6], [1, 0, 0, 1, 12, 6]]
+2|15|[[1, 0, 0, 1, 4, 0], [1, 0, 0, 1, 0, 2], [1, 0, 0, 1, 4, 2], [1, 0, 0, 1, 8, 0], [1, 0, 0, 1, 12, 0], [1, 0, 0, 1, 8, 2], [1, 0, 0, 1, 12, 2], [1, 0, 0, 1, 0, 4], [1, 0, 0, 1, 4, 4], [1, 0, 0, 1, 0, 6], [1, 0, 0, 1, 4, 6], [1, 0, 0, 1, 8, 4], [1, 0, 0, 1, 12, 4], [1, 0, 0, 1, 8, 6], [1, 0, 0, 1, 12, 6]]
+EOF
+
+# Filter out timestamp from pattern_hash and normalize JSON formatting
+sed -E 's/\|(pattern_[0-9_]+_[0-9]+\.[0-9]{2}_)[0-9]+/|\1/; s/":\s*/":/g; s/\s*,"/,"/g; s/,\s+/, /g; s/\[\s*/[/g; s/\s*\]/]/g' "${DB_OUTPUT_FILE}" > "${DB_OUTPUT_FILE}.filtered"
+
+# Compare database output
+if ! diff -u "${EXPECTED_DB_FILE}" "${DB_OUTPUT_FILE}.filtered" > "${DB_OUTPUT_FILE}.diff"; then
+    echo "Error: Database entries do not match expected"
+    cat "${DB_OUTPUT_FILE}.diff"
+    exit 1
+else
+    echo "Database entries verified successfully"
+fi
+
+# Step 6: Capture flat and check that the hierarchical export, with every occurrence placed,
+# holds the same geometry
+echo "Checking the exported geometry against a flat capture"
+recreate_database
+eval ${COMMAND} --export_gds "${FLAT_EXPORT}" > "${LOG_FILE}" 2>&1 || {
+    echo "Error: dfm_pattern_capture failed with exit code $?"
+    cat "${LOG_FILE}"
+    exit 1
+}
+${BUILD_DIR}/compare_layouts "${HIERARCHICAL_EXPORT}" "${FLAT_EXPORT}" || {
+    echo "Error: Hierarchical capture geometry does not match the flat capture"
+    exit 1
+}
+echo "Exported geometry verified successfully"
+
+# Clean up temporary files
+rm -f "${LOG_FILE}" "${LOG_FILE}.filtered" "${LOG_FILE}.diff" "${DB_OUTPUT_FILE}" "${DB_OUTPUT_FILE}.filtered" "${DB_OUTPUT_FILE}.diff"
+rm -f ./hier.gds "${HIERARCHICAL_EXPORT}" "${FLAT_EXPORT}"
+
+echo "Regression test passed successfully!"
+exit 0
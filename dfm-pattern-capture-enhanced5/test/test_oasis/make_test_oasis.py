@@ -0,0 +1,663 @@
+#!/usr/bin/env python3
+"""Writes the OASIS reader fixture test.oas and its flat GDSII equivalent test.gds.
+
+test.oas exercises every geometry record the reader decodes (RECTANGLE, POLYGON, PATH,
+TRAPEZOID and its A/B forms, CTRAPEZOID types 0-25, CIRCLE), point lists 0-5, repetitions
+0-11, modal variables (omitted fields, XYRELATIVE, repetition reuse), PLACEMENT with rotation,
+mirroring, magnification and repetition, CELLNAME by reference number and CELL by name, and
+CBLOCKs, including one that holds a whole cell. Records the reader only skips (TEXT,
+PROPERTY) are mixed in.
+
+test.gds holds the same geometry flattened into one structure, computed here from the
+intended shapes rather than decoded from test.oas: every shape is a BOUNDARY, except the
+one 45-degree path, which is a PATH. Database unit 1 nm, user unit 1 um in both files.
+
+Usage: make_test_oasis.py [output_dir]
+"""
+
+import math
+import os
+import struct
+import sys
+import zlib
+
+# ---------------------------------------------------------------------------------------------
+# OASIS encoding
+
+
+def uint(value):
+    assert value >= 0
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def sint(value):
+    return uint((abs(value) << 1) | (1 if value < 0 else 0))
+
+
+def bstring(text):
+    data = text.encode()
+    return uint(len(data)) + data
+
+
+OCTANGULAR = {(1, 0): 0, (0, 1): 1, (-1, 0): 2, (0, -1): 3, (1, 1): 4, (-1, 1): 5, (-1, -1): 6, (1, -1): 7}
+
+
+def direction(dx, dy):
+    magnitude = max(abs(dx), abs(dy))
+    if magnitude == 0 or (dx != 0 and dy != 0 and abs(dx) != abs(dy)):
+        return None, magnitude
+    return OCTANGULAR[(dx // magnitude, dy // magnitude)], magnitude
+
+
+def two_delta(dx, dy):
+    code, magnitude = direction(dx, dy)
+    assert code is not None and code < 4
+    return uint((magnitude << 2) | code)
+
+
+def three_delta(dx, dy):
+    code, magnitude = direction(dx, dy)
+    assert code is not None
+    return uint((magnitude << 3) | code)
+
+
+def g_delta(dx, dy):
+    code, magnitude = direction(dx, dy)
+    if code is not None:
+        return uint((magnitude << 4) | (code << 1))
+    return uint((abs(dx) << 2) | (2 if dx < 0 else 0) | 1) + sint(dy)
+
+
+def point_list(kind, vertices, polygon):
+    """Point list of the given type for vertices relative to the first one, which is the origin."""
+    deltas = [(x1 - xa, y1 - ya) for (xa, ya), (x1, y1) in zip(vertices, vertices[1:])]
+    if kind in (0, 1):
+        # Alternating horizontal and vertical 1-deltas; for polygons the last two edges are implicit
+        if polygon:
+            deltas = deltas[:-1]
+        out = bytearray()
+        horizontal = kind == 0
+        for dx, dy in deltas:
+            assert (dy == 0) if horizontal else (dx == 0)
+            out += sint(dx if horizontal else dy)
+            horizontal = not horizontal
+        return uint(kind) + uint(len(deltas)) + bytes(out)
+    if kind == 5:
+        # Each g-delta is the change of displacement from the previous edge
+        out = bytearray()
+        px, py = 0, 0
+        for dx, dy in deltas:
+            out += g_delta(dx - px, dy - py)
+            px, py = dx, dy
+        return uint(kind) + uint(len(deltas)) + bytes(out)
+    encode = {2: two_delta, 3: three_delta, 4: g_delta}[kind]
+    return uint(kind) + uint(len(deltas)) + b"".join(encode(dx, dy) for dx, dy in deltas)
+
+
+class Repetition:
+    """Repetition record body plus the offsets of its instances."""
+
+    def __init__(self, kind, *params):
+        self.kind = kind
+        self.params = params
+        self.offsets = []
+        body = uint(kind)
+        if kind == 1:
+            columns, rows, dx, dy = params
+            body += uint(columns - 2) + uint(rows - 2) + uint(dx) + uint(dy)
+            self.offsets = [(c * dx, r * dy) for r in range(rows) for c in range(columns)]
+        elif kind == 2:
+            columns, dx = params
+            body += uint(columns - 2) + uint(dx)
+            self.offsets = [(c * dx, 0) for c in range(columns)]
+        elif kind == 3:
+            rows, dy = params
+            body += uint(rows - 2) + uint(dy)
+            self.offsets = [(0, r * dy) for r in range(rows)]
+        elif kind in (4, 5, 6, 7):
+            grid, spaces = (1, params[0]) if kind in (4, 6) else params
+            body += uint(len(spaces) - 1)
+            if kind in (5, 7):
+                body += uint(grid)
+            body += b"".join(uint(space) for space in spaces)
+            position = 0
+            self.offsets = [(0, 0)]
+            for space in spaces:
+                position += space * grid
+                self.offsets.append((position, 0) if kind in (4, 5) else (0, position))
+        elif kind == 8:
+            columns, rows, column_step, row_step = params
+            body += uint(columns - 2) + uint(rows - 2) + g_delta(*column_step) + g_delta(*row_step)
+            self.offsets = [(c * column_step[0] + r * row_step[0], c * column_step[1] + r * row_step[1])
+                            for r in range(rows) for c in range(columns)]
+        elif kind == 9:
+            count, step = params
+            body += uint(count - 2) + g_delta(*step)
+            self.offsets = [(c * step[0], c * step[1]) for c in range(count)]
+        elif kind in (10, 11):
+            grid, steps = (1, params[0]) if kind == 10 else params
+            body += uint(len(steps) - 1)
+            if kind == 11:
+                body += uint(grid)
+            body += b"".join(g_delta(*step) for step in steps)
+            x, y = 0, 0
+            self.offsets = [(0, 0)]
+            for dx, dy in steps:
+                x, y = x + dx * grid, y + dy * grid
+                self.offsets.append((x, y))
+        else:
+            raise ValueError(kind)
+        self.body = body
+
+
+class OasisWriter:
+    """Writes records into the current block, omitting every field its modal variable already holds."""
+
+    def __init__(self):
+        self.out = bytearray()
+        self.block = None
+        self.cell_shapes = None
+        self.reset_modal()
+
+    def reset_modal(self):
+        self.xy_relative = False
+        self.geometry_position = [0, 0]
+        self.placement_position = [0, 0]
+        self.modal = {}
+
+    def emit(self, data):
+        (self.block if self.block is not None else self.out).extend(data)
+
+    def begin_cblock(self):
+        self.block = bytearray()
+
+    def end_cblock(self):
+        raw = bytes(self.block)
+        self.block = None
+        compressor = zlib.compressobj(9, zlib.DEFLATED, -15)
+        packed = compressor.compress(raw) + compressor.flush()
+        self.emit(uint(34) + uint(0) + uint(len(raw)) + uint(len(packed)) + packed)
+
+    def set_relative(self, relative):
+        self.xy_relative = relative
+        self.emit(uint(16 if relative else 15))
+
+    def cell(self, refnum=None, name=None):
+        self.emit(uint(13) + uint(refnum) if name is None else uint(14) + bstring(name))
+        self.reset_modal()
+        self.cell_shapes = []
+
+    def changed(self, key, value):
+        if self.modal.get(key) == value:
+            return False
+        self.modal[key] = value
+        return True
+
+    def coordinate(self, axis, modal, value):
+        """Info bit and encoded coordinate, or (False, b"") when the modal position already holds it."""
+        if modal[axis] == value:
+            return False, b""
+        encoded = sint(value - modal[axis] if self.xy_relative else value)
+        modal[axis] = value
+        return True, encoded
+
+    def repetition(self, rep):
+        if rep is None:
+            return False, b""
+        if self.modal.get("repetition") is rep:
+            return True, uint(0)
+        self.modal["repetition"] = rep
+        return True, rep.body
+
+    def geometry_record(self, record, info, fields, layer, datatype, x, y, rep, outline, extra=b""):
+        """Common layer/datatype, position and repetition handling; fields go between them. The
+        outline (None: not flattened here) is recorded at every repetition offset."""
+        body = bytearray()
+        if self.changed("layer", layer):
+            info |= 0x01
+            body += uint(layer)
+        if self.changed("datatype", datatype):
+            info |= 0x02
+            body += uint(datatype)
+        body += fields
+        body += extra
+        has_x, encoded_x = self.coordinate(0, self.geometry_position, x)
+        has_y, encoded_y = self.coordinate(1, self.geometry_position, y)
+        has_rep, encoded_rep = self.repetition(rep)
+        info |= (0x10 if has_x else 0) | (0x08 if has_y else 0) | (0x04 if has_rep else 0)
+        self.emit(uint(record) + bytes([info]) + bytes(body) + encoded_x + encoded_y + encoded_rep)
+        if outline is None:
+            return
+        for dx, dy in (rep.offsets if rep else [(0, 0)]):
+            self.cell_shapes.append(((layer, datatype), [(x + dx + px, y + dy + py) for px, py in outline]))
+
+    def rectangle(self, layer, datatype, x, y, w, h, rep=None):
+        info, fields = 0, bytearray()
+        if w == h:
+            info |= 0x80
+            if self.changed("w", w):
+                info |= 0x40
+                fields += uint(w)
+            self.modal["h"] = h
+        else:
+            if self.changed("w", w):
+                info |= 0x40
+                fields += uint(w)
+            if self.changed("h", h):
+                info |= 0x20
+                fields += uint(h)
+        self.geometry_record(20, info, fields, layer, datatype, x, y, rep, [(0, 0), (w, 0), (w, h), (0, h)])
+
+    def polygon(self, layer, datatype, kind, vertices, rep=None):
+        x, y = vertices[0]
+        relative = [(vx - x, vy - y) for vx, vy in vertices]
+        info, fields = 0, b""
+        if self.changed("polygon", (kind, tuple(relative))):
+            info |= 0x20
+            fields = point_list(kind, relative, True)
+        self.geometry_record(21, info, fields, layer, datatype, x, y, rep, relative)
+
+    def path(self, layer, datatype, kind, spine, half_width, start, end, rep=None, manhattan=True):
+        """start/end: "flush", "half" or an explicit extension. Only Manhattan paths are flattened here."""
+        x, y = spine[0]
+        relative = [(vx - x, vy - y) for vx, vy in spine]
+        info, fields = 0, bytearray()
+        if self.changed("halfwidth", half_width):
+            info |= 0x40
+            fields += uint(half_width)
+        extension = lambda value: 0 if value == "flush" else half_width if value == "half" else value
+        scheme, explicit = 0, bytearray()
+        for shift, value, key in ((2, start, "start"), (0, end, "end")):
+            # The modal extension holds a length: "half" is resolved when it is read
+            if not self.changed(key, extension(value)):
+                continue
+            if value == "flush":
+                scheme |= 1 << shift
+            elif value == "half":
+                scheme |= 2 << shift
+            else:
+                scheme |= 3 << shift
+                explicit += sint(value)
+        if scheme:
+            info |= 0x80
+            fields += uint(scheme) + explicit
+        if self.changed("path", (kind, tuple(relative))):
+            info |= 0x20
+            fields += point_list(kind, relative, False)
+        outline = None
+        if manhattan:
+            outline = manhattan_path_outline(relative, half_width, extension(start), extension(end))
+        self.geometry_record(22, info, bytes(fields), layer, datatype, x, y, rep, outline)
+
+    def trapezoid(self, layer, datatype, x, y, w, h, vertical, delta_a, delta_b, rep=None):
+        record = 23 if delta_a and delta_b else 24 if delta_a else 25
+        info, fields = 0x80 if vertical else 0, bytearray()
+        if self.changed("w", w):
+            info |= 0x40
+            fields += uint(w)
+        if self.changed("h", h):
+            info |= 0x20
+            fields += uint(h)
+        deltas = (sint(delta_a) if record != 25 else b"") + (sint(delta_b) if record != 24 else b"")
+        if vertical:
+            # delta-a and delta-b: rise of the bottom and the top edge from right to left
+            outline = [(0, max(delta_a, 0)), (0, h + min(delta_b, 0)), (w, h - max(delta_b, 0)), (w, -min(delta_a, 0))]
+        else:
+            # delta-a and delta-b: shift of the left and the right edge's top end from its bottom end
+            outline = [(max(delta_a, 0), h), (w + min(delta_b, 0), h), (w - max(delta_b, 0), 0), (-min(delta_a, 0), 0)]
+        self.geometry_record(record, info, bytes(fields), layer, datatype, x, y, rep, outline, deltas)
+
+    def ctrapezoid(self, layer, datatype, x, y, kind, w, h, rep=None):
+        info, fields = 0, bytearray()
+        if self.changed("ctrapezoid", kind):
+            info |= 0x80
+            fields += uint(kind)
+        # Types 16-19, 22, 23 and 25 take only a width, types 20 and 21 only a height
+        if kind not in (20, 21) and self.changed("w", w):
+            info |= 0x40
+            fields += uint(w)
+        if kind in (16, 17, 18, 19, 25):
+            h = w
+        elif kind in (22, 23):
+            h = 2 * w
+        elif kind in (20, 21):
+            w = 2 * h
+        if kind not in (16, 17, 18, 19, 22, 23, 25) and self.changed("h", h):
+            info |= 0x20
+            fields += uint(h)
+        self.geometry_record(26, info, bytes(fields), layer, datatype, x, y, rep, ctrapezoid_outline(kind, w, h))
+
+    def circle(self, layer, datatype, x, y, radius, rep=None):
+        info, fields = 0, b""
+        if self.changed("radius", radius):
+            info |= 0x20
+            fields = uint(radius)
+        self.geometry_record(27, info, fields, layer, datatype, x, y, rep, circle_outline(radius))
+
+    def placement(self, refnum, shapes, x, y, angle=0, mirror=False, magnification=None, rep=None):
+        """PLACEMENT of a cell whose shapes were recorded earlier; magnification selects PLACEMENT_TRANSFORM."""
+        transform = magnification is not None
+        info = 0
+        body = bytearray()
+        if self.changed("placement_cell", refnum):
+            info |= 0xC0
+            body += uint(refnum)
+        if transform:
+            if magnification != 1:
+                info |= 0x04
+                body += uint(0) + uint(magnification)
+            if angle:
+                info |= 0x02
+                body += uint(0) + uint(angle)
+        else:
+            info |= (angle // 90) << 1
+        info |= 0x01 if mirror else 0
+        has_x, encoded_x = self.coordinate(0, self.placement_position, x)
+        has_y, encoded_y = self.coordinate(1, self.placement_position, y)
+        has_rep, encoded_rep = self.repetition(rep)
+        info |= (0x20 if has_x else 0) | (0x10 if has_y else 0) | (0x08 if has_rep else 0)
+        self.emit(uint(18 if transform else 17) + bytes([info]) + bytes(body) + encoded_x + encoded_y + encoded_rep)
+        scale = magnification or 1
+        for dx, dy in (rep.offsets if rep else [(0, 0)]):
+            for key, outline in shapes:
+                placed = [place(p, x + dx, y + dy, angle, mirror, scale) for p in outline]
+                self.cell_shapes.append((key, placed))
+
+    def text(self, text, layer, texttype, x, y):
+        self.emit(uint(19) + bytes([0x5B]) + bstring(text) + uint(layer) + uint(texttype) + sint(x) + sint(y))
+
+    def property(self, name, value):
+        # Name given as a string, one unsigned-integer value
+        self.emit(uint(28) + bytes([0x14]) + bstring(name) + uint(8) + uint(value))
+
+
+def place(point, x, y, angle, mirror, scale):
+    px, py = point
+    if mirror:
+        py = -py
+    cos, sin = {0: (1, 0), 90: (0, 1), 180: (-1, 0), 270: (0, -1)}[angle]
+    return (x + scale * (cos * px - sin * py), y + scale * (sin * px + cos * py))
+
+
+def manhattan_path_outline(spine, half_width, start_extension, end_extension):
+    """Outline of an axis-parallel path: mitered corners, ends extended along the spine."""
+    def unit(a, b):
+        dx, dy = b[0] - a[0], b[1] - a[1]
+        assert dx == 0 or dy == 0
+        return ((dx > 0) - (dx < 0), (dy > 0) - (dy < 0))
+
+    points = list(spine)
+    first, last = unit(points[0], points[1]), unit(points[-2], points[-1])
+    points[0] = (points[0][0] - first[0] * start_extension, points[0][1] - first[1] * start_extension)
+    points[-1] = (points[-1][0] + last[0] * end_extension, points[-1][1] + last[1] * end_extension)
+    left, right = [], []
+    for i, p in enumerate(points):
+        incoming = unit(points[max(i - 1, 0)], points[max(i, 1)])
+        outgoing = unit(points[min(i, len(points) - 2)], points[min(i + 1, len(points) - 1)])
+        # Left normals; at a corner the offset reaches both sides' edges
+        nx, ny = -incoming[1], incoming[0]
+        if outgoing != incoming:
+            nx, ny = nx - outgoing[1], ny + outgoing[0]
+        left.append((p[0] + nx * half_width, p[1] + ny * half_width))
+        right.append((p[0] - nx * half_width, p[1] - ny * half_width))
+    return left + right[::-1]
+
+
+def ctrapezoid_outline(kind, w, h):
+    shapes = {
+        0: [(0, 0), (0, h), (w - h, h), (w, 0)],
+        1: [(0, 0), (0, h), (w, h), (w - h, 0)],
+        2: [(0, 0), (h, h), (w, h), (w, 0)],
+        3: [(h, 0), (0, h), (w, h), (w, 0)],
+        4: [(0, 0), (h, h), (w - h, h), (w, 0)],
+        5: [(h, 0), (0, h), (w, h), (w - h, 0)],
+        6: [(0, 0), (h, h), (w, h), (w - h, 0)],
+        7: [(h, 0), (0, h), (w - h, h), (w, 0)],
+        8: [(0, 0), (0, h), (w, h - w), (w, 0)],
+        9: [(0, 0), (0, h - w), (w, h), (w, 0)],
+        10: [(0, 0), (0, h), (w, h), (w, w)],
+        11: [(0, w), (0, h), (w, h), (w, 0)],
+        12: [(0, 0), (0, h), (w, h - w), (w, w)],
+        13: [(0, w), (0, h - w), (w, h), (w, 0)],
+        14: [(0, 0), (0, h - w), (w, h), (w, w)],
+        15: [(0, w), (0, h), (w, h - w), (w, 0)],
+        16: [(0, 0), (0, w), (w, 0)],
+        17: [(0, 0), (0, w), (w, w)],
+        18: [(0, 0), (w, w), (w, 0)],
+        19: [(0, w), (w, w), (w, 0)],
+        20: [(0, 0), (h, h), (2 * h, 0)],
+        21: [(0, h), (2 * h, h), (h, 0)],
+        22: [(0, 0), (0, 2 * w), (w, w)],
+        23: [(w, 0), (0, w), (w, 2 * w)],
+        24: [(0, 0), (0, h), (w, h), (w, 0)],
+        25: [(0, 0), (0, w), (w, w), (w, 0)],
+    }
+    return shapes[kind]
+
+
+def circle_outline(radius, segments=32):
+    """The reader's approximation: a regular 32-gon with vertices rounded to the grid."""
+    def round_half_away(value):
+        return int(math.floor(abs(value) + 0.5)) * (1 if value >= 0 else -1)
+
+    outline = []
+    for i in range(segments):
+        angle = 2.0 * math.pi * i / segments
+        p = (round_half_away(radius * math.cos(angle)), round_half_away(radius * math.sin(angle)))
+        if not outline or outline[-1] != p:
+            outline.append(p)
+    return outline
+
+
+def end_record():
+    # END is padded to 256 bytes: record id, padding string, validation scheme 0
+    padding = 256 - 1 - 2 - 1
+    record = uint(2) + uint(padding) + b"\0" * padding + uint(0)
+    assert len(record) == 256
+    return record
+
+
+# ---------------------------------------------------------------------------------------------
+# GDSII encoding
+
+
+def gds_record(record_type, data_type, payload=b""):
+    return struct.pack(">HBB", 4 + len(payload), record_type, data_type) + payload
+
+
+def gds_real8(value):
+    if value == 0:
+        return b"\0" * 8
+    sign = 0x80 if value < 0 else 0
+    value = abs(value)
+    exponent = 64
+    while value >= 1:
+        value /= 16
+        exponent += 1
+    while value < 1 / 16:
+        value *= 16
+        exponent -= 1
+    mantissa = int(round(value * (1 << 56)))
+    return bytes([sign | exponent]) + mantissa.to_bytes(7, "big")
+
+
+def gds_xy(points):
+    return gds_record(0x10, 0x03, b"".join(struct.pack(">ii", int(x), int(y)) for x, y in points))
+
+
+def write_gds(filename, boundaries, paths):
+    data = bytearray()
+    date = struct.pack(">12h", 2025, 1, 1, 0, 0, 0, 2025, 1, 1, 0, 0, 0)
+    data += gds_record(0x00, 0x02, struct.pack(">h", 600))
+    data += gds_record(0x01, 0x02, date)
+    data += gds_record(0x02, 0x06, b"OASISREF")
+    # UNITS as LayoutFileWriter writes them (unit_scale = db_unit / user_unit = 1e-3 um per unit)
+    data += gds_record(0x03, 0x05, gds_real8(1e-6) + gds_real8(1e-9))
+    data += gds_record(0x05, 0x02, date)
+    data += gds_record(0x06, 0x06, b"TOP\0")
+    for (layer, datatype), outline in boundaries:
+        data += gds_record(0x08, 0x00)
+        data += gds_record(0x0D, 0x02, struct.pack(">h", layer))
+        data += gds_record(0x0E, 0x02, struct.pack(">h", datatype))
+        data += gds_xy(outline + [outline[0]])
+        data += gds_record(0x11, 0x00)
+    for (layer, datatype), spine, width, start, end in paths:
+        data += gds_record(0x09, 0x00)
+        data += gds_record(0x0D, 0x02, struct.pack(">h", layer))
+        data += gds_record(0x0E, 0x02, struct.pack(">h", datatype))
+        data += gds_record(0x21, 0x02, struct.pack(">h", 4))
+        data += gds_record(0x0F, 0x03, struct.pack(">i", width))
+        data += gds_record(0x30, 0x03, struct.pack(">i", start))
+        data += gds_record(0x31, 0x03, struct.pack(">i", end))
+        data += gds_xy(spine)
+        data += gds_record(0x11, 0x00)
+    data += gds_record(0x07, 0x00)
+    data += gds_record(0x04, 0x00)
+    with open(filename, "wb") as f:
+        f.write(data)
+
+
+# ---------------------------------------------------------------------------------------------
+# Fixture
+
+
+def main():
+    output_dir = sys.argv[1] if len(sys.argv) > 1 else os.path.dirname(os.path.abspath(__file__))
+    w = OasisWriter()
+    w.out += b"%SEMI-OASIS\r\n"
+    # START: version, 1000 database units per micron, table offsets in START (all absent)
+    w.out += uint(1) + bstring("1.0") + uint(0) + uint(1000) + uint(0) + b"".join(uint(0) for _ in range(12))
+    # Names by implicit reference numbers: SUB 0, TOP 1 (whose CELL record names it directly), CB 2
+    w.out += uint(3) + bstring("SUB") + uint(3) + bstring("TOP") + uint(3) + bstring("CB")
+    w.property("S_GDS_PROPERTY", 1)
+
+    # SUB (refnum 0): an L-shaped polygon and a rectangle on layer 10, placed several times by TOP
+    w.cell(refnum=0)
+    w.polygon(10, 0, 0, [(0, 0), (400, 0), (400, 100), (100, 100), (100, 300), (0, 300)])
+    w.rectangle(10, 0, 200, 200, 150, 50)
+    sub_shapes = w.cell_shapes
+
+    # CB (refnum 2): a cell held entirely in a CBLOCK, placed once by TOP
+    w.begin_cblock()
+    w.cell(refnum=2)
+    w.set_relative(True)
+    w.rectangle(11, 0, 0, 0, 60, 60)
+    w.rectangle(11, 0, 100, 0, 60, 60)
+    w.ctrapezoid(11, 1, 200, 0, 16, 60, 60)
+    w.end_cblock()
+    cb_shapes = w.cell_shapes
+
+    # TOP
+    w.cell(name="TOP")
+    top = w.cell_shapes
+
+    # Layer 1: rectangles and squares, with modal width, height, layer and position reused
+    w.rectangle(1, 0, 0, 0, 100, 50)
+    w.rectangle(1, 0, 200, 0, 100, 50)
+    w.rectangle(1, 0, 200, 100, 100, 80)
+    w.rectangle(1, 0, 400, 100, 70, 70)
+    w.set_relative(True)
+    w.rectangle(1, 0, 500, 100, 70, 70)
+    w.rectangle(1, 2, 600, 300, 40, 20)
+    w.set_relative(False)
+    w.text("label", 1, 0, 10, 10)
+
+    # Layer 2: the same polygon through point lists 0-5, then polygons that need each form
+    y = 1000
+    l_shape = [(0, 0), (300, 0), (300, 100), (100, 100), (100, 200), (0, 200)]
+    for kind in (0, 2, 3, 4, 5):
+        w.polygon(2, 0, kind, [(x + kind * 400, yy + y) for x, yy in l_shape])
+    vertical_first = [(0, 0), (0, 200), (100, 200), (100, 100), (300, 100), (300, 0)]
+    w.polygon(2, 0, 1, [(x + 2400, yy + y) for x, yy in vertical_first])
+    w.polygon(2, 1, 3, [(0, 1400), (200, 1400), (300, 1500), (300, 1700), (100, 1700), (0, 1600)])
+    w.polygon(2, 1, 4, [(500, 1400), (830, 1450), (760, 1720), (540, 1610)])
+    w.polygon(2, 1, 5, [(1000, 1400), (1310, 1430), (1390, 1700), (1120, 1800), (1010, 1650)])
+    # Modal point list reused at a new position
+    w.polygon(2, 1, 5, [(1500, 1400), (1810, 1430), (1890, 1700), (1620, 1800), (1510, 1650)])
+
+    # Layer 3: Manhattan paths with every extension scheme; the 45-degree one is a GDSII PATH
+    w.path(3, 0, 0, [(0, 3000), (500, 3000), (500, 3400), (900, 3400)], 20, "flush", "flush")
+    w.path(3, 0, 2, [(1000, 3000), (1000, 3300), (1300, 3300)], 20, "half", 35)
+    w.path(3, 0, 1, [(1500, 3000), (1500, 3200), (1800, 3200), (1800, 3500)], 15, -5, "half")
+    w.path(3, 0, 4, [(2000, 3000), (2400, 3000), (2400, 3300), (2100, 3300)], 15, -5, "half")
+    diagonal = [(2600, 3000), (2900, 3300), (3200, 3300)]
+    w.path(3, 1, 3, diagonal, 25, 10, 10, manhattan=False)  # Compared through a GDSII PATH
+
+    # Layer 4: trapezoids, horizontal and vertical, in all three record forms
+    w.trapezoid(4, 0, 0, 4000, 300, 100, False, 50, -40)
+    w.trapezoid(4, 0, 400, 4000, 300, 100, False, -60, 0)
+    w.trapezoid(4, 0, 800, 4000, 300, 100, False, 0, 70)
+    w.trapezoid(4, 0, 1200, 4000, 100, 300, True, 40, -50)
+    w.trapezoid(4, 0, 1400, 4000, 100, 300, True, -30, 0)
+    w.trapezoid(4, 0, 1600, 4000, 100, 300, True, 0, 60)
+
+    # Layer 5: CTRAPEZOID types 0-25, the second half inside a CBLOCK; modal state carries into it
+    def ctrapezoid_size(kind):
+        if kind <= 7:
+            return 300, 100
+        if kind <= 15:
+            return 100, 300
+        return 100, 50 if kind in (20, 21) else 100
+
+    for kind in range(13):
+        cw, ch = ctrapezoid_size(kind)
+        w.ctrapezoid(5, 0, kind * 400, 5000, kind, cw, ch)
+    w.begin_cblock()
+    for kind in range(13, 26):
+        cw, ch = ctrapezoid_size(kind)
+        w.ctrapezoid(5, 0, kind * 400, 5000, kind, cw, ch)
+    w.end_cblock()
+
+    # Layer 6: circles
+    w.circle(6, 0, 0, 6000, 100)
+    w.circle(6, 0, 300, 6000, 100)
+    w.circle(6, 0, 600, 6000, 37)
+
+    # Layer 7: every repetition type on a small rectangle, then type 0 reusing the last one
+    repetitions = [
+        Repetition(1, 3, 2, 50, 40),
+        Repetition(2, 4, 30),
+        Repetition(3, 3, 45),
+        Repetition(4, [20, 35, 50]),
+        Repetition(5, 5, [4, 6, 3]),
+        Repetition(6, [25, 40]),
+        Repetition(7, 10, [3, 5, 2]),
+        Repetition(8, 3, 2, (40, 10), (-15, 45)),
+        Repetition(9, 4, (30, 30)),
+        Repetition(10, [(40, 0), (15, 37), (-20, 50)]),
+        Repetition(11, 5, [(8, 0), (3, 7), (-4, -9)]),
+    ]
+    for i, rep in enumerate(repetitions):
+        w.rectangle(7, 0, (i % 6) * 400, 7000 + (i // 6) * 400, 20, 10, rep)
+    w.rectangle(7, 1, 0, 8000, 20, 10, repetitions[-1])
+    w.rectangle(7, 1, 400, 8000, 20, 10, repetitions[-1])
+    w.polygon(7, 1, 2, [(800, 8000), (830, 8000), (830, 8020), (800, 8020)], repetitions[-1])
+
+    # Layer 10 via SUB: PLACEMENT rotations and mirroring, a repeated placement, PLACEMENT_TRANSFORM
+    w.placement(0, sub_shapes, 0, 10000)
+    w.placement(0, sub_shapes, 1000, 10000, angle=90)
+    w.placement(0, sub_shapes, 2000, 10000, angle=180, mirror=True)
+    w.placement(0, sub_shapes, 3000, 10000, angle=270)
+    w.placement(0, sub_shapes, 0, 11000, rep=Repetition(1, 2, 2, 600, 500))
+    w.placement(0, sub_shapes, 2000, 11000, angle=90, mirror=True, magnification=2)
+    w.placement(2, cb_shapes, 4000, 10000)
+
+    w.out += end_record()
+
+    with open(os.path.join(output_dir, "test.oas"), "wb") as f:
+        f.write(w.out)
+    diagonal_gds = [(3, 1), diagonal, 50, 10, 10]
+    write_gds(os.path.join(output_dir, "test.gds"), top, [diagonal_gds])
+    print("Wrote %d shapes to test.oas and test.gds" % (len(top) + 1))
+
+
+if __name__ == "__main__":
+    main()
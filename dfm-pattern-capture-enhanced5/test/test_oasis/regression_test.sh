@@ -0,0 +1,38 @@
+#!/bin/bash
+
+# OASIS reader regression test.
+# test.oas covers every OASIS record and repetition type the reader handles: modal state, point
+# lists 0-5, repetitions 0-11, trapezoids, CTRAPEZOID, circles, placements and CBLOCKs.
+# test.gds holds the same geometry flattened into GDSII boundaries; both files are written by
+# make_test_oasis.py. compare_layouts checks that the two read back as the same polygons, with
+# one and with several reader threads, with repetitions kept compact, and from a gzipped copy.
+
+set -e # Exit on error
+
+# Paths and variables
+PROJECT_DIR="$(cd "$(dirname "$0")/../.." && pwd)"
+BUILD_DIR="${BUILD_DIR:-${PROJECT_DIR}/build}"
+TEST_DIR="${PROJECT_DIR}/test/test_oasis"
+OASIS_FILE="${TEST_DIR}/test.oas"
+GDS_FILE="${TEST_DIR}/test.gds"
+GZIP_FILE="${BUILD_DIR}/test_oasis.oas.gz"
+
+compare() {
+    echo "Comparing $1 with ${GDS_FILE} (${*:2})"
+    ${BUILD_DIR}/compare_layouts "$1" "${GDS_FILE}" "${@:2}" || {
+        echo "Error: $1 does not match ${GDS_FILE} (${*:2})"
+        exit 1
+    }
+    echo
+}
+
+compare "${OASIS_FILE}" --threads 1
+compare "${OASIS_FILE}" --threads 4
+compare "${OASIS_FILE}" --threads 4 --keep_repetitions
+
+gzip -c "${OASIS_FILE}" > "${GZIP_FILE}"
+compare "${GZIP_FILE}" --threads 4
+rm -f "${GZIP_FILE}"
+
+echo "OASIS regression test completed successfully!"
+exit 0
@@ -12,7 +12,16 @@ SOURCES += \
 -   src/patterncapture.cpp \
 +   src/batchpatterncapture.cpp \
     ../shared/Geometry.cpp \
+    ../shared/PolygonMeasure.cpp \
+    ../shared/PolygonArena.cpp \
     ../shared/LayoutFileReader.cpp \
+    ../shared/GDSIIDecode.cpp \
+    ../shared/MappedFile.cpp \
+    ../shared/LayoutIndex.cpp \
+    ../shared/LayerCache.cpp \
+    ../shared/LayoutCatalog.cpp \
+    ../shared/LayoutHierarchy.cpp \
+    ../shared/OASISParser.cpp \
     ../shared/Logging.cpp \
     ../shared/DatabaseManager.cpp \
     src/connectdbdialog.cpp
@@ -25,7 +34,19 @@ HEADERS += \
 +   src/batchpatterncapture.h \
     src/ZoomEventFilter.h \
     ../shared/Geometry.h \
+    ../shared/PolygonArena.h \
+    ../shared/PolygonMeasure.h \
     ../shared/LayoutFileReader.h \
+    ../shared/MappedFile.h \
+    ../shared/LayoutIndex.h \
+    ../shared/LayerCache.h \
+    ../shared/LayoutCatalog.h \
+    ../shared/LayoutHierarchy.h \
+    ../shared/GDSIIRecords.h \
+    ../shared/GDSIIDecode.h \
+    ../shared/OASISParser.h \
+    ../shared/OASISRecords.h \
+    ../shared/ParallelFor.h \
     ../shared/Logging.h \
     ../shared/DatabaseManager.h \
     src/connectdbdialog.h
@@ -35,6 +56,6 @@ INCLUDEPATH += \
     /usr/include \
     /usr/include/postgresql
 
-LIBS += -L/usr/lib -lpqxx -lpq
+LIBS += -L/usr/lib -lpqxx -lpq -lz
 
 DEPENDPATH += $$PWD/src $$PWD/../shared
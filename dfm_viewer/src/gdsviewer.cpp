@@ -62,6 +62,7 @@ void GdsViewer::loadGdsFile() {
         progressDialog->show();
         scene->clear();
         layerCombo->clear();
+        loadedLayers.clear();
         if (reader) delete reader;
         reader = new LayoutFileReader(fileName.toStdString());
         for (int i = 0; i <= 100; i += 10) {
@@ -69,10 +70,23 @@ void GdsViewer::loadGdsFile() {
             QCoreApplication::processEvents();
             QThread::msleep(100);
         }
-        availableLayers = reader->getAvailableLayersAndDatatypes();
-        for (const auto& [layer, datatype] : availableLayers) {
-            layerCombo->addItem(QString("Layer %1:%2").arg(layer).arg(datatype));
+        // One catalog pass lists the layers; layers without polygons are left out of the list
+        const LayoutCatalog &catalog = reader->getCatalog();
+        availableLayers.clear();
+        QStringList labels;
+        for (const auto &[layer, datatype] : catalog.keys()) {
+            const LayerStatistics *stats = catalog.find(layer, datatype);
+            QString label = QString("Layer %1:%2").arg(layer).arg(datatype);
+            if (catalog.measured && stats) {
+                if (stats->empty()) continue;
+                label += QString(" (%1 polygons)").arg(stats->polygon_count);
+            }
+            availableLayers.emplace_back(layer, datatype);
+            labels << label;
         }
+        layerCombo->blockSignals(true);
+        layerCombo->addItems(labels);
+        layerCombo->blockSignals(false);
         if (!availableLayers.empty()) {
             updateLayer(0);
             LOG_INFO("Loaded file: " + fileName.toStdString() + " with " + std::to_string(availableLayers.size()) + " layers");
@@ -93,7 +107,13 @@ void GdsViewer::updateLayer(int index) {
     if (!reader || index < 0 || index >= static_cast<int>(availableLayers.size())) return;
     try {
         scene->clear();
-        Layer layer = reader->loadLayer(availableLayers[index].first, availableLayers[index].second);
+        const auto key = availableLayers[index];
+        auto it = loadedLayers.find(key);
+        if (it == loadedLayers.end()) {
+            std::vector<Layer> layers = reader->loadLayers({key});
+            it = loadedLayers.emplace(key, std::move(layers.front())).first;
+        }
+        const Layer &layer = it->second;
         renderLayer(layer);
         LOG_INFO("Rendered layer " + std::to_string(availableLayers[index].first) + ":" + std::to_string(availableLayers[index].second) +
                  " with " + std::to_string(layer.getPolygonCount()) + " polygons");
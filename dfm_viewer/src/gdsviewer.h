@@ -8,6 +8,7 @@
 #include <QFileDialog>
 #include <QComboBox>
 #include <QProgressDialog>
+#include <map>
 #include "LayoutFileReader.h"
 
 class GdsViewer : public QMainWindow { // Changed from QWidget
@@ -28,6 +29,7 @@ private:
     QComboBox *layerCombo;
     LayoutFileReader *reader;
     std::vector<std::pair<int, int>> availableLayers;
+    std::map<std::pair<int, int>, Layer> loadedLayers; // Layers shown so far, each read on first display
     QProgressDialog *progressDialog;
     QWidget *centralWidget; // Added for QMainWindow
 };
@@ -3,6 +3,7 @@
 #include <sstream>
 #include <iomanip>
 #include <cstdlib>
+#include <limits>
 #include <set>
 
 DatabaseManager::DatabaseManager(const std::string& db_name, const std::string& user,
@@ -125,6 +126,15 @@ bool DatabaseManager::createTables() {
             )
         )";
         txn.exec0(query);
+        // Further occurrences of a pattern captured once for a repeated cell context, as a JSON array
+        // of [xx, xy, yx, yy, dx, dy] placements of the pattern's stored geometry
+        query = R"(
+            CREATE TABLE IF NOT EXISTS pattern_occurrences (
+                pattern_id INTEGER PRIMARY KEY REFERENCES patterns(id),
+                placements JSONB
+            )
+        )";
+        txn.exec0(query);
         txn.commit();
         LOG_INFO("Created tables in database: " + db_name_);
         return true;
@@ -169,12 +179,48 @@ bool DatabaseManager::storePattern(const MultiLayerPattern& pattern, const std::
     LOG_FUNCTION();
     if (!isConnected() && !connect()) return false;
 
+    std::vector<std::pair<int, int>> input_keys;
+    for (const auto& layer : pattern.input_layers) {
+        input_keys.emplace_back(layer.layer_number, layer.datatype);
+    }
     try {
         pqxx::work txn(*conn_);
-        int pattern_id = insertPatternMetadata(txn, pattern, layout_file_name);
+        int pattern_id = insertPatternMetadata(txn, pattern, input_keys, layout_file_name);
         if (pattern_id < 0) throw std::runtime_error("Failed to insert pattern metadata");
         if (!insertPatternGeometries(txn, pattern_id, pattern))
             throw std::runtime_error("Failed to insert pattern geometries");
+        if (!insertPatternOccurrences(txn, pattern_id, pattern))
+            throw std::runtime_error("Failed to insert pattern occurrences");
+        txn.commit();
+        LOG_INFO("Stored pattern: " + pattern.pattern_id);
+        return true;
+    } catch (const std::exception& e) {
+        reportError("Error storing pattern: " + std::string(e.what()));
+        return false;
+    }
+}
+
+bool DatabaseManager::storePattern(const MultiLayerPattern& pattern, const std::vector<FlatLayer>& input_layers,
+                                   const std::string& layout_file_name) {
+    LOG_FUNCTION();
+    if (!isConnected() && !connect()) return false;
+
+    std::vector<std::pair<int, int>> input_keys;
+    for (const auto& layer : input_layers) {
+        input_keys.emplace_back(layer.layer_number, layer.datatype);
+    }
+    try {
+        pqxx::work txn(*conn_);
+        int pattern_id = insertPatternMetadata(txn, pattern, input_keys, layout_file_name);
+        if (pattern_id < 0) throw std::runtime_error("Failed to insert pattern metadata");
+        for (const auto& layer : input_layers) {
+            if (!insertLayerGeometries(txn, pattern_id, layer))
+                throw std::runtime_error("Failed to insert layer geometries");
+        }
+        if (!insertPolygon(txn, pattern_id, pattern.mask_layer_number, pattern.mask_layer_datatype, pattern.mask_polygon))
+            throw std::runtime_error("Failed to insert pattern geometries");
+        if (!insertPatternOccurrences(txn, pattern_id, pattern))
+            throw std::runtime_error("Failed to insert pattern occurrences");
         txn.commit();
         LOG_INFO("Stored pattern: " + pattern.pattern_id);
         return true;
@@ -184,16 +230,18 @@ bool DatabaseManager::storePattern(const MultiLayerPattern& pattern, const std::
     }
 }
 
-int DatabaseManager::insertPatternMetadata(pqxx::work& txn, const MultiLayerPattern& pattern, const std::string& layout_file_name) {
+int DatabaseManager::insertPatternMetadata(pqxx::work& txn, const MultiLayerPattern& pattern,
+                                           const std::vector<std::pair<int, int>>& input_layers,
+                                           const std::string& layout_file_name) {
     LOG_FUNCTION();
     std::string query;
     try {
         std::ostringstream layers_stream;
         layers_stream << "[";
-        for (size_t i = 0; i < pattern.input_layers.size(); ++i) {
+        for (size_t i = 0; i < input_layers.size(); ++i) {
             if (i > 0) layers_stream << ",";
-            layers_stream << "{\"layer\":" << pattern.input_layers[i].layer_number
-                          << ",\"datatype\":" << pattern.input_layers[i].datatype << "}";
+            layers_stream << "{\"layer\":" << input_layers[i].first
+                          << ",\"datatype\":" << input_layers[i].second << "}";
         }
         layers_stream << "]";
         std::string layers_str = layers_stream.str();
@@ -223,15 +271,60 @@ bool DatabaseManager::insertPatternGeometries(pqxx::work& txn, int pattern_id, c
     return insertPolygon(txn, pattern_id, pattern.mask_layer_number, pattern.mask_layer_datatype, pattern.mask_polygon);
 }
 
+bool DatabaseManager::insertLayerGeometries(pqxx::work& txn, int pattern_id, const FlatLayer& layer) {
+    LOG_FUNCTION();
+    for (size_t i = 0; i < layer.polygonCount(); ++i) {
+        if (!insertPolygon(txn, pattern_id, layer.layer_number, layer.datatype, layer.vertices(i),
+                           layer.vertexCount(i), layer.areas[i], layer.perimeters[i])) {
+            return false;
+        }
+    }
+    LOG_DEBUG("Inserted " + std::to_string(layer.polygonCount()) + " polygons of layer " +
+              std::to_string(layer.layer_number) + ":" + std::to_string(layer.datatype) + " for pattern " +
+              std::to_string(pattern_id));
+    return true;
+}
+
+bool DatabaseManager::insertPatternOccurrences(pqxx::work& txn, int pattern_id, const MultiLayerPattern& pattern) {
+    LOG_FUNCTION();
+    if (pattern.occurrences.empty()) return true;
+    std::string query;
+    try {
+        std::ostringstream json_stream;
+        json_stream << std::setprecision(std::numeric_limits<double>::max_digits10) << "[";
+        for (size_t i = 0; i < pattern.occurrences.size(); ++i) {
+            const PatternPlacement& p = pattern.occurrences[i];
+            if (i > 0) json_stream << ",";
+            json_stream << "[" << p.xx << "," << p.xy << "," << p.yx << "," << p.yy << "," << p.dx << "," << p.dy << "]";
+        }
+        json_stream << "]";
+
+        query = "INSERT INTO pattern_occurrences (pattern_id, placements) VALUES ($1, $2::jsonb)";
+        txn.exec_params(query, pattern_id, json_stream.str());
+        LOG_DEBUG("Inserted " + std::to_string(pattern.occurrences.size()) + " occurrences for pattern " +
+                  std::to_string(pattern_id));
+        return true;
+    } catch (const std::exception& e) {
+        reportError("Error inserting pattern occurrences: " + std::string(e.what()), query);
+        return false;
+    }
+}
+
 bool DatabaseManager::insertPolygon(pqxx::work& txn, int pattern_id, int layer_number, int datatype, const Polygon& polygon) {
+    return insertPolygon(txn, pattern_id, layer_number, datatype, polygon.points.data(), polygon.points.size(),
+                         polygon.area, polygon.perimeter);
+}
+
+bool DatabaseManager::insertPolygon(pqxx::work& txn, int pattern_id, int layer_number, int datatype, const Point* points,
+                                    size_t point_count, double area, double perimeter) {
     LOG_FUNCTION();
     std::string query;
     try {
         std::ostringstream json_stream;
         json_stream << std::fixed << std::setprecision(2) << "[";
-        for (size_t i = 0; i < polygon.points.size(); ++i) {
+        for (size_t i = 0; i < point_count; ++i) {
             if (i > 0) json_stream << ",";
-            json_stream << "[" << polygon.points[i].x << "," << polygon.points[i].y << "]";
+            json_stream << "[" << points[i].x << "," << points[i].y << "]";
         }
         json_stream << "]";
         std::string json_str = json_stream.str();
@@ -240,7 +333,7 @@ bool DatabaseManager::insertPolygon(pqxx::work& txn, int pattern_id, int layer_n
                 "(pattern_id, layer_number, datatype, geometry_type, coordinates, area, perimeter) "
                 "VALUES ($1, $2, $3, $4, $5::jsonb, $6, $7)";
         txn.exec_params(query,
-            pattern_id, layer_number, datatype, "polygon", json_str, polygon.area, polygon.perimeter);
+            pattern_id, layer_number, datatype, "polygon", json_str, area, perimeter);
         LOG_DEBUG("Inserted polygon for layer " + std::to_string(layer_number) + ":" + std::to_string(datatype));
         return true;
     } catch (const std::exception& e) {
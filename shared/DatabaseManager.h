@@ -43,7 +43,12 @@ public:
     bool createDatabaseIfNotExists();
     bool createTables();
     bool isValidSchema();
+    // Stores the pattern's geometry once; its further occurrences go to pattern_occurrences as placements
     bool storePattern(const MultiLayerPattern& pattern, const std::string& layout_file_name);
+    // Same, with the clipped input geometry taken from flat layers (e.g. pattern.flat_input_layers)
+    // instead of pattern.input_layers; everything is stored in one transaction
+    bool storePattern(const MultiLayerPattern& pattern, const std::vector<FlatLayer>& input_layers,
+                      const std::string& layout_file_name);
     std::vector<Pattern> getPatterns();
     std::vector<Geometry> getGeometries(int pattern_id = -1);
     std::vector<std::string> getAvailableDatabases();
@@ -57,9 +62,14 @@ private:
     std::unique_ptr<pqxx::connection> conn_;
     ErrorCallback error_callback_;
     void reportError(const std::string& message, const std::string& query = "");
-    int insertPatternMetadata(pqxx::work& txn, const MultiLayerPattern& pattern, const std::string& layout_file_name);
+    int insertPatternMetadata(pqxx::work& txn, const MultiLayerPattern& pattern,
+                              const std::vector<std::pair<int, int>>& input_layers, const std::string& layout_file_name);
     bool insertPatternGeometries(pqxx::work& txn, int pattern_id, const MultiLayerPattern& pattern);
+    bool insertLayerGeometries(pqxx::work& txn, int pattern_id, const FlatLayer& layer);
+    bool insertPatternOccurrences(pqxx::work& txn, int pattern_id, const MultiLayerPattern& pattern);
     bool insertPolygon(pqxx::work& txn, int pattern_id, int layer_number, int datatype, const Polygon& polygon);
+    bool insertPolygon(pqxx::work& txn, int pattern_id, int layer_number, int datatype, const Point* points,
+                       size_t point_count, double area, double perimeter);
 };
 
 #endif // DATABASEMANAGER_H
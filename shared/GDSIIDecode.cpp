@@ -0,0 +1,264 @@
+#include "GDSIIDecode.h"
+#include "GDSIIRecords.h"
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DFM_XY_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+static_assert(sizeof(Point) == 2 * sizeof(double), "Point must be two packed doubles");
+
+void decodeScalar(const uint8_t* xy, size_t point_count, int32_t* out) {
+    for (size_t i = 0; i < 2 * point_count; ++i, xy += 4) {
+        out[i] = gdsReadInt32(xy);
+    }
+}
+
+// The point kernels grow box by the decoded points when Bounds is set; the box starts out empty
+template <bool Bounds>
+void decodeScalar(const uint8_t* xy, size_t point_count, double scale, Point* out, BoundingBox& box) {
+    for (size_t i = 0; i < point_count; ++i, xy += 8) {
+        out[i].x = gdsReadInt32(xy) * scale;
+        out[i].y = gdsReadInt32(xy + 4) * scale;
+        if (Bounds) box.include(out[i]);
+    }
+}
+
+#ifdef DFM_XY_SIMD
+
+// Reverses the bytes of each 32-bit lane
+__attribute__((target("ssse3"))) inline __m128i swap128(__m128i v) {
+    return _mm_shuffle_epi8(v, _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3));
+}
+
+__attribute__((target("avx2"))) inline __m256i swap256(__m256i v) {
+    // The shuffle works within each 128-bit half, which is all a 32-bit swap needs
+    return _mm256_shuffle_epi8(v, _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                                  12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3));
+}
+
+__attribute__((target("ssse3"))) void decodeSSSE3(const uint8_t* xy, size_t point_count, int32_t* out) {
+    size_t i = 0;
+    for (; i + 2 <= point_count; i += 2) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(xy + 8 * i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), swap128(v));
+    }
+    decodeScalar(xy + 8 * i, point_count - i, out + 2 * i);
+}
+
+// Lane 0 holds x and lane 1 holds y, matching the layout of Point
+template <bool Bounds>
+__attribute__((target("ssse3"))) void decodeSSSE3(const uint8_t* xy, size_t point_count, double scale,
+                                                  Point* out, BoundingBox& box) {
+    const __m128d factor = _mm_set1_pd(scale);
+    __m128d low = _mm_set_pd(box.min_y, box.min_x), high = _mm_set_pd(box.max_y, box.max_x);
+    double* d = reinterpret_cast<double*>(out);
+    size_t i = 0;
+    for (; i + 2 <= point_count; i += 2) {
+        __m128i v = swap128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(xy + 8 * i)));
+        __m128d a = _mm_mul_pd(_mm_cvtepi32_pd(v), factor);
+        __m128d b = _mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(v, v)), factor);
+        _mm_storeu_pd(d + 2 * i, a);
+        _mm_storeu_pd(d + 2 * i + 2, b);
+        if (Bounds) {
+            low = _mm_min_pd(low, _mm_min_pd(a, b));
+            high = _mm_max_pd(high, _mm_max_pd(a, b));
+        }
+    }
+    if (Bounds) {
+        _mm_storel_pd(&box.min_x, low);
+        _mm_storeh_pd(&box.min_y, low);
+        _mm_storel_pd(&box.max_x, high);
+        _mm_storeh_pd(&box.max_y, high);
+    }
+    decodeScalar<Bounds>(xy + 8 * i, point_count - i, scale, out + i, box);
+}
+
+__attribute__((target("avx2"))) void decodeAVX2(const uint8_t* xy, size_t point_count, int32_t* out) {
+    size_t i = 0;
+    for (; i + 4 <= point_count; i += 4) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(xy + 8 * i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * i), swap256(v));
+    }
+    if (i + 2 <= point_count) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(xy + 8 * i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), swap128(v));
+        i += 2;
+    }
+    _mm256_zeroupper();
+    decodeScalar(xy + 8 * i, point_count - i, out + 2 * i);
+}
+
+// Lanes alternate x and y, two points per register
+template <bool Bounds>
+__attribute__((target("avx2"))) void decodeAVX2(const uint8_t* xy, size_t point_count, double scale,
+                                                Point* out, BoundingBox& box) {
+    const __m256d factor = _mm256_set1_pd(scale);
+    __m256d low = _mm256_set_pd(box.min_y, box.min_x, box.min_y, box.min_x);
+    __m256d high = _mm256_set_pd(box.max_y, box.max_x, box.max_y, box.max_x);
+    double* d = reinterpret_cast<double*>(out);
+    size_t i = 0;
+    for (; i + 4 <= point_count; i += 4) {
+        __m256i v = swap256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(xy + 8 * i)));
+        __m256d a = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v)), factor);
+        __m256d b = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)), factor);
+        _mm256_storeu_pd(d + 2 * i, a);
+        _mm256_storeu_pd(d + 2 * i + 4, b);
+        if (Bounds) {
+            low = _mm256_min_pd(low, _mm256_min_pd(a, b));
+            high = _mm256_max_pd(high, _mm256_max_pd(a, b));
+        }
+    }
+    if (i + 2 <= point_count) {
+        __m128i v = swap128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(xy + 8 * i)));
+        __m256d a = _mm256_mul_pd(_mm256_cvtepi32_pd(v), factor);
+        _mm256_storeu_pd(d + 2 * i, a);
+        if (Bounds) {
+            low = _mm256_min_pd(low, a);
+            high = _mm256_max_pd(high, a);
+        }
+        i += 2;
+    }
+    if (Bounds) {
+        __m128d l = _mm_min_pd(_mm256_castpd256_pd128(low), _mm256_extractf128_pd(low, 1));
+        __m128d h = _mm_max_pd(_mm256_castpd256_pd128(high), _mm256_extractf128_pd(high, 1));
+        _mm_storel_pd(&box.min_x, l);
+        _mm_storeh_pd(&box.min_y, l);
+        _mm_storel_pd(&box.max_x, h);
+        _mm_storeh_pd(&box.max_y, h);
+    }
+    _mm256_zeroupper(); // The scalar tail is SSE code; dirty upper halves would stall its conversions
+    decodeScalar<Bounds>(xy + 8 * i, point_count - i, scale, out + i, box);
+}
+
+#endif // DFM_XY_SIMD
+
+GdsXYKernel detectKernel() {
+    const char* forced = std::getenv("DFM_XY_DECODER");
+    if (forced) {
+        for (GdsXYKernel kernel : {GdsXYKernel::Scalar, GdsXYKernel::SSSE3, GdsXYKernel::AVX2}) {
+            if (std::strcmp(forced, gdsXYKernelName(kernel)) == 0 && gdsXYKernelSupported(kernel)) {
+                return kernel;
+            }
+        }
+    }
+    if (gdsXYKernelSupported(GdsXYKernel::AVX2)) return GdsXYKernel::AVX2;
+    if (gdsXYKernelSupported(GdsXYKernel::SSSE3)) return GdsXYKernel::SSSE3;
+    return GdsXYKernel::Scalar;
+}
+
+void checkSupported(GdsXYKernel kernel) {
+    if (!gdsXYKernelSupported(kernel)) {
+        throw std::invalid_argument(std::string("XY decoder not supported on this CPU: ") + gdsXYKernelName(kernel));
+    }
+}
+
+void decodeWith(GdsXYKernel kernel, const uint8_t* xy, size_t point_count, int32_t* out) {
+    switch (kernel) {
+#ifdef DFM_XY_SIMD
+        case GdsXYKernel::AVX2:
+            decodeAVX2(xy, point_count, out);
+            return;
+        case GdsXYKernel::SSSE3:
+            decodeSSSE3(xy, point_count, out);
+            return;
+#endif
+        default:
+            decodeScalar(xy, point_count, out);
+    }
+}
+
+template <bool Bounds>
+void decodeWith(GdsXYKernel kernel, const uint8_t* xy, size_t point_count, double scale, Point* out,
+                BoundingBox& box) {
+    switch (kernel) {
+#ifdef DFM_XY_SIMD
+        case GdsXYKernel::AVX2:
+            decodeAVX2<Bounds>(xy, point_count, scale, out, box);
+            return;
+        case GdsXYKernel::SSSE3:
+            decodeSSSE3<Bounds>(xy, point_count, scale, out, box);
+            return;
+#endif
+        default:
+            decodeScalar<Bounds>(xy, point_count, scale, out, box);
+    }
+}
+
+void decodeWith(GdsXYKernel kernel, const uint8_t* xy, size_t point_count, double scale, Point* out) {
+    BoundingBox unused = BoundingBox::empty();
+    decodeWith<false>(kernel, xy, point_count, scale, out, unused);
+}
+
+void decodeWith(GdsXYKernel kernel, const uint8_t* xy, size_t point_count, double scale, Point* out,
+                BoundingBox& bounds) {
+    bounds = BoundingBox::empty();
+    decodeWith<true>(kernel, xy, point_count, scale, out, bounds);
+}
+
+} // namespace
+
+const char* gdsXYKernelName(GdsXYKernel kernel) {
+    switch (kernel) {
+        case GdsXYKernel::SSSE3:
+            return "ssse3";
+        case GdsXYKernel::AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+bool gdsXYKernelSupported(GdsXYKernel kernel) {
+    switch (kernel) {
+#ifdef DFM_XY_SIMD
+        case GdsXYKernel::SSSE3:
+            return __builtin_cpu_supports("ssse3");
+        case GdsXYKernel::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        case GdsXYKernel::Scalar:
+            return true;
+        default:
+            return false;
+    }
+}
+
+GdsXYKernel gdsActiveXYKernel() {
+    static const GdsXYKernel kernel = detectKernel();
+    return kernel;
+}
+
+void gdsDecodeXY(const uint8_t* xy, size_t point_count, int32_t* out) {
+    decodeWith(gdsActiveXYKernel(), xy, point_count, out);
+}
+
+void gdsDecodeXY(const uint8_t* xy, size_t point_count, int32_t* out, GdsXYKernel kernel) {
+    checkSupported(kernel);
+    decodeWith(kernel, xy, point_count, out);
+}
+
+void gdsDecodeXY(const uint8_t* xy, size_t point_count, double scale, Point* out) {
+    decodeWith(gdsActiveXYKernel(), xy, point_count, scale, out);
+}
+
+void gdsDecodeXY(const uint8_t* xy, size_t point_count, double scale, Point* out, GdsXYKernel kernel) {
+    checkSupported(kernel);
+    decodeWith(kernel, xy, point_count, scale, out);
+}
+
+void gdsDecodeXY(const uint8_t* xy, size_t point_count, double scale, Point* out, BoundingBox& bounds) {
+    decodeWith(gdsActiveXYKernel(), xy, point_count, scale, out, bounds);
+}
+
+void gdsDecodeXY(const uint8_t* xy, size_t point_count, double scale, Point* out, BoundingBox& bounds,
+                 GdsXYKernel kernel) {
+    checkSupported(kernel);
+    decodeWith(kernel, xy, point_count, scale, out, bounds);
+}
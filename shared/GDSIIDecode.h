@@ -0,0 +1,29 @@
+#ifndef GDSII_DECODE_H
+#define GDSII_DECODE_H
+
+#include "Geometry.h"
+#include <cstddef>
+#include <cstdint>
+
+// Decoders for whole GDSII XY payloads: arrays of big-endian int32 (x, y) pairs. The x86 kernels
+// byte-swap 16 (SSSE3) or 32 (AVX2) bytes per shuffle; the best one the CPU supports is chosen
+// at run time, and DFM_XY_DECODER=scalar|ssse3|avx2 overrides the choice.
+enum class GdsXYKernel { Scalar, SSSE3, AVX2 };
+
+const char* gdsXYKernelName(GdsXYKernel kernel);
+bool gdsXYKernelSupported(GdsXYKernel kernel);
+// Kernel used by the calls without an explicit kernel, detected on first use
+GdsXYKernel gdsActiveXYKernel();
+
+// Writes the 2 * point_count coordinates at xy to out in native byte order
+void gdsDecodeXY(const uint8_t* xy, size_t point_count, int32_t* out);
+void gdsDecodeXY(const uint8_t* xy, size_t point_count, int32_t* out, GdsXYKernel kernel);
+// Writes point_count points (x * scale, y * scale) to out; scale 1.0 keeps database units
+void gdsDecodeXY(const uint8_t* xy, size_t point_count, double scale, Point* out);
+void gdsDecodeXY(const uint8_t* xy, size_t point_count, double scale, Point* out, GdsXYKernel kernel);
+// Same, also finding the bounding box of the scaled points in the decoding pass (empty without points)
+void gdsDecodeXY(const uint8_t* xy, size_t point_count, double scale, Point* out, BoundingBox& bounds);
+void gdsDecodeXY(const uint8_t* xy, size_t point_count, double scale, Point* out, BoundingBox& bounds,
+                 GdsXYKernel kernel);
+
+#endif // GDSII_DECODE_H
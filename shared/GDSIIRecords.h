@@ -0,0 +1,184 @@
+#ifndef GDSII_RECORDS_H
+#define GDSII_RECORDS_H
+
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+
+// GDSII record types used by the reader
+enum GdsRecordType : uint8_t {
+    GDS_HEADER = 0x00,
+    GDS_BGNLIB = 0x01,
+    GDS_LIBNAME = 0x02,
+    GDS_UNITS = 0x03,
+    GDS_ENDLIB = 0x04,
+    GDS_BGNSTR = 0x05,
+    GDS_STRNAME = 0x06,
+    GDS_ENDSTR = 0x07,
+    GDS_BOUNDARY = 0x08,
+    GDS_PATH = 0x09,
+    GDS_SREF = 0x0A,
+    GDS_AREF = 0x0B,
+    GDS_TEXT = 0x0C,
+    GDS_LAYER = 0x0D,
+    GDS_DATATYPE = 0x0E,
+    GDS_WIDTH = 0x0F,
+    GDS_XY = 0x10,
+    GDS_ENDEL = 0x11,
+    GDS_SNAME = 0x12,
+    GDS_COLROW = 0x13,
+    GDS_NODE = 0x15,
+    GDS_TEXTTYPE = 0x16,
+    GDS_STRANS = 0x1A,
+    GDS_MAG = 0x1B,
+    GDS_ANGLE = 0x1C,
+    GDS_PATHTYPE = 0x21,
+    GDS_BOX = 0x2D,
+    GDS_BOXTYPE = 0x2E,
+    GDS_BGNEXTN = 0x30,
+    GDS_ENDEXTN = 0x31
+};
+
+// GDSII data types
+enum GdsDataType : uint8_t {
+    GDS_NO_DATA = 0x00,
+    GDS_BIT_ARRAY = 0x01,
+    GDS_INT16 = 0x02,
+    GDS_INT32 = 0x03,
+    GDS_REAL8 = 0x05,
+    GDS_ASCII = 0x06
+};
+
+inline uint16_t gdsReadUint16(const uint8_t* p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+inline int32_t gdsReadInt32(const uint8_t* p) {
+    return static_cast<int32_t>((static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+                                (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]));
+}
+
+// GDSII 8-byte excess-64 base-16 real
+inline double gdsReadReal8(const uint8_t* p) {
+    bool negative = p[0] & 0x80;
+    int exponent = (p[0] & 0x7F) - 64;
+    uint64_t mantissa = 0;
+    for (int i = 1; i < 8; ++i) {
+        mantissa = (mantissa << 8) | p[i];
+    }
+    double value = static_cast<double>(mantissa) / (1ULL << 56) * std::pow(16.0, exponent);
+    return negative ? -value : value;
+}
+
+inline void gdsWriteUint16(uint8_t* p, uint16_t value) {
+    p[0] = static_cast<uint8_t>(value >> 8);
+    p[1] = static_cast<uint8_t>(value);
+}
+
+inline void gdsWriteInt32(uint8_t* p, int32_t value) {
+    uint32_t u = static_cast<uint32_t>(value);
+    p[0] = static_cast<uint8_t>(u >> 24);
+    p[1] = static_cast<uint8_t>(u >> 16);
+    p[2] = static_cast<uint8_t>(u >> 8);
+    p[3] = static_cast<uint8_t>(u);
+}
+
+// Inverse of gdsReadReal8; the mantissa is normalized to [1/16, 1) and rounded to 56 bits
+inline void gdsWriteReal8(uint8_t* p, double value) {
+    uint8_t sign = value < 0 ? 0x80 : 0;
+    value = std::fabs(value);
+    int exponent = 0;
+    uint64_t mantissa = 0;
+    if (value > 0) {
+        while (value >= 1.0 && exponent < 63) {
+            value /= 16.0;
+            ++exponent;
+        }
+        while (value < 0.0625 && exponent > -64) {
+            value *= 16.0;
+            --exponent;
+        }
+        mantissa = static_cast<uint64_t>(std::llround(std::ldexp(value, 56)));
+        if (mantissa >> 56) { // Rounded up to 1.0
+            mantissa >>= 4;
+            ++exponent;
+        }
+    }
+    p[0] = static_cast<uint8_t>(sign | ((exponent + 64) & 0x7F));
+    for (int i = 1; i < 8; ++i) {
+        p[i] = static_cast<uint8_t>(mantissa >> ((7 - i) * 8));
+    }
+}
+
+// One record inside a GDSII byte buffer
+struct GdsRecord {
+    size_t offset;          // Byte offset of the record header
+    uint16_t length;        // Total record length including the 4-byte header
+    uint8_t record_type;
+    uint8_t data_type;
+    const uint8_t* payload; // Points into the scanned buffer
+    size_t payload_size() const { return length - 4u; }
+};
+
+// Walks the records of an in-memory GDSII stream by pointer arithmetic.
+// Skipping a record costs one addition; no I/O or exceptions happen while scanning a buffer.
+// Scanning a MappedFile that is still being decompressed waits for records as they arrive.
+class GdsRecordScanner {
+public:
+    GdsRecordScanner(const uint8_t* data, size_t size, size_t offset = 0)
+        : data_(data), size_(size), end_(size), pos_(offset), truncated_(false), file_(nullptr) {}
+    // Scans [offset, end) of file, or up to the end of the file
+    GdsRecordScanner(const MappedFile& file, size_t offset = 0, size_t end = SIZE_MAX)
+        : data_(file.data()), size_(std::min(file.waitFor(0), end)), end_(end), pos_(offset), truncated_(false),
+          file_(&file) {}
+
+    // Returns false at the end of the buffer or on a malformed record (see truncated()).
+    bool next(GdsRecord& record) {
+        for (;;) {
+            while (pos_ + 4 <= size_) {
+                uint16_t length = gdsReadUint16(data_ + pos_);
+                if (length == 0) { // Zero padding after ENDLIB
+                    pos_ += 2;
+                    continue;
+                }
+                if (length < 4 || pos_ + length > size_) {
+                    if (length >= 4 && waitFor(pos_ + length)) continue;
+                    truncated_ = true;
+                    return false;
+                }
+                record.offset = pos_;
+                record.length = length;
+                record.record_type = data_[pos_ + 2];
+                record.data_type = data_[pos_ + 3];
+                record.payload = data_ + pos_ + 4;
+                pos_ += length;
+                return true;
+            }
+            if (!waitFor(pos_ + 4)) return false;
+        }
+    }
+
+    size_t offset() const { return pos_; }
+    bool truncated() const { return truncated_; }
+
+private:
+    // Slow path when the readable bytes run out: waits for more of a file being decompressed
+    bool waitFor(size_t needed) {
+        if (!file_ || size_ >= end_) return false;
+        size_t available = std::min(file_->waitFor(needed), end_);
+        bool grew = available > size_;
+        size_ = available;
+        return grew;
+    }
+
+    const uint8_t* data_;
+    size_t size_;      // Readable bytes
+    size_t end_;       // End of the scanned range
+    size_t pos_;
+    bool truncated_;
+    const MappedFile* file_;
+};
+
+#endif // GDSII_RECORDS_H
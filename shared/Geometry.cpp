@@ -1,4 +1,6 @@
 #include "Geometry.h"
+#include "PolygonMeasure.h"
+#include <algorithm>
 #include <cmath>
 #include <sstream>
 #include <Logging.h>
@@ -8,10 +10,97 @@ bool Point::operator==(const Point& other) const {
     return std::abs(x - other.x) < EPSILON && std::abs(y - other.y) < EPSILON;
 }
 
-Polygon::Polygon() : area(0.0), perimeter(0.0) {}
+namespace {
+
+// Everything finalize() caches, found in one pass over a closed outline
+struct OutlineMeasures {
+    double doubled_signed_area = 0.0; // Shoelace sum, same order as Polygon::calculateArea
+    double perimeter = 0.0;
+    BoundingBox bbox = BoundingBox::empty();
+    size_t first_duplicate;           // Point repeated by the next one; count when there is none
+};
+
+OutlineMeasures measureOutline(const Point* points, size_t count) {
+    const double EPSILON = 1e-10; // Point::operator== tolerance
+    OutlineMeasures m;
+    m.first_duplicate = count;
+    for (size_t i = 0; i < count; ++i) {
+        const Point& p = points[i];
+        const Point& q = points[i + 1 < count ? i + 1 : 0];
+        m.bbox.include(p);
+        m.doubled_signed_area += p.x * q.y - q.x * p.y;
+        double dx = q.x - p.x;
+        double dy = q.y - p.y;
+        m.perimeter += std::sqrt(dx * dx + dy * dy);
+        if (std::abs(dx) < EPSILON && std::abs(dy) < EPSILON && m.first_duplicate == count) {
+            m.first_duplicate = i;
+        }
+    }
+    return m;
+}
+
+// The checks of Polygon::isValid on measured points; logs why a polygon fails
+bool judgeOutline(const Point* points, size_t count, const OutlineMeasures& m) {
+    if (count < 3) {
+        std::ostringstream oss;
+        oss << "Polygon invalid: fewer than 3 points (" << count << ")";
+        LOG_DEBUG(oss.str());
+        return false;
+    }
+    // Some point is off the origin exactly when the box reaches past the threshold
+    const double COORD_THRESHOLD = 1e-10;
+    if (m.bbox.min_x >= -COORD_THRESHOLD && m.bbox.max_x <= COORD_THRESHOLD &&
+        m.bbox.min_y >= -COORD_THRESHOLD && m.bbox.max_y <= COORD_THRESHOLD) {
+        LOG_DEBUG("Polygon invalid: all points near [0,0]");
+        return false;
+    }
+    if (m.first_duplicate != count) {
+        std::ostringstream oss;
+        oss << "Polygon invalid: duplicate points at [" << points[m.first_duplicate].x << ","
+            << points[m.first_duplicate].y << "]";
+        LOG_DEBUG(oss.str());
+        return false;
+    }
+    double area = std::abs(m.doubled_signed_area) / 2.0;
+    if (area < 1e-9) {
+        std::ostringstream oss;
+        oss << "Polygon invalid: area too small (" << area << ")";
+        LOG_DEBUG(oss.str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+Polygon::Polygon()
+    : area(0.0), perimeter(0.0), bbox(BoundingBox::everything()), finalized(false), valid(false), clockwise(false) {}
+
+Polygon::Polygon(const allocator_type& allocator)
+    : points(allocator), area(0.0), perimeter(0.0), bbox(BoundingBox::everything()), finalized(false), valid(false),
+      clockwise(false) {}
+
+Polygon::Polygon(const Polygon& other, const allocator_type& allocator)
+    : points(other.points, allocator), area(other.area), perimeter(other.perimeter), bbox(other.bbox),
+      finalized(other.finalized), valid(other.valid), clockwise(other.clockwise) {}
+
+Polygon::Polygon(Polygon&& other, const allocator_type& allocator)
+    : points(std::move(other.points), allocator), area(other.area), perimeter(other.perimeter), bbox(other.bbox),
+      finalized(other.finalized), valid(other.valid), clockwise(other.clockwise) {}
+
+void Polygon::finalize() {
+    OutlineMeasures m = measureOutline(points.data(), points.size());
+    bool polygon = points.size() >= 3;
+    area = polygon ? std::abs(m.doubled_signed_area) / 2.0 : 0.0;
+    perimeter = polygon ? m.perimeter : 0.0;
+    bbox = m.bbox;
+    valid = judgeOutline(points.data(), points.size(), m);
+    clockwise = m.doubled_signed_area < 0.0;
+    finalized = true;
+}
 
 void Polygon::calculateArea() {
-    LOG_FUNCTION();
+    finalized = false;
     area = 0.0;
     size_t n = points.size();
     if (n < 3) return;
@@ -23,7 +112,7 @@ void Polygon::calculateArea() {
 }
 
 void Polygon::calculatePerimeter() {
-    LOG_FUNCTION();
+    finalized = false;
     perimeter = 0.0;
     size_t n = points.size();
     if (n < 3) return;
@@ -35,69 +124,515 @@ void Polygon::calculatePerimeter() {
     }
 }
 
+void Polygon::calculateBoundingBox() {
+    finalized = false;
+    bbox = BoundingBox::empty();
+    for (const auto& p : points) {
+        bbox.include(p);
+    }
+}
+
 bool Polygon::isValid() const {
-    LOG_FUNCTION();
-    if (points.size() < 3) {
-        std::ostringstream oss;
-        oss << "Polygon invalid: fewer than 3 points (" << points.size() << ")";
-        LOG_DEBUG(oss.str());
-        return false;
+    if (finalized) {
+        return valid;
     }
+    return judgeOutline(points.data(), points.size(), measureOutline(points.data(), points.size()));
+}
 
-    const double COORD_THRESHOLD = 1e-10;
-    bool has_valid_point = false;
-    for (const auto& p : points) {
-        if (std::abs(p.x) > COORD_THRESHOLD || std::abs(p.y) > COORD_THRESHOLD) {
-            has_valid_point = true;
-            break;
+uint8_t Polygon::outlineFlags() const {
+    if (finalized) {
+        return (valid ? OUTLINE_VALID : 0) | (clockwise ? OUTLINE_CLOCKWISE : 0);
+    }
+    OutlineMeasures m = measureOutline(points.data(), points.size());
+    return (judgeOutline(points.data(), points.size(), m) ? OUTLINE_VALID : 0) |
+           (m.doubled_signed_area < 0.0 ? OUTLINE_CLOCKWISE : 0);
+}
+
+void Polygon::restoreMeasures(double area_, double perimeter_, const BoundingBox& bbox_, uint8_t flags) {
+    area = area_;
+    perimeter = perimeter_;
+    bbox = bbox_;
+    valid = (flags & OUTLINE_VALID) != 0;
+    clockwise = (flags & OUTLINE_CLOCKWISE) != 0;
+    finalized = true;
+}
+
+Polygon pathOutline(const std::vector<Point>& spine, double half_width, double begin_extension, double end_extension) {
+    Polygon outline;
+    std::vector<Point> points;
+    for (const auto& p : spine) {
+        if (points.empty() || !(points.back() == p)) {
+            points.push_back(p);
         }
     }
-    if (!has_valid_point) {
-        LOG_DEBUG("Polygon invalid: all points near [0,0]");
-        return false;
+    if (points.size() < 2 || half_width <= 0.0) {
+        outline.bbox = BoundingBox::empty();
+        return outline;
     }
 
-    const double EPSILON = 1e-10;
-    for (size_t i = 0; i < points.size(); ++i) {
-        size_t j = (i + 1) % points.size();
-        if (std::abs(points[i].x - points[j].x) < EPSILON &&
-            std::abs(points[i].y - points[j].y) < EPSILON) {
-            std::ostringstream oss;
-            oss << "Polygon invalid: duplicate points at [" << points[i].x << "," << points[i].y << "]";
-            LOG_DEBUG(oss.str());
-            return false;
+    // Unit direction of every segment; exact for axis-parallel segments
+    size_t n = points.size();
+    std::vector<Point> dirs(n - 1);
+    bool manhattan = true;
+    for (size_t i = 0; i + 1 < n; ++i) {
+        double dx = points[i + 1].x - points[i].x;
+        double dy = points[i + 1].y - points[i].y;
+        if (dx == 0.0 || dy == 0.0) {
+            dirs[i] = Point((dx > 0.0) - (dx < 0.0), (dy > 0.0) - (dy < 0.0));
+            continue;
         }
+        manhattan = false;
+        double len = std::sqrt(dx * dx + dy * dy);
+        dirs[i] = Point(dx / len, dy / len);
     }
+    points.front().x -= dirs.front().x * begin_extension;
+    points.front().y -= dirs.front().y * begin_extension;
+    points.back().x += dirs.back().x * end_extension;
+    points.back().y += dirs.back().y * end_extension;
 
-    double temp_area = 0.0;
-    for (size_t i = 0; i < points.size(); ++i) {
-        size_t j = (i + 1) % points.size();
-        temp_area += points[i].x * points[j].y - points[j].x * points[i].y;
+    // Left side forward, right side backward. A 180 degree reversal gets a square end on both sides,
+    // so at the turn the outline folds back over the spine instead of crossing itself.
+    std::vector<Point> left, right;
+    left.reserve(n + 2);
+    right.reserve(n + 2);
+    auto addOffset = [&](const Point& p, double ox, double oy) {
+        left.emplace_back(p.x + ox, p.y + oy);
+        right.emplace_back(p.x - ox, p.y - oy);
+    };
+    for (size_t i = 0; i < n; ++i) {
+        const Point& in = dirs[i == 0 ? 0 : i - 1];
+        const Point& out = dirs[i == n - 1 ? n - 2 : i];
+        double nx = -(in.y + out.y), ny = in.x + out.x; // Sum of the two left normals
+        double projection = nx * -in.y + ny * in.x;     // Its projection onto the incoming normal
+        if (projection <= 1e-12) {
+            addOffset(points[i], -in.y * half_width, in.x * half_width);
+            addOffset(points[i], -out.y * half_width, out.x * half_width);
+        } else if (manhattan) {
+            // Axis-parallel spine, the bulk of routing: the offset is +-half_width per axis, the sum of
+            // the normals at a corner and the normal itself along a straight run
+            Point normal = in == out ? Point(-in.y, in.x) : Point(nx, ny);
+            addOffset(points[i], normal.x * half_width, normal.y * half_width);
+        } else {
+            // Inner vertices sit on the miter of adjacent segments
+            addOffset(points[i], nx * half_width / projection, ny * half_width / projection);
+        }
     }
-    temp_area = std::abs(temp_area) / 2.0;
-    if (temp_area < 1e-9) {
-        std::ostringstream oss;
-        oss << "Polygon invalid: area too small (" << temp_area << ")";
-        LOG_DEBUG(oss.str());
-        return false;
+    outline.points.assign(left.begin(), left.end());
+    outline.points.insert(outline.points.end(), right.rbegin(), right.rend());
+    outline.calculateBoundingBox();
+    return outline;
+}
+
+namespace {
+
+// First and last k in [0, limit) with k * step inside [lo, hi]; false if there is none
+bool stepRange(double step, double lo, double hi, long long limit, long long& first, long long& last) {
+    if (step == 0.0) {
+        first = 0;
+        last = limit - 1;
+        return lo <= 0.0 && hi >= 0.0 && limit > 0;
     }
+    double a = lo / step, b = hi / step;
+    if (a > b) std::swap(a, b);
+    // Clamp before converting so far-away queries cannot overflow
+    a = std::max(a, -1.0);
+    b = std::min(b, static_cast<double>(limit));
+    first = std::max(0LL, static_cast<long long>(std::ceil(a)));
+    last = std::min(limit - 1, static_cast<long long>(std::floor(b)));
+    return first <= last;
+}
 
-    return true;
+} // namespace
+
+ShapeRepetition::ShapeRepetition() : columns(1), rows(1), column_step(0.0, 0.0), row_step(0.0, 0.0) {}
+
+size_t ShapeRepetition::count() const {
+    return offsets.empty() ? static_cast<size_t>(columns) * static_cast<size_t>(rows) : offsets.size();
+}
+
+void ShapeRepetition::sortOffsets() {
+    std::sort(offsets.begin(), offsets.end(), [](const Point& a, const Point& b) {
+        return a.x < b.x || (a.x == b.x && a.y < b.y);
+    });
+}
+
+Polygon ShapeRepetition::instance(const Point& offset) const {
+    Polygon poly = shape; // Translation keeps area, perimeter and flags, and moves the box exactly
+    for (auto& p : poly.points) {
+        p.x += offset.x;
+        p.y += offset.y;
+    }
+    poly.bbox = {shape.bbox.min_x + offset.x, shape.bbox.min_y + offset.y, shape.bbox.max_x + offset.x,
+                 shape.bbox.max_y + offset.y};
+    return poly;
+}
+
+void ShapeRepetition::expand(PolygonList& polygons) const {
+    polygons.reserve(polygons.size() + count());
+    if (!offsets.empty()) {
+        for (const auto& offset : offsets) {
+            polygons.push_back(instance(offset));
+        }
+        return;
+    }
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < columns; ++c) {
+            polygons.push_back(instance(Point(c * column_step.x + r * row_step.x, c * column_step.y + r * row_step.y)));
+        }
+    }
+}
+
+BoundingBox ShapeRepetition::bounds() const {
+    BoundingBox box = BoundingBox::empty();
+    if (shape.points.empty() || count() == 0) return box;
+    auto includeOffset = [&](double x, double y) {
+        box.include(BoundingBox{shape.bbox.min_x + x, shape.bbox.min_y + y, shape.bbox.max_x + x, shape.bbox.max_y + y});
+    };
+    if (!offsets.empty()) {
+        for (const auto& offset : offsets) {
+            includeOffset(offset.x, offset.y);
+        }
+        return box;
+    }
+    // Offsets are linear in the column and row, so the corners of the grid bound them
+    for (int r : {0, rows - 1}) {
+        for (int c : {0, columns - 1}) {
+            includeOffset(c * column_step.x + r * row_step.x, c * column_step.y + r * row_step.y);
+        }
+    }
+    return box;
+}
+
+std::vector<Point> ShapeRepetition::overlappingOffsets(double min_x, double min_y, double max_x, double max_y) const {
+    std::vector<Point> result;
+    if (shape.points.empty()) return result;
+    // Offsets that make the shape's bounding box touch the query box
+    const double EPSILON = 1e-9;
+    double low_x = min_x - shape.bbox.max_x - EPSILON, high_x = max_x - shape.bbox.min_x + EPSILON;
+    double low_y = min_y - shape.bbox.max_y - EPSILON, high_y = max_y - shape.bbox.min_y + EPSILON;
+
+    if (!offsets.empty()) {
+        auto it = std::lower_bound(offsets.begin(), offsets.end(), low_x,
+                                   [](const Point& p, double x) { return p.x < x; });
+        for (; it != offsets.end() && it->x <= high_x; ++it) {
+            if (it->y >= low_y && it->y <= high_y) {
+                result.push_back(*it);
+            }
+        }
+        return result;
+    }
+
+    // Along an axis the columns do not move in, the query bounds the rows directly
+    long long first_row = 0, last_row = rows - 1, first, last;
+    if (column_step.x == 0.0) {
+        if (!stepRange(row_step.x, low_x, high_x, rows, first, last)) return result;
+        first_row = std::max(first_row, first);
+        last_row = std::min(last_row, last);
+    }
+    if (column_step.y == 0.0) {
+        if (!stepRange(row_step.y, low_y, high_y, rows, first, last)) return result;
+        first_row = std::max(first_row, first);
+        last_row = std::min(last_row, last);
+    }
+    for (long long r = first_row; r <= last_row; ++r) {
+        double row_x = r * row_step.x, row_y = r * row_step.y;
+        long long first_x, last_x, first_y, last_y;
+        if (!stepRange(column_step.x, low_x - row_x, high_x - row_x, columns, first_x, last_x) ||
+            !stepRange(column_step.y, low_y - row_y, high_y - row_y, columns, first_y, last_y)) {
+            continue;
+        }
+        for (long long c = std::max(first_x, first_y); c <= std::min(last_x, last_y); ++c) {
+            result.emplace_back(c * column_step.x + row_x, c * column_step.y + row_y);
+        }
+    }
+    return result;
 }
 
-Layer::Layer(int num, int dt) : layer_number(num), datatype(dt) {}
+void ShapeRepetition::collectOverlapping(double min_x, double min_y, double max_x, double max_y,
+                                         PolygonList& instances) const {
+    for (const auto& offset : overlappingOffsets(min_x, min_y, max_x, max_y)) {
+        instances.push_back(instance(offset));
+    }
+}
+
+int64_t DbuPolygon::doubledArea() const {
+    int64_t area = 0;
+    size_t n = points.size();
+    for (size_t i = 0; i < n; ++i) {
+        size_t j = (i + 1) % n;
+        area += static_cast<int64_t>(points[i].x) * points[j].y - static_cast<int64_t>(points[j].x) * points[i].y;
+    }
+    return area < 0 ? -area : area;
+}
+
+bool DbuPolygon::isValid() const {
+    return points.size() >= 3 && doubledArea() > 0;
+}
+
+void DbuPolygon::calculateBoundingBox() {
+    bbox = DbuBox::empty();
+    for (const auto& p : points) {
+        bbox.include(p);
+    }
+}
+
+Polygon DbuPolygon::toUser(double unit_scale) const {
+    Polygon poly;
+    poly.points.reserve(points.size());
+    for (const auto& p : points) {
+        poly.points.emplace_back(p.x * unit_scale, p.y * unit_scale);
+    }
+    poly.finalize();
+    return poly;
+}
+
+DbuLayer::DbuLayer(int num, int dt, double unit) : layer_number(num), datatype(dt), unit_scale(unit) {}
+
+void DbuLayer::calculateBounds() {
+    bounds = DbuBox::empty();
+    for (const auto& poly : polygons) {
+        bounds.include(poly.bbox);
+    }
+}
+
+Layer DbuLayer::toUser() const {
+    Layer layer(layer_number, datatype);
+    layer.polygons.reserve(polygons.size());
+    for (const auto& poly : polygons) {
+        layer.polygons.push_back(poly.toUser(unit_scale));
+    }
+    layer.calculateBounds();
+    return layer;
+}
+
+FlatLayer::FlatLayer(int num, int dt) : layer_number(num), datatype(dt), offsets(1, 0) {}
+
+void FlatLayer::reserve(size_t polygon_count, size_t point_count) {
+    points.reserve(point_count);
+    offsets.reserve(polygon_count + 1);
+    areas.reserve(polygon_count);
+    perimeters.reserve(polygon_count);
+    boxes.reserve(polygon_count);
+    flags.reserve(polygon_count);
+}
+
+void FlatLayer::addPolygon(const Polygon& polygon) {
+    points.insert(points.end(), polygon.points.begin(), polygon.points.end());
+    offsets.push_back(points.size());
+    areas.push_back(polygon.area);
+    perimeters.push_back(polygon.perimeter);
+    boxes.push_back(polygon.bbox);
+    flags.push_back(polygon.outlineFlags());
+}
+
+void FlatLayer::addPolygon(const Point* vertices, size_t count) {
+    // Same pass as Polygon::finalize
+    OutlineMeasures m = measureOutline(vertices, count);
+    bool polygon = count >= 3;
+    points.insert(points.end(), vertices, vertices + count);
+    offsets.push_back(points.size());
+    areas.push_back(polygon ? std::abs(m.doubled_signed_area) / 2.0 : 0.0);
+    perimeters.push_back(polygon ? m.perimeter : 0.0);
+    boxes.push_back(count > 0 ? m.bbox : BoundingBox{0.0, 0.0, 0.0, 0.0});
+    flags.push_back((judgeOutline(vertices, count, m) ? Polygon::OUTLINE_VALID : 0) |
+                    (m.doubled_signed_area < 0.0 ? Polygon::OUTLINE_CLOCKWISE : 0));
+}
+
+void FlatLayer::getPolygon(size_t i, Polygon& polygon) const {
+    polygon.points.assign(vertices(i), vertices(i) + vertexCount(i));
+    polygon.restoreMeasures(areas[i], perimeters[i], boxes[i], flags[i]);
+}
+
+double FlatLayer::getTotalArea() const {
+    double total = 0.0;
+    for (double area : areas) {
+        total += area;
+    }
+    return total;
+}
+
+FlatLayer FlatLayer::fromLayer(const Layer& layer) {
+    FlatLayer flat(layer.layer_number, layer.datatype);
+    size_t point_count = 0;
+    for (const auto& poly : layer.polygons) {
+        point_count += poly.points.size();
+    }
+    for (const auto& repetition : layer.repetitions) {
+        point_count += repetition.shape.points.size() * repetition.count();
+    }
+    flat.reserve(layer.getPolygonCount(), point_count);
+    for (const auto& poly : layer.polygons) {
+        flat.addPolygon(poly);
+    }
+    PolygonList instances;
+    for (const auto& repetition : layer.repetitions) {
+        instances.clear();
+        repetition.expand(instances);
+        for (const auto& poly : instances) {
+            flat.addPolygon(poly);
+        }
+    }
+    return flat;
+}
+
+Layer FlatLayer::toLayer() const {
+    Layer layer(layer_number, datatype);
+    layer.polygons.resize(polygonCount());
+    for (size_t i = 0; i < polygonCount(); ++i) {
+        getPolygon(i, layer.polygons[i]);
+    }
+    layer.calculateBounds();
+    return layer;
+}
+
+namespace {
+
+std::pmr::memory_resource* layerResource(const std::shared_ptr<PolygonArena>& arena) {
+    return arena ? arena.get() : std::pmr::get_default_resource();
+}
+
+} // namespace
+
+Layer::Layer(int num, int dt) : layer_number(num), datatype(dt), bounds(BoundingBox::everything()) {}
+
+Layer::Layer(int num, int dt, std::shared_ptr<PolygonArena> arena_)
+    : layer_number(num), datatype(dt), arena(std::move(arena_)), polygons(layerResource(arena)),
+      bounds(BoundingBox::everything()) {}
+
+Layer::Layer(const Layer& other)
+    : layer_number(other.layer_number), datatype(other.datatype), arena(other.arena),
+      polygons(other.polygons, layerResource(arena)), repetitions(other.repetitions), bounds(other.bounds) {}
+
+// The source keeps its reference: its emptied polygon list still allocates from the arena
+Layer::Layer(Layer&& other) noexcept
+    : layer_number(other.layer_number), datatype(other.datatype), arena(other.arena),
+      polygons(std::move(other.polygons)), repetitions(std::move(other.repetitions)), bounds(other.bounds) {}
+
+Layer& Layer::operator=(const Layer& other) {
+    layer_number = other.layer_number;
+    datatype = other.datatype;
+    polygons = other.polygons;
+    repetitions = other.repetitions;
+    bounds = other.bounds;
+    return *this;
+}
+
+Layer& Layer::operator=(Layer&& other) {
+    layer_number = other.layer_number;
+    datatype = other.datatype;
+    polygons = std::move(other.polygons); // Steals the buffer when both lists share memory, copies otherwise
+    repetitions = std::move(other.repetitions);
+    bounds = other.bounds;
+    return *this;
+}
 
 size_t Layer::getPolygonCount() const {
-    return polygons.size();
+    size_t count = polygons.size();
+    for (const auto& repetition : repetitions) {
+        count += repetition.count();
+    }
+    return count;
+}
+
+size_t Layer::getVertexCount() const {
+    size_t count = 0;
+    for (const auto& poly : polygons) {
+        count += poly.points.size();
+    }
+    for (const auto& repetition : repetitions) {
+        count += repetition.shape.points.size() * repetition.count();
+    }
+    return count;
 }
 
 double Layer::getTotalArea() const {
     LOG_FUNCTION();
+    std::vector<double> areas(polygons.size());
+    measurePolygons(polygons.data(), polygons.size(), areas.data(), nullptr);
     double total = 0.0;
-    for (const auto& poly : polygons) {
-        total += poly.area;
+    for (double area : areas) {
+        total += area;
+    }
+    for (const auto& repetition : repetitions) {
+        double area = 0.0;
+        measurePolygons(&repetition.shape, 1, &area, nullptr);
+        total += area * static_cast<double>(repetition.count());
     }
     return total;
 }
 
+void Layer::calculateBounds() {
+    bounds = BoundingBox::empty();
+    for (const auto& poly : polygons) {
+        bounds.include(poly.bbox);
+    }
+    for (const auto& repetition : repetitions) {
+        bounds.include(repetition.bounds());
+    }
+}
+
+void Layer::expandRepetitions() {
+    for (const auto& repetition : repetitions) {
+        repetition.expand(polygons);
+    }
+    repetitions.clear();
+}
+
+void Layer::keepOverlapping(const BoundingBox& window) {
+    auto outside = [&](const Polygon& poly) { return poly.points.empty() || !window.overlaps(poly.bbox); };
+    polygons.erase(std::remove_if(polygons.begin(), polygons.end(), outside), polygons.end());
+    for (const auto& repetition : repetitions) {
+        repetition.collectOverlapping(window.min_x, window.min_y, window.max_x, window.max_y, polygons);
+    }
+    repetitions.clear();
+    calculateBounds();
+}
+
 MultiLayerPattern::MultiLayerPattern() : mask_layer_number(-1), mask_layer_datatype(-1) {}
+
+namespace {
+
+// Placements keep area, perimeter and validity, map bounding boxes onto bounding boxes and reverse
+// the orientation when they mirror
+void placePolygon(Polygon& poly, const PatternPlacement& placement) {
+    for (auto& p : poly.points) {
+        p = placement.apply(p);
+    }
+    Point a = placement.apply(Point(poly.bbox.min_x, poly.bbox.min_y));
+    Point b = placement.apply(Point(poly.bbox.max_x, poly.bbox.max_y));
+    poly.bbox = {std::min(a.x, b.x), std::min(a.y, b.y), std::max(a.x, b.x), std::max(a.y, b.y)};
+    poly.clockwise = poly.clockwise != (placement.xx * placement.yy - placement.xy * placement.yx < 0.0);
+}
+
+} // namespace
+
+MultiLayerPattern MultiLayerPattern::placedAt(size_t i) const {
+    const PatternPlacement& placement = occurrences.at(i);
+    MultiLayerPattern placed;
+    placed.pattern_id = pattern_id;
+    placed.mask_layer_number = mask_layer_number;
+    placed.mask_layer_datatype = mask_layer_datatype;
+    placed.mask_polygon = mask_polygon;
+    placed.created_at = created_at;
+    placePolygon(placed.mask_polygon, placement);
+    placed.input_layers = input_layers;
+    for (auto& layer : placed.input_layers) {
+        layer.expandRepetitions();
+        for (auto& poly : layer.polygons) {
+            placePolygon(poly, placement);
+        }
+        layer.calculateBounds();
+    }
+    Polygon poly;
+    for (const auto& layer : flat_input_layers) {
+        FlatLayer placed_layer(layer.layer_number, layer.datatype);
+        placed_layer.reserve(layer.polygonCount(), layer.points.size());
+        for (size_t k = 0; k < layer.polygonCount(); ++k) {
+            layer.getPolygon(k, poly);
+            placePolygon(poly, placement);
+            placed_layer.addPolygon(poly);
+        }
+        placed.flat_input_layers.push_back(std::move(placed_layer));
+    }
+    return placed;
+}
@@ -1,8 +1,15 @@
 #ifndef GEOMETRY_H
 #define GEOMETRY_H
 
+#include "PolygonArena.h"
+#include <algorithm>
 #include <vector>
 #include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <memory_resource>
 #include <string>
 
 struct Point {
@@ -12,23 +19,239 @@ struct Point {
     bool operator==(const Point& other) const;
 };
 
+// Axis-aligned box, e.g. a region of interest in user units
+struct BoundingBox {
+    double min_x, min_y, max_x, max_y;
+    // Whether the box shares at least a boundary point with [x0, x1] x [y0, y1]
+    bool overlaps(double x0, double y0, double x1, double y1) const {
+        return x0 <= max_x && x1 >= min_x && y0 <= max_y && y1 >= min_y;
+    }
+    bool overlaps(const BoundingBox& other) const {
+        return overlaps(other.min_x, other.min_y, other.max_x, other.max_y);
+    }
+    bool isEmpty() const { return min_x > max_x || min_y > max_y; }
+    void include(const Point& p) {
+        min_x = std::min(min_x, p.x);
+        min_y = std::min(min_y, p.y);
+        max_x = std::max(max_x, p.x);
+        max_y = std::max(max_y, p.y);
+    }
+    void include(const BoundingBox& other) {
+        min_x = std::min(min_x, other.min_x);
+        min_y = std::min(min_y, other.min_y);
+        max_x = std::max(max_x, other.max_x);
+        max_y = std::max(max_y, other.max_y);
+    }
+    // Inverted box that overlaps nothing, to grow with include()
+    static BoundingBox empty() {
+        const double MAX = std::numeric_limits<double>::max();
+        return {MAX, MAX, -MAX, -MAX};
+    }
+    // Box that overlaps everything, for bounds that are not known
+    static BoundingBox everything() {
+        const double MAX = std::numeric_limits<double>::max();
+        return {-MAX, -MAX, MAX, MAX};
+    }
+};
+
+// Allocator-aware: a container on a memory resource (Layer::polygons on a PolygonArena) places the
+// points of the polygons put into it there too. A plain copy is allocated on the heap.
+//
+// Whoever fills the points calls finalize(), which measures the polygon in one pass: area,
+// perimeter, bbox and the validity and orientation flags. isValid() then only reads the flag.
+// Until bbox is set it spans everything, so pruning against it never drops a polygon.
 struct Polygon {
-    std::vector<Point> points;
+    using allocator_type = std::pmr::polymorphic_allocator<Point>;
+    std::pmr::vector<Point> points;
     double area;
     double perimeter;
+    BoundingBox bbox;
+    bool finalized; // valid and clockwise describe the points; cleared by the calculate*() methods
+    bool valid;     // What isValid() checks, cached
+    bool clockwise; // Negative signed area
     Polygon();
+    explicit Polygon(const allocator_type& allocator);
+    Polygon(const Polygon& other) = default;
+    Polygon(Polygon&& other) = default;
+    Polygon(const Polygon& other, const allocator_type& allocator);
+    Polygon(Polygon&& other, const allocator_type& allocator);
+    Polygon& operator=(const Polygon& other) = default;
+    Polygon& operator=(Polygon&& other) = default;
+    // Area, perimeter, bbox and the flags in one pass over the points; call again after changing them
+    void finalize();
     void calculateArea();
     void calculatePerimeter();
+    void calculateBoundingBox();              // Empty without points
+    // At least three points, not all at the origin, no repeated consecutive point and a non-zero
+    // area; constant time after finalize(), a full check otherwise
     bool isValid() const;
+    // valid and clockwise packed into one byte, to be stored with area, perimeter and bbox;
+    // measured from the points when the polygon is not finalized
+    static const uint8_t OUTLINE_VALID = 1;
+    static const uint8_t OUTLINE_CLOCKWISE = 2;
+    uint8_t outlineFlags() const;
+    // Sets what finalize() would compute from stored measures instead of the points
+    void restoreMeasures(double area, double perimeter, const BoundingBox& bbox, uint8_t flags);
+};
+
+// Outline of a path with the given half-width. The ends are extended along the first and last
+// segments; corners are mitered. Consecutive duplicate spine points are ignored. Single
+// axis-parallel segments are emitted directly as rectangles.
+Polygon pathOutline(const std::vector<Point>& spine, double half_width, double begin_extension, double end_extension);
+
+using PolygonList = std::pmr::vector<Polygon>;
+
+// One shape repeated on a regular grid or at a list of offsets (OASIS repetitions such as
+// via arrays and fill), kept compact instead of expanded into one Polygon per instance.
+struct ShapeRepetition {
+    Polygon shape;                // Instance at offset (0,0)
+    int columns, rows;            // Grid of columns x rows; 1x1 when offsets are listed
+    Point column_step, row_step;  // Displacement between columns and between rows
+    std::vector<Point> offsets;   // Explicit offsets, sorted by x; used instead of the grid when not empty
+    ShapeRepetition();
+    size_t count() const;
+    void sortOffsets();
+    Polygon instance(const Point& offset) const;
+    void expand(PolygonList& polygons) const;
+    BoundingBox bounds() const;   // Of every instance
+    // Offsets of the instances whose bounding box overlaps the query box, found without
+    // visiting the instances outside of it
+    std::vector<Point> overlappingOffsets(double min_x, double min_y, double max_x, double max_y) const;
+    void collectOverlapping(double min_x, double min_y, double max_x, double max_y,
+                            PolygonList& instances) const;
 };
 
 struct Layer {
     int layer_number;
     int datatype;
-    std::vector<Polygon> polygons;
+    // Memory of the polygons and their points, freed with the last layer holding it; null for the heap.
+    // Layers of one load or capture batch may share an arena, but only on one thread at a time.
+    std::shared_ptr<PolygonArena> arena;
+    PolygonList polygons;
+    std::vector<ShapeRepetition> repetitions; // Only filled when the reader keeps repetitions
+    // Of every polygon and repeated instance, from their cached boxes; empty for an empty layer.
+    // The readers grow it as they add polygons, the AND operations set it; otherwise it spans
+    // everything until calculateBounds() is called.
+    BoundingBox bounds;
     Layer(int num, int dt = 0);
-    size_t getPolygonCount() const;
+    Layer(int num, int dt, std::shared_ptr<PolygonArena> arena);
+    // A copy is built in the source's arena. Assignment copies or moves the polygons into the
+    // memory of this layer, which keeps its arena.
+    Layer(const Layer& other);
+    Layer(Layer&& other) noexcept;
+    Layer& operator=(const Layer& other);
+    Layer& operator=(Layer&& other);
+    size_t getPolygonCount() const;           // Including every repeated instance
+    size_t getVertexCount() const;            // Including every repeated instance
+    double getTotalArea() const;              // Measured from the points with the batch kernels
+    void calculateBounds();
+    void expandRepetitions();                 // Moves every repeated instance into polygons
+    // Drops the polygons whose bounding box misses window; repeated instances inside it become polygons
+    void keepOverlapping(const BoundingBox& window);
+};
+
+// Point in integer database units, as stored in the layout file
+struct DbuPoint {
+    int32_t x, y;
+    DbuPoint() = default;
+    DbuPoint(int32_t x_, int32_t y_) : x(x_), y(y_) {}
+    bool operator==(const DbuPoint& other) const { return x == other.x && y == other.y; }
+};
+
+// Axis-aligned box in database units; the integer counterpart of BoundingBox
+struct DbuBox {
+    int32_t min_x, min_y, max_x, max_y;
+    bool overlaps(const DbuBox& other) const {
+        return other.min_x <= max_x && other.max_x >= min_x && other.min_y <= max_y && other.max_y >= min_y;
+    }
+    void include(const DbuPoint& p) {
+        min_x = std::min(min_x, p.x);
+        min_y = std::min(min_y, p.y);
+        max_x = std::max(max_x, p.x);
+        max_y = std::max(max_y, p.y);
+    }
+    void include(const DbuBox& other) {
+        min_x = std::min(min_x, other.min_x);
+        min_y = std::min(min_y, other.min_y);
+        max_x = std::max(max_x, other.max_x);
+        max_y = std::max(max_y, other.max_y);
+    }
+    // Inverted box that overlaps nothing, to grow with include()
+    static DbuBox empty() {
+        const int32_t MAX = std::numeric_limits<int32_t>::max();
+        return {MAX, MAX, std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::min()};
+    }
+    // Box that overlaps everything, for bounds that are not known
+    static DbuBox everything() {
+        const int32_t MAX = std::numeric_limits<int32_t>::max();
+        return {std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::min(), MAX, MAX};
+    }
+};
+
+// Polygon in integer database units: half the coordinate memory of Polygon, and exact.
+// Like Polygon::bbox, bbox spans everything until calculateBoundingBox() is called.
+struct DbuPolygon {
+    std::vector<DbuPoint> points;
+    DbuBox bbox = DbuBox::everything();
+    int64_t doubledArea() const;               // Twice the absolute area, exact
+    bool isValid() const;                      // At least three points and a non-zero area
+    void calculateBoundingBox();               // Empty without points
+    Polygon toUser(double unit_scale) const;   // Scaled to user units, with area and perimeter
+};
+
+// Layer in database units; coordinates become user units only on output
+struct DbuLayer {
+    int layer_number;
+    int datatype;
+    double unit_scale; // User units per database unit of the layout
+    std::vector<DbuPolygon> polygons;
+    // Of every polygon's box; the reader grows it as it adds polygons, otherwise it spans
+    // everything until calculateBounds() is called
+    DbuBox bounds = DbuBox::everything();
+    DbuLayer(int num, int dt = 0, double unit = 0.001);
+    void calculateBounds();
+    Layer toUser() const;
+};
+
+// Layer stored as parallel arrays: every vertex in one buffer, polygon i spanning
+// points[offsets[i]] .. points[offsets[i + 1] - 1], with its area, perimeter and bounding box
+// alongside. Loading N polygons costs a few growing buffers instead of N point vectors.
+struct FlatLayer {
+    int layer_number;
+    int datatype;
+    std::vector<Point> points;
+    std::vector<uint64_t> offsets;   // polygonCount() + 1 entries
+    std::vector<double> areas;
+    std::vector<double> perimeters;
+    std::vector<BoundingBox> boxes;  // In user units
+    std::vector<uint8_t> flags;      // Polygon::outlineFlags()
+    FlatLayer(int num, int dt = 0);
+    size_t polygonCount() const { return offsets.size() - 1; }
+    size_t vertexCount(size_t i) const { return offsets[i + 1] - offsets[i]; }
+    const Point* vertices(size_t i) const { return points.data() + offsets[i]; }
+    void reserve(size_t polygon_count, size_t point_count);
+    // Appends a polygon, keeping its area, perimeter, bounding box and flags
+    void addPolygon(const Polygon& polygon);
+    // Appends count vertices and computes their area, perimeter, bounding box and flags
+    void addPolygon(const Point* vertices, size_t count);
+    // Copies polygon i, finalized from its stored measures, into polygon, reusing its point buffer
+    void getPolygon(size_t i, Polygon& polygon) const;
     double getTotalArea() const;
+    // Repeated shapes are expanded
+    static FlatLayer fromLayer(const Layer& layer);
+    Layer toLayer() const;
+};
+
+// Receives polygons one at a time as they are decoded or flattened; slot is the index of the
+// requested layer. The polygon and its point buffer are reused afterwards, so copy what you keep.
+using PolygonSink = std::function<void(size_t slot, const Polygon& polygon)>;
+
+// Moves a captured pattern onto another occurrence of the same context: a rotation by a multiple
+// of 90 degrees, optionally mirrored, then a translation in user units
+struct PatternPlacement {
+    double xx, xy, yx, yy; // Linear part, row-major; every entry is 0, 1 or -1
+    double dx, dy;
+    Point apply(const Point& p) const { return Point(xx * p.x + xy * p.y + dx, yx * p.x + yy * p.y + dy); }
 };
 
 struct MultiLayerPattern {
@@ -37,8 +260,17 @@ struct MultiLayerPattern {
     int mask_layer_datatype;
     Polygon mask_polygon;
     std::vector<Layer> input_layers;
+    // Capture over flat layers fills these instead of input_layers
+    std::vector<FlatLayer> flat_input_layers;
     std::chrono::system_clock::time_point created_at;
+    // Further occurrences of the same context found by hierarchical capture, relative to the geometry
+    // above, which is the first one. The pattern is computed and stored once; consumers that need
+    // flat output expand each occurrence with placedAt().
+    std::vector<PatternPlacement> occurrences;
     MultiLayerPattern();
+    size_t occurrenceCount() const { return 1 + occurrences.size(); }
+    // Copy of the pattern's geometry moved to occurrences[i], without occurrences of its own
+    MultiLayerPattern placedAt(size_t i) const;
 };
 
 #endif
@@ -0,0 +1,402 @@
+#include "LayerCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <Logging.h>
+
+namespace {
+
+const char CACHE_MAGIC[8] = {'D', 'F', 'M', 'C', 'A', 'C', 'H', 'E'};
+const uint32_t CACHE_VERSION = 2;
+const uint64_t CHECKSUM_SEED = 14695981039346656037ULL;
+
+// Fixed-size records at the start of the file; every section that follows is 8-byte aligned
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t layer_count;
+    uint64_t file_size;          // LayoutIndex::FileKey of the layout
+    int64_t file_mtime_ns;
+    uint64_t file_hash;
+    uint64_t catalog_count;      // layer:datatype pairs after the directory; 0 if unknown
+    uint64_t directory_checksum; // Of the directory and the catalog
+};
+
+struct CacheDirectoryEntry {
+    int32_t layer_number;
+    int32_t datatype;
+    uint64_t polygon_count;
+    uint64_t point_count;
+    uint64_t data_offset;        // Points, offsets, boxes, areas, perimeters and flags, back to back
+    uint64_t checksum;           // Of those arrays
+};
+
+// The flag bytes are padded to keep the next layer 8-byte aligned
+uint64_t flagsSize(uint64_t polygon_count) {
+    return (polygon_count + 7) / 8 * 8;
+}
+
+uint64_t layerDataSize(uint64_t polygon_count, uint64_t point_count) {
+    return point_count * sizeof(Point) + (polygon_count + 1) * sizeof(uint64_t) +
+           polygon_count * (sizeof(BoundingBox) + 2 * sizeof(double)) + flagsSize(polygon_count);
+}
+
+// FNV-1a over 64-bit words; sizes are multiples of 8 except possibly at the very end
+uint64_t checksum64(uint64_t hash, const uint8_t* data, size_t size) {
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; ++i) {
+        uint64_t word;
+        std::memcpy(&word, data + 8 * i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ULL;
+    }
+    for (size_t i = words * 8; i < size; ++i) {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Buffered output that checksums everything written since the last restart()
+class ChecksumWriter {
+public:
+    explicit ChecksumWriter(std::ofstream& out) : out_(out), hash_(CHECKSUM_SEED) {}
+
+    template <typename T>
+    void put(const T& value) {
+        append(&value, sizeof(T));
+    }
+
+    void append(const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        if (size >= BUFFER_SIZE) {
+            flush();
+            hash_ = checksum64(hash_, bytes, size);
+            out_.write(reinterpret_cast<const char*>(bytes), static_cast<std::streamsize>(size));
+            return;
+        }
+        buffer_.insert(buffer_.end(), bytes, bytes + size);
+        if (buffer_.size() >= BUFFER_SIZE) {
+            flush();
+        }
+    }
+
+    void restart() {
+        flush();
+        hash_ = CHECKSUM_SEED;
+    }
+
+    uint64_t checksum() {
+        flush();
+        return hash_;
+    }
+
+private:
+    static const size_t BUFFER_SIZE = 1 << 20;
+
+    void flush() {
+        hash_ = checksum64(hash_, buffer_.data(), buffer_.size());
+        out_.write(reinterpret_cast<const char*>(buffer_.data()), static_cast<std::streamsize>(buffer_.size()));
+        buffer_.clear();
+    }
+
+    std::ofstream& out_;
+    uint64_t hash_;
+    std::vector<uint8_t> buffer_;
+};
+
+} // namespace
+
+Layer LayerCacheView::toLayer() const {
+    Layer layer(layer_number, datatype, std::make_shared<PolygonArena>());
+    layer.polygons.resize(polygon_count);
+    layer.bounds = BoundingBox::empty();
+    for (size_t i = 0; i < polygon_count; ++i) {
+        Polygon& poly = layer.polygons[i];
+        poly.points.assign(points + offsets[i], points + offsets[i + 1]);
+        poly.restoreMeasures(areas[i], perimeters[i], boxes[i], flags[i]);
+        layer.bounds.include(boxes[i]);
+    }
+    return layer;
+}
+
+LayerCache::LayerCache() = default;
+
+std::string LayerCache::cachePathFor(const std::string& layout_file) {
+    return layout_file + ".dfmcache";
+}
+
+bool LayerCache::open(const std::string& layout_file) {
+    LOG_FUNCTION();
+    file_.reset();
+    views_.clear();
+    verified_.clear();
+    catalog_.clear();
+
+    std::string cache_file = cachePathFor(layout_file);
+    struct stat st;
+    if (::stat(cache_file.c_str(), &st) != 0) {
+        LOG_INFO("No layer cache found at " + cache_file);
+        return false;
+    }
+    auto file = std::make_unique<MappedFile>(cache_file);
+    const uint8_t* data = file->data();
+    size_t size = file->size();
+
+    CacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    if (size >= sizeof(header)) {
+        std::memcpy(&header, data, sizeof(header));
+    }
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION) {
+        LOG_WARN("Ignoring layer cache with unknown format: " + cache_file);
+        return false;
+    }
+    LayoutIndex::FileKey stored_key, current_key;
+    stored_key.size = header.file_size;
+    stored_key.mtime_ns = header.file_mtime_ns;
+    stored_key.content_hash = header.file_hash;
+    if (!LayoutIndex::computeFileKey(layout_file, current_key) || !(stored_key == current_key)) {
+        LOG_INFO("Layer cache is stale, it will be rebuilt: " + cache_file);
+        return false;
+    }
+
+    uint64_t directory_size = header.layer_count * sizeof(CacheDirectoryEntry);
+    if (header.catalog_count > size / (2 * sizeof(int32_t)) ||
+        sizeof(header) + directory_size + header.catalog_count * 2 * sizeof(int32_t) > size) {
+        LOG_WARN("Ignoring truncated layer cache: " + cache_file);
+        return false;
+    }
+    const uint8_t* directory = data + sizeof(header);
+    uint64_t tables_size = directory_size + header.catalog_count * 2 * sizeof(int32_t);
+    if (checksum64(CHECKSUM_SEED, directory, tables_size) != header.directory_checksum) {
+        LOG_WARN("Ignoring corrupt layer cache: " + cache_file);
+        return false;
+    }
+
+    std::vector<LayerCacheView> views;
+    for (uint32_t i = 0; i < header.layer_count; ++i) {
+        CacheDirectoryEntry entry;
+        std::memcpy(&entry, directory + i * sizeof(entry), sizeof(entry));
+        if (entry.polygon_count > size || entry.point_count > size || entry.data_offset % 8 != 0 ||
+            entry.data_offset > size || layerDataSize(entry.polygon_count, entry.point_count) > size - entry.data_offset) {
+            LOG_WARN("Ignoring truncated layer cache: " + cache_file);
+            return false;
+        }
+        const uint8_t* p = data + entry.data_offset;
+        LayerCacheView view;
+        view.layer_number = entry.layer_number;
+        view.datatype = entry.datatype;
+        view.polygon_count = static_cast<size_t>(entry.polygon_count);
+        view.point_count = static_cast<size_t>(entry.point_count);
+        view.points = reinterpret_cast<const Point*>(p);
+        p += view.point_count * sizeof(Point);
+        view.offsets = reinterpret_cast<const uint64_t*>(p);
+        p += (view.polygon_count + 1) * sizeof(uint64_t);
+        view.boxes = reinterpret_cast<const BoundingBox*>(p);
+        p += view.polygon_count * sizeof(BoundingBox);
+        view.areas = reinterpret_cast<const double*>(p);
+        p += view.polygon_count * sizeof(double);
+        view.perimeters = reinterpret_cast<const double*>(p);
+        p += view.polygon_count * sizeof(double);
+        view.flags = p;
+        view.checksum = entry.checksum;
+        views.push_back(view);
+    }
+    const uint8_t* catalog = directory + directory_size;
+    for (uint64_t i = 0; i < header.catalog_count; ++i) {
+        int32_t pair[2];
+        std::memcpy(pair, catalog + i * sizeof(pair), sizeof(pair));
+        catalog_.emplace_back(pair[0], pair[1]);
+    }
+
+    std::sort(views.begin(), views.end(), [](const LayerCacheView& a, const LayerCacheView& b) {
+        return std::make_pair(a.layer_number, a.datatype) < std::make_pair(b.layer_number, b.datatype);
+    });
+    views_ = std::move(views);
+    verified_.assign(views_.size(), 0);
+    file_ = std::move(file);
+
+    std::ostringstream oss;
+    oss << "Mapped layer cache " << cache_file << " with " << views_.size() << " layers";
+    LOG_INFO(oss.str());
+    return true;
+}
+
+const LayerCacheView* LayerCache::find(int layer_number, int datatype) const {
+    auto it = std::lower_bound(views_.begin(), views_.end(), std::make_pair(layer_number, datatype),
+                               [](const LayerCacheView& view, const std::pair<int, int>& key) {
+                                   return std::make_pair(view.layer_number, view.datatype) < key;
+                               });
+    if (it == views_.end() || it->layer_number != layer_number || it->datatype != datatype) {
+        return nullptr;
+    }
+    int& verified = verified_[it - views_.begin()];
+    if (verified == 0) {
+        // The arrays are contiguous, starting with the points
+        const uint8_t* begin = reinterpret_cast<const uint8_t*>(it->points);
+        bool valid = checksum64(CHECKSUM_SEED, begin, layerDataSize(it->polygon_count, it->point_count)) == it->checksum &&
+                     it->offsets[0] == 0 && it->offsets[it->polygon_count] == it->point_count;
+        for (size_t i = 0; valid && i < it->polygon_count; ++i) {
+            valid = it->offsets[i] <= it->offsets[i + 1];
+        }
+        verified = valid ? 1 : -1;
+        if (!valid) {
+            std::ostringstream oss;
+            oss << "Ignoring corrupt cached layer " << layer_number << ":" << datatype;
+            LOG_WARN(oss.str());
+        }
+    }
+    return verified > 0 ? &*it : nullptr;
+}
+
+bool LayerCache::save(const std::string& layout_file, const std::vector<Layer>& layers,
+                      const std::vector<std::pair<int, int>>& catalog) {
+    LOG_FUNCTION();
+    LayoutIndex::FileKey key;
+    if (!LayoutIndex::computeFileKey(layout_file, key)) {
+        LOG_WARN("Cannot stat layout file for caching: " + layout_file);
+        return false;
+    }
+
+    // Every layer to write, sorted by layer:datatype: still-valid cached ones and the new ones
+    struct Source {
+        std::pair<int, int> key;
+        const LayerCacheView* view;
+        const Layer* layer;
+    };
+    std::vector<Source> sources;
+    for (const auto& layer : layers) {
+        std::pair<int, int> layer_key(layer.layer_number, layer.datatype);
+        bool duplicate = std::any_of(sources.begin(), sources.end(), [&](const Source& s) { return s.key == layer_key; });
+        if (!duplicate) {
+            sources.push_back({layer_key, nullptr, &layer});
+        }
+    }
+    for (const auto& view : views_) {
+        std::pair<int, int> view_key(view.layer_number, view.datatype);
+        bool replaced = std::any_of(sources.begin(), sources.end(), [&](const Source& s) { return s.key == view_key; });
+        if (!replaced && find(view.layer_number, view.datatype)) {
+            sources.push_back({view_key, &view, nullptr});
+        }
+    }
+    std::sort(sources.begin(), sources.end(), [](const Source& a, const Source& b) { return a.key < b.key; });
+
+    std::string cache_file = cachePathFor(layout_file);
+    std::string temp_file = cache_file + ".tmp";
+    std::ofstream out(temp_file, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        LOG_WARN("Cannot write layer cache: " + cache_file);
+        return false;
+    }
+
+    CacheHeader header;
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.layer_count = static_cast<uint32_t>(sources.size());
+    header.file_size = key.size;
+    header.file_mtime_ns = key.mtime_ns;
+    header.file_hash = key.content_hash;
+    header.catalog_count = catalog.size();
+    header.directory_checksum = 0;
+    std::vector<CacheDirectoryEntry> directory(sources.size());
+    // Header and directory are written again once the layer checksums are known
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(directory.data()),
+              static_cast<std::streamsize>(directory.size() * sizeof(CacheDirectoryEntry)));
+    ChecksumWriter writer(out);
+    for (const auto& [layer_number, datatype] : catalog) {
+        writer.put(static_cast<int32_t>(layer_number));
+        writer.put(static_cast<int32_t>(datatype));
+    }
+    uint64_t offset = sizeof(header) + directory.size() * sizeof(CacheDirectoryEntry) +
+                      catalog.size() * 2 * sizeof(int32_t);
+
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const Source& source = sources[i];
+        CacheDirectoryEntry& entry = directory[i];
+        entry.layer_number = source.key.first;
+        entry.datatype = source.key.second;
+        entry.data_offset = offset;
+        writer.restart();
+        if (source.view) {
+            const LayerCacheView& view = *source.view;
+            entry.polygon_count = view.polygon_count;
+            entry.point_count = view.point_count;
+            writer.append(view.points, layerDataSize(view.polygon_count, view.point_count));
+        } else {
+            PolygonList expanded;
+            for (const auto& repetition : source.layer->repetitions) {
+                repetition.expand(expanded);
+            }
+            const PolygonList* parts[2] = {&source.layer->polygons, &expanded};
+            entry.polygon_count = 0;
+            entry.point_count = 0;
+            for (const auto* part : parts) {
+                for (const auto& poly : *part) {
+                    writer.append(poly.points.data(), poly.points.size() * sizeof(Point));
+                    entry.polygon_count++;
+                    entry.point_count += poly.points.size();
+                }
+            }
+            uint64_t point_offset = 0;
+            writer.put(point_offset);
+            for (const auto* part : parts) {
+                for (const auto& poly : *part) {
+                    point_offset += poly.points.size();
+                    writer.put(point_offset);
+                }
+            }
+            for (const auto* part : parts) {
+                for (const auto& poly : *part) {
+                    writer.put(poly.bbox);
+                }
+            }
+            for (const auto* part : parts) {
+                for (const auto& poly : *part) {
+                    writer.put(poly.area);
+                }
+            }
+            for (const auto* part : parts) {
+                for (const auto& poly : *part) {
+                    writer.put(poly.perimeter);
+                }
+            }
+            for (const auto* part : parts) {
+                for (const auto& poly : *part) {
+                    writer.put(poly.outlineFlags());
+                }
+            }
+            for (uint64_t pad = entry.polygon_count; pad < flagsSize(entry.polygon_count); ++pad) {
+                writer.put(uint8_t(0));
+            }
+        }
+        entry.checksum = writer.checksum();
+        offset += layerDataSize(entry.polygon_count, entry.point_count);
+    }
+    writer.checksum(); // Flushes
+
+    uint64_t tables_checksum = checksum64(CHECKSUM_SEED, reinterpret_cast<const uint8_t*>(directory.data()),
+                                          directory.size() * sizeof(CacheDirectoryEntry));
+    for (const auto& [layer_number, datatype] : catalog) {
+        int32_t pair[2] = {layer_number, datatype};
+        tables_checksum = checksum64(tables_checksum, reinterpret_cast<const uint8_t*>(pair), sizeof(pair));
+    }
+    header.directory_checksum = tables_checksum;
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(directory.data()),
+              static_cast<std::streamsize>(directory.size() * sizeof(CacheDirectoryEntry)));
+    out.close();
+    if (!out || std::rename(temp_file.c_str(), cache_file.c_str()) != 0) {
+        LOG_WARN("Failed writing layer cache: " + cache_file);
+        std::remove(temp_file.c_str());
+        return false;
+    }
+
+    std::ostringstream oss;
+    oss << "Saved layer cache " << cache_file << " with " << sources.size() << " layers";
+    LOG_INFO(oss.str());
+    return open(layout_file);
+}
@@ -0,0 +1,57 @@
+#ifndef LAYER_CACHE_H
+#define LAYER_CACHE_H
+
+#include "Geometry.h"
+#include "LayoutIndex.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// One cached layer, pointing straight into the memory-mapped cache file: the vertices of all
+// polygons back to back, with per-polygon offsets, bounding boxes, areas, perimeters and flags
+struct LayerCacheView {
+    int layer_number;
+    int datatype;
+    size_t polygon_count;
+    size_t point_count;
+    const Point* points;          // Vertices of polygon i are points[offsets[i]] .. points[offsets[i + 1] - 1]
+    const uint64_t* offsets;      // polygon_count + 1 entries
+    const BoundingBox* boxes;     // In user units
+    const double* areas;
+    const double* perimeters;
+    const uint8_t* flags;         // Polygon::outlineFlags()
+    uint64_t checksum;            // Of the arrays above, checked before the view is first handed out
+    Layer toLayer() const;
+};
+
+// Sidecar cache of parsed layers stored next to a layout file as "<layout_file>.dfmcache".
+// It is keyed like the .dfmidx index by the layout's size, modification time and sampled
+// content hash. The file is memory-mapped and read without deserialization; layers loaded
+// later are added by rewriting it.
+class LayerCache {
+public:
+    LayerCache();
+    static std::string cachePathFor(const std::string& layout_file);
+
+    // Maps the cache of layout_file; returns false if it is missing, corrupt or stale.
+    bool open(const std::string& layout_file);
+    // Cached layer, or nullptr if it is not cached or fails its checksum
+    const LayerCacheView* find(int layer_number, int datatype) const;
+    // layer:datatype pairs of the layout, when the cache was written after a full scan
+    const std::vector<std::pair<int, int>>& catalog() const { return catalog_; }
+    // Writes the cache of layout_file with the cached layers plus layers (repeated shapes are
+    // stored expanded), then maps the new file. Returns false if it could not be written.
+    bool save(const std::string& layout_file, const std::vector<Layer>& layers,
+              const std::vector<std::pair<int, int>>& catalog);
+
+private:
+    std::unique_ptr<MappedFile> file_;
+    std::vector<LayerCacheView> views_;    // Sorted by layer:datatype
+    mutable std::vector<int> verified_;    // Per view: 0 unchecked, 1 valid, -1 corrupt
+    std::vector<std::pair<int, int>> catalog_;
+};
+
+#endif // LAYER_CACHE_H
@@ -0,0 +1,102 @@
+#include "LayoutCatalog.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+LayerStatistics::LayerStatistics(int num, int dt)
+    : layer_number(num), datatype(dt), polygon_count(0), invalid_count(0), vertex_count(0), total_area(0.0),
+      bounds{std::numeric_limits<double>::max(), std::numeric_limits<double>::max(),
+             std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest()},
+      begin(0), end(0) {}
+
+uint64_t LayerStatistics::estimatedBytes() const {
+    return polygon_count * sizeof(Polygon) + vertex_count * sizeof(Point);
+}
+
+LayoutCatalog::LayoutCatalog() : unit_scale(0.001), measured(false), hierarchical(false) {}
+
+void LayoutCatalog::clear() {
+    layers_.clear();
+    unit_scale = 0.001;
+    measured = false;
+    hierarchical = false;
+}
+
+LayerStatistics& LayoutCatalog::entryFor(int layer_number, int datatype) {
+    auto it = std::lower_bound(layers_.begin(), layers_.end(), std::make_pair(layer_number, datatype),
+                               [](const LayerStatistics& entry, const std::pair<int, int>& key) {
+                                   return std::make_pair(entry.layer_number, entry.datatype) < key;
+                               });
+    if (it == layers_.end() || it->layer_number != layer_number || it->datatype != datatype) {
+        it = layers_.insert(it, LayerStatistics(layer_number, datatype));
+    }
+    return *it;
+}
+
+LayerStatistics& LayoutCatalog::addLayer(int layer_number, int datatype) {
+    return entryFor(layer_number, datatype);
+}
+
+void LayoutCatalog::addShape(int layer_number, int datatype, bool valid, size_t vertex_count, double doubled_area,
+                             int32_t min_x, int32_t min_y, int32_t max_x, int32_t max_y, uint64_t begin,
+                             uint64_t end) {
+    LayerStatistics& entry = entryFor(layer_number, datatype);
+    if (valid) {
+        entry.polygon_count++;
+        entry.vertex_count += vertex_count;
+        entry.total_area += std::abs(doubled_area) * 0.5 * unit_scale * unit_scale;
+    } else {
+        entry.invalid_count++;
+    }
+    if (vertex_count > 0) {
+        entry.bounds.min_x = std::min(entry.bounds.min_x, min_x * unit_scale);
+        entry.bounds.min_y = std::min(entry.bounds.min_y, min_y * unit_scale);
+        entry.bounds.max_x = std::max(entry.bounds.max_x, max_x * unit_scale);
+        entry.bounds.max_y = std::max(entry.bounds.max_y, max_y * unit_scale);
+    }
+    if (entry.end == 0) {
+        entry.begin = begin;
+    }
+    entry.end = end;
+}
+
+void LayoutCatalog::merge(const LayoutCatalog& other) {
+    hierarchical = hierarchical || other.hierarchical;
+    for (const auto& source : other.layers_) {
+        LayerStatistics& entry = entryFor(source.layer_number, source.datatype);
+        entry.polygon_count += source.polygon_count;
+        entry.invalid_count += source.invalid_count;
+        entry.vertex_count += source.vertex_count;
+        entry.total_area += source.total_area;
+        entry.bounds.min_x = std::min(entry.bounds.min_x, source.bounds.min_x);
+        entry.bounds.min_y = std::min(entry.bounds.min_y, source.bounds.min_y);
+        entry.bounds.max_x = std::max(entry.bounds.max_x, source.bounds.max_x);
+        entry.bounds.max_y = std::max(entry.bounds.max_y, source.bounds.max_y);
+        if (source.end != 0) {
+            if (entry.end == 0) {
+                entry.begin = source.begin;
+            }
+            entry.end = source.end;
+        }
+    }
+}
+
+const LayerStatistics* LayoutCatalog::find(int layer_number, int datatype) const {
+    auto it = std::lower_bound(layers_.begin(), layers_.end(), std::make_pair(layer_number, datatype),
+                               [](const LayerStatistics& entry, const std::pair<int, int>& key) {
+                                   return std::make_pair(entry.layer_number, entry.datatype) < key;
+                               });
+    if (it == layers_.end() || it->layer_number != layer_number || it->datatype != datatype) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+std::vector<std::pair<int, int>> LayoutCatalog::keys() const {
+    std::vector<std::pair<int, int>> keys;
+    keys.reserve(layers_.size());
+    for (const auto& entry : layers_) {
+        keys.emplace_back(entry.layer_number, entry.datatype);
+    }
+    return keys;
+}
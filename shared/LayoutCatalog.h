@@ -0,0 +1,58 @@
+#ifndef LAYOUT_CATALOG_H
+#define LAYOUT_CATALOG_H
+
+#include "Geometry.h"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Statistics of one layer:datatype, gathered by the pass that scans its elements
+struct LayerStatistics {
+    int layer_number;
+    int datatype;
+    uint64_t polygon_count;  // Valid shapes (BOUNDARY, BOX, PATH outlines), as a load returns them
+    uint64_t invalid_count;  // Shapes a load discards (fewer than three points, duplicate vertices, no area)
+    uint64_t vertex_count;   // Vertices of the valid shapes, without closing points
+    double total_area;       // Of the valid shapes, in square user units
+    BoundingBox bounds;      // Of all shapes, in user units; inverted while there are none
+    uint64_t begin, end;     // Byte range from the first shape element to the end of the last one
+    LayerStatistics(int num, int dt);
+    bool empty() const { return polygon_count == 0; }
+    // Approximate heap size of these polygons once loaded into a Layer
+    uint64_t estimatedBytes() const;
+};
+
+// Per layer:datatype catalog of a layout file. The GDSII reader fills it in the same pass that
+// loads layers, so planning a load needs no extra scan. When only the layer:datatype pairs are
+// known (OASIS files, the layer cache) the catalog is not measured and the statistics stay zero.
+class LayoutCatalog {
+public:
+    LayoutCatalog();
+    void clear();
+
+    // Makes a layer:datatype visible; returns its (possibly new) entry
+    LayerStatistics& addLayer(int layer_number, int datatype);
+    // Records one shape element: its vertex count and doubled signed area in database units
+    // (closing point excluded), its database-unit bounding box and its byte range
+    void addShape(int layer_number, int datatype, bool valid, size_t vertex_count, double doubled_area,
+                  int32_t min_x, int32_t min_y, int32_t max_x, int32_t max_y, uint64_t begin, uint64_t end);
+    // Adds the statistics of a catalog built over a later part of the same file
+    void merge(const LayoutCatalog& other);
+
+    const LayerStatistics* find(int layer_number, int datatype) const;
+    const std::vector<LayerStatistics>& layers() const { return layers_; }
+    std::vector<std::pair<int, int>> keys() const;
+    bool empty() const { return layers_.empty(); }
+
+    double unit_scale;  // User units per database unit, used by addShape
+    bool measured;      // Statistics were gathered; false when only the layer:datatype pairs are known
+    bool hierarchical;  // The file has SREF/AREF: counts are of shapes drawn in their cells, not of placed instances
+
+private:
+    LayerStatistics& entryFor(int layer_number, int datatype);
+
+    std::vector<LayerStatistics> layers_; // Sorted by layer:datatype
+};
+
+#endif // LAYOUT_CATALOG_H
@@ -1,11 +1,79 @@
 #include "LayoutFileReader.h"
+#include "GDSIIRecords.h"
+#include "GDSIIDecode.h"
+#include "MappedFile.h"
+#include "OASISParser.h"
+#include "ParallelFor.h"
 #include <algorithm>
 #include <stdexcept>
 #include <cstring>
 #include <cmath>
 #include <sstream>
+#include <map>
+#include <set>
 #include <Logging.h>
 
+namespace {
+
+std::string lowerExtension(const std::string& filename) {
+    std::string ext = filename.substr(filename.find_last_of('.') + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext;
+}
+
+// Outline of a GDSII PATH in database units. Round ends (PATHTYPE 1) are approximated by
+// half-width square ends; a negative WIDTH is absolute and only its magnitude matters here.
+Polygon gdsPathOutline(const std::vector<Point>& spine, int path_type, int32_t width, int32_t begin_extension,
+                       int32_t end_extension) {
+    double half_width = std::abs(static_cast<double>(width)) / 2.0;
+    double begin = 0.0, end = 0.0;
+    if (path_type == 1 || path_type == 2) {
+        begin = end = half_width;
+    } else if (path_type == 4) {
+        begin = begin_extension;
+        end = end_extension;
+    }
+    return pathOutline(spine, half_width, begin, end);
+}
+
+// Catalog view of one shape element, judged from its database-unit vertices the way
+// Polygon::isValid() judges the scaled polygon that a load would build
+struct ShapeMeasure {
+    bool valid = false;
+    size_t vertex_count = 0;
+    double doubled_area = 0.0;
+};
+
+template <typename PointAt>
+ShapeMeasure measureShape(size_t count, double unit_scale, PointAt point_at) {
+    ShapeMeasure measure;
+    if (count > 1 && point_at(0) == point_at(count - 1)) {
+        count--; // Closing point
+    }
+    measure.vertex_count = count;
+    if (count < 3) {
+        return measure;
+    }
+    const double THRESHOLD = 1e-10; // Polygon::isValid() thresholds, in user units
+    bool away_from_origin = false;
+    bool duplicate = false;
+    Point previous = point_at(count - 1);
+    for (size_t i = 0; i < count; ++i) {
+        Point p = point_at(i);
+        away_from_origin = away_from_origin || std::abs(p.x * unit_scale) > THRESHOLD ||
+                           std::abs(p.y * unit_scale) > THRESHOLD;
+        duplicate = duplicate || (std::abs((p.x - previous.x) * unit_scale) < THRESHOLD &&
+                                  std::abs((p.y - previous.y) * unit_scale) < THRESHOLD);
+        measure.doubled_area += previous.x * p.y - p.x * previous.y;
+        previous = p;
+    }
+    measure.valid = away_from_origin && !duplicate &&
+                    std::abs(measure.doubled_area) / 2.0 * unit_scale * unit_scale >= 1e-9;
+    return measure;
+}
+
+} // namespace
+
 LayoutFileReader::LayoutFileReader(const std::string& filename) : filename_(filename) {
     detectFileType();
 }
@@ -14,79 +82,416 @@ LayoutFileReader::FileType LayoutFileReader::getFileType() const {
     return file_type_;
 }
 
+void LayoutFileReader::setReaderThreads(int thread_count) {
+    reader_threads_ = std::max(thread_count, 1);
+}
+
+void LayoutFileReader::setKeepRepetitions(bool keep) {
+    keep_repetitions_ = keep;
+}
+
+void LayoutFileReader::setTopCell(const std::string& cell_name) {
+    LOG_FUNCTION();
+    top_cell_ = cell_name;
+    catalog_.clear();
+    catalog_loaded_ = false;
+    if (top_cell_.empty()) {
+        // The whole layout again: the cell table is rebuilt with the file's own top cells
+        hierarchy_.reset();
+        hierarchical_ = index_valid_ && index_.reference_count > 0;
+        return;
+    }
+    LOG_INFO("Loading only the geometry reachable from cell " + top_cell_ + " of " + filename_);
+    hierarchical_ = true; // Cells are only known from the structure scan
+    if (use_cache_) {
+        LOG_WARN("The layer cache holds whole-layout layers and is not used with a top cell");
+        use_cache_ = false;
+    }
+    if (hierarchy_) {
+        applyTopCell();
+    }
+}
+
+void LayoutFileReader::setUseCache(bool use_cache) {
+    LOG_FUNCTION();
+    if (use_cache && !top_cell_.empty()) {
+        LOG_WARN("The layer cache holds whole-layout layers and is not used with a top cell");
+        use_cache = false;
+    }
+    use_cache_ = use_cache;
+    if (use_cache_ && cache_.open(filename_) && !cache_.catalog().empty() && !catalog_loaded_) {
+        catalog_.clear();
+        for (const auto& [layer, dt] : cache_.catalog()) {
+            catalog_.addLayer(layer, dt);
+        }
+        catalog_loaded_ = true;
+    }
+}
+
+void LayoutFileReader::setUseIndex(bool use_index) {
+    LOG_FUNCTION();
+    use_index_ = use_index && file_type_ == GDSII;
+    index_valid_ = false;
+    if (use_index_ && index_.load(filename_)) {
+        index_valid_ = true;
+        if (!top_cell_.empty()) {
+            return; // The index describes the whole layout, not the top cell's subtree
+        }
+        // The index keeps the statistics of the pass that built it
+        catalog_.clear();
+        catalog_.unit_scale = index_.unit_scale;
+        catalog_.measured = true;
+        catalog_.hierarchical = index_.reference_count > 0;
+        for (const auto& entry : index_.entries()) {
+            LayerStatistics& stats = catalog_.addLayer(entry.layer_number, entry.datatype);
+            if (entry.ranges.empty()) continue;
+            stats.polygon_count = entry.polygon_count - entry.invalid_count;
+            stats.invalid_count = entry.invalid_count;
+            stats.vertex_count = entry.vertex_count;
+            stats.total_area = entry.total_area;
+            stats.bounds = {entry.min_x * index_.unit_scale, entry.min_y * index_.unit_scale,
+                            entry.max_x * index_.unit_scale, entry.max_y * index_.unit_scale};
+            stats.begin = entry.ranges.front().begin;
+            stats.end = entry.ranges.back().end;
+        }
+        catalog_loaded_ = true;
+        hierarchical_ = index_.reference_count > 0;
+    }
+}
+
 Layer LayoutFileReader::loadLayer(int layer_number, int datatype) {
+    LOG_FUNCTION();
+    std::vector<Layer> layers = loadLayers({{layer_number, datatype}});
+    return layers.front();
+}
+
+Layer LayoutFileReader::loadLayer(int layer_number, int datatype, const BoundingBox& roi) {
+    LOG_FUNCTION();
+    std::ostringstream oss;
+    oss << "Loading layer " << layer_number << ":" << datatype << " in window (" << roi.min_x << ", " << roi.min_y
+        << ") - (" << roi.max_x << ", " << roi.max_y << ") from " << filename_;
+    LOG_INFO(oss.str());
+    if (use_cache_) {
+        // The cache keeps every polygon's bounding box, so only the overlapping ones are copied
+        if (const LayerCacheView* view = cache_.find(layer_number, datatype)) {
+            Layer layer(layer_number, datatype, std::make_shared<PolygonArena>());
+            layer.bounds = BoundingBox::empty();
+            for (size_t i = 0; i < view->polygon_count; ++i) {
+                const BoundingBox& box = view->boxes[i];
+                if (!roi.overlaps(box.min_x, box.min_y, box.max_x, box.max_y)) continue;
+                Polygon poly;
+                poly.points.assign(view->points + view->offsets[i], view->points + view->offsets[i + 1]);
+                poly.restoreMeasures(view->areas[i], view->perimeters[i], box, view->flags[i]);
+                layer.polygons.push_back(std::move(poly));
+                layer.bounds.include(box);
+            }
+            oss.str("");
+            oss << "Loaded " << layer.polygons.size() << " cached polygons overlapping the window";
+            LOG_INFO(oss.str());
+            return layer;
+        }
+    }
+    if (file_type_ == GDSII && !hierarchical_) {
+        std::vector<Layer> layers{Layer(layer_number, datatype, std::make_shared<PolygonArena>())};
+        layers.front().bounds = BoundingBox::empty();
+        MappedFile file(filename_);
+        size_t reference_count = loadFlatGDSII(file, {{{layer_number, datatype}, 0}}, layers, &roi);
+        if (reference_count == 0) {
+            oss.str("");
+            oss << "Loaded " << layers.front().polygons.size() << " polygons overlapping the window";
+            LOG_INFO(oss.str());
+            return layers.front();
+        }
+        oss.str("");
+        oss << "Found " << reference_count << " SREF/AREF references, loading " << filename_ << " hierarchically";
+        LOG_INFO(oss.str());
+        hierarchical_ = true;
+    }
+    Layer layer = loadLayer(layer_number, datatype);
+    layer.keepOverlapping(roi);
+    oss.str("");
+    oss << "Kept " << layer.polygons.size() << " polygons overlapping the window";
+    LOG_INFO(oss.str());
+    return layer;
+}
+
+std::vector<Layer> LayoutFileReader::loadLayers(const std::vector<std::pair<int, int>>& layers_and_datatypes) {
     LOG_FUNCTION();
     std::ostringstream oss;
-    oss << "Loading layer " << layer_number << ":" << datatype << " from " << filename_;
+    oss << "Loading layers ";
+    for (const auto& [layer_number, datatype] : layers_and_datatypes) {
+        oss << layer_number << ":" << datatype << " ";
+    }
+    oss << "from " << filename_;
     LOG_INFO(oss.str());
-    Layer layer(layer_number, datatype);
+    return use_cache_ ? loadCachedLayers(layers_and_datatypes) : parseLayers(layers_and_datatypes);
+}
+
+std::vector<Layer> LayoutFileReader::loadCachedLayers(const std::vector<std::pair<int, int>>& requested) {
+    LOG_FUNCTION();
+    std::vector<std::pair<int, int>> missing;
+    for (const auto& key : requested) {
+        if (!cache_.find(key.first, key.second) && std::find(missing.begin(), missing.end(), key) == missing.end()) {
+            missing.push_back(key);
+        }
+    }
+    std::ostringstream oss;
+    oss << "Layer cache holds " << requested.size() - missing.size() << " of " << requested.size()
+        << " requested layers";
+    LOG_INFO(oss.str());
+
+    std::vector<Layer> parsed;
+    if (!missing.empty()) {
+        parsed = parseLayers(missing);
+        cache_.save(filename_, parsed, catalog_loaded_ ? catalog_.keys() : std::vector<std::pair<int, int>>());
+    }
+
+    std::vector<Layer> layers;
+    layers.reserve(requested.size());
+    for (const auto& key : requested) {
+        auto it = std::find_if(parsed.begin(), parsed.end(), [&](const Layer& layer) {
+            return layer.layer_number == key.first && layer.datatype == key.second;
+        });
+        if (it != parsed.end()) {
+            layers.push_back(*it);
+        } else if (const LayerCacheView* view = cache_.find(key.first, key.second)) {
+            layers.push_back(view->toLayer());
+        } else {
+            layers.emplace_back(key.first, key.second);
+        }
+    }
+    return layers;
+}
+
+std::vector<Layer> LayoutFileReader::parseLayers(const std::vector<std::pair<int, int>>& layers_and_datatypes) {
+    LOG_FUNCTION();
+    std::ostringstream oss;
+    std::vector<Layer> layers;
+    layers.reserve(layers_and_datatypes.size());
+    for (const auto& [layer_number, datatype] : layers_and_datatypes) {
+        // Each layer's polygons are allocated in, and freed with, an arena of its own. Its bounds
+        // grow as the polygons are added, while their boxes are still in cache.
+        layers.emplace_back(layer_number, datatype, std::make_shared<PolygonArena>());
+        layers.back().bounds = BoundingBox::empty();
+    }
     if (file_type_ == GDSII) {
-        loadGDSIILayer(layer_number, datatype, layer);
+        loadGDSIILayers(layers_and_datatypes, layers);
     } else if (file_type_ == OASIS) {
-        loadOASISLayer(layer_number, datatype, layer);
+        loadOASISLayers(layers_and_datatypes, layers);
     } else {
         oss.str("");
         oss << "Unsupported file format: " << filename_;
         throw std::runtime_error(oss.str());
     }
-    oss.str("");
-    oss << "Completed loading layer " << layer_number << ":" << datatype
-        << " with " << layer.polygons.size() << " polygons";
+    for (const auto& layer : layers) {
+        oss.str("");
+        oss << "Completed loading layer " << layer.layer_number << ":" << layer.datatype
+            << " with " << layer.polygons.size() << " polygons";
+        LOG_INFO(oss.str());
+    }
+    return layers;
+}
+
+void LayoutFileReader::forEachPolygon(int layer_number, int datatype, const std::function<void(const Polygon&)>& visitor) {
+    LOG_FUNCTION();
+    size_t count = 0;
+    streamLayers({{{layer_number, datatype}, 0}}, [&](size_t, const Polygon& polygon) {
+        visitor(polygon);
+        count++;
+    });
+    std::ostringstream oss;
+    oss << "Streamed " << count << " polygons from layer " << layer_number << ":" << datatype << " in file "
+        << filename_;
     LOG_INFO(oss.str());
-    return layer;
 }
 
-std::vector<std::pair<int, int>> LayoutFileReader::getAvailableLayersAndDatatypes() {
+std::vector<DbuLayer> LayoutFileReader::loadLayersDbu(const std::vector<std::pair<int, int>>& layers_and_datatypes) {
     LOG_FUNCTION();
-    std::vector<std::pair<int, int>> layers;
-    if (file_type_ == GDSII) {
-        std::ifstream file(filename_, std::ios::binary);
-        if (!file.is_open()) {
-            std::ostringstream oss;
-            oss << "Cannot open file: " << filename_;
-            throw std::runtime_error(oss.str());
-        }
-        int current_layer = -1;
-        while (!file.eof()) {
-            try {
-                uint16_t length = read_uint16(file);
-                if (length == 0) continue;
-                uint8_t record_type = read_uint8(file);
-                uint8_t data_type = read_uint8(file);
-                if (record_type == 0x0D && data_type == 0x02) { // LAYER
-                    if (length == 6) {
-                        current_layer = read_uint16(file);
-                    } else {
-                        file.ignore(length - 4);
-                    }
-                } else if (record_type == 0x0E && data_type == 0x02) { // DATATYPE
-                    if (length == 6) {
-                        int datatype = read_uint16(file);
-                        if (current_layer >= 0) {
-                            layers.emplace_back(current_layer, datatype);
-                        }
-                    } else {
-                        file.ignore(length - 4);
-                    }
-                } else {
-                    file.ignore(length - 4);
-                }
-            } catch (const std::runtime_error& e) {
-                break;
-            }
+    double unit_scale = getUnitScale();
+    std::vector<DbuLayer> layers;
+    std::map<std::pair<int, int>, size_t> slots;
+    for (size_t i = 0; i < layers_and_datatypes.size(); ++i) {
+        layers.emplace_back(layers_and_datatypes[i].first, layers_and_datatypes[i].second, unit_scale);
+        layers.back().bounds = DbuBox::empty();
+        slots.emplace(layers_and_datatypes[i], i);
+    }
+    // Decoded coordinates are whole database units times unit_scale, so dividing recovers them exactly
+    streamLayers(slots, [&](size_t slot, const Polygon& polygon) {
+        DbuPolygon dbu;
+        dbu.points.reserve(polygon.points.size());
+        dbu.bbox = DbuBox::empty();
+        for (const auto& p : polygon.points) {
+            dbu.points.emplace_back(static_cast<int32_t>(std::llround(p.x / unit_scale)),
+                                    static_cast<int32_t>(std::llround(p.y / unit_scale)));
+            dbu.bbox.include(dbu.points.back());
         }
-        std::sort(layers.begin(), layers.end());
-        layers.erase(std::unique(layers.begin(), layers.end()), layers.end());
-        std::ostringstream oss;
-        oss << "Available layers: ";
-        for (const auto& [layer, dt] : layers) {
-            oss << layer << ":" << dt << " ";
+        layers[slot].bounds.include(dbu.bbox);
+        layers[slot].polygons.push_back(std::move(dbu));
+    });
+
+    std::ostringstream oss;
+    for (size_t i = 0; i < layers.size(); ++i) {
+        size_t first = slots[layers_and_datatypes[i]];
+        if (first != i) {
+            layers[i].polygons = layers[first].polygons;
+            layers[i].bounds = layers[first].bounds;
         }
+        oss.str("");
+        oss << "Loaded " << layers[i].polygons.size() << " polygons in database units from layer "
+            << layers[i].layer_number << ":" << layers[i].datatype << " (unit " << unit_scale << ")";
         LOG_INFO(oss.str());
+    }
+    return layers;
+}
+
+std::vector<FlatLayer> LayoutFileReader::loadFlatLayers(const std::vector<std::pair<int, int>>& layers_and_datatypes) {
+    LOG_FUNCTION();
+    std::vector<FlatLayer> layers;
+    std::map<std::pair<int, int>, size_t> slots;
+    for (size_t i = 0; i < layers_and_datatypes.size(); ++i) {
+        const auto& [layer_number, datatype] = layers_and_datatypes[i];
+        layers.emplace_back(layer_number, datatype);
+        const LayerCacheView* view = use_cache_ ? cache_.find(layer_number, datatype) : nullptr;
+        if (view) {
+            FlatLayer& layer = layers.back();
+            layer.points.assign(view->points, view->points + view->point_count);
+            layer.offsets.assign(view->offsets, view->offsets + view->polygon_count + 1);
+            layer.areas.assign(view->areas, view->areas + view->polygon_count);
+            layer.perimeters.assign(view->perimeters, view->perimeters + view->polygon_count);
+            layer.boxes.assign(view->boxes, view->boxes + view->polygon_count);
+            layer.flags.assign(view->flags, view->flags + view->polygon_count);
+        } else {
+            slots.emplace(layers_and_datatypes[i], i);
+        }
+    }
+    if (!slots.empty()) {
+        streamLayers(slots, [&](size_t slot, const Polygon& polygon) { layers[slot].addPolygon(polygon); });
+    }
+
+    std::ostringstream oss;
+    for (size_t i = 0; i < layers.size(); ++i) {
+        auto slot = slots.find(layers_and_datatypes[i]);
+        if (slot != slots.end() && slot->second != i) {
+            layers[i] = layers[slot->second];
+        }
+        oss.str("");
+        oss << "Loaded " << layers[i].polygonCount() << " polygons (" << layers[i].points.size()
+            << " vertices) into the flat layout from layer " << layers[i].layer_number << ":" << layers[i].datatype;
+        LOG_INFO(oss.str());
+    }
+    return layers;
+}
+
+double LayoutFileReader::getUnitScale() {
+    LOG_FUNCTION();
+    if (hierarchy_) {
+        return hierarchy_->unit_scale;
+    }
+    if (index_valid_) {
+        return index_.unit_scale;
+    }
+    MappedFile file(filename_);
+    if (file_type_ == OASIS) {
+        return 1.0 / OASISParser::readUnit(file);
+    }
+    if (file_type_ != GDSII) {
+        throw std::runtime_error("Unsupported file format: " + filename_);
+    }
+    // UNITS precedes the first structure
+    GdsRecordScanner scanner(file);
+    GdsRecord record;
+    while (scanner.next(record) && record.record_type != GDS_BGNSTR) {
+        if (record.record_type == GDS_UNITS && record.data_type == GDS_REAL8 && record.length == 20) {
+            double scale = gdsReadReal8(record.payload + 8) / gdsReadReal8(record.payload);
+            if (!(std::abs(scale) < 1e-10 || std::isnan(scale) || std::isinf(scale))) {
+                return scale;
+            }
+        }
+    }
+    return 0.001; // Fallback (1 DBU = 0.001 um)
+}
+
+void LayoutFileReader::streamLayers(const std::map<std::pair<int, int>, size_t>& slots, const PolygonSink& sink) {
+    if (file_type_ == GDSII) {
+        MappedFile file(filename_);
+        if (!hierarchical_ && !catalog_loaded_) {
+            hierarchical_ = hasGDSIIReferences(file);
+        }
+        if (hierarchical_) {
+            decodeGDSIICells(file, slots);
+            hierarchy_->flatten(slots, sink);
+        } else {
+            streamFlatGDSII(file, slots, sink);
+        }
+    } else if (file_type_ == OASIS) {
+        // Every OASIS load parses the whole file, so reuse the cell table if it has the layers
+        std::vector<std::pair<int, int>> keys;
+        for (const auto& slot : slots) {
+            keys.push_back(slot.first);
+        }
+        if (!hierarchy_ || !hierarchy_->cellsToDecode({keys.begin(), keys.end()}).empty()) {
+            MappedFile file(filename_);
+            parseOASIS(file, keys);
+        }
+        hierarchy_->flatten(slots, sink);
+    } else {
+        throw std::runtime_error("Unsupported file format: " + filename_);
+    }
+}
+
+const LayoutHierarchy* LayoutFileReader::loadCellShapes(const std::vector<std::pair<int, int>>& layers_and_datatypes) {
+    LOG_FUNCTION();
+    std::set<std::pair<int, int>> keys(layers_and_datatypes.begin(), layers_and_datatypes.end());
+    if (file_type_ == GDSII) {
+        MappedFile file(filename_);
+        if (!hierarchical_ && !catalog_loaded_) {
+            hierarchical_ = hasGDSIIReferences(file);
+        }
+        if (!hierarchical_) {
+            return nullptr;
+        }
+        std::map<std::pair<int, int>, size_t> slots;
+        for (const auto& key : keys) {
+            slots.emplace(key, slots.size());
+        }
+        decodeGDSIICells(file, slots);
     } else if (file_type_ == OASIS) {
-        layers = {{1, 0}, {2, 0}, {3, 0}, {4, 0}, {5, 0}}; // Placeholder
+        if (!hierarchy_ || !hierarchy_->cellsToDecode(keys).empty()) {
+            MappedFile file(filename_);
+            parseOASIS(file, {keys.begin(), keys.end()});
+        }
+    } else {
+        throw std::runtime_error("Unsupported file format: " + filename_);
+    }
+    return hierarchy_.get();
+}
+
+void LayoutFileReader::loadCatalog() {
+    if (catalog_loaded_ || (file_type_ != GDSII && file_type_ != OASIS)) {
+        return;
+    }
+    std::vector<Layer> no_layers;
+    if (file_type_ == GDSII) {
+        loadGDSIILayers({}, no_layers); // Catalog-only pass
+    } else {
+        loadOASISLayers({}, no_layers);
+    }
+}
+
+const LayoutCatalog& LayoutFileReader::getCatalog() {
+    LOG_FUNCTION();
+    loadCatalog();
+    return catalog_;
+}
+
+std::vector<std::pair<int, int>> LayoutFileReader::getAvailableLayersAndDatatypes() {
+    LOG_FUNCTION();
+    std::vector<std::pair<int, int>> layers;
+    if (file_type_ == GDSII || file_type_ == OASIS) {
+        loadCatalog();
+        layers = catalog_.keys();
         std::ostringstream oss;
-        oss << "OASIS placeholder layers: ";
+        oss << "Available layers: ";
         for (const auto& [layer, dt] : layers) {
             oss << layer << ":" << dt << " ";
         }
@@ -97,339 +502,883 @@ std::vector<std::pair<int, int>> LayoutFileReader::getAvailableLayersAndDatatype
 
 void LayoutFileReader::detectFileType() {
     LOG_FUNCTION();
-    std::string ext = filename_.substr(filename_.find_last_of('.') + 1);
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    // Archived layouts keep their own extension in front of the compression suffix ("chip.gds.gz")
+    std::string name = filename_;
+    std::string ext = lowerExtension(name);
+    if (ext == "gz" || ext == "gzip" || ext == "zst" || ext == "zstd") {
+        name.erase(name.find_last_of('.'));
+        ext = lowerExtension(name);
+    }
     if (ext == "gds" || ext == "gdsii") {
         file_type_ = GDSII;
     } else if (ext == "oas" || ext == "oasis") {
         file_type_ = OASIS;
     } else {
-        file_type_ = UNKNOWN;
+        file_type_ = sniffFileType();
     }
+    MappedFile::Compression compression = MappedFile::detectCompression(filename_);
     std::ostringstream oss;
     oss << "Detected file type: " << (file_type_ == GDSII ? "GDSII" : file_type_ == OASIS ? "OASIS" : "UNKNOWN")
+        << (compression == MappedFile::GZIP ? " (gzip)" : compression == MappedFile::ZSTD ? " (zstd)" : "")
         << " for " << filename_;
     LOG_INFO(oss.str());
 }
 
-uint16_t LayoutFileReader::read_uint16(std::ifstream& file) {
-    uint8_t bytes[2];
-    file.read(reinterpret_cast<char*>(bytes), 2);
-    if (!file) {
-        throw std::runtime_error("Failed to read uint16 from file");
+LayoutFileReader::FileType LayoutFileReader::sniffFileType() const {
+    // Without a known extension, look at the first (decompressed) bytes: a GDSII HEADER
+    // record or the OASIS magic string
+    try {
+        MappedFile file(filename_);
+        size_t available = file.waitFor(OASIS_MAGIC_SIZE);
+        if (available >= OASIS_MAGIC_SIZE && std::memcmp(file.data(), OASIS_MAGIC, OASIS_MAGIC_SIZE) == 0) {
+            return OASIS;
+        }
+        if (available >= 4 && gdsReadUint16(file.data()) == 6 && file.data()[2] == GDS_HEADER &&
+            file.data()[3] == GDS_INT16) {
+            return GDSII;
+        }
+    } catch (const std::exception& e) {
+        LOG_WARN(std::string("Cannot inspect layout file: ") + e.what());
     }
-    return (bytes[0] << 8) | bytes[1];
+    return UNKNOWN;
 }
 
-uint8_t LayoutFileReader::read_uint8(std::ifstream& file) {
-    char byte;
-    file.read(&byte, 1);
-    if (!file) {
-        throw std::runtime_error("Failed to read uint8 from file");
+void LayoutFileReader::loadGDSIILayers(const std::vector<std::pair<int, int>>& requested, std::vector<Layer>& layers) {
+    LOG_FUNCTION();
+    MappedFile file(filename_);
+
+    // First slot of each requested layer:datatype; duplicate requests are copied after the pass
+    std::map<std::pair<int, int>, size_t> slots;
+    for (size_t i = 0; i < requested.size(); ++i) {
+        slots.emplace(requested[i], i);
     }
-    return static_cast<uint8_t>(byte);
-}
 
-int32_t LayoutFileReader::read_int32(std::ifstream& file) {
-    uint8_t bytes[4];
-    file.read(reinterpret_cast<char*>(bytes), 4);
-    if (!file) {
-        throw std::runtime_error("Failed to read int32 from file");
+    std::ostringstream oss;
+    oss << "Parsing GDSII file: " << filename_ << " for " << requested.size() << " layers";
+    LOG_INFO(oss.str());
+
+    // A catalog-only pass scans the records even when the file is known to be hierarchical, as
+    // streaming and loadCellShapes() find that out without measuring anything
+    if (!hierarchical_ || (slots.empty() && top_cell_.empty())) {
+        size_t reference_count = loadFlatGDSII(file, slots, layers);
+        if (reference_count > 0 && !hierarchical_) {
+            oss.str("");
+            oss << "Found " << reference_count << " SREF/AREF references, loading " << filename_ << " hierarchically";
+            LOG_INFO(oss.str());
+            hierarchical_ = true;
+            for (auto& layer : layers) {
+                layer.polygons.clear();
+                layer.bounds = BoundingBox::empty();
+            }
+        }
+    }
+    if (hierarchical_ && !slots.empty()) {
+        loadHierarchicalGDSII(file, slots, layers);
+    } else if (!top_cell_.empty()) {
+        buildGDSIICellTable(file); // Catalog of the top cell's subtree
+    }
+
+    for (size_t i = 0; i < requested.size(); ++i) {
+        size_t first = slots[requested[i]];
+        if (first != i) {
+            layers[i].polygons = layers[first].polygons;
+            layers[i].bounds = layers[first].bounds;
+        }
+        oss.str("");
+        oss << "Loaded " << layers[i].polygons.size() << " valid polygons from GDSII layer "
+            << requested[i].first << ":" << requested[i].second << " in file " << filename_;
+        LOG_INFO(oss.str());
+        if (layers[i].polygons.empty()) {
+            oss.str("");
+            oss << "No valid polygons found in layer " << requested[i].first << ":" << requested[i].second;
+            LOG_WARN(oss.str());
+        }
     }
-    return (static_cast<int32_t>(bytes[0]) << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
 }
 
-double LayoutFileReader::read_double(std::ifstream& file) {
-    uint8_t bytes[8];
-    file.read(reinterpret_cast<char*>(bytes), 8);
-    if (!file) {
-        throw std::runtime_error("Failed to read double from file");
+size_t LayoutFileReader::loadFlatGDSII(const MappedFile& file, const std::map<std::pair<int, int>, size_t>& slots,
+                                       std::vector<Layer>& layers, const BoundingBox* roi) {
+    LOG_FUNCTION();
+    if (index_valid_) {
+        // Read only the byte ranges of the requested layers; each task fills one layer
+        std::vector<std::pair<std::pair<int, int>, size_t>> tasks(slots.begin(), slots.end());
+        parallelFor(tasks.size(), reader_threads_, [&](size_t t) {
+            const auto& [key, slot] = tasks[t];
+            const LayoutIndexEntry* entry = index_.find(key.first, key.second);
+            if (!entry) return;
+            double unit_scale = index_.unit_scale;
+            size_t range_count = 0;
+            for (const auto& range : entry->ranges) {
+                if (roi && !roi->overlaps(range.min_x * unit_scale, range.min_y * unit_scale,
+                                          range.max_x * unit_scale, range.max_y * unit_scale)) {
+                    continue;
+                }
+                parseGDSIIRecords(file, range.begin, range.end, slots, layers, unit_scale, nullptr, nullptr, roi);
+                range_count++;
+            }
+            std::ostringstream msg;
+            msg << "Read " << range_count << " of " << entry->ranges.size() << " indexed ranges for layer "
+                << key.first << ":" << key.second;
+            LOG_DEBUG(msg.str());
+        });
+        return 0;
     }
-    uint8_t sign_exp = bytes[0];
-    bool negative = sign_exp & 0x80;
-    int exponent = (sign_exp & 0x7F) - 64;
-    uint64_t mantissa = 0;
-    for (int i = 1; i < 8; ++i) {
-        mantissa = (mantissa << 8) | bytes[i];
+
+    double unit_scale = 0.001; // Fallback (1 DBU = 0.001 um)
+    GDSIIScan scan;
+    if (reader_threads_ > 1) {
+        std::vector<std::pair<size_t, size_t>> chunks =
+            partitionGDSII(file, static_cast<size_t>(reader_threads_) * 4, unit_scale);
+        std::ostringstream oss;
+        oss << "Parsing " << chunks.size() << " chunks on " << reader_threads_ << " threads";
+        LOG_INFO(oss.str());
+
+        // Per-chunk buffers, merged below in file order so the result does not depend on scheduling.
+        // Arenas are single-threaded and polygons cannot move between memory resources without a
+        // copy, so this path parses onto the heap and the merged layers are heap-backed too.
+        std::vector<std::vector<Layer>> chunk_layers(chunks.size());
+        for (auto& chunk : chunk_layers) {
+            for (const auto& layer : layers) {
+                chunk.emplace_back(layer.layer_number, layer.datatype);
+                chunk.back().bounds = BoundingBox::empty();
+            }
+        }
+        std::vector<GDSIIScan> chunk_scans(chunks.size());
+        std::vector<LayoutIndex> chunk_indexes(use_index_ ? chunks.size() : 0);
+        for (size_t c = 0; c < chunk_indexes.size(); ++c) {
+            chunk_scans[c].index = &chunk_indexes[c];
+        }
+        parallelFor(chunks.size(), reader_threads_, [&](size_t c) {
+            double chunk_scale = unit_scale;
+            parseGDSIIRecords(file, chunks[c].first, chunks[c].second, slots, chunk_layers[c], chunk_scale,
+                              &chunk_scans[c], nullptr, roi);
+        });
+
+        std::vector<Layer> merged;
+        merged.reserve(layers.size());
+        for (const auto& layer : layers) {
+            merged.emplace_back(layer.layer_number, layer.datatype);
+            merged.back().bounds = layer.bounds;
+        }
+        for (const auto& [key, slot] : slots) {
+            size_t polygon_count = merged[slot].polygons.size();
+            for (const auto& chunk : chunk_layers) {
+                polygon_count += chunk[slot].polygons.size();
+            }
+            merged[slot].polygons.reserve(polygon_count);
+        }
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            for (const auto& [key, slot] : slots) {
+                // Same memory resource on both sides, so only the point buffers' pointers move
+                auto& source = chunk_layers[c][slot].polygons;
+                auto& target = merged[slot].polygons;
+                target.insert(target.end(), std::make_move_iterator(source.begin()),
+                              std::make_move_iterator(source.end()));
+                merged[slot].bounds.include(chunk_layers[c][slot].bounds);
+            }
+            chunk_layers[c].clear();
+            scan.catalog.merge(chunk_scans[c].catalog);
+            scan.reference_count += chunk_scans[c].reference_count;
+        }
+        layers.swap(merged);
+        if (use_index_) {
+            index_.clear();
+            for (const auto& chunk_index : chunk_indexes) {
+                index_.merge(chunk_index);
+            }
+        }
+    } else {
+        if (use_index_) {
+            index_.clear();
+            scan.index = &index_;
+        }
+        parseGDSIIRecords(file, 0, SIZE_MAX, slots, layers, unit_scale, &scan, nullptr, roi);
     }
-    double value = static_cast<double>(mantissa) / (1ULL << 56) * std::pow(16.0, exponent);
-    return negative ? -value : value;
+
+    catalog_ = std::move(scan.catalog);
+    catalog_.unit_scale = unit_scale;
+    catalog_.measured = true;
+    catalog_.hierarchical = scan.reference_count > 0;
+    catalog_loaded_ = true;
+    if (use_index_) {
+        // Persist the shape statistics with the index, so a later run has the catalog without a pass
+        for (const auto& stats : catalog_.layers()) {
+            if (LayoutIndexEntry* entry = index_.find(stats.layer_number, stats.datatype)) {
+                entry->invalid_count = stats.invalid_count;
+                entry->vertex_count = stats.vertex_count;
+                entry->total_area = stats.total_area;
+            }
+        }
+        index_.unit_scale = unit_scale;
+        index_.reference_count = scan.reference_count;
+        index_valid_ = index_.save(filename_);
+    }
+    return scan.reference_count;
 }
 
-std::string LayoutFileReader::read_string(std::ifstream& file, uint16_t length) {
-    std::string str(length, '\0');
-    file.read(&str[0], length);
-    if (!file) {
-        throw std::runtime_error("Failed to read string from file");
+void LayoutFileReader::streamFlatGDSII(const MappedFile& file, const std::map<std::pair<int, int>, size_t>& slots,
+                                       const PolygonSink& sink) {
+    LOG_FUNCTION();
+    // Sequential, so polygons arrive in file order
+    std::vector<Layer> no_layers;
+    if (index_valid_) {
+        double unit_scale = index_.unit_scale;
+        for (const auto& [key, slot] : slots) {
+            const LayoutIndexEntry* entry = index_.find(key.first, key.second);
+            if (!entry) continue;
+            for (const auto& range : entry->ranges) {
+                parseGDSIIRecords(file, range.begin, range.end, slots, no_layers, unit_scale, nullptr, &sink);
+            }
+        }
+        return;
     }
-    str.erase(std::find(str.begin(), str.end(), '\0'), str.end());
-    return str;
+    double unit_scale = 0.001; // Fallback (1 DBU = 0.001 um)
+    GDSIIScan scan;
+    parseGDSIIRecords(file, 0, SIZE_MAX, slots, no_layers, unit_scale, &scan, &sink);
+    catalog_ = std::move(scan.catalog);
+    catalog_.unit_scale = unit_scale;
+    catalog_.measured = true;
+    catalog_.hierarchical = scan.reference_count > 0;
+    catalog_loaded_ = true;
 }
 
-uint64_t LayoutFileReader::read_unsigned_int(std::ifstream& file) {
-    uint64_t value = 0;
-    uint8_t byte = read_uint8(file);
-    value = byte & 0x7F;
-    while (byte & 0x80) {
-        byte = read_uint8(file);
-        value = (value << 7) | (byte & 0x7F);
+bool LayoutFileReader::hasGDSIIReferences(const MappedFile& file) const {
+    GdsRecordScanner scanner(file);
+    GdsRecord record;
+    while (scanner.next(record)) {
+        if (record.record_type == GDS_SREF || record.record_type == GDS_AREF) {
+            return true;
+        }
     }
-    return value;
+    return false;
 }
 
-int64_t LayoutFileReader::read_signed_int(std::ifstream& file) {
-    uint64_t u = read_unsigned_int(file);
-    bool negative = u & 1;
-    u >>= 1;
-    return negative ? -static_cast<int64_t>(u) : static_cast<int64_t>(u);
+void LayoutFileReader::loadHierarchicalGDSII(const MappedFile& file,
+                                             const std::map<std::pair<int, int>, size_t>& slots,
+                                             std::vector<Layer>& layers) {
+    LOG_FUNCTION();
+    decodeGDSIICells(file, slots);
+    hierarchy_->flatten(slots, layers);
 }
 
-void LayoutFileReader::loadGDSIILayer(int layer_number, int datatype, Layer& layer) {
+void LayoutFileReader::decodeGDSIICells(const MappedFile& file, const std::map<std::pair<int, int>, size_t>& slots) {
     LOG_FUNCTION();
-    std::ifstream file(filename_, std::ios::binary);
-    if (!file.is_open()) {
-        std::ostringstream oss;
-        oss << "Cannot open file: " << filename_;
-        throw std::runtime_error(oss.str());
+    buildGDSIICellTable(file);
+
+    // Decode each cell once per layer, in cell-local database units; later loads reuse the cache
+    std::set<std::pair<int, int>> keys;
+    for (const auto& slot : slots) {
+        keys.insert(slot.first);
+    }
+    std::vector<int> cells = hierarchy_->cellsToDecode(keys);
+    std::ostringstream oss;
+    oss << "Decoding " << cells.size() << " of " << hierarchy_->cellCount() << " cells";
+    LOG_INFO(oss.str());
+
+    parallelFor(cells.size(), reader_threads_, [&](size_t c) {
+        Cell& cell = hierarchy_->cell(cells[c]);
+        std::map<std::pair<int, int>, size_t> cell_slots;
+        std::vector<Layer> cell_layers;
+        for (const auto& key : keys) {
+            if (cell.layers.count(key) && !cell.decoded_layers.count(key)) {
+                cell_slots.emplace(key, cell_layers.size());
+                cell_layers.emplace_back(key.first, key.second);
+            }
+        }
+        double dbu_scale = 1.0;
+        parseGDSIIRecords(file, cell.begin, cell.end, cell_slots, cell_layers, dbu_scale, nullptr);
+        for (const auto& [key, slot] : cell_slots) {
+            cell.shapes[key] = std::move(cell_layers[slot].polygons);
+            cell.decoded_layers.insert(key);
+        }
+    });
+}
+
+void LayoutFileReader::buildGDSIICellTable(const MappedFile& file) {
+    if (!hierarchy_) {
+        hierarchy_ = buildGDSIIHierarchy(file);
+        applyTopCell();
     }
+}
 
-    double unit_scale = 0.001; // Fallback (1 DBU = 0.001 um)
-    bool in_boundary = false;
-    int current_layer = -1;
-    int current_datatype = -1;
-    Polygon poly;
+void LayoutFileReader::applyTopCell() {
+    if (top_cell_.empty()) {
+        return;
+    }
+    if (!hierarchy_->selectTopCell(top_cell_)) {
+        throw std::runtime_error("Top cell " + top_cell_ + " not found in " + filename_);
+    }
+    int top = hierarchy_->topCells().front();
+    catalog_.clear();
+    catalog_.unit_scale = hierarchy_->unit_scale;
+    catalog_.hierarchical = true;
+    for (const auto& [layer, dt] : hierarchy_->subtreeLayers(top)) {
+        catalog_.addLayer(layer, dt);
+    }
+    catalog_loaded_ = true;
 
+    const Cell& cell = hierarchy_->cell(top);
+    BoundingBox bounds = hierarchy_->subtreeBounds(top);
     std::ostringstream oss;
-    oss << "Parsing GDSII file: " << filename_ << " for layer " << layer_number
-        << ":" << datatype;
+    oss << "Top cell " << top_cell_ << ": " << hierarchy_->reachableCells().size() << " of "
+        << hierarchy_->cellCount() << " cells reachable, " << catalog_.layers().size() << " layers, bytes "
+        << cell.begin << "-" << cell.end;
+    if (bounds.min_x <= bounds.max_x) {
+        double scale = hierarchy_->unit_scale;
+        oss << ", bounds (" << bounds.min_x * scale << ", " << bounds.min_y * scale << ") - ("
+            << bounds.max_x * scale << ", " << bounds.max_y * scale << ")";
+    }
     LOG_INFO(oss.str());
+}
 
-    while (!file.eof()) {
-        try {
-            uint16_t length = read_uint16(file);
-            if (length == 0) continue;
-            uint8_t record_type = read_uint8(file);
-            uint8_t data_type = read_uint8(file);
-
-            switch (record_type) {
-                case 0x03: // UNITS
-                    if (data_type == 0x05 && length == 20) {
-                        double user_unit = read_double(file);
-                        double db_unit = read_double(file);
-                        unit_scale = db_unit / user_unit;
-                        if (std::abs(unit_scale) < 1e-10 || std::isnan(unit_scale) || std::isinf(unit_scale)) {
-                            oss.str("");
-                            oss << "Invalid unit_scale " << unit_scale
-                                << " (user_unit=" << user_unit << ", db_unit=" << db_unit
-                                << "), using fallback 0.001";
-                            LOG_WARN(oss.str());
-                            unit_scale = 0.001;
-                        }
-                        oss.str("");
-                        oss << "UNITS: user_unit=" << user_unit << ", db_unit=" << db_unit
-                            << ", unit_scale=" << unit_scale;
-                        LOG_INFO(oss.str());
-                    } else {
-                        file.ignore(length - 4);
+const LayoutHierarchy& LayoutFileReader::getCellTable() {
+    LOG_FUNCTION();
+    if (!hierarchy_) {
+        MappedFile file(filename_);
+        if (file_type_ == GDSII) {
+            buildGDSIICellTable(file);
+        } else if (file_type_ == OASIS) {
+            parseOASIS(file, {});
+        } else {
+            throw std::runtime_error("Unsupported file format: " + filename_);
+        }
+    }
+    return *hierarchy_;
+}
+
+std::unique_ptr<LayoutHierarchy> LayoutFileReader::buildGDSIIHierarchy(const MappedFile& file) {
+    LOG_FUNCTION();
+    auto hierarchy = std::make_unique<LayoutHierarchy>();
+    int current_cell = -1;
+    int current_layer = -1;
+    size_t structure_begin = 0;
+    bool in_reference = false;
+    bool is_array = false;
+    bool mirror_x = false;
+    double magnification = 1.0;
+    double angle = 0.0;
+    CellReference reference;
+    std::vector<Point> placement;
+    bool in_shape = false;     // Inside a BOUNDARY, PATH or BOX
+    double shape_margin = 0.0; // Widening of a path's spine box by its width and extensions
+    std::vector<int32_t> coordinates;
+    std::ostringstream oss;
+
+    GdsRecordScanner scanner(file);
+    GdsRecord record;
+    while (scanner.next(record)) {
+        switch (record.record_type) {
+            case GDS_UNITS:
+                if (record.data_type == GDS_REAL8 && record.length == 20) {
+                    double scale = gdsReadReal8(record.payload + 8) / gdsReadReal8(record.payload);
+                    if (!(std::abs(scale) < 1e-10 || std::isnan(scale) || std::isinf(scale))) {
+                        hierarchy->unit_scale = scale;
                     }
-                    break;
-                case 0x08: // BOUNDARY
-                    in_boundary = true;
-                    poly = Polygon();
-                    break;
-                case 0x0D: // LAYER
-                    if (data_type == 0x02 && length == 6) {
-                        current_layer = read_uint16(file);
-                    } else {
-                        file.ignore(length - 4);
+                }
+                break;
+            case GDS_BGNSTR:
+                structure_begin = record.offset;
+                break;
+            case GDS_STRNAME: {
+                std::string name(reinterpret_cast<const char*>(record.payload), record.payload_size());
+                name.erase(std::find(name.begin(), name.end(), '\0'), name.end());
+                current_cell = hierarchy->addCell(name);
+                hierarchy->cell(current_cell).begin = structure_begin;
+                break;
+            }
+            case GDS_ENDSTR:
+                if (current_cell >= 0) {
+                    hierarchy->cell(current_cell).end = record.offset + record.length;
+                }
+                current_cell = -1;
+                break;
+            case GDS_BOUNDARY:
+            case GDS_PATH:
+            case GDS_BOX:
+                in_shape = true;
+                shape_margin = 0.0;
+                break;
+            case GDS_WIDTH:
+            case GDS_BGNEXTN:
+            case GDS_ENDEXTN:
+                // Conservative: the full width covers the half width plus a square end extension
+                if (in_shape && record.data_type == GDS_INT32 && record.length == 8) {
+                    shape_margin += std::abs(static_cast<double>(gdsReadInt32(record.payload)));
+                }
+                break;
+            case GDS_SREF:
+            case GDS_AREF:
+                in_reference = true;
+                is_array = record.record_type == GDS_AREF;
+                reference = CellReference();
+                mirror_x = false;
+                magnification = 1.0;
+                angle = 0.0;
+                placement.clear();
+                break;
+            case GDS_SNAME:
+                if (in_reference) {
+                    reference.cell_name.assign(reinterpret_cast<const char*>(record.payload), record.payload_size());
+                    reference.cell_name.erase(std::find(reference.cell_name.begin(), reference.cell_name.end(), '\0'),
+                                              reference.cell_name.end());
+                }
+                break;
+            case GDS_STRANS:
+                if (in_reference && record.payload_size() >= 2) {
+                    uint16_t flags = gdsReadUint16(record.payload);
+                    mirror_x = (flags & 0x8000) != 0;
+                    if (flags & 0x0006) {
+                        LOG_WARN("Absolute magnification/angle in reference to " + reference.cell_name +
+                                 " treated as relative");
                     }
-                    break;
-                case 0x0E: // DATATYPE
-                    if (data_type == 0x02 && length == 6) {
-                        current_datatype = read_uint16(file);
-                    } else {
-                        file.ignore(length - 4);
+                }
+                break;
+            case GDS_MAG:
+                if (in_reference && record.data_type == GDS_REAL8 && record.payload_size() >= 8) {
+                    magnification = gdsReadReal8(record.payload);
+                }
+                break;
+            case GDS_ANGLE:
+                if (in_reference && record.data_type == GDS_REAL8 && record.payload_size() >= 8) {
+                    angle = gdsReadReal8(record.payload);
+                }
+                break;
+            case GDS_COLROW:
+                if (in_reference && record.payload_size() >= 4) {
+                    reference.columns = std::max<int>(gdsReadUint16(record.payload), 1);
+                    reference.rows = std::max<int>(gdsReadUint16(record.payload + 2), 1);
+                }
+                break;
+            case GDS_XY:
+                if (in_reference && record.data_type == GDS_INT32) {
+                    for (size_t i = 0; i + 8 <= record.payload_size(); i += 8) {
+                        placement.emplace_back(gdsReadInt32(record.payload + i), gdsReadInt32(record.payload + i + 4));
                     }
-                    break;
-                case 0x10: // XY
-                    if (in_boundary && data_type == 0x03) {
-                        int num_points = (length - 4) / 8;
-                        poly.points.clear();
-                        oss.str("");
-                        oss << "Raw coordinates: ";
-                        for (int i = 0; i < num_points; i++) {
-                            int32_t x = read_int32(file);
-                            int32_t y = read_int32(file);
-                            double scaled_x = x * unit_scale;
-                            double scaled_y = y * unit_scale;
-                            poly.points.emplace_back(scaled_x, scaled_y);
-                            oss << "[" << x << "," << y << "] ";
-                        }
-                        LOG_DEBUG(oss.str());
+                } else if (in_shape && current_cell >= 0 && record.data_type == GDS_INT32 &&
+                           record.payload_size() >= 8) {
+                    size_t num_points = record.payload_size() / 8;
+                    coordinates.resize(2 * num_points);
+                    gdsDecodeXY(record.payload, num_points, coordinates.data());
+                    BoundingBox& bounds = hierarchy->cell(current_cell).bounds;
+                    for (size_t i = 0; i < num_points; ++i) {
+                        bounds.min_x = std::min(bounds.min_x, coordinates[2 * i] - shape_margin);
+                        bounds.min_y = std::min(bounds.min_y, coordinates[2 * i + 1] - shape_margin);
+                        bounds.max_x = std::max(bounds.max_x, coordinates[2 * i] + shape_margin);
+                        bounds.max_y = std::max(bounds.max_y, coordinates[2 * i + 1] + shape_margin);
+                    }
+                }
+                break;
+            case GDS_LAYER:
+                if (record.data_type == GDS_INT16 && record.length == 6) {
+                    current_layer = gdsReadUint16(record.payload);
+                }
+                break;
+            case GDS_DATATYPE:
+            case GDS_BOXTYPE:
+                if (current_cell >= 0 && current_layer >= 0 && record.data_type == GDS_INT16 && record.length == 6) {
+                    hierarchy->cell(current_cell).layers.emplace(current_layer, gdsReadUint16(record.payload));
+                }
+                break;
+            case GDS_ENDEL:
+                if (in_reference && current_cell >= 0) {
+                    if (placement.empty() || (is_array && placement.size() < 3)) {
                         oss.str("");
-                        oss << "Scaled coordinates: ";
-                        for (const auto& p : poly.points) {
-                            oss << "[" << p.x << "," << p.y << "] ";
-                        }
-                        LOG_DEBUG(oss.str());
-                        if (poly.points.size() > 1 && poly.points.front() == poly.points.back()) {
-                            poly.points.pop_back();
-                        }
+                        oss << "Skipping reference to " << reference.cell_name << " without placement at offset "
+                            << record.offset;
+                        LOG_WARN(oss.str());
                     } else {
-                        file.ignore(length - 4);
-                    }
-                    break;
-                case 0x11: // ENDEL
-                    if (in_boundary) {
-                        if (current_layer == layer_number && current_datatype == datatype) {
-                            poly.calculateArea();
-                            poly.calculatePerimeter();
-                            if (poly.isValid()) {
-                                layer.polygons.push_back(poly);
-                                oss.str("");
-                                oss << "Added valid polygon to layer " << layer_number
-                                    << ":" << datatype << ", area=" << poly.area
-                                    << ", points=" << poly.points.size();
-                                LOG_DEBUG(oss.str());
-                            } else {
-                                oss.str("");
-                                oss << "Discarded invalid polygon in layer " << layer_number
-                                    << ":" << datatype << ", points=" << poly.points.size()
-                                    << ", area=" << poly.area;
-                                LOG_DEBUG(oss.str());
-                                oss.str("");
-                                oss << "Discarded polygon coordinates: ";
-                                for (const auto& p : poly.points) {
-                                    oss << "[" << p.x << "," << p.y << "] ";
-                                }
-                                LOG_DEBUG(oss.str());
-                            }
+                        const Point& origin = placement[0];
+                        reference.transform =
+                            CellTransform::fromPlacement(origin.x, origin.y, angle, magnification, mirror_x);
+                        if (is_array) {
+                            reference.column_step = Point((placement[1].x - origin.x) / reference.columns,
+                                                          (placement[1].y - origin.y) / reference.columns);
+                            reference.row_step = Point((placement[2].x - origin.x) / reference.rows,
+                                                       (placement[2].y - origin.y) / reference.rows);
+                        } else {
+                            reference.columns = reference.rows = 1;
                         }
-                        in_boundary = false;
+                        hierarchy->cell(current_cell).references.push_back(reference);
                     }
-                    break;
-                default:
-                    file.ignore(length - 4);
-                    break;
-            }
-        } catch (const std::runtime_error& e) {
-            if (file.eof()) {
+                }
+                in_reference = false;
+                in_shape = false;
+                break;
+            default:
                 break;
-            }
-            oss.str("");
-            oss << "Error during parsing: " << e.what();
-            LOG_ERROR(oss.str());
-            break;
         }
     }
-
-    oss.str("");
-    oss << "Loaded " << layer.polygons.size() << " valid polygons from GDSII layer "
-        << layer_number << ":" << datatype << " in file " << filename_;
-    LOG_INFO(oss.str());
-    if (layer.polygons.empty()) {
+    if (scanner.truncated()) {
         oss.str("");
-        oss << "No valid polygons found in layer " << layer_number << ":" << datatype;
-        LOG_WARN(oss.str());
+        oss << "Error during parsing: malformed or truncated record at offset " << scanner.offset();
+        LOG_ERROR(oss.str());
     }
+    hierarchy->resolveReferences();
+    return hierarchy;
 }
 
-void LayoutFileReader::loadOASISLayer(int layer_number, int datatype, Layer& layer) {
+std::vector<std::pair<size_t, size_t>> LayoutFileReader::partitionGDSII(const MappedFile& file, size_t chunk_count,
+                                                                        double& unit_scale) {
     LOG_FUNCTION();
-    std::ifstream file(filename_, std::ios::binary);
-    if (!file.is_open()) {
-        std::ostringstream oss;
-        oss << "Cannot open file: " << filename_;
-        throw std::runtime_error(oss.str());
+    // Pre-scan: follow record lengths only and cut the file into roughly equal chunks.
+    // Cuts are placed at a BGNSTR when one follows the target offset closely, otherwise at
+    // the next element start, so every chunk begins outside of any element.
+    std::vector<std::pair<size_t, size_t>> chunks;
+    size_t target = std::max<size_t>(file.size() / std::max<size_t>(chunk_count, 1), 1);
+    size_t slack = target / 4;
+    size_t chunk_begin = 0;
+    size_t next_cut = target;
+
+    GdsRecordScanner scanner(file.data(), file.size());
+    GdsRecord record;
+    while (scanner.next(record)) {
+        if (record.record_type == GDS_UNITS && record.data_type == GDS_REAL8 && record.length == 20) {
+            double user_unit = gdsReadReal8(record.payload);
+            double db_unit = gdsReadReal8(record.payload + 8);
+            double scale = db_unit / user_unit;
+            if (!(std::abs(scale) < 1e-10 || std::isnan(scale) || std::isinf(scale))) {
+                unit_scale = scale;
+            }
+            continue;
+        }
+        if (record.offset < next_cut) continue;
+        bool structure_start = record.record_type == GDS_BGNSTR;
+        bool element_start = record.record_type == GDS_BOUNDARY || record.record_type == GDS_PATH ||
+                             record.record_type == GDS_SREF || record.record_type == GDS_AREF ||
+                             record.record_type == GDS_TEXT || record.record_type == GDS_NODE ||
+                             record.record_type == GDS_BOX;
+        if (structure_start || (element_start && record.offset >= next_cut + slack)) {
+            chunks.emplace_back(chunk_begin, record.offset);
+            chunk_begin = record.offset;
+            next_cut = record.offset + target;
+        }
     }
+    chunks.emplace_back(chunk_begin, file.size());
 
+    std::ostringstream oss;
+    oss << "Partitioned " << file.size() << " bytes into " << chunks.size() << " chunks";
+    LOG_DEBUG(oss.str());
+    return chunks;
+}
+
+void LayoutFileReader::parseGDSIIRecords(const MappedFile& file, size_t begin, size_t end,
+                                         const std::map<std::pair<int, int>, size_t>& slots,
+                                         std::vector<Layer>& layers, double& unit_scale, GDSIIScan* scan,
+                                         const PolygonSink* sink, const BoundingBox* roi) {
+    const bool debug_logging = Logger::getInstance().isLoggingEnabled() &&
+                               Logger::getInstance().getLogLevel() >= LogLevel::LOG_DEBUG;
+    uint16_t shape_element = 0; // GDS_BOUNDARY, GDS_PATH or GDS_BOX while inside one
+    bool element_has_datatype = false;
+    bool outside_roi = false;
+    int path_type = 0;
+    int32_t path_width = 0, begin_extension = 0, end_extension = 0;
+    std::vector<Point> points; // XY of the current shape element: user units, database units for paths
+    std::vector<int32_t> coordinates; // Decoded XY in database units, when the catalog or a window needs them
+    size_t element_begin = 0;
     int current_layer = -1;
     int current_datatype = -1;
-
-    uint8_t record_type = read_uint8(file);
-    if (record_type != 1) {
-        throw std::runtime_error("Missing START record in OASIS file");
+    int32_t min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+    ShapeMeasure measure; // Of the current shape element, for the catalog
+    LayoutIndex* index = scan ? scan->index : nullptr;
+    if (scan) {
+        scan->catalog.unit_scale = unit_scale;
     }
-    uint64_t start_length = read_unsigned_int(file);
-    file.ignore(start_length);
-
+    Polygon poly;
     std::ostringstream oss;
-    while (file.good()) {
-        record_type = read_uint8(file);
-        switch (record_type) {
-            case 19: { // LAYER
-                current_layer = static_cast<int>(read_unsigned_int(file));
-                current_datatype = static_cast<int>(read_unsigned_int(file));
-                oss.str("");
-                oss << "OASIS LAYER: " << current_layer << ", DATATYPE: " << current_datatype;
-                LOG_INFO(oss.str());
-                break;
-            }
-            case 23: { // POLYGON
-                if (current_layer == layer_number && current_datatype == datatype) {
-                    Polygon poly;
-                    uint64_t point_count = read_unsigned_int(file);
+
+    GdsRecordScanner scanner(file, begin, end);
+    GdsRecord record;
+    while (scanner.next(record)) {
+        switch (record.record_type) {
+            case GDS_UNITS:
+                if (record.data_type == GDS_REAL8 && record.length == 20) {
+                    double user_unit = gdsReadReal8(record.payload);
+                    double db_unit = gdsReadReal8(record.payload + 8);
+                    unit_scale = db_unit / user_unit;
+                    if (std::abs(unit_scale) < 1e-10 || std::isnan(unit_scale) || std::isinf(unit_scale)) {
+                        oss.str("");
+                        oss << "Invalid unit_scale " << unit_scale
+                            << " (user_unit=" << user_unit << ", db_unit=" << db_unit
+                            << "), using fallback 0.001";
+                        LOG_WARN(oss.str());
+                        unit_scale = 0.001;
+                    }
                     oss.str("");
-                    oss << "OASIS POLYGON: " << point_count << " points";
+                    oss << "UNITS: user_unit=" << user_unit << ", db_unit=" << db_unit
+                        << ", unit_scale=" << unit_scale;
                     LOG_INFO(oss.str());
-                    bool has_valid_point = false;
-                    for (uint64_t i = 0; i < point_count; i++) {
-                        int64_t x = read_signed_int(file);
-                        int64_t y = read_signed_int(file);
-                        double scaled_x = static_cast<double>(x);
-                        double scaled_y = static_cast<double>(y);
-                        if (std::abs(scaled_x) > 1e-6 && std::abs(scaled_y) > 1e-6) {
-                            has_valid_point = true;
+                    if (scan) {
+                        scan->catalog.unit_scale = unit_scale;
+                    }
+                }
+                break;
+            case GDS_BOUNDARY:
+            case GDS_PATH:
+            case GDS_BOX:
+                shape_element = record.record_type;
+                points.clear();
+                path_type = 0;
+                path_width = begin_extension = end_extension = 0;
+                element_begin = record.offset;
+                element_has_datatype = false;
+                outside_roi = false;
+                measure = ShapeMeasure();
+                break;
+            case GDS_SREF:
+            case GDS_AREF:
+                if (scan) {
+                    scan->reference_count++;
+                }
+                [[fallthrough]];
+            case GDS_TEXT:
+            case GDS_NODE:
+                element_begin = record.offset;
+                element_has_datatype = false;
+                break;
+            case GDS_LAYER:
+                if (record.data_type == GDS_INT16 && record.length == 6) {
+                    current_layer = gdsReadUint16(record.payload);
+                }
+                break;
+            case GDS_DATATYPE:
+            case GDS_BOXTYPE:
+                if (record.data_type == GDS_INT16 && record.length == 6) {
+                    current_datatype = gdsReadUint16(record.payload);
+                    element_has_datatype = true;
+                    if (scan && current_layer >= 0) {
+                        scan->catalog.addLayer(current_layer, current_datatype);
+                    }
+                }
+                break;
+            case GDS_PATHTYPE:
+                if (shape_element == GDS_PATH && record.data_type == GDS_INT16 && record.length == 6) {
+                    path_type = gdsReadUint16(record.payload);
+                }
+                break;
+            case GDS_WIDTH:
+                if (shape_element == GDS_PATH && record.data_type == GDS_INT32 && record.length == 8) {
+                    path_width = gdsReadInt32(record.payload);
+                }
+                break;
+            case GDS_BGNEXTN:
+                if (shape_element == GDS_PATH && record.data_type == GDS_INT32 && record.length == 8) {
+                    begin_extension = gdsReadInt32(record.payload);
+                }
+                break;
+            case GDS_ENDEXTN:
+                if (shape_element == GDS_PATH && record.data_type == GDS_INT32 && record.length == 8) {
+                    end_extension = gdsReadInt32(record.payload);
+                }
+                break;
+            case GDS_XY:
+                if (shape_element != 0 && record.data_type == GDS_INT32) {
+                    size_t num_points = record.payload_size() / 8;
+                    const uint8_t* xy = record.payload;
+                    if ((scan || roi) && num_points > 0) {
+                        coordinates.resize(2 * num_points);
+                        gdsDecodeXY(xy, num_points, coordinates.data());
+                        min_x = max_x = coordinates[0];
+                        min_y = max_y = coordinates[1];
+                        for (size_t i = 1; i < num_points; i++) {
+                            int32_t x = coordinates[2 * i];
+                            int32_t y = coordinates[2 * i + 1];
+                            min_x = std::min(min_x, x);
+                            max_x = std::max(max_x, x);
+                            min_y = std::min(min_y, y);
+                            max_y = std::max(max_y, y);
                         }
-                        poly.points.emplace_back(scaled_x, scaled_y);
-                        oss.str("");
-                        oss << "  Point " << i << ": (" << scaled_x << ", " << scaled_y << ")";
-                        LOG_DEBUG(oss.str());
                     }
-                    if (!has_valid_point) {
-                        oss.str("");
-                        oss << "OASIS polygon has no significant non-zero points";
-                        LOG_WARN(oss.str());
-                        poly.points.clear();
+                    if (scan && shape_element != GDS_PATH) {
+                        const int32_t* c = coordinates.data();
+                        measure = measureShape(num_points, unit_scale,
+                                               [c](size_t i) { return Point(c[2 * i], c[2 * i + 1]); });
+                    }
+                    // The catalog and index need the outline of every path, since the width widens it
+                    if (!slots.count({current_layer, current_datatype}) && !(scan && shape_element == GDS_PATH)) {
                         break;
                     }
-                    if (poly.points.size() > 1 && poly.points.front() == poly.points.back()) {
-                        poly.points.pop_back();
+                    // Boundaries and boxes outside the window are rejected before their points are copied;
+                    // a path is tested on its outline
+                    if (roi && shape_element != GDS_PATH &&
+                        (num_points == 0 || !roi->overlaps(min_x * unit_scale, min_y * unit_scale,
+                                                           max_x * unit_scale, max_y * unit_scale))) {
+                        outside_roi = true;
+                        break;
                     }
-                    poly.calculateArea();
-                    poly.calculatePerimeter();
-                    if (poly.isValid()) {
-                        layer.polygons.push_back(poly);
+                    // Path outlines are built in database units; other shapes are scaled while decoding
+                    points.resize(num_points);
+                    gdsDecodeXY(xy, num_points, shape_element == GDS_PATH ? 1.0 : unit_scale, points.data());
+                    if (debug_logging) {
                         oss.str("");
-                        oss << "Added OASIS polygon to layer " << layer_number
-                            << ":" << datatype << ", area=" << poly.area;
-                        LOG_INFO(oss.str());
+                        oss << "Decoded coordinates: ";
+                        for (const auto& p : points) {
+                            oss << "[" << p.x << "," << p.y << "] ";
+                        }
+                        LOG_DEBUG(oss.str());
                     }
-                } else {
-                    uint64_t point_count = read_unsigned_int(file);
-                    file.ignore(point_count * 2 * sizeof(int64_t));
                 }
                 break;
-            }
-            case 34: { // END
-                oss.str("");
-                oss << "Reached OASIS END record";
-                LOG_INFO(oss.str());
-                return;
-            }
-            default: {
+            case GDS_ENDEL:
+                poly.points.clear();
+                if (shape_element == GDS_PATH) {
+                    poly = gdsPathOutline(points, path_type, path_width, begin_extension, end_extension);
+                    if (scan) {
+                        measure = measureShape(poly.points.size(), unit_scale,
+                                               [&poly](size_t i) { return poly.points[i]; });
+                    }
+                    if ((scan || roi) && !poly.points.empty()) {
+                        min_x = max_x = static_cast<int32_t>(std::floor(poly.points[0].x));
+                        min_y = max_y = static_cast<int32_t>(std::floor(poly.points[0].y));
+                        for (const auto& p : poly.points) {
+                            min_x = std::min(min_x, static_cast<int32_t>(std::floor(p.x)));
+                            max_x = std::max(max_x, static_cast<int32_t>(std::ceil(p.x)));
+                            min_y = std::min(min_y, static_cast<int32_t>(std::floor(p.y)));
+                            max_y = std::max(max_y, static_cast<int32_t>(std::ceil(p.y)));
+                        }
+                        outside_roi = roi && !roi->overlaps(min_x * unit_scale, min_y * unit_scale,
+                                                            max_x * unit_scale, max_y * unit_scale);
+                    }
+                } else if (shape_element != 0) {
+                    poly.points.assign(points.begin(), points.end());
+                }
+                if (scan && shape_element != 0 && element_has_datatype && current_layer >= 0) {
+                    scan->catalog.addShape(current_layer, current_datatype, measure.valid, measure.vertex_count,
+                                           measure.doubled_area, min_x, min_y, max_x, max_y, element_begin,
+                                           record.offset + record.length);
+                }
+                if (index && element_has_datatype && current_layer >= 0) {
+                    index->addElement(current_layer, current_datatype, shape_element != 0, element_begin,
+                                      record.offset + record.length, min_x, min_y, max_x, max_y);
+                }
+                if (shape_element != 0) {
+                    auto slot = slots.find({current_layer, current_datatype});
+                    if (slot != slots.end() && !outside_roi) {
+                        if (shape_element == GDS_PATH) {
+                            for (auto& p : poly.points) {
+                                p.x *= unit_scale;
+                                p.y *= unit_scale;
+                            }
+                        }
+                        if (poly.points.size() > 1 && poly.points.front() == poly.points.back()) {
+                            poly.points.pop_back();
+                        }
+                        if (debug_logging) {
+                            oss.str("");
+                            oss << "Scaled coordinates: ";
+                            for (const auto& p : poly.points) {
+                                oss << "[" << p.x << "," << p.y << "] ";
+                            }
+                            LOG_DEBUG(oss.str());
+                        }
+                        poly.finalize();
+                        if (poly.isValid()) {
+                            if (sink) {
+                                (*sink)(slot->second, poly);
+                            } else {
+                                layers[slot->second].polygons.push_back(poly);
+                                layers[slot->second].bounds.include(poly.bbox);
+                            }
+                            if (debug_logging) {
+                                oss.str("");
+                                oss << "Added valid polygon to layer " << current_layer
+                                    << ":" << current_datatype << ", area=" << poly.area
+                                    << ", points=" << poly.points.size();
+                                LOG_DEBUG(oss.str());
+                            }
+                        } else if (debug_logging) {
+                            oss.str("");
+                            oss << "Discarded invalid polygon in layer " << current_layer
+                                << ":" << current_datatype << ", points=" << poly.points.size()
+                                << ", area=" << poly.area;
+                            LOG_DEBUG(oss.str());
+                            oss.str("");
+                            oss << "Discarded polygon coordinates: ";
+                            for (const auto& p : poly.points) {
+                                oss << "[" << p.x << "," << p.y << "] ";
+                            }
+                            LOG_DEBUG(oss.str());
+                        }
+                    }
+                    shape_element = 0;
+                }
+                break;
+            default:
                 break;
-            }
         }
     }
+    if (scanner.truncated()) {
+        oss.str("");
+        oss << "Error during parsing: malformed or truncated record at offset " << scanner.offset();
+        LOG_ERROR(oss.str());
+    }
+}
 
-    oss.str("");
-    oss << "Loaded " << layer.polygons.size() << " polygons from OASIS layer "
-        << layer_number << ":" << datatype << " in file " << filename_;
-    LOG_INFO(oss.str());
-    if (layer.polygons.empty()) {
+void LayoutFileReader::loadOASISLayers(const std::vector<std::pair<int, int>>& requested, std::vector<Layer>& layers) {
+    LOG_FUNCTION();
+    MappedFile file(filename_);
+    std::map<std::pair<int, int>, size_t> slots;
+    for (size_t i = 0; i < requested.size(); ++i) {
+        slots.emplace(requested[i], i);
+    }
+    // Reuse the cell table if an earlier load or loadCellShapes() decoded the layers
+    std::set<std::pair<int, int>> keys(requested.begin(), requested.end());
+    if (!hierarchy_ || !catalog_loaded_ || !hierarchy_->cellsToDecode(keys).empty()) {
+        parseOASIS(file, requested);
+    }
+    if (!slots.empty()) {
+        hierarchy_->flatten(slots, layers);
+    }
+
+    std::ostringstream oss;
+    for (size_t i = 0; i < requested.size(); ++i) {
+        size_t first = slots[requested[i]];
+        if (first != i) {
+            layers[i].polygons = layers[first].polygons;
+            layers[i].repetitions = layers[first].repetitions;
+            layers[i].bounds = layers[first].bounds;
+        }
         oss.str("");
-        oss << "No polygons found in OASIS layer " << layer_number << ":" << datatype;
-        LOG_WARN(oss.str());
+        oss << "Loaded " << layers[i].getPolygonCount() << " polygons from OASIS layer "
+            << requested[i].first << ":" << requested[i].second << " in file " << filename_;
+        if (!layers[i].repetitions.empty()) {
+            oss << " (" << layers[i].repetitions.size() << " repetitions kept compact)";
+        }
+        LOG_INFO(oss.str());
+        if (layers[i].getPolygonCount() == 0) {
+            oss.str("");
+            oss << "No polygons found in OASIS layer " << requested[i].first << ":" << requested[i].second;
+            LOG_WARN(oss.str());
+        }
+    }
+}
+
+void LayoutFileReader::parseOASIS(const MappedFile& file, const std::vector<std::pair<int, int>>& requested) {
+    LOG_FUNCTION();
+    std::set<std::pair<int, int>> keys(requested.begin(), requested.end());
+    // OASIS records carry no length, so every load parses the whole file; layers decoded
+    // by earlier loads are decoded again to keep the cell table complete
+    if (hierarchy_) {
+        for (size_t i = 0; i < hierarchy_->cellCount(); ++i) {
+            const auto& decoded = hierarchy_->cell(static_cast<int>(i)).decoded_layers;
+            keys.insert(decoded.begin(), decoded.end());
+        }
+    }
+
+    std::ostringstream oss;
+    oss << "Parsing OASIS file: " << filename_ << " for " << requested.size() << " layers";
+    LOG_INFO(oss.str());
+
+    auto hierarchy = std::make_unique<LayoutHierarchy>();
+    std::set<std::pair<int, int>> catalog;
+    OASISParser parser(file);
+    parser.setThreadCount(reader_threads_);
+    parser.setKeepRepetitions(keep_repetitions_);
+    parser.parse(keys, *hierarchy, catalog);
+    hierarchy_ = std::move(hierarchy);
+    catalog_.clear();
+    for (const auto& [layer, dt] : catalog) {
+        catalog_.addLayer(layer, dt);
     }
+    catalog_loaded_ = true;
+    applyTopCell();
 }
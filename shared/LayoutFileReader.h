@@ -2,31 +2,144 @@
 #define LAYOUT_FILE_READER_H
 
 #include "Geometry.h"
+#include "LayerCache.h"
+#include "LayoutCatalog.h"
+#include "LayoutHierarchy.h"
+#include "LayoutIndex.h"
 #include <string>
 #include <vector>
-#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+
+class MappedFile;
 
 class LayoutFileReader {
 public:
     enum FileType { GDSII, OASIS, UNKNOWN };
+    // gzip- and zstd-compressed files are recognized by their magic bytes and decompressed on a
+    // background thread while they are parsed
     LayoutFileReader(const std::string& filename);
     FileType getFileType() const;
+    // Builds or reuses the "<file>.dfmidx" sidecar index (GDSII only). With a valid index
+    // the layer catalog needs no scan and loads read only the requested layers' byte ranges.
+    void setUseIndex(bool use_index);
+    // Maps or creates the "<file>.dfmcache" sidecar of parsed layers. Layers found in it load without
+    // parsing the layout; the others are parsed once and added to it (repeated shapes expanded).
+    void setUseCache(bool use_cache);
+    // Number of threads used to parse layout files and inflate OASIS CBLOCKs (1 = sequential)
+    void setReaderThreads(int thread_count);
+    // Returns repeated OASIS shapes in Layer::repetitions instead of expanding every instance
+    // into Layer::polygons (off by default)
+    void setKeepRepetitions(bool keep);
+    // Restricts every load to the geometry reachable from the named cell, placed in that cell's
+    // coordinates; only the byte ranges of its subtree are decoded. The catalog then lists the layers
+    // drawn in the subtree (not measured) and the layer cache is not used. Loads throw if the file has
+    // no such cell. An empty name loads the whole layout again; call before loading.
+    void setTopCell(const std::string& cell_name);
     Layer loadLayer(int layer_number, int datatype); // Updated to include datatype
+    // Loads only the polygons of one layer:datatype whose bounding box overlaps roi (user units);
+    // they are not clipped. Flat GDSII rejects elements from their XY extents before building a
+    // polygon and, with a valid index, reads only the indexed ranges overlapping roi. Hierarchical
+    // and OASIS layouts are flattened from their cell cache and filtered. A layer in the .dfmcache
+    // is filtered on its stored bounding boxes.
+    Layer loadLayer(int layer_number, int datatype, const BoundingBox& roi);
+    // Loads all requested layer:datatype pairs in a single pass over the file.
+    // Layers are returned in request order; the layer catalog is filled by the same pass.
+    std::vector<Layer> loadLayers(const std::vector<std::pair<int, int>>& layers_and_datatypes);
+    // Hands every polygon of one layer:datatype to visitor as it is decoded, without building a Layer.
+    // The polygon's buffers are reused for the next one. Flat GDSII is streamed in file order on one
+    // thread; hierarchical GDSII and OASIS stream while flattening their cached cell geometry.
+    void forEachPolygon(int layer_number, int datatype, const std::function<void(const Polygon&)>& visitor);
+    // Same as loadLayers(), keeping integer database-unit coordinates (repetitions are expanded)
+    std::vector<DbuLayer> loadLayersDbu(const std::vector<std::pair<int, int>>& layers_and_datatypes);
+    // Same as loadLayers(), into the flat structure-of-arrays layout (repetitions are expanded).
+    // Layers held by the layer cache are copied from its arrays without building polygons.
+    std::vector<FlatLayer> loadFlatLayers(const std::vector<std::pair<int, int>>& layers_and_datatypes);
+    // Decodes these layers in every cell of a hierarchical GDSII or OASIS layout, in cell-local
+    // coordinates, without flattening them; later loads of the layers reuse the decoded cells.
+    // Returns the cell table, or nullptr for a flat GDSII file, whose layers are left unread.
+    const LayoutHierarchy* loadCellShapes(const std::vector<std::pair<int, int>>& layers_and_datatypes);
+    // User units per database unit: GDSII UNITS, or the inverse of the OASIS START unit
+    double getUnitScale();
     std::vector<std::pair<int, int>> getAvailableLayersAndDatatypes(); // Updated to return layer:datatype pairs
+    // Per layer:datatype statistics, filled by the pass of the last GDSII load (or read from a valid
+    // index); runs a catalog-only pass when nothing has filled it yet. OASIS files and the layer cache
+    // only provide the layer:datatype pairs (see LayoutCatalog::measured).
+    const LayoutCatalog& getCatalog();
+    // Whether a load, the index or the layer cache has filled the catalog, so getCatalog() costs nothing
+    bool hasCatalog() const { return catalog_loaded_; }
+    // Cell table of a hierarchical GDSII file, built by the first load that finds SREF/AREF
+    // references, or of any OASIS file after a load; nullptr for flat GDSII files.
+    const LayoutHierarchy* getHierarchy() const { return hierarchy_.get(); }
+    // Structure catalog: every cell's name, byte range, references and bounding box. Built by a
+    // record-header scan (GDSII) or a parse without geometry (OASIS) if no load has built it yet.
+    const LayoutHierarchy& getCellTable();
 
 private:
     std::string filename_;
     FileType file_type_;
+    bool catalog_loaded_ = false;
+    LayoutCatalog catalog_; // Layer:datatype pairs seen in the file, with their statistics when measured
+    bool use_index_ = false;
+    bool index_valid_ = false;
+    LayoutIndex index_;
+    bool use_cache_ = false;
+    LayerCache cache_;
+    int reader_threads_ = 1;
+    bool keep_repetitions_ = false;
+    bool hierarchical_ = false;
+    std::unique_ptr<LayoutHierarchy> hierarchy_;
+    std::string top_cell_; // Empty: the top cells of the file
+
+    // What a pass over GDSII records found besides the requested geometry
+    struct GDSIIScan {
+        LayoutCatalog catalog;                 // layer:datatype pairs seen, with shape statistics
+        LayoutIndex* index = nullptr;          // Filled when not null
+        size_t reference_count = 0;            // SREF/AREF elements seen
+    };
+
+    // From the extension, ignoring a .gz/.zst suffix, or else from the file's first bytes
     void detectFileType();
-    void loadGDSIILayer(int layer_number, int datatype, Layer& layer);
-    void loadOASISLayer(int layer_number, int datatype, Layer& layer);
-    uint16_t read_uint16(std::ifstream& file);
-    uint8_t read_uint8(std::ifstream& file);
-    int32_t read_int32(std::ifstream& file);
-    double read_double(std::ifstream& file);
-    std::string read_string(std::ifstream& file, uint16_t length);
-    uint64_t read_unsigned_int(std::ifstream& file);
-    int64_t read_signed_int(std::ifstream& file);
+    // Runs a catalog-only pass unless the catalog is already loaded
+    void loadCatalog();
+    // Cached layers come from the mapped cache; the others are parsed and then cached
+    std::vector<Layer> loadCachedLayers(const std::vector<std::pair<int, int>>& requested);
+    // Parses the requested layers from the layout file
+    std::vector<Layer> parseLayers(const std::vector<std::pair<int, int>>& layers_and_datatypes);
+    FileType sniffFileType() const;
+    void loadGDSIILayers(const std::vector<std::pair<int, int>>& requested, std::vector<Layer>& layers);
+    // Loads every BOUNDARY, PATH and BOX as if the file were flat, only those overlapping roi when
+    // it is set; returns the number of references found
+    size_t loadFlatGDSII(const MappedFile& file, const std::map<std::pair<int, int>, size_t>& slots,
+                         std::vector<Layer>& layers, const BoundingBox* roi = nullptr);
+    // Hands the polygons of the slotted layers to sink, choosing flat, hierarchical or OASIS decoding
+    void streamLayers(const std::map<std::pair<int, int>, size_t>& slots, const PolygonSink& sink);
+    // Decodes the flat file, or only the indexed ranges, straight into sink
+    void streamFlatGDSII(const MappedFile& file, const std::map<std::pair<int, int>, size_t>& slots,
+                         const PolygonSink& sink);
+    // Header-only scan for SREF/AREF, deciding how to stream before any polygon is handed out
+    bool hasGDSIIReferences(const MappedFile& file) const;
+    void loadHierarchicalGDSII(const MappedFile& file, const std::map<std::pair<int, int>, size_t>& slots,
+                               std::vector<Layer>& layers);
+    // Builds the cell table if needed and decodes the requested layers of every cell drawing them
+    void decodeGDSIICells(const MappedFile& file, const std::map<std::pair<int, int>, size_t>& slots);
+    // Builds hierarchy_ from a GDSII structure scan if needed and applies the top cell
+    void buildGDSIICellTable(const MappedFile& file);
+    // Makes top_cell_ the only top cell of hierarchy_ and lists its subtree's layers in the catalog
+    void applyTopCell();
+    std::unique_ptr<LayoutHierarchy> buildGDSIIHierarchy(const MappedFile& file);
+    std::vector<std::pair<size_t, size_t>> partitionGDSII(const MappedFile& file, size_t chunk_count,
+                                                          double& unit_scale);
+    // Decodes the records in [begin, end); end = SIZE_MAX reads to the end of the file as it is decompressed.
+    // Polygons go to sink instead of layers when it is set; shapes missing roi are skipped when it is set.
+    void parseGDSIIRecords(const MappedFile& file, size_t begin, size_t end,
+                           const std::map<std::pair<int, int>, size_t>& slots,
+                           std::vector<Layer>& layers, double& unit_scale, GDSIIScan* scan,
+                           const PolygonSink* sink = nullptr, const BoundingBox* roi = nullptr);
+    void loadOASISLayers(const std::vector<std::pair<int, int>>& requested, std::vector<Layer>& layers);
+    // Parses the whole file into hierarchy_, decoding the requested layers and those decoded before
+    void parseOASIS(const MappedFile& file, const std::vector<std::pair<int, int>>& requested);
 };
 
 #endif
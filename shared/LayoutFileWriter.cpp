@@ -0,0 +1,233 @@
+#include "LayoutFileWriter.h"
+#include "GDSIIRecords.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <Logging.h>
+
+namespace {
+
+static_assert(sizeof(DbuPoint) == 2 * sizeof(int32_t), "DbuPoint must be two packed int32 coordinates");
+
+// BGNLIB/BGNSTR carry fixed dates so that identical inputs produce byte-identical files
+const uint16_t TIMESTAMP[6] = {2025, 1, 1, 0, 0, 0};
+
+} // namespace
+
+LayoutFileWriter::LayoutFileWriter(const std::string& filename, size_t buffer_size)
+    : filename_(filename), buffer_(std::max<size_t>(buffer_size, 1 << 16)), used_(0), written_(0),
+      unit_scale_(0.001) {
+    LOG_FUNCTION();
+    out_.open(filename, std::ios::binary | std::ios::trunc);
+    if (!out_.is_open()) {
+        throw std::runtime_error("Cannot open output file: " + filename);
+    }
+}
+
+LayoutFileWriter::~LayoutFileWriter() {
+    if (out_.is_open()) {
+        try {
+            close();
+        } catch (const std::exception& e) {
+            LOG_ERROR(e.what());
+        }
+    }
+}
+
+void LayoutFileWriter::beginLibrary(const std::string& name, double user_unit, double db_unit) {
+    LOG_FUNCTION();
+    if (user_unit <= 0 || db_unit <= 0) {
+        throw std::invalid_argument("GDSII units must be positive");
+    }
+    unit_scale_ = db_unit / user_unit;
+    writeInt16(GDS_HEADER, 600);
+    writeTimestamps(GDS_BGNLIB);
+    writeString(GDS_LIBNAME, name);
+    uint8_t* p = reserve(20);
+    writeRecordHeader(p, 20, GDS_UNITS, GDS_REAL8);
+    gdsWriteReal8(p, user_unit); // Unit pair as LayoutFileReader reads it: unit_scale = db_unit / user_unit
+    gdsWriteReal8(p + 8, db_unit);
+    used_ += 20;
+}
+
+void LayoutFileWriter::endLibrary() {
+    writeNoData(GDS_ENDLIB);
+}
+
+void LayoutFileWriter::beginStructure(const std::string& name) {
+    writeTimestamps(GDS_BGNSTR);
+    writeString(GDS_STRNAME, name);
+}
+
+void LayoutFileWriter::endStructure() {
+    writeNoData(GDS_ENDSTR);
+}
+
+void LayoutFileWriter::writeBoundary(int layer_number, int datatype, const int32_t* xy, size_t point_count) {
+    if (point_count < 3 || point_count > MAX_BOUNDARY_POINTS) {
+        std::ostringstream oss;
+        oss << "Cannot write a BOUNDARY with " << point_count << " points on layer " << layer_number << ":"
+            << datatype << " (3.." << MAX_BOUNDARY_POINTS << " allowed)";
+        throw std::invalid_argument(oss.str());
+    }
+    writeElementHeader(layer_number, datatype);
+    uint8_t* p = beginXY(point_count + 1);
+    for (size_t i = 0; i < 2 * point_count; ++i, p += 4) {
+        gdsWriteInt32(p, xy[i]);
+    }
+    gdsWriteInt32(p, xy[0]);
+    gdsWriteInt32(p + 4, xy[1]);
+    writeNoData(GDS_ENDEL);
+}
+
+void LayoutFileWriter::writeBoundary(int layer_number, int datatype, const std::vector<DbuPoint>& points) {
+    writeBoundary(layer_number, datatype, reinterpret_cast<const int32_t*>(points.data()), points.size());
+}
+
+void LayoutFileWriter::writePolygon(int layer_number, int datatype, const Polygon& polygon) {
+    xy_.resize(2 * polygon.points.size());
+    for (size_t i = 0; i < polygon.points.size(); ++i) {
+        xy_[2 * i] = static_cast<int32_t>(std::llround(polygon.points[i].x / unit_scale_));
+        xy_[2 * i + 1] = static_cast<int32_t>(std::llround(polygon.points[i].y / unit_scale_));
+    }
+    writeBoundary(layer_number, datatype, xy_.data(), polygon.points.size());
+}
+
+void LayoutFileWriter::writeLayer(const Layer& layer) {
+    LOG_FUNCTION();
+    for (const auto& polygon : layer.polygons) {
+        writePolygon(layer.layer_number, layer.datatype, polygon);
+    }
+    PolygonList instances;
+    for (const auto& repetition : layer.repetitions) {
+        instances.clear();
+        repetition.expand(instances);
+        for (const auto& polygon : instances) {
+            writePolygon(layer.layer_number, layer.datatype, polygon);
+        }
+    }
+}
+
+void LayoutFileWriter::writeSref(const std::string& name, int32_t x, int32_t y) {
+    writeNoData(GDS_SREF);
+    writeString(GDS_SNAME, name);
+    uint8_t* p = beginXY(1);
+    gdsWriteInt32(p, x);
+    gdsWriteInt32(p + 4, y);
+    writeNoData(GDS_ENDEL);
+}
+
+void LayoutFileWriter::writeAref(const std::string& name, int columns, int rows, int32_t x, int32_t y,
+                                 int32_t column_step, int32_t row_step) {
+    if (columns < 1 || rows < 1 || columns > 32767 || rows > 32767) {
+        throw std::invalid_argument("AREF of " + name + " needs 1..32767 columns and rows");
+    }
+    writeNoData(GDS_AREF);
+    writeString(GDS_SNAME, name);
+    uint8_t* p = reserve(8);
+    writeRecordHeader(p, 8, GDS_COLROW, GDS_INT16);
+    gdsWriteUint16(p, static_cast<uint16_t>(columns));
+    gdsWriteUint16(p + 2, static_cast<uint16_t>(rows));
+    used_ += 8;
+    // Origin, then the displaced corners after all columns and after all rows
+    p = beginXY(3);
+    const int64_t xy[6] = {x, y, x + int64_t(column_step) * columns, y, x, y + int64_t(row_step) * rows};
+    for (int i = 0; i < 6; ++i, p += 4) {
+        gdsWriteInt32(p, static_cast<int32_t>(xy[i]));
+    }
+    writeNoData(GDS_ENDEL);
+}
+
+void LayoutFileWriter::close() {
+    LOG_FUNCTION();
+    flush();
+    out_.close();
+    if (out_.fail()) {
+        throw std::runtime_error("Failed to close output file: " + filename_);
+    }
+    std::ostringstream oss;
+    oss << "Wrote " << written_ << " bytes to " << filename_;
+    LOG_INFO(oss.str());
+}
+
+uint8_t* LayoutFileWriter::reserve(size_t bytes) {
+    if (used_ + bytes > buffer_.size()) {
+        flush();
+        if (bytes > buffer_.size()) {
+            buffer_.resize(bytes);
+        }
+    }
+    return buffer_.data() + used_;
+}
+
+void LayoutFileWriter::writeRecordHeader(uint8_t*& p, size_t length, uint8_t record_type, uint8_t data_type) {
+    gdsWriteUint16(p, static_cast<uint16_t>(length));
+    p[2] = record_type;
+    p[3] = data_type;
+    p += 4;
+}
+
+void LayoutFileWriter::writeNoData(uint8_t record_type) {
+    uint8_t* p = reserve(4);
+    writeRecordHeader(p, 4, record_type, GDS_NO_DATA);
+    used_ += 4;
+}
+
+void LayoutFileWriter::writeInt16(uint8_t record_type, int value) {
+    uint8_t* p = reserve(6);
+    writeRecordHeader(p, 6, record_type, GDS_INT16);
+    gdsWriteUint16(p, static_cast<uint16_t>(value));
+    used_ += 6;
+}
+
+void LayoutFileWriter::writeString(uint8_t record_type, const std::string& value) {
+    size_t padded = (value.size() + 1) & ~size_t(1); // Strings are padded to an even length with a NUL
+    if (padded + 4 > 0xFFFF) {
+        throw std::invalid_argument("GDSII string too long: " + value.substr(0, 32) + "...");
+    }
+    uint8_t* p = reserve(padded + 4);
+    writeRecordHeader(p, padded + 4, record_type, GDS_ASCII);
+    std::memcpy(p, value.data(), value.size());
+    if (padded != value.size()) p[value.size()] = 0;
+    used_ += padded + 4;
+}
+
+void LayoutFileWriter::writeTimestamps(uint8_t record_type) {
+    uint8_t* p = reserve(28);
+    writeRecordHeader(p, 28, record_type, GDS_INT16);
+    for (int i = 0; i < 12; ++i, p += 2) {
+        gdsWriteUint16(p, TIMESTAMP[i % 6]);
+    }
+    used_ += 28;
+}
+
+void LayoutFileWriter::writeElementHeader(int layer_number, int datatype) {
+    uint8_t* p = reserve(16);
+    writeRecordHeader(p, 4, GDS_BOUNDARY, GDS_NO_DATA);
+    writeRecordHeader(p, 6, GDS_LAYER, GDS_INT16);
+    gdsWriteUint16(p, static_cast<uint16_t>(layer_number));
+    p += 2;
+    writeRecordHeader(p, 6, GDS_DATATYPE, GDS_INT16);
+    gdsWriteUint16(p, static_cast<uint16_t>(datatype));
+    used_ += 16;
+}
+
+uint8_t* LayoutFileWriter::beginXY(size_t point_count) {
+    size_t length = 4 + 8 * point_count;
+    uint8_t* p = reserve(length);
+    writeRecordHeader(p, length, GDS_XY, GDS_INT32);
+    used_ += length;
+    return p;
+}
+
+void LayoutFileWriter::flush() {
+    if (used_ == 0) return;
+    out_.write(reinterpret_cast<const char*>(buffer_.data()), static_cast<std::streamsize>(used_));
+    if (!out_) {
+        throw std::runtime_error("Failed to write output file: " + filename_);
+    }
+    written_ += used_;
+    used_ = 0;
+}
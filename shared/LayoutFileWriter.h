@@ -0,0 +1,73 @@
+#ifndef LAYOUT_FILE_WRITER_H
+#define LAYOUT_FILE_WRITER_H
+
+#include "Geometry.h"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Streaming GDSII writer. Records are encoded big-endian straight into a large buffer that is
+// written to the file in whole blocks, so generating multi-GB layouts is bound by the disk.
+// Calls must follow the GDSII structure: beginLibrary, then any number of
+// beginStructure ... endStructure, then endLibrary. I/O errors throw std::runtime_error.
+class LayoutFileWriter {
+public:
+    // Most vertices of one BOUNDARY: an XY record holds at most 8191 points including the closing one
+    static const size_t MAX_BOUNDARY_POINTS = 8190;
+
+    explicit LayoutFileWriter(const std::string& filename, size_t buffer_size = 4 << 20);
+    // Flushes the buffer if close() was not called; errors are logged, not thrown
+    ~LayoutFileWriter();
+    LayoutFileWriter(const LayoutFileWriter&) = delete;
+    LayoutFileWriter& operator=(const LayoutFileWriter&) = delete;
+
+    // user_unit and db_unit are in meters (e.g. 1e-6 and 1e-9); polygons given in user units
+    // are rounded to the database grid
+    void beginLibrary(const std::string& name, double user_unit = 1e-6, double db_unit = 1e-9);
+    void endLibrary();
+    void beginStructure(const std::string& name);
+    void endStructure();
+
+    // BOUNDARY from point_count (x, y) database-unit pairs; the closing point is added
+    void writeBoundary(int layer_number, int datatype, const int32_t* xy, size_t point_count);
+    void writeBoundary(int layer_number, int datatype, const std::vector<DbuPoint>& points);
+    // BOUNDARY from a polygon in user units
+    void writePolygon(int layer_number, int datatype, const Polygon& polygon);
+    void writeLayer(const Layer& layer);
+
+    // SREF of structure name placed at (x, y), without rotation or magnification
+    void writeSref(const std::string& name, int32_t x, int32_t y);
+    // AREF of structure name: columns x rows instances starting at (x, y), column_step apart
+    // along x and row_step apart along y
+    void writeAref(const std::string& name, int columns, int rows, int32_t x, int32_t y, int32_t column_step,
+                   int32_t row_step);
+
+    // Flushes and closes the file
+    void close();
+    uint64_t bytesWritten() const { return written_ + used_; }
+    const std::string& filename() const { return filename_; }
+
+private:
+    // Reserves space for `bytes` more bytes, flushing the buffer first if needed
+    uint8_t* reserve(size_t bytes);
+    void writeRecordHeader(uint8_t*& p, size_t length, uint8_t record_type, uint8_t data_type);
+    void writeNoData(uint8_t record_type);
+    void writeInt16(uint8_t record_type, int value);
+    void writeString(uint8_t record_type, const std::string& value);
+    void writeTimestamps(uint8_t record_type);
+    void writeElementHeader(int layer_number, int datatype);
+    uint8_t* beginXY(size_t point_count);
+    void flush();
+
+    std::string filename_;
+    std::ofstream out_;
+    std::vector<uint8_t> buffer_;
+    size_t used_;
+    uint64_t written_;
+    double unit_scale_;       // Database unit in user units
+    std::vector<int32_t> xy_; // Scratch coordinates for writePolygon
+};
+
+#endif // LAYOUT_FILE_WRITER_H
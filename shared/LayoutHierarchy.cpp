@@ -0,0 +1,428 @@
+#include "LayoutHierarchy.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <Logging.h>
+
+CellTransform::CellTransform() : xx(1.0), xy(0.0), yx(0.0), yy(1.0), dx(0.0), dy(0.0) {}
+
+CellTransform CellTransform::fromPlacement(double x, double y, double angle_degrees, double magnification,
+                                           bool mirror_x) {
+    // Exact sine/cosine for the Manhattan angles used by nearly all placements
+    double c, s;
+    double normalized = std::fmod(angle_degrees, 360.0);
+    if (normalized < 0) normalized += 360.0;
+    if (normalized == 0.0) { c = 1.0; s = 0.0; }
+    else if (normalized == 90.0) { c = 0.0; s = 1.0; }
+    else if (normalized == 180.0) { c = -1.0; s = 0.0; }
+    else if (normalized == 270.0) { c = 0.0; s = -1.0; }
+    else {
+        double radians = normalized * M_PI / 180.0;
+        c = std::cos(radians);
+        s = std::sin(radians);
+    }
+
+    CellTransform t;
+    t.xx = magnification * c;
+    t.yx = magnification * s;
+    t.xy = magnification * (mirror_x ? s : -s);
+    t.yy = magnification * (mirror_x ? -c : c);
+    t.dx = x;
+    t.dy = y;
+    return t;
+}
+
+CellTransform CellTransform::translation(double x, double y) {
+    CellTransform t;
+    t.dx = x;
+    t.dy = y;
+    return t;
+}
+
+CellTransform CellTransform::operator*(const CellTransform& inner) const {
+    CellTransform t;
+    t.xx = xx * inner.xx + xy * inner.yx;
+    t.xy = xx * inner.xy + xy * inner.yy;
+    t.yx = yx * inner.xx + yy * inner.yx;
+    t.yy = yx * inner.xy + yy * inner.yy;
+    t.dx = xx * inner.dx + xy * inner.dy + dx;
+    t.dy = yx * inner.dx + yy * inner.dy + dy;
+    return t;
+}
+
+Point CellTransform::apply(const Point& p) const {
+    return Point(xx * p.x + xy * p.y + dx, yx * p.x + yy * p.y + dy);
+}
+
+bool CellTransform::isIdentity() const {
+    return xx == 1.0 && xy == 0.0 && yx == 0.0 && yy == 1.0 && dx == 0.0 && dy == 0.0;
+}
+
+bool CellTransform::isGridIsometry() const {
+    for (double v : {xx, xy, yx, yy}) {
+        if (v != 0.0 && v != 1.0 && v != -1.0) return false;
+    }
+    return std::abs(xx * yy - xy * yx) == 1.0 && dx == std::round(dx) && dy == std::round(dy);
+}
+
+CellReference::CellReference() : cell_index(-1), columns(1), rows(1), column_step(0.0, 0.0), row_step(0.0, 0.0) {}
+
+CellTransform CellReference::instance(int column, int row) const {
+    return CellTransform::translation(column * column_step.x + row * row_step.x,
+                                      column * column_step.y + row * row_step.y) * transform;
+}
+
+namespace {
+
+const BoundingBox EMPTY_BOX{std::numeric_limits<double>::max(), std::numeric_limits<double>::max(),
+                            std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest()};
+
+void include(BoundingBox& box, const Point& p) {
+    box.min_x = std::min(box.min_x, p.x);
+    box.min_y = std::min(box.min_y, p.y);
+    box.max_x = std::max(box.max_x, p.x);
+    box.max_y = std::max(box.max_y, p.y);
+}
+
+} // namespace
+
+Cell::Cell() : begin(0), end(0), bounds(EMPTY_BOX) {}
+
+int LayoutHierarchy::addCell(const std::string& name) {
+    auto it = cell_by_name_.find(name);
+    if (it != cell_by_name_.end()) {
+        return it->second;
+    }
+    int index = static_cast<int>(cells_.size());
+    cells_.emplace_back();
+    cells_.back().name = name;
+    cell_by_name_.emplace(name, index);
+    return index;
+}
+
+int LayoutHierarchy::findCell(const std::string& name) const {
+    auto it = cell_by_name_.find(name);
+    return it == cell_by_name_.end() ? -1 : it->second;
+}
+
+size_t LayoutHierarchy::referenceCount() const {
+    size_t count = 0;
+    for (const auto& cell : cells_) {
+        count += cell.references.size();
+    }
+    return count;
+}
+
+void LayoutHierarchy::resolveReferences() {
+    LOG_FUNCTION();
+    std::vector<bool> referenced(cells_.size(), false);
+    for (auto& cell : cells_) {
+        for (auto& reference : cell.references) {
+            reference.cell_index = findCell(reference.cell_name);
+            if (reference.cell_index < 0) {
+                LOG_WARN("Reference to undefined cell " + reference.cell_name + " in cell " + cell.name);
+                continue;
+            }
+            referenced[reference.cell_index] = true;
+        }
+    }
+    top_cells_.clear();
+    for (size_t i = 0; i < cells_.size(); ++i) {
+        if (!referenced[i]) {
+            top_cells_.push_back(static_cast<int>(i));
+        }
+    }
+    subtree_layers_.assign(cells_.size(), {});
+    subtree_layers_done_.assign(cells_.size(), false);
+    subtree_bounds_.assign(cells_.size(), EMPTY_BOX);
+    subtree_bounds_done_.assign(cells_.size(), false);
+
+    std::ostringstream oss;
+    oss << "Cell table: " << cells_.size() << " cells, " << referenceCount() << " references, top cells:";
+    for (int top : top_cells_) {
+        oss << " " << cells_[top].name;
+    }
+    LOG_INFO(oss.str());
+}
+
+bool LayoutHierarchy::selectTopCell(const std::string& name) {
+    int index = findCell(name);
+    if (index < 0) {
+        return false;
+    }
+    top_cells_.assign(1, index);
+    return true;
+}
+
+std::vector<int> LayoutHierarchy::reachableCells() const {
+    std::vector<bool> visited(cells_.size(), false);
+    std::vector<int> stack(top_cells_.begin(), top_cells_.end());
+    while (!stack.empty()) {
+        int index = stack.back();
+        stack.pop_back();
+        if (visited[index]) continue;
+        visited[index] = true;
+        for (const auto& reference : cells_[index].references) {
+            if (reference.cell_index >= 0 && !visited[reference.cell_index]) {
+                stack.push_back(reference.cell_index);
+            }
+        }
+    }
+    std::vector<int> result;
+    for (size_t i = 0; i < visited.size(); ++i) {
+        if (visited[i]) result.push_back(static_cast<int>(i));
+    }
+    return result;
+}
+
+BoundingBox LayoutHierarchy::subtreeBounds(int cell_index) const {
+    if (subtree_bounds_done_[cell_index]) {
+        return subtree_bounds_[cell_index];
+    }
+    subtree_bounds_done_[cell_index] = true; // Also guards against reference cycles
+    BoundingBox box = cells_[cell_index].bounds;
+    for (const auto& reference : cells_[cell_index].references) {
+        if (reference.cell_index < 0) continue;
+        BoundingBox child = subtreeBounds(reference.cell_index);
+        if (child.min_x > child.max_x) continue;
+        // Array instances differ by a translation, so the corner instances bound all of them
+        for (int row : {0, reference.rows - 1}) {
+            for (int column : {0, reference.columns - 1}) {
+                CellTransform t = reference.instance(column, row);
+                include(box, t.apply(Point(child.min_x, child.min_y)));
+                include(box, t.apply(Point(child.min_x, child.max_y)));
+                include(box, t.apply(Point(child.max_x, child.min_y)));
+                include(box, t.apply(Point(child.max_x, child.max_y)));
+            }
+        }
+    }
+    subtree_bounds_[cell_index] = box;
+    return box;
+}
+
+const std::set<std::pair<int, int>>& LayoutHierarchy::subtreeLayers(int cell_index) const {
+    if (subtree_layers_done_[cell_index]) {
+        return subtree_layers_[cell_index];
+    }
+    subtree_layers_done_[cell_index] = true; // Also guards against reference cycles
+    std::set<std::pair<int, int>> layers = cells_[cell_index].layers;
+    for (const auto& reference : cells_[cell_index].references) {
+        if (reference.cell_index >= 0) {
+            const auto& child_layers = subtreeLayers(reference.cell_index);
+            layers.insert(child_layers.begin(), child_layers.end());
+        }
+    }
+    subtree_layers_[cell_index] = std::move(layers);
+    return subtree_layers_[cell_index];
+}
+
+bool LayoutHierarchy::subtreeHasLayer(int cell_index, const std::pair<int, int>& layer_key) const {
+    return subtreeLayers(cell_index).count(layer_key) > 0;
+}
+
+bool LayoutHierarchy::subtreeHasAnyLayer(int cell_index, const std::map<std::pair<int, int>, size_t>& slots) const {
+    const auto& layers = subtreeLayers(cell_index);
+    for (const auto& slot : slots) {
+        if (layers.count(slot.first)) return true;
+    }
+    return false;
+}
+
+std::vector<int> LayoutHierarchy::cellsToDecode(const std::set<std::pair<int, int>>& layer_keys) const {
+    std::vector<int> result;
+    std::vector<bool> visited(cells_.size(), false);
+    std::vector<int> stack(top_cells_.rbegin(), top_cells_.rend());
+    while (!stack.empty()) {
+        int index = stack.back();
+        stack.pop_back();
+        if (visited[index]) continue;
+        visited[index] = true;
+        const Cell& cell = cells_[index];
+        for (const auto& key : layer_keys) {
+            if (cell.layers.count(key) && !cell.decoded_layers.count(key)) {
+                result.push_back(index);
+                break;
+            }
+        }
+        for (auto it = cell.references.rbegin(); it != cell.references.rend(); ++it) {
+            if (it->cell_index >= 0 && !visited[it->cell_index]) {
+                stack.push_back(it->cell_index);
+            }
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+void LayoutHierarchy::flatten(const std::map<std::pair<int, int>, size_t>& slots, std::vector<Layer>& layers) const {
+    LOG_FUNCTION();
+    std::vector<int> path;
+    for (int top : top_cells_) {
+        if (subtreeHasAnyLayer(top, slots)) {
+            flattenCell(top, CellTransform(), slots, &layers, nullptr, path);
+        }
+    }
+}
+
+void LayoutHierarchy::flatten(const std::map<std::pair<int, int>, size_t>& slots, const PolygonSink& sink) const {
+    LOG_FUNCTION();
+    std::vector<int> path;
+    for (int top : top_cells_) {
+        if (subtreeHasAnyLayer(top, slots)) {
+            flattenCell(top, CellTransform(), slots, nullptr, &sink, path);
+        }
+    }
+}
+
+void LayoutHierarchy::flattenLocal(int cell_index, const std::map<std::pair<int, int>, size_t>& slots,
+                                   std::vector<Layer>& layers) const {
+    std::vector<int> path;
+    flattenCell(cell_index, CellTransform(), slots, &layers, nullptr, path);
+}
+
+Polygon LayoutHierarchy::placeShape(const Polygon& local, const CellTransform& transform) const {
+    Polygon poly;
+    placeShape(local, transform, poly);
+    return poly;
+}
+
+void LayoutHierarchy::placeShape(const Polygon& local, const CellTransform& transform, Polygon& placed) const {
+    placed.points.clear();
+    placed.points.reserve(local.points.size());
+    for (const auto& p : local.points) {
+        Point q = transform.apply(p);
+        // Instances land on the database grid before scaling to user units
+        placed.points.emplace_back(std::round(q.x) * unit_scale, std::round(q.y) * unit_scale);
+    }
+    placed.finalize();
+}
+
+void LayoutHierarchy::flattenCell(int cell_index, const CellTransform& transform,
+                                  const std::map<std::pair<int, int>, size_t>& slots, std::vector<Layer>* layers,
+                                  const PolygonSink* sink, std::vector<int>& path) const {
+    if (std::find(path.begin(), path.end(), cell_index) != path.end()) {
+        LOG_ERROR("Recursive reference to cell " + cells_[cell_index].name + " ignored");
+        return;
+    }
+    path.push_back(cell_index);
+    const Cell& cell = cells_[cell_index];
+    Polygon poly; // Placement buffer, reused for every shape of the cell
+
+    for (const auto& [key, slot] : slots) {
+        auto shapes = cell.shapes.find(key);
+        if (shapes == cell.shapes.end()) continue;
+        for (const auto& local : shapes->second) {
+            placeShape(local, transform, poly);
+            if (!poly.isValid()) continue;
+            if (layers) {
+                (*layers)[slot].polygons.push_back(poly);
+                (*layers)[slot].bounds.include(poly.bbox);
+            } else {
+                (*sink)(slot, poly);
+            }
+        }
+    }
+
+    for (const auto& [key, slot] : slots) {
+        auto repetitions = cell.repetitions.find(key);
+        if (repetitions == cell.repetitions.end()) continue;
+        for (const auto& local : repetitions->second) {
+            if (!layers || !transform.isGridIsometry()) {
+                // Rounding after an arbitrary transform depends on the instance, so expand
+                PolygonList instances;
+                local.expand(instances);
+                for (const auto& instance : instances) {
+                    placeShape(instance, transform, poly);
+                    if (!poly.isValid()) continue;
+                    if (layers) {
+                        (*layers)[slot].polygons.push_back(poly);
+                        (*layers)[slot].bounds.include(poly.bbox);
+                    } else {
+                        (*sink)(slot, poly);
+                    }
+                }
+                continue;
+            }
+            ShapeRepetition placed;
+            placed.shape = placeShape(local.shape, transform);
+            if (!placed.shape.isValid()) continue;
+            auto place_step = [&](const Point& step) {
+                return Point((transform.xx * step.x + transform.xy * step.y) * unit_scale,
+                             (transform.yx * step.x + transform.yy * step.y) * unit_scale);
+            };
+            placed.columns = local.columns;
+            placed.rows = local.rows;
+            placed.column_step = place_step(local.column_step);
+            placed.row_step = place_step(local.row_step);
+            placed.offsets.reserve(local.offsets.size());
+            for (const auto& offset : local.offsets) {
+                placed.offsets.push_back(place_step(offset));
+            }
+            placed.sortOffsets();
+            (*layers)[slot].bounds.include(placed.bounds());
+            (*layers)[slot].repetitions.push_back(std::move(placed));
+        }
+    }
+
+    for (const auto& reference : cell.references) {
+        if (reference.cell_index < 0 || !subtreeHasAnyLayer(reference.cell_index, slots)) continue;
+        for (int row = 0; row < reference.rows; ++row) {
+            for (int column = 0; column < reference.columns; ++column) {
+                flattenCell(reference.cell_index, transform * reference.instance(column, row), slots, layers, sink,
+                            path);
+            }
+        }
+    }
+    path.pop_back();
+}
+
+std::vector<CellTransform> LayoutHierarchy::instancesOf(int cell_index) const {
+    // Cells whose subtree places the target, so the walk skips unrelated branches
+    std::vector<bool> places_target(cells_.size(), false);
+    places_target[cell_index] = true;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t i = 0; i < cells_.size(); ++i) {
+            if (places_target[i]) continue;
+            for (const auto& reference : cells_[i].references) {
+                if (reference.cell_index >= 0 && places_target[reference.cell_index]) {
+                    places_target[i] = changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    std::vector<CellTransform> instances;
+    std::vector<int> path;
+    for (int top : top_cells_) {
+        if (places_target[top]) {
+            collectInstances(top, CellTransform(), cell_index, places_target, instances, path);
+        }
+    }
+    return instances;
+}
+
+void LayoutHierarchy::collectInstances(int cell_index, const CellTransform& transform, int target,
+                                       const std::vector<bool>& places_target,
+                                       std::vector<CellTransform>& instances, std::vector<int>& path) const {
+    if (cell_index == target) {
+        instances.push_back(transform);
+        return;
+    }
+    if (std::find(path.begin(), path.end(), cell_index) != path.end()) {
+        return; // Reported by flatten()
+    }
+    path.push_back(cell_index);
+    for (const auto& reference : cells_[cell_index].references) {
+        if (reference.cell_index < 0 || !places_target[reference.cell_index]) continue;
+        for (int row = 0; row < reference.rows; ++row) {
+            for (int column = 0; column < reference.columns; ++column) {
+                collectInstances(reference.cell_index, transform * reference.instance(column, row), target,
+                                 places_target, instances, path);
+            }
+        }
+    }
+    path.pop_back();
+}
@@ -0,0 +1,117 @@
+#ifndef LAYOUT_HIERARCHY_H
+#define LAYOUT_HIERARCHY_H
+
+#include "Geometry.h"
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Affine placement transform in database units: reflect about the x axis (optional),
+// magnify, rotate counterclockwise, then translate.
+struct CellTransform {
+    double xx, xy, yx, yy; // Linear part, row-major
+    double dx, dy;         // Translation
+    CellTransform();
+    static CellTransform fromPlacement(double x, double y, double angle_degrees, double magnification, bool mirror_x);
+    static CellTransform translation(double x, double y);
+    CellTransform operator*(const CellTransform& inner) const; // Applies inner first, then this
+    Point apply(const Point& p) const;
+    bool isIdentity() const;
+    // Manhattan rotation/reflection without magnification and with an on-grid offset: placing
+    // database-unit geometry with it needs no rounding
+    bool isGridIsometry() const;
+};
+
+// SREF/AREF (or PLACEMENT) of one cell inside another
+struct CellReference {
+    std::string cell_name;
+    int cell_index;            // Resolved target cell, -1 if unresolved
+    CellTransform transform;   // Placement of the first instance
+    int columns, rows;         // Array size; 1x1 for single references
+    Point column_step;         // Displacement between columns, in parent database units
+    Point row_step;            // Displacement between rows, in parent database units
+    CellReference();
+    // Placement of the instance in the given array column and row
+    CellTransform instance(int column, int row) const;
+};
+
+struct Cell {
+    std::string name;
+    size_t begin, end;                                  // Byte range of the cell in the layout file
+    std::set<std::pair<int, int>> layers;               // layer:datatype pairs drawn directly in this cell
+    BoundingBox bounds;                                 // Of the shapes drawn directly in this cell, in its database
+                                                        // units; inverted when empty or not measured (OASIS)
+    std::vector<CellReference> references;
+    std::map<std::pair<int, int>, PolygonList> shapes; // Decoded cell-local geometry in database units
+    std::map<std::pair<int, int>, std::vector<ShapeRepetition>> repetitions; // Repeated shapes kept compact, same units
+    std::set<std::pair<int, int>> decoded_layers;       // Layers whose shapes are already decoded
+    Cell();
+};
+
+// Cell table of a hierarchical layout. Each cell's geometry is decoded once per layer and
+// cached in cell-local database units; flattening only transforms the cached shapes per instance.
+class LayoutHierarchy {
+public:
+    // Returns the index of the named cell, creating it for forward references
+    int addCell(const std::string& name);
+    int findCell(const std::string& name) const;
+    Cell& cell(int index) { return cells_[index]; }
+    const Cell& cell(int index) const { return cells_[index]; }
+    size_t cellCount() const { return cells_.size(); }
+    size_t referenceCount() const;
+
+    // Resolves reference names and determines the top cells (cells nobody references)
+    void resolveReferences();
+    const std::vector<int>& topCells() const { return top_cells_; }
+    // Makes the named cell the only top cell: decoding, flattening and instancesOf() then stay inside
+    // its subtree, in its own coordinates. Returns false if there is no such cell.
+    bool selectTopCell(const std::string& name);
+    // Cells reachable from the top cells, in index order
+    std::vector<int> reachableCells() const;
+
+    // Cells reachable from the top cells that draw one of the layers but have not decoded it yet
+    std::vector<int> cellsToDecode(const std::set<std::pair<int, int>>& layer_keys) const;
+    bool subtreeHasLayer(int cell_index, const std::pair<int, int>& layer_key) const;
+    // layer:datatype pairs drawn in a cell or in any cell it places
+    const std::set<std::pair<int, int>>& subtreeLayers(int cell_index) const;
+    // Bounding box of a cell and every instance it places, in its database units; inverted when empty
+    BoundingBox subtreeBounds(int cell_index) const;
+
+    // Appends the flattened geometry of every requested layer, scaled to user units, to layers[slot],
+    // growing its bounds
+    void flatten(const std::map<std::pair<int, int>, size_t>& slots, std::vector<Layer>& layers) const;
+    // Same as flatten(), handing every placed polygon to sink instead; repetitions are expanded
+    void flatten(const std::map<std::pair<int, int>, size_t>& slots, const PolygonSink& sink) const;
+    // Same as flatten(), for the subtree of one cell in that cell's own coordinates
+    void flattenLocal(int cell_index, const std::map<std::pair<int, int>, size_t>& slots,
+                      std::vector<Layer>& layers) const;
+    // Placements of a cell in top-cell coordinates, one per instance (identity for a top cell)
+    std::vector<CellTransform> instancesOf(int cell_index) const;
+    // Places a cell-local shape: transforms it, snaps it to the database grid and scales it to user units
+    Polygon placeShape(const Polygon& local, const CellTransform& transform) const;
+    // Same, into a reused polygon
+    void placeShape(const Polygon& local, const CellTransform& transform, Polygon& placed) const;
+
+    double unit_scale = 0.001; // User units per database unit
+
+private:
+    // Appends to layers, or streams to sink when layers is null
+    void flattenCell(int cell_index, const CellTransform& transform, const std::map<std::pair<int, int>, size_t>& slots,
+                     std::vector<Layer>* layers, const PolygonSink* sink, std::vector<int>& path) const;
+    void collectInstances(int cell_index, const CellTransform& transform, int target,
+                          const std::vector<bool>& places_target, std::vector<CellTransform>& instances,
+                          std::vector<int>& path) const;
+    bool subtreeHasAnyLayer(int cell_index, const std::map<std::pair<int, int>, size_t>& slots) const;
+
+    std::vector<Cell> cells_;
+    std::map<std::string, int> cell_by_name_;
+    std::vector<int> top_cells_;
+    mutable std::vector<std::set<std::pair<int, int>>> subtree_layers_; // Memoized per cell
+    mutable std::vector<bool> subtree_layers_done_;
+    mutable std::vector<BoundingBox> subtree_bounds_; // Memoized per cell
+    mutable std::vector<bool> subtree_bounds_done_;
+};
+
+#endif // LAYOUT_HIERARCHY_H
@@ -0,0 +1,307 @@
+#include "LayoutIndex.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <sys/stat.h>
+#include <Logging.h>
+
+namespace {
+
+const char INDEX_MAGIC[8] = {'D', 'F', 'M', 'I', 'D', 'X', '\0', '\0'};
+const uint32_t INDEX_VERSION = 5;
+
+// Adjacent elements are coalesced into ranges of at most this many bytes, which keeps the
+// range bounding boxes tight enough for region-of-interest loads
+const uint64_t MAX_RANGE_BYTES = 16 << 10;
+
+// Stored size of an entry before its ranges: layer, datatype, statistics, bounding box, range count
+const uint64_t ENTRY_HEADER_BYTES = 2 * sizeof(int32_t) + 3 * sizeof(uint64_t) + sizeof(double) +
+                                    4 * sizeof(int32_t) + sizeof(uint64_t);
+
+// The content hash samples the head, the tail and evenly spaced blocks of the file,
+// so validating the index of a multi-GB layout stays cheap.
+const uint64_t HASH_EDGE_BYTES = 1 << 20;
+const uint64_t HASH_BLOCK_BYTES = 4096;
+const int HASH_BLOCK_COUNT = 64;
+
+uint64_t fnv1a(uint64_t hash, const char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+template <typename T>
+void writeValue(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::ifstream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return static_cast<bool>(in);
+}
+
+// Bytes between the read position and the end of the file; counts read from a corrupt index are
+// checked against it before anything is allocated for them
+uint64_t bytesLeft(std::ifstream& in, uint64_t file_size) {
+    std::streamoff position = in.tellg();
+    return position < 0 || static_cast<uint64_t>(position) > file_size ? 0 : file_size - position;
+}
+
+} // namespace
+
+LayoutIndexEntry::LayoutIndexEntry(int num, int dt)
+    : layer_number(num), datatype(dt), polygon_count(0), invalid_count(0), vertex_count(0), total_area(0.0),
+      min_x(std::numeric_limits<int32_t>::max()), min_y(std::numeric_limits<int32_t>::max()),
+      max_x(std::numeric_limits<int32_t>::min()), max_y(std::numeric_limits<int32_t>::min()) {}
+
+LayoutIndex::LayoutIndex() : unit_scale(0.001), reference_count(0) {}
+
+bool LayoutIndex::FileKey::operator==(const FileKey& other) const {
+    return size == other.size && mtime_ns == other.mtime_ns && content_hash == other.content_hash;
+}
+
+std::string LayoutIndex::indexPathFor(const std::string& layout_file) {
+    return layout_file + ".dfmidx";
+}
+
+bool LayoutIndex::computeFileKey(const std::string& layout_file, FileKey& key) {
+    LOG_FUNCTION();
+    struct stat st;
+    if (::stat(layout_file.c_str(), &st) != 0) {
+        return false;
+    }
+    key.size = static_cast<uint64_t>(st.st_size);
+    key.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+
+    std::ifstream file(layout_file, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::vector<char> buffer(HASH_EDGE_BYTES);
+    uint64_t hash = 14695981039346656037ULL;
+    auto hashRange = [&](uint64_t offset, uint64_t length) {
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(offset));
+        file.read(buffer.data(), static_cast<std::streamsize>(length));
+        hash = fnv1a(hash, buffer.data(), static_cast<size_t>(file.gcount()));
+    };
+    hashRange(0, std::min(HASH_EDGE_BYTES, key.size));
+    if (key.size > 2 * HASH_EDGE_BYTES) {
+        uint64_t stride = (key.size - 2 * HASH_EDGE_BYTES) / HASH_BLOCK_COUNT;
+        for (int i = 0; i < HASH_BLOCK_COUNT && stride >= HASH_BLOCK_BYTES; ++i) {
+            hashRange(HASH_EDGE_BYTES + i * stride, HASH_BLOCK_BYTES);
+        }
+    }
+    if (key.size > HASH_EDGE_BYTES) {
+        uint64_t tail = std::min(HASH_EDGE_BYTES, key.size - HASH_EDGE_BYTES);
+        hashRange(key.size - tail, tail);
+    }
+    key.content_hash = hash;
+    return true;
+}
+
+void LayoutIndex::clear() {
+    entries_.clear();
+    unit_scale = 0.001;
+    reference_count = 0;
+}
+
+LayoutIndexEntry& LayoutIndex::entryFor(int layer_number, int datatype) {
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), std::make_pair(layer_number, datatype),
+                               [](const LayoutIndexEntry& entry, const std::pair<int, int>& key) {
+                                   return std::make_pair(entry.layer_number, entry.datatype) < key;
+                               });
+    if (it == entries_.end() || it->layer_number != layer_number || it->datatype != datatype) {
+        it = entries_.insert(it, LayoutIndexEntry(layer_number, datatype));
+    }
+    return *it;
+}
+
+void LayoutIndex::addElement(int layer_number, int datatype, bool is_shape, uint64_t begin, uint64_t end,
+                             int32_t min_x, int32_t min_y, int32_t max_x, int32_t max_y) {
+    LayoutIndexEntry& entry = entryFor(layer_number, datatype);
+    if (!is_shape) {
+        return;
+    }
+    entry.polygon_count++;
+    entry.min_x = std::min(entry.min_x, min_x);
+    entry.min_y = std::min(entry.min_y, min_y);
+    entry.max_x = std::max(entry.max_x, max_x);
+    entry.max_y = std::max(entry.max_y, max_y);
+    appendRange(entry, {begin, end, min_x, min_y, max_x, max_y});
+}
+
+void LayoutIndex::appendRange(LayoutIndexEntry& entry, const LayoutIndexRange& range) {
+    if (!entry.ranges.empty()) {
+        LayoutIndexRange& last = entry.ranges.back();
+        if (last.end == range.begin && range.end - last.begin <= MAX_RANGE_BYTES) {
+            last.end = range.end; // Coalesce with the previous elements
+            last.min_x = std::min(last.min_x, range.min_x);
+            last.min_y = std::min(last.min_y, range.min_y);
+            last.max_x = std::max(last.max_x, range.max_x);
+            last.max_y = std::max(last.max_y, range.max_y);
+            return;
+        }
+    }
+    entry.ranges.push_back(range);
+}
+
+void LayoutIndex::merge(const LayoutIndex& other) {
+    reference_count += other.reference_count;
+    for (const auto& source : other.entries_) {
+        LayoutIndexEntry& entry = entryFor(source.layer_number, source.datatype);
+        if (source.polygon_count == 0) continue;
+        entry.polygon_count += source.polygon_count;
+        entry.invalid_count += source.invalid_count;
+        entry.vertex_count += source.vertex_count;
+        entry.total_area += source.total_area;
+        entry.min_x = std::min(entry.min_x, source.min_x);
+        entry.min_y = std::min(entry.min_y, source.min_y);
+        entry.max_x = std::max(entry.max_x, source.max_x);
+        entry.max_y = std::max(entry.max_y, source.max_y);
+        for (const auto& range : source.ranges) {
+            appendRange(entry, range);
+        }
+    }
+}
+
+const LayoutIndexEntry* LayoutIndex::find(int layer_number, int datatype) const {
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), std::make_pair(layer_number, datatype),
+                               [](const LayoutIndexEntry& entry, const std::pair<int, int>& key) {
+                                   return std::make_pair(entry.layer_number, entry.datatype) < key;
+                               });
+    if (it == entries_.end() || it->layer_number != layer_number || it->datatype != datatype) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+LayoutIndexEntry* LayoutIndex::find(int layer_number, int datatype) {
+    return const_cast<LayoutIndexEntry*>(static_cast<const LayoutIndex*>(this)->find(layer_number, datatype));
+}
+
+bool LayoutIndex::load(const std::string& layout_file) {
+    LOG_FUNCTION();
+    std::string index_file = indexPathFor(layout_file);
+    std::ifstream in(index_file, std::ios::binary | std::ios::ate);
+    if (!in.is_open()) {
+        LOG_INFO("No layout index found at " + index_file);
+        return false;
+    }
+    const uint64_t file_size = static_cast<uint64_t>(in.tellg());
+    in.seekg(0);
+
+    char magic[sizeof(INDEX_MAGIC)];
+    uint32_t version = 0;
+    FileKey stored_key, current_key;
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0 || !readValue(in, version) ||
+        version != INDEX_VERSION) {
+        LOG_WARN("Ignoring layout index with unknown format: " + index_file);
+        return false;
+    }
+    if (!readValue(in, stored_key.size) || !readValue(in, stored_key.mtime_ns) ||
+        !readValue(in, stored_key.content_hash)) {
+        LOG_WARN("Ignoring truncated layout index: " + index_file);
+        return false;
+    }
+    if (!computeFileKey(layout_file, current_key) || !(stored_key == current_key)) {
+        LOG_INFO("Layout index is stale, it will be rebuilt: " + index_file);
+        return false;
+    }
+
+    std::vector<LayoutIndexEntry> entries;
+    uint32_t entry_count = 0;
+    if (!readValue(in, unit_scale) || !readValue(in, reference_count) || !readValue(in, entry_count)) {
+        LOG_WARN("Ignoring truncated layout index: " + index_file);
+        return false;
+    }
+    if (entry_count > bytesLeft(in, file_size) / ENTRY_HEADER_BYTES) {
+        LOG_WARN("Ignoring corrupt layout index: " + index_file);
+        return false;
+    }
+    for (uint32_t i = 0; i < entry_count; ++i) {
+        int32_t layer_number = 0, datatype = 0;
+        uint64_t range_count = 0;
+        if (!readValue(in, layer_number) || !readValue(in, datatype)) break;
+        LayoutIndexEntry entry(layer_number, datatype);
+        if (!readValue(in, entry.polygon_count) || !readValue(in, entry.invalid_count) ||
+            !readValue(in, entry.vertex_count) || !readValue(in, entry.total_area) || !readValue(in, entry.min_x) ||
+            !readValue(in, entry.min_y) || !readValue(in, entry.max_x) || !readValue(in, entry.max_y) ||
+            !readValue(in, range_count)) break;
+        if (range_count > bytesLeft(in, file_size) / sizeof(LayoutIndexRange)) break;
+        entry.ranges.resize(range_count);
+        in.read(reinterpret_cast<char*>(entry.ranges.data()),
+                static_cast<std::streamsize>(range_count * sizeof(entry.ranges[0])));
+        if (!in) break;
+        entries.push_back(std::move(entry));
+    }
+    if (entries.size() != entry_count) {
+        LOG_WARN("Ignoring truncated layout index: " + index_file);
+        return false;
+    }
+    entries_ = std::move(entries);
+
+    std::ostringstream oss;
+    oss << "Loaded layout index " << index_file << " with " << entries_.size() << " layers";
+    LOG_INFO(oss.str());
+    return true;
+}
+
+bool LayoutIndex::save(const std::string& layout_file) const {
+    LOG_FUNCTION();
+    FileKey key;
+    if (!computeFileKey(layout_file, key)) {
+        LOG_WARN("Cannot stat layout file for indexing: " + layout_file);
+        return false;
+    }
+    // Written aside and renamed over the index, so a concurrent or interrupted run never sees half of it
+    std::string index_file = indexPathFor(layout_file);
+    std::string temp_file = index_file + ".tmp";
+    std::ofstream out(temp_file, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        LOG_WARN("Cannot write layout index: " + index_file);
+        return false;
+    }
+
+    out.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    writeValue(out, INDEX_VERSION);
+    writeValue(out, key.size);
+    writeValue(out, key.mtime_ns);
+    writeValue(out, key.content_hash);
+    writeValue(out, unit_scale);
+    writeValue(out, reference_count);
+    writeValue(out, static_cast<uint32_t>(entries_.size()));
+    for (const auto& entry : entries_) {
+        writeValue(out, static_cast<int32_t>(entry.layer_number));
+        writeValue(out, static_cast<int32_t>(entry.datatype));
+        writeValue(out, entry.polygon_count);
+        writeValue(out, entry.invalid_count);
+        writeValue(out, entry.vertex_count);
+        writeValue(out, entry.total_area);
+        writeValue(out, entry.min_x);
+        writeValue(out, entry.min_y);
+        writeValue(out, entry.max_x);
+        writeValue(out, entry.max_y);
+        writeValue(out, static_cast<uint64_t>(entry.ranges.size()));
+        out.write(reinterpret_cast<const char*>(entry.ranges.data()),
+                  static_cast<std::streamsize>(entry.ranges.size() * sizeof(entry.ranges[0])));
+    }
+    out.close();
+    if (!out || std::rename(temp_file.c_str(), index_file.c_str()) != 0) {
+        LOG_WARN("Failed writing layout index: " + index_file);
+        std::remove(temp_file.c_str());
+        return false;
+    }
+
+    std::ostringstream oss;
+    oss << "Saved layout index " << index_file << " with " << entries_.size() << " layers";
+    LOG_INFO(oss.str());
+    return true;
+}
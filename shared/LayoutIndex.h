@@ -0,0 +1,74 @@
+#ifndef LAYOUT_INDEX_H
+#define LAYOUT_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Run of consecutive shape elements of one layer:datatype in the layout file
+struct LayoutIndexRange {
+    uint64_t begin, end;                // [begin, end) byte range of the elements
+    int32_t min_x, min_y, max_x, max_y; // Bounding box of the elements in database units
+};
+
+// Per layer:datatype summary of one layer in a layout file
+struct LayoutIndexEntry {
+    int layer_number;
+    int datatype;
+    uint64_t polygon_count;  // BOUNDARY, PATH and BOX elements on this layer:datatype
+    uint64_t invalid_count;  // Of those, the ones a load discards (see LayerStatistics)
+    uint64_t vertex_count;   // Vertices of the valid ones
+    double total_area;       // Area of the valid ones in square user units
+    int32_t min_x, min_y;    // Bounding box of those elements in database units
+    int32_t max_x, max_y;
+    // Coalesced element ranges in file order; each stays small, so a region query can skip most of them
+    std::vector<LayoutIndexRange> ranges;
+    LayoutIndexEntry(int num, int dt);
+};
+
+// Sidecar index stored next to a layout file as "<layout_file>.dfmidx".
+// It is keyed by the file size, modification time and a sampled content hash,
+// so a stale index is detected and rebuilt instead of being trusted.
+class LayoutIndex {
+public:
+    LayoutIndex();
+    static std::string indexPathFor(const std::string& layout_file);
+
+    // Reads the sidecar of layout_file; returns false if it is missing, corrupt or stale.
+    bool load(const std::string& layout_file);
+    // Writes the sidecar of layout_file; returns false if it could not be written.
+    bool save(const std::string& layout_file) const;
+
+    void clear();
+    bool empty() const { return entries_.empty(); }
+    // Records one element. Only shape elements (BOUNDARY, PATH, BOX) contribute ranges, counts and
+    // bounding boxes; other elements only make their layer:datatype visible in the catalog.
+    void addElement(int layer_number, int datatype, bool is_shape, uint64_t begin, uint64_t end,
+                    int32_t min_x, int32_t min_y, int32_t max_x, int32_t max_y);
+    // Appends the entries of an index built over a later part of the same file
+    void merge(const LayoutIndex& other);
+    const LayoutIndexEntry* find(int layer_number, int datatype) const;
+    LayoutIndexEntry* find(int layer_number, int datatype);
+    const std::vector<LayoutIndexEntry>& entries() const { return entries_; }
+
+    double unit_scale;
+    uint64_t reference_count; // SREF/AREF elements; a non-zero count means the layout must be loaded hierarchically
+
+    // Identity of a layout file's contents; also keys the .dfmcache layer cache
+    struct FileKey {
+        uint64_t size = 0;
+        int64_t mtime_ns = 0;
+        uint64_t content_hash = 0;
+        bool operator==(const FileKey& other) const;
+    };
+    static bool computeFileKey(const std::string& layout_file, FileKey& key);
+
+private:
+    LayoutIndexEntry& entryFor(int layer_number, int datatype);
+    static void appendRange(LayoutIndexEntry& entry, const LayoutIndexRange& range);
+
+    std::vector<LayoutIndexEntry> entries_; // Sorted by layer:datatype
+};
+
+#endif // LAYOUT_INDEX_H
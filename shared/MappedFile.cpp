@@ -0,0 +1,330 @@
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef DFM_WITH_ZSTD
+#define ZSTD_STATIC_LINKING_ONLY // ZSTD_decompressBound
+#include <zstd.h>
+#endif
+#include <Logging.h>
+
+namespace {
+
+// Decompressed bytes are published to readers in steps of this size
+const size_t PUBLISH_STEP = 4 << 20;
+// Deflate cannot expand a byte into more than 1032 bytes
+const size_t DEFLATE_MAX_RATIO = 1032;
+// Without a usable size hint, the first writable window holds this multiple of the compressed size
+const size_t EXPECTED_RATIO = 4;
+
+size_t roundToPages(size_t size) {
+    size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return std::max((size + page - 1) / page * page, page);
+}
+
+MappedFile::Compression compressionOf(const uint8_t* data, size_t size) {
+    static const uint8_t GZIP_MAGIC[] = {0x1F, 0x8B};
+    static const uint8_t ZSTD_MAGIC[] = {0x28, 0xB5, 0x2F, 0xFD};
+    if (size >= sizeof(GZIP_MAGIC) && std::memcmp(data, GZIP_MAGIC, sizeof(GZIP_MAGIC)) == 0) {
+        return MappedFile::GZIP;
+    }
+    if (size >= sizeof(ZSTD_MAGIC) && std::memcmp(data, ZSTD_MAGIC, sizeof(ZSTD_MAGIC)) == 0) {
+        return MappedFile::ZSTD;
+    }
+    return MappedFile::NONE;
+}
+
+// gzip decoder; concatenated members are decoded as one file
+class GzipInflater {
+public:
+    GzipInflater() {
+        std::memset(&stream_, 0, sizeof(stream_));
+        if (inflateInit2(&stream_, 16 + MAX_WBITS) != Z_OK) {
+            throw std::runtime_error("Failed to initialize zlib inflater");
+        }
+    }
+    ~GzipInflater() { inflateEnd(&stream_); }
+    GzipInflater(const GzipInflater&) = delete;
+    GzipInflater& operator=(const GzipInflater&) = delete;
+
+    z_stream& stream() { return stream_; }
+
+private:
+    z_stream stream_;
+};
+
+} // namespace
+
+MappedFile::MappedFile(const std::string& filename)
+    : data_(nullptr), size_(0), mapped_(false), compression_(NONE), source_(nullptr), source_size_(0),
+      source_mapped_(false), output_(nullptr), reserved_(0), committed_(0), available_(0), complete_(true), cancel_(false) {
+    LOG_FUNCTION();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void* addr = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                ::madvise(addr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                data_ = static_cast<const uint8_t*>(addr);
+                size_ = static_cast<size_t>(st.st_size);
+                mapped_ = true;
+            }
+        }
+        ::close(fd);
+    }
+
+    if (!mapped_) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            std::ostringstream oss;
+            oss << "Cannot open file: " << filename;
+            throw std::runtime_error(oss.str());
+        }
+        buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+    }
+
+    std::ostringstream oss;
+    oss << (mapped_ ? "Memory-mapped " : "Buffered ") << size_ << " bytes from " << filename;
+    LOG_DEBUG(oss.str());
+
+    compression_ = compressionOf(data_, size_);
+    if (compression_ == NONE) {
+        available_ = size_;
+        return;
+    }
+
+    // The raw file becomes the decoder's input
+    source_ = data_;
+    source_size_ = size_;
+    source_mapped_ = mapped_;
+    mapped_ = false;
+    size_t expected = source_size_ * EXPECTED_RATIO;
+    if (compression_ == GZIP) {
+        reserved_ = source_size_ * DEFLATE_MAX_RATIO;
+        // ISIZE trailer: size of the last member modulo 2^32, exact for the usual single-member file
+        if (source_size_ >= 18) {
+            const uint8_t* trailer = source_ + source_size_ - 4;
+            size_t isize = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | (static_cast<size_t>(trailer[3]) << 24);
+            expected = std::max(expected, isize);
+        }
+    } else {
+#ifdef DFM_WITH_ZSTD
+        unsigned long long bound = ZSTD_decompressBound(source_, source_size_);
+        if (bound == ZSTD_CONTENTSIZE_ERROR) {
+            throw std::runtime_error("Malformed zstd file: " + filename);
+        }
+        reserved_ = static_cast<size_t>(bound);
+        unsigned long long content = ZSTD_findDecompressedSize(source_, source_size_);
+        if (content != ZSTD_CONTENTSIZE_UNKNOWN && content != ZSTD_CONTENTSIZE_ERROR) {
+            expected = static_cast<size_t>(content);
+        }
+#else
+        throw std::runtime_error("Cannot read " + filename + ": built without zstd support (DFM_WITH_ZSTD)");
+#endif
+    }
+
+    // Reserve inaccessible address space for the worst case, which costs no memory (nor commit charge,
+    // even with overcommit disabled), and make a window at its start writable. The window grows in place
+    // as it fills, so data() never moves; should the full reservation not fit, a smaller one is taken and
+    // decompression only fails if the data outgrows it.
+    reserved_ = roundToPages(reserved_);
+    committed_ = std::min(roundToPages(expected), reserved_);
+    void* addr = MAP_FAILED;
+    while (true) {
+        addr = ::mmap(nullptr, reserved_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (addr != MAP_FAILED || reserved_ == committed_) break;
+        reserved_ = std::max(roundToPages(reserved_ / 2), committed_);
+    }
+    if (addr == MAP_FAILED || ::mprotect(addr, committed_, PROT_READ | PROT_WRITE) != 0) {
+        if (addr != MAP_FAILED) ::munmap(addr, reserved_);
+        oss.str("");
+        oss << "Cannot reserve " << committed_ << " bytes to decompress " << filename;
+        throw std::runtime_error(oss.str());
+    }
+    output_ = static_cast<uint8_t*>(addr);
+    data_ = output_;
+    size_ = 0;
+    complete_ = false;
+
+    oss.str("");
+    oss << "Decompressing " << (compression_ == GZIP ? "gzip" : "zstd") << " file " << filename
+        << " in the background";
+    LOG_INFO(oss.str());
+    decoder_ = std::thread([this, filename] { decompress(filename); });
+}
+
+MappedFile::~MappedFile() {
+    if (decoder_.joinable()) {
+        cancel_ = true;
+        decoder_.join();
+    }
+    if (output_) {
+        ::munmap(output_, reserved_);
+    }
+    if (mapped_) {
+        ::munmap(const_cast<uint8_t*>(data_), size_);
+    }
+}
+
+size_t MappedFile::waitFor(size_t end) const {
+    if (!complete_.load(std::memory_order_acquire)) {
+        size_t available = available_.load(std::memory_order_acquire);
+        if (available >= end) {
+            return available;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        progress_.wait(lock, [&] { return complete_.load() || available_.load() >= end; });
+        if (!complete_.load()) {
+            return available_.load();
+        }
+    }
+    if (!error_.empty()) {
+        throw std::runtime_error(error_);
+    }
+    return size_;
+}
+
+MappedFile::Compression MappedFile::detectCompression(const std::string& filename) {
+    uint8_t magic[4] = {0, 0, 0, 0};
+    std::ifstream file(filename, std::ios::binary);
+    file.read(reinterpret_cast<char*>(magic), sizeof(magic));
+    return compressionOf(magic, static_cast<size_t>(file.gcount()));
+}
+
+void MappedFile::decompress(const std::string& filename) {
+    std::string error;
+    try {
+        if (compression_ == GZIP) {
+            decompressGzip();
+        } else {
+            decompressZstd();
+        }
+    } catch (const std::exception& e) {
+        error = "Cannot decompress " + filename + ": " + e.what();
+        LOG_ERROR(error);
+    }
+    finish(error);
+
+    std::ostringstream oss;
+    oss << "Decompressed " << source_size_ << " bytes into " << available_.load() << " bytes from " << filename;
+    LOG_INFO(oss.str());
+}
+
+void MappedFile::decompressGzip() {
+    GzipInflater inflater;
+    z_stream& stream = inflater.stream();
+    size_t consumed = 0;
+    size_t produced = 0;
+    while (!cancel_.load(std::memory_order_relaxed)) {
+        size_t input = std::min<size_t>(source_size_ - consumed, 1u << 30);
+        size_t output = writable(produced);
+        stream.next_in = const_cast<Bytef*>(source_ + consumed);
+        stream.avail_in = static_cast<uInt>(input);
+        stream.next_out = output_ + produced;
+        stream.avail_out = static_cast<uInt>(output);
+        int result = ::inflate(&stream, Z_NO_FLUSH);
+        consumed += input - stream.avail_in;
+        produced += output - stream.avail_out;
+        publish(produced);
+
+        if (result == Z_STREAM_END) {
+            // Another member may follow; anything else after the last one (e.g. zero padding) is ignored
+            if (compressionOf(source_ + consumed, source_size_ - consumed) != GZIP) {
+                break;
+            }
+            inflateReset(&stream);
+        } else if (result != Z_OK && result != Z_BUF_ERROR) {
+            throw std::runtime_error(stream.msg ? stream.msg : "inflate error " + std::to_string(result));
+        } else if (consumed == source_size_ && stream.avail_out > 0) {
+            throw std::runtime_error("truncated gzip data");
+        }
+    }
+}
+
+void MappedFile::decompressZstd() {
+#ifdef DFM_WITH_ZSTD
+    std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> context(ZSTD_createDCtx(), ZSTD_freeDCtx);
+    if (!context) {
+        throw std::runtime_error("Failed to initialize zstd decoder");
+    }
+    ZSTD_inBuffer input = {source_, source_size_, 0};
+    size_t produced = 0;
+    while (!cancel_.load(std::memory_order_relaxed)) {
+        ZSTD_outBuffer output = {output_ + produced, writable(produced), 0};
+        size_t result = ZSTD_decompressStream(context.get(), &output, &input);
+        if (ZSTD_isError(result)) {
+            throw std::runtime_error(ZSTD_getErrorName(result));
+        }
+        produced += output.pos;
+        publish(produced);
+        if (input.pos == input.size) {
+            if (result == 0) break; // Last frame complete and flushed
+            if (output.pos < output.size) {
+                throw std::runtime_error("truncated zstd data");
+            }
+        }
+    }
+#endif
+}
+
+size_t MappedFile::writable(size_t produced) {
+    if (produced == committed_) {
+        if (committed_ == reserved_) {
+            std::ostringstream oss;
+            oss << "decompressed data exceeds the " << reserved_ << " bytes reserved for it";
+            throw std::runtime_error(oss.str());
+        }
+        // Doubling keeps the number of grow steps logarithmic in the final size
+        size_t grown = std::min(roundToPages(committed_ * 2), reserved_);
+        if (::mprotect(output_ + committed_, grown - committed_, PROT_READ | PROT_WRITE) != 0) {
+            std::ostringstream oss;
+            oss << "cannot grow the decompression buffer from " << committed_ << " to " << grown << " bytes";
+            throw std::runtime_error(oss.str());
+        }
+        committed_ = grown;
+    }
+    return std::min(committed_ - produced, PUBLISH_STEP);
+}
+
+void MappedFile::publish(size_t size) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        available_.store(size, std::memory_order_release);
+    }
+    progress_.notify_all();
+}
+
+void MappedFile::finish(const std::string& error) {
+    size_t size = available_.load();
+    // Return the unused part of the reservation and release the compressed input
+    size_t used = roundToPages(size);
+    if (used < reserved_) {
+        ::munmap(output_ + used, reserved_ - used);
+        reserved_ = used;
+        committed_ = std::min(committed_, used);
+    }
+    if (source_mapped_) {
+        ::munmap(const_cast<uint8_t*>(source_), source_size_);
+        source_mapped_ = false;
+    } else {
+        std::vector<uint8_t>().swap(buffer_);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = error;
+        size_ = size;
+        complete_.store(true, std::memory_order_release);
+    }
+    progress_.notify_all();
+}
@@ -0,0 +1,75 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Read-only view of a whole file. The file is memory-mapped when possible;
+// if mapping fails (e.g. a pipe or an empty file) its contents are read into memory.
+// gzip (and, when built with DFM_WITH_ZSTD, zstd) files are recognized by their magic bytes
+// and decompressed by a background thread into reserved address space that is made writable as
+// it fills. data() is valid at once and never moves, but its bytes arrive progressively:
+// sequential readers call waitFor() to overlap parsing with decompression, while size() waits
+// for the whole file.
+class MappedFile {
+public:
+    enum Compression { NONE, GZIP, ZSTD };
+
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return data_; }
+    // Size of the (decompressed) file; blocks until decompression has finished
+    size_t size() const { return complete_.load(std::memory_order_acquire) ? size_ : waitFor(SIZE_MAX); }
+    bool isMapped() const { return mapped_; }
+    Compression compression() const { return compression_; }
+
+    // Blocks until the first end bytes are readable or the whole file is; returns the readable size.
+    // Throws std::runtime_error if the compressed data is corrupt.
+    size_t waitFor(size_t end) const;
+
+    // Compression of the file at filename, from its first bytes (NONE if it cannot be read)
+    static Compression detectCompression(const std::string& filename);
+
+private:
+    void decompress(const std::string& filename);
+    void decompressGzip();
+    void decompressZstd();
+    // Bytes the decoder may write at offset produced, growing the writable window if it is full;
+    // throws std::runtime_error if it cannot grow
+    size_t writable(size_t produced);
+    // Makes the first `size` decompressed bytes readable and wakes waiting readers
+    void publish(size_t size);
+    void finish(const std::string& error);
+
+    const uint8_t* data_;
+    size_t size_;
+    bool mapped_;
+    std::vector<uint8_t> buffer_; // Used only when the file could not be mapped
+
+    // Compressed input: data_/size_ first describe the raw file, which moves here
+    Compression compression_;
+    const uint8_t* source_;
+    size_t source_size_;
+    bool source_mapped_;
+    uint8_t* output_;        // Reserved address range the decompressed bytes are written to
+    size_t reserved_;
+    size_t committed_;       // Writable prefix of the reserved range
+    std::thread decoder_;
+    std::atomic<size_t> available_;
+    std::atomic<bool> complete_;
+    std::atomic<bool> cancel_;
+    std::string error_;
+    mutable std::mutex mutex_;
+    mutable std::condition_variable progress_;
+};
+
+#endif // MAPPED_FILE_H
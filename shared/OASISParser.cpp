@@ -0,0 +1,968 @@
+#include "OASISParser.h"
+#include "ParallelFor.h"
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <zlib.h>
+#include <Logging.h>
+
+namespace {
+
+// CTRAPEZOID vertices as x = wx*w + hx*h, y = wy*w + hy*h; types 16-23 are triangles
+struct CTrapezoidVertex {
+    int8_t wx, hx, wy, hy;
+};
+
+const CTrapezoidVertex CTRAPEZOID_VERTICES[26][4] = {
+    {{0, 0, 0, 0}, {0, 0, 0, 1}, {1, -1, 0, 1}, {1, 0, 0, 0}},  // 0
+    {{0, 0, 0, 0}, {0, 0, 0, 1}, {1, 0, 0, 1}, {1, -1, 0, 0}},  // 1
+    {{0, 0, 0, 0}, {0, 1, 0, 1}, {1, 0, 0, 1}, {1, 0, 0, 0}},   // 2
+    {{0, 1, 0, 0}, {0, 0, 0, 1}, {1, 0, 0, 1}, {1, 0, 0, 0}},   // 3
+    {{0, 0, 0, 0}, {0, 1, 0, 1}, {1, -1, 0, 1}, {1, 0, 0, 0}},  // 4
+    {{0, 1, 0, 0}, {0, 0, 0, 1}, {1, 0, 0, 1}, {1, -1, 0, 0}},  // 5
+    {{0, 0, 0, 0}, {0, 1, 0, 1}, {1, 0, 0, 1}, {1, -1, 0, 0}},  // 6
+    {{0, 1, 0, 0}, {0, 0, 0, 1}, {1, -1, 0, 1}, {1, 0, 0, 0}},  // 7
+    {{0, 0, 0, 0}, {0, 0, 0, 1}, {1, 0, -1, 1}, {1, 0, 0, 0}},  // 8
+    {{0, 0, 0, 0}, {0, 0, -1, 1}, {1, 0, 0, 1}, {1, 0, 0, 0}},  // 9
+    {{0, 0, 0, 0}, {0, 0, 0, 1}, {1, 0, 0, 1}, {1, 0, 1, 0}},   // 10
+    {{0, 0, 1, 0}, {0, 0, 0, 1}, {1, 0, 0, 1}, {1, 0, 0, 0}},   // 11
+    {{0, 0, 0, 0}, {0, 0, 0, 1}, {1, 0, -1, 1}, {1, 0, 1, 0}},  // 12
+    {{0, 0, 1, 0}, {0, 0, -1, 1}, {1, 0, 0, 1}, {1, 0, 0, 0}},  // 13
+    {{0, 0, 0, 0}, {0, 0, -1, 1}, {1, 0, 0, 1}, {1, 0, 1, 0}},  // 14
+    {{0, 0, 1, 0}, {0, 0, 0, 1}, {1, 0, -1, 1}, {1, 0, 0, 0}},  // 15
+    {{0, 0, 0, 0}, {0, 0, 1, 0}, {1, 0, 0, 0}, {0, 0, 0, 0}},   // 16
+    {{0, 0, 0, 0}, {0, 0, 1, 0}, {1, 0, 1, 0}, {0, 0, 0, 0}},   // 17
+    {{0, 0, 0, 0}, {1, 0, 1, 0}, {1, 0, 0, 0}, {0, 0, 0, 0}},   // 18
+    {{0, 0, 1, 0}, {1, 0, 1, 0}, {1, 0, 0, 0}, {0, 0, 0, 0}},   // 19
+    {{0, 0, 0, 0}, {0, 1, 0, 1}, {0, 2, 0, 0}, {0, 0, 0, 0}},   // 20
+    {{0, 0, 0, 1}, {0, 2, 0, 1}, {0, 1, 0, 0}, {0, 0, 0, 0}},   // 21
+    {{0, 0, 0, 0}, {0, 0, 2, 0}, {1, 0, 1, 0}, {0, 0, 0, 0}},   // 22
+    {{1, 0, 0, 0}, {0, 0, 1, 0}, {1, 0, 2, 0}, {0, 0, 0, 0}},   // 23
+    {{0, 0, 0, 0}, {0, 0, 0, 1}, {1, 0, 0, 1}, {1, 0, 0, 0}},   // 24
+    {{0, 0, 0, 0}, {0, 0, 1, 0}, {1, 0, 1, 0}, {1, 0, 0, 0}},   // 25
+};
+
+const int CIRCLE_SEGMENTS = 32;
+
+// Raw deflate decoder (CBLOCK compression type 0), reset and reused for every block
+class Inflater {
+public:
+    Inflater() {
+        std::memset(&stream_, 0, sizeof(stream_));
+        if (inflateInit2(&stream_, -MAX_WBITS) != Z_OK) {
+            throw std::runtime_error("Failed to initialize zlib inflater");
+        }
+    }
+    ~Inflater() { inflateEnd(&stream_); }
+    Inflater(const Inflater&) = delete;
+    Inflater& operator=(const Inflater&) = delete;
+
+    // Inflates into output and returns the number of bytes produced. With partial set, stopping
+    // because output is full is not an error.
+    size_t inflate(const uint8_t* input, size_t input_size, uint8_t* output, size_t output_size, bool partial) {
+        inflateReset(&stream_);
+        stream_.next_in = const_cast<Bytef*>(input);
+        stream_.avail_in = static_cast<uInt>(input_size);
+        stream_.next_out = output;
+        stream_.avail_out = static_cast<uInt>(output_size);
+        int result = ::inflate(&stream_, Z_FINISH);
+        bool complete = result == Z_STREAM_END || (partial && (result == Z_OK || result == Z_BUF_ERROR));
+        if (!complete) {
+            throw std::runtime_error(std::string("Malformed OASIS CBLOCK: ") +
+                                     (stream_.msg ? stream_.msg : "inflate error " + std::to_string(result)));
+        }
+        return output_size - stream_.avail_out;
+    }
+
+private:
+    z_stream stream_;
+};
+
+Inflater& threadInflater() {
+    thread_local Inflater inflater;
+    return inflater;
+}
+
+} // namespace
+
+OASISParser::OASISParser(const uint8_t* data, size_t size)
+    : data_(data), size_(size), file_(nullptr), unit_(1000.0), thread_count_(1), keep_repetitions_(false), scanning_(false), segment_begin_(0),
+      layer_keys_(nullptr), catalog_(nullptr), shape_count_(0), placement_count_(0) {}
+
+OASISParser::OASISParser(const MappedFile& file) : OASISParser(file.data(), 0) {
+    file_ = &file;
+}
+
+void OASISParser::setThreadCount(int thread_count) {
+    thread_count_ = std::max(thread_count, 1);
+}
+
+void OASISParser::setKeepRepetitions(bool keep) {
+    keep_repetitions_ = keep;
+}
+
+void OASISParser::parse(const std::set<std::pair<int, int>>& layer_keys, LayoutHierarchy& hierarchy,
+                        std::set<std::pair<int, int>>& catalog) {
+    LOG_FUNCTION();
+    layer_keys_ = &layer_keys;
+    catalog_ = &catalog;
+    cells_.clear();
+    name_records_.clear();
+    modal_ = Modal();
+
+    OasisStream stream = file_ ? OasisStream(*file_) : OasisStream(data_, size_);
+    if (!stream.canRead(OASIS_MAGIC_SIZE) || std::memcmp(data_, OASIS_MAGIC, OASIS_MAGIC_SIZE) != 0) {
+        throw std::runtime_error("Missing OASIS magic string");
+    }
+    stream.skip(OASIS_MAGIC_SIZE);
+    if (stream.readUnsigned() != OAS_START) {
+        throw std::runtime_error("Missing START record in OASIS file");
+    }
+    readStart(stream);
+
+    if (thread_count_ > 1) {
+        parseParallel(stream);
+    } else if (!parseRecords(stream, false)) {
+        stream.fail("missing END record");
+    }
+    LOG_INFO("Reached OASIS END record");
+    buildHierarchy(hierarchy);
+}
+
+double OASISParser::readUnit(const MappedFile& file) {
+    OasisStream stream(file);
+    if (!stream.canRead(OASIS_MAGIC_SIZE) || std::memcmp(file.data(), OASIS_MAGIC, OASIS_MAGIC_SIZE) != 0) {
+        throw std::runtime_error("Missing OASIS magic string");
+    }
+    stream.skip(OASIS_MAGIC_SIZE);
+    if (stream.readUnsigned() != OAS_START) {
+        throw std::runtime_error("Missing START record in OASIS file");
+    }
+    stream.skipString(); // Version
+    double unit = stream.readReal();
+    return unit > 0.0 && !std::isinf(unit) ? unit : 1000.0;
+}
+
+bool OASISParser::parseRecords(OasisStream& stream, bool in_cblock) {
+    while (!stream.atEnd()) {
+        size_t record_begin = stream.offset();
+        uint64_t record_type = stream.readUnsigned();
+        switch (record_type) {
+            case OAS_PAD:
+                break;
+            case OAS_END:
+                if (in_cblock) stream.fail("END record inside a CBLOCK");
+                if (scanning_) cutSegment(record_begin);
+                return true;
+            case OAS_CELLNAME_IMPLICIT: {
+                CellNameRecord record;
+                record.name = stream.readString();
+                if (!scanning_) name_records_.push_back(std::move(record));
+                break;
+            }
+            case OAS_CELLNAME: {
+                CellNameRecord record;
+                record.name = stream.readString();
+                record.implicit = false;
+                record.refnum = stream.readUnsigned();
+                if (!scanning_) name_records_.push_back(std::move(record));
+                break;
+            }
+            case OAS_TEXTSTRING_IMPLICIT:
+            case OAS_PROPNAME_IMPLICIT:
+            case OAS_PROPSTRING_IMPLICIT:
+                stream.skipString();
+                break;
+            case OAS_TEXTSTRING:
+            case OAS_PROPNAME:
+            case OAS_PROPSTRING:
+                stream.skipString();
+                stream.readUnsigned();
+                break;
+            case OAS_LAYERNAME:
+            case OAS_LAYERNAME_TEXT:
+                stream.skipString();
+                readInterval(stream);
+                readInterval(stream);
+                break;
+            case OAS_CELL_REFNUM: {
+                CellName name;
+                name.by_refnum = true;
+                name.refnum = stream.readUnsigned();
+                if (scanning_) cutSegment(record_begin);
+                else beginCell(name);
+                break;
+            }
+            case OAS_CELL_NAME: {
+                CellName name;
+                name.name = stream.readString();
+                if (scanning_) cutSegment(record_begin);
+                else beginCell(name);
+                break;
+            }
+            case OAS_XYABSOLUTE:
+                modal_.xy_relative = false;
+                break;
+            case OAS_XYRELATIVE:
+                modal_.xy_relative = true;
+                break;
+            case OAS_PLACEMENT:
+                readPlacement(stream, false);
+                break;
+            case OAS_PLACEMENT_TRANSFORM:
+                readPlacement(stream, true);
+                break;
+            case OAS_TEXT:
+                readText(stream);
+                break;
+            case OAS_RECTANGLE:
+                readRectangle(stream);
+                break;
+            case OAS_POLYGON:
+                readPolygon(stream);
+                break;
+            case OAS_PATH:
+                readPath(stream);
+                break;
+            case OAS_TRAPEZOID:
+            case OAS_TRAPEZOID_A:
+            case OAS_TRAPEZOID_B:
+                readTrapezoid(stream, static_cast<uint8_t>(record_type));
+                break;
+            case OAS_CTRAPEZOID:
+                readCTrapezoid(stream);
+                break;
+            case OAS_CIRCLE:
+                readCircle(stream);
+                break;
+            case OAS_PROPERTY:
+                readProperty(stream);
+                break;
+            case OAS_PROPERTY_REPEAT:
+                break;
+            case OAS_XNAME_IMPLICIT:
+                stream.readUnsigned();
+                stream.skipString();
+                break;
+            case OAS_XNAME:
+                stream.readUnsigned();
+                stream.skipString();
+                stream.readUnsigned();
+                break;
+            case OAS_XELEMENT:
+                stream.readUnsigned();
+                stream.skipString();
+                break;
+            case OAS_XGEOMETRY:
+                readXGeometry(stream);
+                break;
+            case OAS_CBLOCK: {
+                if (in_cblock) stream.fail("nested CBLOCK");
+                Segment block = readCBlockHeader(stream);
+                if (scanning_) {
+                    cutSegment(record_begin);
+                    segments_.push_back(block);
+                    segment_begin_ = block.end;
+                } else {
+                    // Inflated records continue the stream, including its modal state
+                    const std::vector<uint8_t>& buffer = inflateSegment(block);
+                    OasisStream inflated(buffer.data(), block.inflated_size);
+                    parseRecords(inflated, true);
+                }
+                break;
+            }
+            default:
+                stream.fail("unknown record type " + std::to_string(record_type));
+        }
+    }
+    return false;
+}
+
+OASISParser::Segment OASISParser::readCBlockHeader(OasisStream& stream) {
+    uint64_t compression = stream.readUnsigned();
+    uint64_t inflated_size = stream.readUnsigned();
+    uint64_t compressed_size = stream.readUnsigned();
+    if (compression != 0) {
+        stream.fail("unknown CBLOCK compression type " + std::to_string(compression));
+    }
+    // Deflate cannot expand data by more than about 1032:1
+    if (inflated_size > compressed_size * 1032 + 64 || compressed_size > std::numeric_limits<uInt>::max() ||
+        inflated_size > std::numeric_limits<uInt>::max()) {
+        stream.fail("implausible CBLOCK sizes");
+    }
+    Segment block;
+    block.compressed = true;
+    block.begin = stream.offset();
+    block.end = block.begin + static_cast<size_t>(compressed_size);
+    block.inflated_size = static_cast<size_t>(inflated_size);
+    stream.skip(static_cast<size_t>(compressed_size));
+    return block;
+}
+
+const std::vector<uint8_t>& OASISParser::inflateSegment(const Segment& block) const {
+    thread_local std::vector<uint8_t> buffer; // Reused for every CBLOCK inflated on this thread
+    if (buffer.size() < block.inflated_size) {
+        buffer.resize(block.inflated_size);
+    }
+    size_t produced = threadInflater().inflate(data_ + block.begin, block.end - block.begin, buffer.data(),
+                                               block.inflated_size, false);
+    if (produced != block.inflated_size) {
+        std::ostringstream oss;
+        oss << "Malformed OASIS data at offset " << block.begin << ": CBLOCK inflated to " << produced
+            << " bytes instead of " << block.inflated_size;
+        throw std::runtime_error(oss.str());
+    }
+    return buffer;
+}
+
+void OASISParser::cutSegment(size_t offset) {
+    if (offset > segment_begin_) {
+        Segment segment;
+        segment.begin = segment_begin_;
+        segment.end = offset;
+        segments_.push_back(segment);
+    }
+    segment_begin_ = offset;
+}
+
+uint64_t OASISParser::firstRecordType(const Segment& segment) const {
+    uint8_t head[10];
+    size_t length = 0;
+    if (segment.compressed) {
+        length = threadInflater().inflate(data_ + segment.begin, segment.end - segment.begin, head,
+                                          std::min(sizeof(head), segment.inflated_size), true);
+    } else {
+        length = std::min(sizeof(head), segment.end - segment.begin);
+        std::memcpy(head, data_ + segment.begin, length);
+    }
+    OasisStream stream(head, length);
+    return stream.atEnd() ? static_cast<uint64_t>(OAS_PAD) : stream.readUnsigned();
+}
+
+void OASISParser::parseParallel(OasisStream& stream) {
+    // Structural pass over the top-level records: locate CBLOCKs and cut the stream at CELL records
+    scanning_ = true;
+    segments_.clear();
+    segment_begin_ = stream.offset();
+    bool reached_end = parseRecords(stream, false);
+    scanning_ = false;
+    modal_ = Modal();
+    if (!reached_end) {
+        stream.fail("missing END record");
+    }
+
+    // Modal variables are reset by every CELL record, so a run of segments that starts with one
+    // can be parsed independently. Other segments continue the run before them.
+    std::vector<uint64_t> first_types(segments_.size());
+    parallelFor(segments_.size(), thread_count_, [&](size_t s) { first_types[s] = firstRecordType(segments_[s]); });
+    std::vector<size_t> unit_begins;
+    for (size_t s = 0; s < segments_.size(); ++s) {
+        if (unit_begins.empty() || first_types[s] == OAS_CELL_REFNUM || first_types[s] == OAS_CELL_NAME) {
+            unit_begins.push_back(s);
+        }
+    }
+    unit_begins.push_back(segments_.size());
+    size_t unit_count = unit_begins.size() - 1;
+    size_t compressed = std::count_if(segments_.begin(), segments_.end(), [](const Segment& s) { return s.compressed; });
+    std::ostringstream oss;
+    oss << "Parsing " << unit_count << " OASIS cell runs with " << compressed << " CBLOCKs on "
+        << thread_count_ << " threads";
+    LOG_INFO(oss.str());
+
+    std::vector<std::unique_ptr<OASISParser>> workers(unit_count);
+    std::vector<std::set<std::pair<int, int>>> catalogs(unit_count);
+    parallelFor(unit_count, thread_count_, [&](size_t u) {
+        auto worker = std::make_unique<OASISParser>(data_, size_);
+        worker->unit_ = unit_;
+        worker->keep_repetitions_ = keep_repetitions_;
+        worker->layer_keys_ = layer_keys_;
+        worker->catalog_ = &catalogs[u];
+        for (size_t s = unit_begins[u]; s < unit_begins[u + 1]; ++s) {
+            const Segment& segment = segments_[s];
+            if (segment.compressed) {
+                const std::vector<uint8_t>& buffer = worker->inflateSegment(segment);
+                OasisStream inflated(buffer.data(), segment.inflated_size);
+                worker->parseRecords(inflated, true);
+            } else {
+                OasisStream raw(data_, segment.end, segment.begin);
+                worker->parseRecords(raw, false);
+            }
+        }
+        workers[u] = std::move(worker);
+    });
+
+    // Merge in file order so the result does not depend on scheduling
+    for (size_t u = 0; u < unit_count; ++u) {
+        OASISParser& worker = *workers[u];
+        cells_.insert(cells_.end(), std::make_move_iterator(worker.cells_.begin()),
+                      std::make_move_iterator(worker.cells_.end()));
+        name_records_.insert(name_records_.end(), std::make_move_iterator(worker.name_records_.begin()),
+                             std::make_move_iterator(worker.name_records_.end()));
+        catalog_->insert(catalogs[u].begin(), catalogs[u].end());
+        shape_count_ += worker.shape_count_;
+        placement_count_ += worker.placement_count_;
+        workers[u].reset();
+    }
+    segments_.clear();
+}
+
+void OASISParser::buildHierarchy(LayoutHierarchy& hierarchy) {
+    // CELLNAME records may follow their use, so names are resolved only now
+    cell_names_.clear();
+    uint64_t next_refnum = 0;
+    for (const auto& record : name_records_) {
+        cell_names_[record.implicit ? next_refnum++ : record.refnum] = record.name;
+    }
+    for (auto& parsed : cells_) {
+        int index = hierarchy.addCell(resolveName(parsed.name));
+        Cell& cell = hierarchy.cell(index);
+        cell.layers = std::move(parsed.layers);
+        cell.shapes = std::move(parsed.shapes);
+        cell.repetitions = std::move(parsed.repetitions);
+        cell.decoded_layers = *layer_keys_;
+        for (const auto& placement : parsed.placements) {
+            CellReference reference;
+            reference.cell_name = resolveName(placement.target);
+            reference.transform = placement.transform;
+            if (!placement.repeated) {
+                cell.references.push_back(reference);
+            } else if (placement.repetition.isGrid()) {
+                const OasisRepetition& rep = placement.repetition;
+                reference.columns = static_cast<int>(rep.columns);
+                reference.rows = static_cast<int>(rep.rows);
+                reference.column_step = Point(static_cast<double>(rep.column_step.x),
+                                              static_cast<double>(rep.column_step.y));
+                reference.row_step = Point(static_cast<double>(rep.row_step.x), static_cast<double>(rep.row_step.y));
+                cell.references.push_back(reference);
+            } else {
+                for (const auto& offset : placement.repetition.offsets) {
+                    CellReference instance = reference;
+                    instance.transform = CellTransform::translation(static_cast<double>(offset.x),
+                                                                    static_cast<double>(offset.y)) * reference.transform;
+                    cell.references.push_back(instance);
+                }
+            }
+        }
+    }
+    hierarchy.unit_scale = 1.0 / unit_;
+    hierarchy.resolveReferences();
+
+    std::ostringstream oss;
+    oss << "Parsed OASIS file: " << cells_.size() << " cells, " << placement_count_ << " placements, "
+        << shape_count_ << " shapes on requested layers, " << catalog_->size() << " layers";
+    LOG_INFO(oss.str());
+    cells_.clear();
+    name_records_.clear();
+}
+
+void OASISParser::readStart(OasisStream& stream) {
+    std::string version = stream.readString();
+    unit_ = stream.readReal();
+    if (!(unit_ > 0.0) || std::isinf(unit_)) {
+        std::ostringstream oss;
+        oss << "Invalid OASIS unit " << unit_ << ", using fallback 1000 per micron";
+        LOG_WARN(oss.str());
+        unit_ = 1000.0;
+    }
+    uint64_t offset_flag = stream.readUnsigned();
+    if (offset_flag == 0) {
+        for (int i = 0; i < 12; ++i) { // Six name tables: flag and offset each
+            stream.readUnsigned();
+        }
+    }
+    std::ostringstream oss;
+    oss << "OASIS START: version=" << version << ", unit=" << unit_ << " per micron";
+    LOG_INFO(oss.str());
+}
+
+void OASISParser::beginCell(const CellName& name) {
+    cells_.emplace_back();
+    cells_.back().name = name;
+    // Modal variables do not carry over from one cell to the next
+    modal_ = Modal();
+}
+
+OASISParser::ParsedCell& OASISParser::currentCell(OasisStream& stream) {
+    if (cells_.empty()) {
+        stream.fail("element record outside of a CELL");
+    }
+    return cells_.back();
+}
+
+std::string OASISParser::resolveName(const CellName& name) const {
+    if (!name.by_refnum) {
+        return name.name;
+    }
+    auto it = cell_names_.find(name.refnum);
+    if (it == cell_names_.end()) {
+        LOG_WARN("Undefined OASIS CELLNAME reference " + std::to_string(name.refnum));
+        return "#" + std::to_string(name.refnum);
+    }
+    return it->second;
+}
+
+int64_t OASISParser::readCoordinate(OasisStream& stream, int64_t& modal_value) {
+    int64_t value = stream.readSigned();
+    modal_value = modal_.xy_relative ? modal_value + value : value;
+    return modal_value;
+}
+
+void OASISParser::readLayerAndDatatype(OasisStream& stream, uint8_t info) {
+    if (info & 0x01) modal_.layer = stream.readUnsigned();
+    if (info & 0x02) modal_.datatype = stream.readUnsigned();
+}
+
+void OASISParser::readGeometryPosition(OasisStream& stream, uint8_t info) {
+    if (info & 0x10) readCoordinate(stream, modal_.geometry_x);
+    if (info & 0x08) readCoordinate(stream, modal_.geometry_y);
+    if (info & 0x04) readRepetition(stream);
+}
+
+void OASISParser::addShape(OasisStream& stream, const std::vector<Point>& outline, bool repeated) {
+    ParsedCell& cell = currentCell(stream);
+    std::pair<int, int> key(static_cast<int>(modal(modal_.layer, "layer", stream)),
+                            static_cast<int>(modal(modal_.datatype, "datatype", stream)));
+    catalog_->insert(key);
+    cell.layers.insert(key);
+    if (!layer_keys_->count(key) || outline.size() < 3) {
+        return;
+    }
+
+    auto outlineAt = [&](const OasisDelta& offset) {
+        Polygon poly;
+        poly.points.reserve(outline.size());
+        double x = static_cast<double>(modal_.geometry_x + offset.x);
+        double y = static_cast<double>(modal_.geometry_y + offset.y);
+        poly.bbox = BoundingBox::empty();
+        for (const auto& p : outline) {
+            poly.points.emplace_back(p.x + x, p.y + y);
+            poly.bbox.include(poly.points.back());
+        }
+        if (poly.points.size() > 1 && poly.points.front() == poly.points.back()) {
+            poly.points.pop_back();
+        }
+        return poly;
+    };
+    PolygonList& shapes = cell.shapes[key];
+    auto place = [&](const OasisDelta& offset) {
+        shapes.push_back(outlineAt(offset));
+        shape_count_++;
+    };
+    if (!repeated) {
+        place(OasisDelta());
+        return;
+    }
+    const OasisRepetition& rep = modal(modal_.repetition, "repetition", stream);
+    if (keep_repetitions_ && rep.count() > 1) {
+        ShapeRepetition compact;
+        compact.shape = outlineAt(OasisDelta());
+        if (rep.isGrid()) {
+            compact.columns = static_cast<int>(rep.columns);
+            compact.rows = static_cast<int>(rep.rows);
+            compact.column_step = Point(static_cast<double>(rep.column_step.x), static_cast<double>(rep.column_step.y));
+            compact.row_step = Point(static_cast<double>(rep.row_step.x), static_cast<double>(rep.row_step.y));
+        } else {
+            compact.offsets.reserve(rep.offsets.size());
+            for (const auto& offset : rep.offsets) {
+                compact.offsets.emplace_back(static_cast<double>(offset.x), static_cast<double>(offset.y));
+            }
+            compact.sortOffsets();
+        }
+        shape_count_ += compact.count();
+        cell.repetitions[key].push_back(std::move(compact));
+        return;
+    }
+    if (!rep.isGrid()) {
+        for (const auto& offset : rep.offsets) {
+            place(offset);
+        }
+        return;
+    }
+    for (int64_t r = 0; r < rep.rows; ++r) {
+        for (int64_t c = 0; c < rep.columns; ++c) {
+            OasisDelta offset;
+            offset.x = c * rep.column_step.x + r * rep.row_step.x;
+            offset.y = c * rep.column_step.y + r * rep.row_step.y;
+            place(offset);
+        }
+    }
+}
+
+void OASISParser::readPlacement(OasisStream& stream, bool with_transform) {
+    uint8_t info = stream.readByte();
+    if (info & 0x80) {
+        CellName target;
+        if (info & 0x40) {
+            target.by_refnum = true;
+            target.refnum = stream.readUnsigned();
+        } else {
+            target.name = stream.readString();
+        }
+        modal_.placement_cell = target;
+    }
+    double magnification = 1.0;
+    double angle = 0.0;
+    if (with_transform) {
+        if (info & 0x04) magnification = stream.readReal();
+        if (info & 0x02) angle = stream.readReal();
+    } else {
+        angle = 90.0 * ((info >> 1) & 0x03);
+    }
+    if (info & 0x20) readCoordinate(stream, modal_.placement_x);
+    if (info & 0x10) readCoordinate(stream, modal_.placement_y);
+    bool repeated = (info & 0x08) != 0;
+    if (repeated) readRepetition(stream);
+    if (scanning_) return;
+
+    ParsedPlacement placement;
+    placement.target = modal(modal_.placement_cell, "placement-cell", stream);
+    placement.transform = CellTransform::fromPlacement(static_cast<double>(modal_.placement_x),
+                                                       static_cast<double>(modal_.placement_y), angle, magnification,
+                                                       (info & 0x01) != 0);
+    if (repeated) {
+        placement.repeated = true;
+        placement.repetition = *modal_.repetition;
+    }
+    currentCell(stream).placements.push_back(std::move(placement));
+    placement_count_++;
+}
+
+void OASISParser::readText(OasisStream& stream) {
+    uint8_t info = stream.readByte();
+    if (info & 0x40) {
+        if (info & 0x20) {
+            stream.readUnsigned();
+        } else {
+            stream.skipString();
+        }
+    }
+    if (info & 0x01) modal_.textlayer = stream.readUnsigned();
+    if (info & 0x02) modal_.texttype = stream.readUnsigned();
+    if (info & 0x10) readCoordinate(stream, modal_.text_x);
+    if (info & 0x08) readCoordinate(stream, modal_.text_y);
+    if (info & 0x04) readRepetition(stream);
+}
+
+void OASISParser::readRectangle(OasisStream& stream) {
+    uint8_t info = stream.readByte();
+    readLayerAndDatatype(stream, info);
+    if (info & 0x40) modal_.geometry_w = stream.readUnsigned();
+    if (info & 0x20) modal_.geometry_h = stream.readUnsigned();
+    readGeometryPosition(stream, info);
+    if (scanning_) return;
+    if (info & 0x80) { // Square
+        modal_.geometry_h = modal(modal_.geometry_w, "geometry-w", stream);
+    }
+    double w = static_cast<double>(modal(modal_.geometry_w, "geometry-w", stream));
+    double h = static_cast<double>(modal(modal_.geometry_h, "geometry-h", stream));
+    addShape(stream, {Point(0, 0), Point(w, 0), Point(w, h), Point(0, h)}, (info & 0x04) != 0);
+}
+
+void OASISParser::readPolygon(OasisStream& stream) {
+    uint8_t info = stream.readByte();
+    readLayerAndDatatype(stream, info);
+    if (info & 0x20) modal_.polygon_points = readPointList(stream, true);
+    readGeometryPosition(stream, info);
+    if (scanning_) return;
+    std::vector<Point> outline;
+    for (const auto& d : modal(modal_.polygon_points, "polygon-point-list", stream)) {
+        outline.emplace_back(static_cast<double>(d.x), static_cast<double>(d.y));
+    }
+    addShape(stream, outline, (info & 0x04) != 0);
+}
+
+void OASISParser::readPath(OasisStream& stream) {
+    uint8_t info = stream.readByte();
+    readLayerAndDatatype(stream, info);
+    if (info & 0x40) modal_.path_halfwidth = stream.readUnsigned();
+    if (info & 0x80) {
+        uint64_t scheme = stream.readUnsigned();
+        auto extension = [&](uint64_t code, std::optional<int64_t>& value) {
+            switch (code & 0x03) {
+                case 1: value = 0; break;
+                case 2:
+                    if (!scanning_) value = static_cast<int64_t>(modal(modal_.path_halfwidth, "path-halfwidth", stream));
+                    break;
+                case 3: value = stream.readSigned(); break;
+                default: break; // Keep the modal extension
+            }
+        };
+        extension(scheme >> 2, modal_.path_start_extension);
+        extension(scheme, modal_.path_end_extension);
+    }
+    if (info & 0x20) modal_.path_points = readPointList(stream, false);
+    readGeometryPosition(stream, info);
+    if (scanning_) return;
+
+    std::vector<Point> spine;
+    for (const auto& d : modal(modal_.path_points, "path-point-list", stream)) {
+        spine.emplace_back(static_cast<double>(d.x), static_cast<double>(d.y));
+    }
+    Polygon outline = pathOutline(spine, static_cast<double>(modal(modal_.path_halfwidth, "path-halfwidth", stream)),
+                                  static_cast<double>(modal(modal_.path_start_extension, "path-start-extension", stream)),
+                                  static_cast<double>(modal(modal_.path_end_extension, "path-end-extension", stream)));
+    addShape(stream, {outline.points.begin(), outline.points.end()}, (info & 0x04) != 0);
+}
+
+void OASISParser::readTrapezoid(OasisStream& stream, uint8_t record_type) {
+    uint8_t info = stream.readByte();
+    readLayerAndDatatype(stream, info);
+    if (info & 0x40) modal_.geometry_w = stream.readUnsigned();
+    if (info & 0x20) modal_.geometry_h = stream.readUnsigned();
+    int64_t delta_a = record_type != OAS_TRAPEZOID_B ? stream.readSigned() : 0;
+    int64_t delta_b = record_type != OAS_TRAPEZOID_A ? stream.readSigned() : 0;
+    readGeometryPosition(stream, info);
+    if (scanning_) return;
+
+    double w = static_cast<double>(modal(modal_.geometry_w, "geometry-w", stream));
+    double h = static_cast<double>(modal(modal_.geometry_h, "geometry-h", stream));
+    double a = static_cast<double>(delta_a), b = static_cast<double>(delta_b);
+    std::vector<Point> outline;
+    if (info & 0x80) { // Vertical: the deltas move the ends of the left and right edges
+        outline = {Point(0, std::max(a, 0.0)), Point(0, h + std::min(b, 0.0)),
+                   Point(w, h - std::max(b, 0.0)), Point(w, -std::min(a, 0.0))};
+    } else {           // Horizontal: the deltas move the ends of the top and bottom edges
+        outline = {Point(std::max(a, 0.0), h), Point(w + std::min(b, 0.0), h),
+                   Point(w - std::max(b, 0.0), 0), Point(-std::min(a, 0.0), 0)};
+    }
+    addShape(stream, outline, (info & 0x04) != 0);
+}
+
+void OASISParser::readCTrapezoid(OasisStream& stream) {
+    uint8_t info = stream.readByte();
+    readLayerAndDatatype(stream, info);
+    if (info & 0x80) modal_.ctrapezoid_type = stream.readUnsigned();
+    if (info & 0x40) modal_.geometry_w = stream.readUnsigned();
+    if (info & 0x20) modal_.geometry_h = stream.readUnsigned();
+    readGeometryPosition(stream, info);
+    if (scanning_) return;
+
+    uint64_t type = modal(modal_.ctrapezoid_type, "ctrapezoid-type", stream);
+    if (type > 25) {
+        stream.fail("invalid CTRAPEZOID type " + std::to_string(type));
+    }
+    // Some types imply one dimension from the other
+    double w = 0.0, h = 0.0;
+    if (type == 20 || type == 21) {
+        h = static_cast<double>(modal(modal_.geometry_h, "geometry-h", stream));
+        w = 2.0 * h;
+    } else {
+        w = static_cast<double>(modal(modal_.geometry_w, "geometry-w", stream));
+        if ((type >= 16 && type <= 19) || type == 25) {
+            h = w;
+        } else if (type == 22 || type == 23) {
+            h = 2.0 * w;
+        } else {
+            h = static_cast<double>(modal(modal_.geometry_h, "geometry-h", stream));
+        }
+    }
+    size_t vertex_count = (type >= 16 && type <= 23) ? 3 : 4;
+    std::vector<Point> outline;
+    for (size_t i = 0; i < vertex_count; ++i) {
+        const CTrapezoidVertex& v = CTRAPEZOID_VERTICES[type][i];
+        outline.emplace_back(v.wx * w + v.hx * h, v.wy * w + v.hy * h);
+    }
+    addShape(stream, outline, (info & 0x04) != 0);
+}
+
+void OASISParser::readCircle(OasisStream& stream) {
+    uint8_t info = stream.readByte();
+    readLayerAndDatatype(stream, info);
+    if (info & 0x20) modal_.circle_radius = stream.readUnsigned();
+    readGeometryPosition(stream, info);
+    if (scanning_) return;
+
+    // Approximated by a regular polygon on the database grid
+    double radius = static_cast<double>(modal(modal_.circle_radius, "circle-radius", stream));
+    std::vector<Point> outline;
+    for (int i = 0; i < CIRCLE_SEGMENTS; ++i) {
+        double angle = 2.0 * M_PI * i / CIRCLE_SEGMENTS;
+        Point p(std::round(radius * std::cos(angle)), std::round(radius * std::sin(angle)));
+        if (outline.empty() || !(outline.back() == p)) {
+            outline.push_back(p);
+        }
+    }
+    addShape(stream, outline, (info & 0x04) != 0);
+}
+
+void OASISParser::readXGeometry(OasisStream& stream) {
+    uint8_t info = stream.readByte();
+    stream.readUnsigned(); // Attribute
+    readLayerAndDatatype(stream, info);
+    stream.skipString();
+    readGeometryPosition(stream, info);
+    if (scanning_) return;
+    currentCell(stream).layers.emplace(static_cast<int>(modal(modal_.layer, "layer", stream)),
+                                       static_cast<int>(modal(modal_.datatype, "datatype", stream)));
+}
+
+void OASISParser::readProperty(OasisStream& stream) {
+    uint8_t info = stream.readByte();
+    if (info & 0x04) {
+        if (info & 0x02) {
+            stream.readUnsigned();
+        } else {
+            stream.skipString();
+        }
+    }
+    if (info & 0x08) { // Reuses the last value list
+        return;
+    }
+    uint64_t value_count = info >> 4;
+    if (value_count == 15) {
+        value_count = stream.readUnsigned();
+    }
+    for (uint64_t i = 0; i < value_count; ++i) {
+        readPropertyValue(stream);
+    }
+}
+
+void OASISParser::readPropertyValue(OasisStream& stream) {
+    uint64_t type = stream.readUnsigned();
+    if (type <= 7) {
+        stream.readReal(type);
+    } else if (type == 8 || type == 9 || (type >= 13 && type <= 15)) {
+        stream.readUnsigned(); // Integer or property string reference
+    } else if (type >= 10 && type <= 12) {
+        stream.skipString();
+    } else {
+        stream.fail("unknown property value type " + std::to_string(type));
+    }
+}
+
+void OASISParser::readInterval(OasisStream& stream) {
+    uint64_t type = stream.readUnsigned();
+    if (type > 4) {
+        stream.fail("unknown interval type " + std::to_string(type));
+    }
+    if (type >= 1) stream.readUnsigned();
+    if (type == 4) stream.readUnsigned();
+}
+
+void OASISParser::readRepetition(OasisStream& stream) {
+    uint64_t type = stream.readUnsigned();
+    if (type == 0) { // Reuse the previous repetition
+        if (!scanning_) modal(modal_.repetition, "repetition", stream);
+        return;
+    }
+    OasisRepetition rep;
+    auto readOffsets = [&](bool along_x, bool with_grid) {
+        uint64_t count = stream.readUnsigned() + 2;
+        int64_t grid = with_grid ? static_cast<int64_t>(stream.readUnsigned()) : 1;
+        int64_t position = 0;
+        rep.offsets.push_back(OasisDelta());
+        for (uint64_t i = 1; i < count; ++i) {
+            position += static_cast<int64_t>(stream.readUnsigned()) * grid;
+            OasisDelta offset;
+            (along_x ? offset.x : offset.y) = position;
+            rep.offsets.push_back(offset);
+        }
+    };
+    switch (type) {
+        case 1:
+            rep.columns = static_cast<int64_t>(stream.readUnsigned()) + 2;
+            rep.rows = static_cast<int64_t>(stream.readUnsigned()) + 2;
+            rep.column_step.x = static_cast<int64_t>(stream.readUnsigned());
+            rep.row_step.y = static_cast<int64_t>(stream.readUnsigned());
+            break;
+        case 2:
+            rep.columns = static_cast<int64_t>(stream.readUnsigned()) + 2;
+            rep.column_step.x = static_cast<int64_t>(stream.readUnsigned());
+            break;
+        case 3:
+            rep.rows = static_cast<int64_t>(stream.readUnsigned()) + 2;
+            rep.row_step.y = static_cast<int64_t>(stream.readUnsigned());
+            break;
+        case 4:
+        case 5:
+            readOffsets(true, type == 5);
+            break;
+        case 6:
+        case 7:
+            readOffsets(false, type == 7);
+            break;
+        case 8:
+            rep.columns = static_cast<int64_t>(stream.readUnsigned()) + 2;
+            rep.rows = static_cast<int64_t>(stream.readUnsigned()) + 2;
+            rep.column_step = stream.readGDelta();
+            rep.row_step = stream.readGDelta();
+            break;
+        case 9:
+            rep.columns = static_cast<int64_t>(stream.readUnsigned()) + 2;
+            rep.column_step = stream.readGDelta();
+            break;
+        case 10:
+        case 11: {
+            uint64_t count = stream.readUnsigned() + 2;
+            int64_t grid = type == 11 ? static_cast<int64_t>(stream.readUnsigned()) : 1;
+            OasisDelta position;
+            rep.offsets.push_back(position);
+            for (uint64_t i = 1; i < count; ++i) {
+                OasisDelta delta = stream.readGDelta();
+                position.x += delta.x * grid;
+                position.y += delta.y * grid;
+                rep.offsets.push_back(position);
+            }
+            break;
+        }
+        default:
+            stream.fail("unknown repetition type " + std::to_string(type));
+    }
+    modal_.repetition = std::move(rep);
+}
+
+std::vector<OasisDelta> OASISParser::readPointList(OasisStream& stream, bool polygon) {
+    uint64_t type = stream.readUnsigned();
+    uint64_t count = stream.readUnsigned();
+    if (!stream.canRead(count)) { // Every delta takes at least one byte
+        stream.fail("point list longer than the file");
+    }
+    std::vector<OasisDelta> points;
+    points.reserve(count + 2);
+    OasisDelta position;
+    points.push_back(position);
+    switch (type) {
+        case 0:
+        case 1: { // Manhattan, alternating horizontal and vertical 1-deltas
+            bool horizontal = type == 0;
+            for (uint64_t i = 0; i < count; ++i) {
+                (horizontal ? position.x : position.y) += stream.readSigned();
+                points.push_back(position);
+                horizontal = !horizontal;
+            }
+            if (polygon) { // The closing edge pair is implicit
+                OasisDelta last = position;
+                (horizontal ? last.x : last.y) = 0;
+                points.push_back(last);
+            }
+            break;
+        }
+        case 2:
+        case 3:
+        case 4:
+            for (uint64_t i = 0; i < count; ++i) {
+                OasisDelta delta = type == 2 ? stream.readTwoDelta()
+                                 : type == 3 ? stream.readThreeDelta() : stream.readGDelta();
+                position.x += delta.x;
+                position.y += delta.y;
+                points.push_back(position);
+            }
+            break;
+        case 5: { // Each g-delta changes the previous displacement
+            OasisDelta step;
+            for (uint64_t i = 0; i < count; ++i) {
+                OasisDelta delta = stream.readGDelta();
+                step.x += delta.x;
+                step.y += delta.y;
+                position.x += step.x;
+                position.y += step.y;
+                points.push_back(position);
+            }
+            break;
+        }
+        default:
+            stream.fail("unknown point list type " + std::to_string(type));
+    }
+    return points;
+}
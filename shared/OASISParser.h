@@ -0,0 +1,167 @@
+#ifndef OASIS_PARSER_H
+#define OASIS_PARSER_H
+
+#include "LayoutHierarchy.h"
+#include "OASISRecords.h"
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Positions described by an OASIS repetition, relative to the first instance
+struct OasisRepetition {
+    // Regular grid of columns x rows with arbitrary step vectors (types 1, 2, 3, 8 and 9)
+    int64_t columns = 1;
+    int64_t rows = 1;
+    OasisDelta column_step;
+    OasisDelta row_step;
+    // Explicit positions, including the first one at (0,0) (types 4-7, 10 and 11); empty for grids
+    std::vector<OasisDelta> offsets;
+
+    bool isGrid() const { return offsets.empty(); }
+    size_t count() const { return isGrid() ? static_cast<size_t>(columns * rows) : offsets.size(); }
+};
+
+// Streaming parser for OASIS (SEMI P39) layout files. One pass over the record stream
+// fills a LayoutHierarchy with every cell, its placements, and the geometry of the
+// requested layers in cell-local database units.
+// With several threads, a structural pass first cuts the stream at CELL records and CBLOCKs;
+// the runs of records that start a cell are then inflated and parsed concurrently and merged
+// in file order, so the result is the same for any thread count.
+class OASISParser {
+public:
+    OASISParser(const uint8_t* data, size_t size);
+    // Parses a whole file; a compressed one is parsed while it is still being decompressed
+    explicit OASISParser(const MappedFile& file);
+    // Threads used to inflate CBLOCKs and parse cells (1 = sequential)
+    void setThreadCount(int thread_count);
+    // Keep repeated shapes as one ShapeRepetition instead of one polygon per instance
+    void setKeepRepetitions(bool keep);
+
+    // Parses the whole file. Geometry is decoded only for layer_keys; every layer:datatype
+    // pair drawn in the file is added to catalog. Throws std::runtime_error on malformed data.
+    void parse(const std::set<std::pair<int, int>>& layer_keys, LayoutHierarchy& hierarchy,
+               std::set<std::pair<int, int>>& catalog);
+    // Database units per micron from the START record, without parsing the rest of the file
+    static double readUnit(const MappedFile& file);
+
+private:
+    // A cell is referred to by a CELLNAME reference number or directly by its name
+    struct CellName {
+        bool by_refnum = false;
+        uint64_t refnum = 0;
+        std::string name;
+    };
+
+    // CELLNAME record; implicit reference numbers are assigned in file order after parsing
+    struct CellNameRecord {
+        bool implicit = true;
+        uint64_t refnum = 0;
+        std::string name;
+    };
+
+    // Part of the top-level record stream: plain file bytes or one compressed CBLOCK
+    struct Segment {
+        size_t begin = 0, end = 0;  // File byte range; the deflate data for a CBLOCK
+        bool compressed = false;
+        size_t inflated_size = 0;
+    };
+
+    struct ParsedPlacement {
+        CellName target;
+        CellTransform transform;
+        bool repeated = false;
+        OasisRepetition repetition;
+    };
+
+    struct ParsedCell {
+        CellName name;
+        std::set<std::pair<int, int>> layers;
+        std::map<std::pair<int, int>, PolygonList> shapes;
+        std::map<std::pair<int, int>, std::vector<ShapeRepetition>> repetitions;
+        std::vector<ParsedPlacement> placements;
+    };
+
+    // Modal variables; unset optionals are undefined until a record assigns them
+    struct Modal {
+        bool xy_relative = false;
+        int64_t placement_x = 0, placement_y = 0;
+        int64_t geometry_x = 0, geometry_y = 0;
+        int64_t text_x = 0, text_y = 0;
+        std::optional<CellName> placement_cell;
+        std::optional<uint64_t> layer, datatype;
+        std::optional<uint64_t> textlayer, texttype;
+        std::optional<uint64_t> geometry_w, geometry_h;
+        std::optional<std::vector<OasisDelta>> polygon_points, path_points;
+        std::optional<uint64_t> path_halfwidth;
+        std::optional<int64_t> path_start_extension, path_end_extension;
+        std::optional<uint64_t> ctrapezoid_type;
+        std::optional<uint64_t> circle_radius;
+        std::optional<OasisRepetition> repetition;
+    };
+
+    void readStart(OasisStream& stream);
+    // Parses records up to END (returns true) or the end of the stream (returns false)
+    bool parseRecords(OasisStream& stream, bool in_cblock);
+    void parseParallel(OasisStream& stream);
+    void buildHierarchy(LayoutHierarchy& hierarchy);
+    Segment readCBlockHeader(OasisStream& stream);
+    // Inflates a CBLOCK into a buffer owned by the calling thread, valid until its next call
+    const std::vector<uint8_t>& inflateSegment(const Segment& block) const;
+    void cutSegment(size_t offset);
+    uint64_t firstRecordType(const Segment& segment) const;
+    void beginCell(const CellName& name);
+    void readPlacement(OasisStream& stream, bool with_transform);
+    void readText(OasisStream& stream);
+    void readRectangle(OasisStream& stream);
+    void readPolygon(OasisStream& stream);
+    void readPath(OasisStream& stream);
+    void readTrapezoid(OasisStream& stream, uint8_t record_type);
+    void readCTrapezoid(OasisStream& stream);
+    void readCircle(OasisStream& stream);
+    void readXGeometry(OasisStream& stream);
+    void readProperty(OasisStream& stream);
+    void readPropertyValue(OasisStream& stream);
+    void readInterval(OasisStream& stream);
+    void readRepetition(OasisStream& stream);
+    std::vector<OasisDelta> readPointList(OasisStream& stream, bool polygon);
+
+    // Shared prefix/suffix of geometry records: layer, datatype, position and repetition
+    void readLayerAndDatatype(OasisStream& stream, uint8_t info);
+    void readGeometryPosition(OasisStream& stream, uint8_t info);
+    int64_t readCoordinate(OasisStream& stream, int64_t& modal_value);
+    // Adds a shape, given relative to the geometry position, to the current cell at every repetition
+    void addShape(OasisStream& stream, const std::vector<Point>& outline, bool repeated);
+    ParsedCell& currentCell(OasisStream& stream);
+
+    template <typename T>
+    const T& modal(const std::optional<T>& value, const char* name, const OasisStream& stream) const {
+        if (!value) stream.fail(std::string("modal variable ") + name + " is undefined");
+        return *value;
+    }
+
+    std::string resolveName(const CellName& name) const;
+
+    const uint8_t* data_;
+    size_t size_;
+    const MappedFile* file_;                   // Streamed instead of data_/size_ when set
+    double unit_;                              // Database units per micron
+    int thread_count_;
+    bool keep_repetitions_;
+    Modal modal_;
+    bool scanning_;                            // Structural pass: records are read but not decoded
+    std::vector<Segment> segments_;            // Filled by the structural pass
+    size_t segment_begin_;
+    std::vector<CellNameRecord> name_records_;
+    std::map<uint64_t, std::string> cell_names_; // CELLNAME table
+    std::vector<ParsedCell> cells_;
+    const std::set<std::pair<int, int>>* layer_keys_;
+    std::set<std::pair<int, int>>* catalog_;
+    size_t shape_count_;
+    size_t placement_count_;
+};
+
+#endif // OASIS_PARSER_H
@@ -0,0 +1,216 @@
+#ifndef OASIS_RECORDS_H
+#define OASIS_RECORDS_H
+
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// OASIS (SEMI P39) record ids
+enum OasisRecordType : uint8_t {
+    OAS_PAD = 0,
+    OAS_START = 1,
+    OAS_END = 2,
+    OAS_CELLNAME_IMPLICIT = 3,
+    OAS_CELLNAME = 4,
+    OAS_TEXTSTRING_IMPLICIT = 5,
+    OAS_TEXTSTRING = 6,
+    OAS_PROPNAME_IMPLICIT = 7,
+    OAS_PROPNAME = 8,
+    OAS_PROPSTRING_IMPLICIT = 9,
+    OAS_PROPSTRING = 10,
+    OAS_LAYERNAME = 11,
+    OAS_LAYERNAME_TEXT = 12,
+    OAS_CELL_REFNUM = 13,
+    OAS_CELL_NAME = 14,
+    OAS_XYABSOLUTE = 15,
+    OAS_XYRELATIVE = 16,
+    OAS_PLACEMENT = 17,
+    OAS_PLACEMENT_TRANSFORM = 18,
+    OAS_TEXT = 19,
+    OAS_RECTANGLE = 20,
+    OAS_POLYGON = 21,
+    OAS_PATH = 22,
+    OAS_TRAPEZOID = 23,
+    OAS_TRAPEZOID_A = 24,
+    OAS_TRAPEZOID_B = 25,
+    OAS_CTRAPEZOID = 26,
+    OAS_CIRCLE = 27,
+    OAS_PROPERTY = 28,
+    OAS_PROPERTY_REPEAT = 29,
+    OAS_XNAME_IMPLICIT = 30,
+    OAS_XNAME = 31,
+    OAS_XELEMENT = 32,
+    OAS_XGEOMETRY = 33,
+    OAS_CBLOCK = 34
+};
+
+const char OASIS_MAGIC[] = "%SEMI-OASIS\r\n";
+const size_t OASIS_MAGIC_SIZE = sizeof(OASIS_MAGIC) - 1;
+
+// Displacement decoded from a 1-, 2-, 3- or g-delta, in database units
+struct OasisDelta {
+    int64_t x = 0;
+    int64_t y = 0;
+};
+
+// Cursor over an in-memory OASIS byte stream. OASIS records carry no length, so every
+// field must be decoded to find the next record; reading past the end throws.
+// A stream over a MappedFile that is still being decompressed waits for bytes as they arrive.
+class OasisStream {
+public:
+    OasisStream(const uint8_t* data, size_t size, size_t offset = 0)
+        : data_(data), size_(size), pos_(offset), file_(nullptr) {}
+    OasisStream(const MappedFile& file, size_t offset = 0)
+        : data_(file.data()), size_(file.waitFor(0)), pos_(offset), file_(&file) {}
+
+    size_t offset() const { return pos_; }
+    bool atEnd() { return pos_ >= size_ && !canRead(1); }
+
+    // Whether count more bytes can be read, waiting for them if the file is still being decompressed
+    bool canRead(size_t count) {
+        if (count <= size_ - std::min(pos_, size_)) return true;
+        if (!file_ || count > SIZE_MAX - pos_) return false;
+        size_ = file_->waitFor(pos_ + count);
+        return count <= size_ - std::min(pos_, size_);
+    }
+
+    uint8_t readByte() {
+        require(1);
+        return data_[pos_++];
+    }
+
+    void skip(size_t count) {
+        require(count);
+        pos_ += count;
+    }
+
+    const uint8_t* readBytes(size_t count) {
+        require(count);
+        const uint8_t* bytes = data_ + pos_;
+        pos_ += count;
+        return bytes;
+    }
+
+    // unsigned-integer: 7 bits per byte, least significant group first
+    uint64_t readUnsigned() {
+        uint64_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t byte = readByte();
+            if (shift > 63) fail("unsigned-integer overflow");
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+    }
+
+    // signed-integer: sign in the lowest bit of an unsigned-integer
+    int64_t readSigned() {
+        uint64_t value = readUnsigned();
+        int64_t magnitude = static_cast<int64_t>(value >> 1);
+        return (value & 1) ? -magnitude : magnitude;
+    }
+
+    double readReal() { return readReal(readUnsigned()); }
+
+    // Real body whose type was already read (property values share the type field with other values)
+    double readReal(uint64_t type) {
+        switch (type) {
+            case 0: return static_cast<double>(readUnsigned());
+            case 1: return -static_cast<double>(readUnsigned());
+            case 2: return 1.0 / static_cast<double>(readUnsigned());
+            case 3: return -1.0 / static_cast<double>(readUnsigned());
+            case 4: {
+                double numerator = static_cast<double>(readUnsigned());
+                return numerator / static_cast<double>(readUnsigned());
+            }
+            case 5: {
+                double numerator = static_cast<double>(readUnsigned());
+                return -numerator / static_cast<double>(readUnsigned());
+            }
+            case 6: {
+                const uint8_t* p = readBytes(4);
+                uint32_t bits = static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+                                static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+                float value;
+                std::memcpy(&value, &bits, sizeof(value));
+                return value;
+            }
+            case 7: {
+                const uint8_t* p = readBytes(8);
+                uint64_t bits = 0;
+                for (int i = 7; i >= 0; --i) {
+                    bits = (bits << 8) | p[i];
+                }
+                double value;
+                std::memcpy(&value, &bits, sizeof(value));
+                return value;
+            }
+            default:
+                fail("unknown real type " + std::to_string(type));
+        }
+        return 0.0;
+    }
+
+    std::string readString() {
+        size_t length = static_cast<size_t>(readUnsigned());
+        const uint8_t* bytes = readBytes(length);
+        return std::string(reinterpret_cast<const char*>(bytes), length);
+    }
+
+    void skipString() { skip(static_cast<size_t>(readUnsigned())); }
+
+    // 2-delta: east, north, west or south
+    OasisDelta readTwoDelta() {
+        uint64_t value = readUnsigned();
+        return octangular(value & 3, static_cast<int64_t>(value >> 2));
+    }
+
+    // 3-delta: the four Manhattan or the four diagonal directions
+    OasisDelta readThreeDelta() {
+        uint64_t value = readUnsigned();
+        return octangular(value & 7, static_cast<int64_t>(value >> 3));
+    }
+
+    // g-delta: an octangular displacement, or an arbitrary one as an x/y pair
+    OasisDelta readGDelta() {
+        uint64_t value = readUnsigned();
+        if (!(value & 1)) {
+            return octangular((value >> 1) & 7, static_cast<int64_t>(value >> 4));
+        }
+        OasisDelta delta;
+        int64_t magnitude = static_cast<int64_t>(value >> 2);
+        delta.x = (value & 2) ? -magnitude : magnitude;
+        delta.y = readSigned();
+        return delta;
+    }
+
+    [[noreturn]] void fail(const std::string& message) const {
+        throw std::runtime_error("Malformed OASIS data at offset " + std::to_string(pos_) + ": " + message);
+    }
+
+private:
+    void require(size_t count) {
+        if (count > size_ - std::min(pos_, size_) && !canRead(count)) {
+            fail("unexpected end of data");
+        }
+    }
+
+    static OasisDelta octangular(uint64_t direction, int64_t magnitude) {
+        static const int DX[8] = {1, 0, -1, 0, 1, -1, -1, 1};
+        static const int DY[8] = {0, 1, 0, -1, 1, 1, -1, -1};
+        OasisDelta delta;
+        delta.x = DX[direction] * magnitude;
+        delta.y = DY[direction] * magnitude;
+        return delta;
+    }
+
+    const uint8_t* data_;
+    size_t size_; // Readable bytes
+    size_t pos_;
+    const MappedFile* file_;
+};
+
+#endif // OASIS_RECORDS_H
@@ -0,0 +1,53 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs task(i) for every i in [0, task_count) on up to thread_count threads.
+// Tasks are handed out dynamically; callers keep results deterministic by writing
+// into per-task slots. The first exception thrown by a task is rethrown here.
+template <typename Task>
+void parallelFor(size_t task_count, int thread_count, Task task) {
+    size_t workers = std::min(task_count, static_cast<size_t>(std::max(thread_count, 1)));
+    if (workers <= 1) {
+        for (size_t i = 0; i < task_count; ++i) {
+            task(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next_task(0);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto worker = [&]() {
+        for (size_t i = next_task++; i < task_count; i = next_task++) {
+            try {
+                task(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (size_t t = 1; t < workers; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+#endif // PARALLEL_FOR_H
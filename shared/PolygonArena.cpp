@@ -0,0 +1,68 @@
+#include "PolygonArena.h"
+#include <algorithm>
+#include <new>
+
+namespace {
+
+const size_t FIRST_CHUNK_BYTES = 64 * 1024;
+const size_t MAX_CHUNK_BYTES = 4 * 1024 * 1024;
+const size_t LARGE_BLOCK_BYTES = 16 * 1024; // Larger blocks bypass the chunks
+
+char* alignUp(char* p, size_t alignment) {
+    auto address = reinterpret_cast<uintptr_t>(p);
+    return p + ((alignment - address % alignment) % alignment);
+}
+
+} // namespace
+
+PolygonArena::PolygonArena()
+    : chunk_(nullptr), current_(nullptr), end_(nullptr), last_block_(nullptr), next_chunk_size_(FIRST_CHUNK_BYTES),
+      allocations_(0), heap_allocations_(0), heap_bytes_(0) {}
+
+PolygonArena::~PolygonArena() {
+    while (chunk_) {
+        Chunk* previous = chunk_->previous;
+        ::operator delete(chunk_, chunk_->size);
+        chunk_ = previous;
+    }
+}
+
+void PolygonArena::addChunk(size_t min_bytes) {
+    size_t size = std::max(next_chunk_size_, min_bytes + sizeof(Chunk));
+    next_chunk_size_ = std::min(next_chunk_size_ * 2, MAX_CHUNK_BYTES);
+    auto* chunk = static_cast<Chunk*>(::operator new(size));
+    chunk->previous = chunk_;
+    chunk->size = size;
+    chunk_ = chunk;
+    current_ = reinterpret_cast<char*>(chunk) + sizeof(Chunk);
+    end_ = reinterpret_cast<char*>(chunk) + size;
+    heap_allocations_++;
+    heap_bytes_ += size;
+}
+
+void* PolygonArena::do_allocate(size_t bytes, size_t alignment) {
+    allocations_++;
+    if (bytes > LARGE_BLOCK_BYTES) {
+        heap_allocations_++;
+        heap_bytes_ += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    char* block = alignUp(current_, alignment);
+    if (!current_ || block + bytes > end_) {
+        addChunk(bytes + alignment);
+        block = alignUp(current_, alignment);
+    }
+    current_ = block + bytes;
+    last_block_ = block;
+    return block;
+}
+
+void PolygonArena::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    if (bytes > LARGE_BLOCK_BYTES) {
+        heap_bytes_ -= bytes;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    } else if (p == last_block_ && static_cast<char*>(p) + bytes == current_) {
+        current_ = last_block_; // E.g. a scratch buffer freed before anything else was allocated
+        last_block_ = nullptr;
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef POLYGON_ARENA_H
+#define POLYGON_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+// Monotonic memory resource for polygon storage. Small blocks (vertex buffers) are carved out of
+// large heap chunks by bumping a pointer and are only given back when the arena is destroyed,
+// except the most recent block, which is reused when freed first. Large blocks (a layer's polygon
+// array) go straight to the heap and are freed at once. A Layer built on an arena (see Layer::arena)
+// allocates the points of every polygon put into it here, so loading or capturing N polygons costs
+// a handful of heap allocations instead of N, and freeing them costs nothing per polygon.
+//
+// Not thread-safe: an arena must only be used by one thread at a time.
+class PolygonArena : public std::pmr::memory_resource {
+public:
+    PolygonArena();
+    ~PolygonArena() override;
+    PolygonArena(const PolygonArena&) = delete;
+    PolygonArena& operator=(const PolygonArena&) = delete;
+
+    uint64_t allocations() const { return allocations_; }          // Blocks handed out
+    uint64_t heapAllocations() const { return heap_allocations_; } // Chunks and large blocks taken from the heap
+    uint64_t heapBytes() const { return heap_bytes_; }             // Currently held from the heap
+
+private:
+    struct Chunk {
+        Chunk* previous;
+        size_t size; // Including this header
+    };
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    void addChunk(size_t min_bytes);
+
+    Chunk* chunk_;       // Most recent chunk; earlier ones are linked through previous
+    char* current_;      // Free space of the current chunk
+    char* end_;
+    char* last_block_;   // Most recent small block, reusable when it is freed first
+    size_t next_chunk_size_;
+    uint64_t allocations_;
+    uint64_t heap_allocations_;
+    uint64_t heap_bytes_;
+};
+
+#endif // POLYGON_ARENA_H
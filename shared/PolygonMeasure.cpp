@@ -0,0 +1,295 @@
+#include "PolygonMeasure.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DFM_MEASURE_SIMD 1
+#define DFM_MEASURE_NOINLINE __attribute__((noinline))
+#include <immintrin.h>
+#else
+#define DFM_MEASURE_NOINLINE
+#endif
+
+namespace {
+
+static_assert(sizeof(Point) == 2 * sizeof(double), "Point must be two packed doubles");
+
+const size_t BLOCK_POINTS = 1024; // Edge buffers of one block stay in the L1 cache
+
+// Writes the cross product x_i * y_i+1 - x_i+1 * y_i and, when Lengths is set, the length of each edge
+// from points[i] to points[i + 1], i < edge_count. Edges that span two polygons are computed too and
+// ignored by the caller.
+using EdgeKernel = void (*)(const Point* points, size_t edge_count, double* cross, double* length);
+
+// Kept out of line: inlined into the AVX-512 kernel, GCC would contract the cross product into an FMA
+// and round it differently from Polygon::calculateArea
+template <bool Lengths>
+DFM_MEASURE_NOINLINE void edgesScalar(const Point* points, size_t edge_count, double* cross, double* length) {
+    for (size_t i = 0; i < edge_count; ++i) {
+        const Point& p = points[i];
+        const Point& q = points[i + 1];
+        cross[i] = p.x * q.y - q.x * p.y;
+        if (Lengths) {
+            double dx = q.x - p.x;
+            double dy = q.y - p.y;
+            length[i] = std::sqrt(dx * dx + dy * dy);
+        }
+    }
+}
+
+#ifdef DFM_MEASURE_SIMD
+
+// Two points per register: lanes x_i, y_i, x_i+1, y_i+1
+template <bool Lengths>
+__attribute__((target("avx2"))) void edgesAVX2(const Point* points, size_t edge_count, double* cross,
+                                               double* length) {
+    const double* d = reinterpret_cast<const double*>(points);
+    size_t i = 0;
+    for (; i + 4 <= edge_count; i += 4) {
+        __m256d a = _mm256_loadu_pd(d + 2 * i);     // Points i, i+1
+        __m256d b = _mm256_loadu_pd(d + 2 * i + 2); // Points i+1, i+2
+        __m256d c = _mm256_loadu_pd(d + 2 * i + 4); // Points i+2, i+3
+        __m256d e = _mm256_loadu_pd(d + 2 * i + 6); // Points i+3, i+4
+        // x_i * y_i+1 and y_i * x_i+1 side by side; their difference is the cross product of edge i
+        __m256d ab = _mm256_mul_pd(a, _mm256_permute_pd(b, 0x5));
+        __m256d ce = _mm256_mul_pd(c, _mm256_permute_pd(e, 0x5));
+        // The horizontal differences come out as edges i, i+2, i+1, i+3
+        _mm256_storeu_pd(cross + i, _mm256_permute4x64_pd(_mm256_hsub_pd(ab, ce), _MM_SHUFFLE(3, 1, 2, 0)));
+        if (Lengths) {
+            __m256d ab_delta = _mm256_sub_pd(b, a);
+            __m256d ce_delta = _mm256_sub_pd(e, c);
+            __m256d squares = _mm256_hadd_pd(_mm256_mul_pd(ab_delta, ab_delta), _mm256_mul_pd(ce_delta, ce_delta));
+            _mm256_storeu_pd(length + i, _mm256_sqrt_pd(_mm256_permute4x64_pd(squares, _MM_SHUFFLE(3, 1, 2, 0))));
+        }
+    }
+    _mm256_zeroupper(); // The scalar tail is SSE code
+    edgesScalar<Lengths>(points + i, edge_count - i, cross + i, length + i);
+}
+
+// Four points per register; even lanes hold x, odd lanes y
+template <bool Lengths>
+__attribute__((target("avx512f"))) void edgesAVX512(const Point* points, size_t edge_count, double* cross,
+                                                    double* length) {
+    const __m512i even = _mm512_set_epi64(14, 12, 10, 8, 6, 4, 2, 0);
+    const __m512i odd = _mm512_set_epi64(15, 13, 11, 9, 7, 5, 3, 1);
+    const double* d = reinterpret_cast<const double*>(points);
+    size_t i = 0;
+    for (; i + 8 <= edge_count; i += 8) {
+        __m512d a = _mm512_loadu_pd(d + 2 * i);      // Points i .. i+3
+        __m512d b = _mm512_loadu_pd(d + 2 * i + 2);  // Points i+1 .. i+4
+        __m512d c = _mm512_loadu_pd(d + 2 * i + 8);  // Points i+4 .. i+7
+        __m512d e = _mm512_loadu_pd(d + 2 * i + 10); // Points i+5 .. i+8
+        __m512d ab = _mm512_mul_pd(a, _mm512_shuffle_pd(b, b, 0x55));
+        __m512d ce = _mm512_mul_pd(c, _mm512_shuffle_pd(e, e, 0x55));
+        _mm512_storeu_pd(cross + i, _mm512_sub_pd(_mm512_permutex2var_pd(ab, even, ce),
+                                                  _mm512_permutex2var_pd(ab, odd, ce)));
+        if (Lengths) {
+            __m512d ab_delta = _mm512_sub_pd(b, a);
+            __m512d ce_delta = _mm512_sub_pd(e, c);
+            __m512d ab_squares = _mm512_mul_pd(ab_delta, ab_delta);
+            __m512d ce_squares = _mm512_mul_pd(ce_delta, ce_delta);
+            __m512d squares = _mm512_add_pd(_mm512_permutex2var_pd(ab_squares, even, ce_squares),
+                                            _mm512_permutex2var_pd(ab_squares, odd, ce_squares));
+            // Masked, as GCC 12 warns about the undefined pass-through operand of _mm512_sqrt_pd
+            _mm512_storeu_pd(length + i, _mm512_maskz_sqrt_pd(0xFF, squares));
+        }
+    }
+    _mm256_zeroupper();
+    edgesScalar<Lengths>(points + i, edge_count - i, cross + i, length + i);
+}
+
+#endif // DFM_MEASURE_SIMD
+
+MeasureKernel detectKernel() {
+    const char* forced = std::getenv("DFM_MEASURE_KERNEL");
+    if (forced) {
+        for (MeasureKernel kernel : {MeasureKernel::Scalar, MeasureKernel::AVX2, MeasureKernel::AVX512}) {
+            if (std::strcmp(forced, measureKernelName(kernel)) == 0 && measureKernelSupported(kernel)) {
+                return kernel;
+            }
+        }
+    }
+    if (measureKernelSupported(MeasureKernel::AVX512)) return MeasureKernel::AVX512;
+    if (measureKernelSupported(MeasureKernel::AVX2)) return MeasureKernel::AVX2;
+    return MeasureKernel::Scalar;
+}
+
+void checkSupported(MeasureKernel kernel) {
+    if (!measureKernelSupported(kernel)) {
+        throw std::invalid_argument(std::string("Measure kernel not supported on this CPU: ") +
+                                    measureKernelName(kernel));
+    }
+}
+
+EdgeKernel edgeKernel(MeasureKernel kernel, bool lengths) {
+    switch (kernel) {
+#ifdef DFM_MEASURE_SIMD
+        case MeasureKernel::AVX512:
+            return lengths ? edgesAVX512<true> : edgesAVX512<false>;
+        case MeasureKernel::AVX2:
+            return lengths ? edgesAVX2<true> : edgesAVX2<false>;
+#endif
+        default:
+            return lengths ? edgesScalar<true> : edgesScalar<false>;
+    }
+}
+
+// Running sums of one polygon, edge by edge in the order of Polygon::calculateArea
+struct OutlineSums {
+    double area = 0.0;
+    double perimeter = 0.0;
+    void add(const double* cross, const double* length, size_t edge_count) {
+        if (length) {
+            // Two independent chains, so each add waits only on its own
+            for (size_t t = 0; t < edge_count; ++t) {
+                area += cross[t];
+                perimeter += length[t];
+            }
+        } else {
+            for (size_t t = 0; t < edge_count; ++t) {
+                area += cross[t];
+            }
+        }
+    }
+};
+
+// Adds the closing edge from the last point back to the first and stores the results of polygon k
+void finishOutline(const Point* outline, size_t n, OutlineSums sums, size_t k, double* areas, double* perimeters) {
+    if (n < 3) {
+        sums = OutlineSums();
+    } else {
+        const Point& p = outline[n - 1];
+        const Point& q = outline[0];
+        sums.area += p.x * q.y - q.x * p.y;
+        double dx = q.x - p.x;
+        double dy = q.y - p.y;
+        sums.perimeter += std::sqrt(dx * dx + dy * dy);
+    }
+    if (areas) areas[k] = std::abs(sums.area) / 2.0;
+    if (perimeters) perimeters[k] = sums.perimeter;
+}
+
+void measureFlat(const Point* points, const uint64_t* offsets, size_t polygon_count, double* areas,
+                 double* perimeters, MeasureKernel kernel) {
+    EdgeKernel edges = edgeKernel(kernel, perimeters != nullptr);
+    double* length_or_null = nullptr;
+    double cross[BLOCK_POINTS];
+    double length[BLOCK_POINTS];
+    if (perimeters) length_or_null = length;
+    size_t i = 0;
+    while (i < polygon_count) {
+        // A run of whole polygons within one block, or a single larger polygon
+        const uint64_t first = offsets[i];
+        size_t j = i + 1;
+        while (j < polygon_count && offsets[j + 1] - first <= BLOCK_POINTS) {
+            ++j;
+        }
+        const uint64_t last = offsets[j];
+        if (last - first > BLOCK_POINTS) {
+            const Point* outline = points + first;
+            size_t n = last - first;
+            OutlineSums sums;
+            for (size_t start = 0; start + 1 < n; start += BLOCK_POINTS) {
+                size_t count = std::min(BLOCK_POINTS, n - 1 - start);
+                edges(outline + start, count, cross, length);
+                sums.add(cross, length_or_null, count);
+            }
+            finishOutline(outline, n, sums, i, areas, perimeters);
+        } else {
+            if (last - first > 1) {
+                edges(points + first, last - first - 1, cross, length);
+            }
+            for (size_t k = i; k < j; ++k) {
+                size_t begin = offsets[k] - first;
+                size_t n = offsets[k + 1] - offsets[k];
+                OutlineSums sums;
+                if (n > 1) {
+                    sums.add(cross + begin, length_or_null ? length + begin : nullptr, n - 1);
+                }
+                finishOutline(points + offsets[k], n, sums, k, areas, perimeters);
+            }
+        }
+        i = j;
+    }
+}
+
+void measureList(const Polygon* polygons, size_t polygon_count, double* areas, double* perimeters,
+                 MeasureKernel kernel) {
+    std::vector<Point> block;
+    std::vector<uint64_t> offsets;
+    block.reserve(BLOCK_POINTS);
+    size_t i = 0;
+    while (i < polygon_count) {
+        // Copies whole polygons until the block is full; a larger polygon fills one by itself
+        block.clear();
+        offsets.assign(1, 0);
+        size_t j = i;
+        do {
+            block.insert(block.end(), polygons[j].points.begin(), polygons[j].points.end());
+            offsets.push_back(block.size());
+            ++j;
+        } while (j < polygon_count && block.size() + polygons[j].points.size() <= BLOCK_POINTS);
+        measureFlat(block.data(), offsets.data(), j - i, areas ? areas + i : nullptr,
+                    perimeters ? perimeters + i : nullptr, kernel);
+        i = j;
+    }
+}
+
+} // namespace
+
+const char* measureKernelName(MeasureKernel kernel) {
+    switch (kernel) {
+        case MeasureKernel::AVX2:
+            return "avx2";
+        case MeasureKernel::AVX512:
+            return "avx512";
+        default:
+            return "scalar";
+    }
+}
+
+bool measureKernelSupported(MeasureKernel kernel) {
+    switch (kernel) {
+#ifdef DFM_MEASURE_SIMD
+        case MeasureKernel::AVX2:
+            return __builtin_cpu_supports("avx2");
+        case MeasureKernel::AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        case MeasureKernel::Scalar:
+            return true;
+        default:
+            return false;
+    }
+}
+
+MeasureKernel activeMeasureKernel() {
+    static const MeasureKernel kernel = detectKernel();
+    return kernel;
+}
+
+void measurePolygons(const Point* points, const uint64_t* offsets, size_t polygon_count, double* areas,
+                     double* perimeters) {
+    measureFlat(points, offsets, polygon_count, areas, perimeters, activeMeasureKernel());
+}
+
+void measurePolygons(const Point* points, const uint64_t* offsets, size_t polygon_count, double* areas,
+                     double* perimeters, MeasureKernel kernel) {
+    checkSupported(kernel);
+    measureFlat(points, offsets, polygon_count, areas, perimeters, kernel);
+}
+
+void measurePolygons(const Polygon* polygons, size_t polygon_count, double* areas, double* perimeters) {
+    measureList(polygons, polygon_count, areas, perimeters, activeMeasureKernel());
+}
+
+void measurePolygons(const Polygon* polygons, size_t polygon_count, double* areas, double* perimeters,
+                     MeasureKernel kernel) {
+    checkSupported(kernel);
+    measureList(polygons, polygon_count, areas, perimeters, kernel);
+}
@@ -0,0 +1,32 @@
+#ifndef POLYGON_MEASURE_H
+#define POLYGON_MEASURE_H
+
+#include "Geometry.h"
+#include <cstddef>
+#include <cstdint>
+
+// Batch area and perimeter of many polygons at once. The vertices are walked as one flat sequence:
+// the x86 kernels compute the cross products and edge lengths of 4 (AVX2) or 8 (AVX-512) edges per
+// step across polygon boundaries, then each polygon sums its own edges in order, so the results are
+// bit-identical to Polygon::calculateArea and calculatePerimeter. The best kernel the CPU supports
+// is chosen at run time, and DFM_MEASURE_KERNEL=scalar|avx2|avx512 overrides the choice.
+enum class MeasureKernel { Scalar, AVX2, AVX512 };
+
+const char* measureKernelName(MeasureKernel kernel);
+bool measureKernelSupported(MeasureKernel kernel);
+// Kernel used by the calls without an explicit kernel, detected on first use
+MeasureKernel activeMeasureKernel();
+
+// Area and perimeter of polygon_count polygons stored back to back, polygon i spanning
+// points[offsets[i]] .. points[offsets[i + 1] - 1] (the layout of FlatLayer). Polygons of fewer
+// than three points measure zero. Either output may be null.
+void measurePolygons(const Point* points, const uint64_t* offsets, size_t polygon_count, double* areas,
+                     double* perimeters);
+void measurePolygons(const Point* points, const uint64_t* offsets, size_t polygon_count, double* areas,
+                     double* perimeters, MeasureKernel kernel);
+// Same for separately allocated polygons, e.g. Layer::polygons; their points are gathered in blocks
+void measurePolygons(const Polygon* polygons, size_t polygon_count, double* areas, double* perimeters);
+void measurePolygons(const Polygon* polygons, size_t polygon_count, double* areas, double* perimeters,
+                     MeasureKernel kernel);
+
+#endif // POLYGON_MEASURE_H